@@ -5,6 +5,7 @@ from pathlib import Path
 from typing import Union, Text, Sequence, Any, Optional
 import os
 
+from agent.calibration import calibration_key, load_profiles, resolve_limits
 from agent.config import load_config
 from agent.execution import run_execution
 from agent.preparation import prepare_for_execution
@@ -44,8 +45,13 @@ def _parse_args_and_env():
 if __name__ == '__main__':
     cli_args = _parse_args_and_env()
     test_suites = load_config(Path(cli_args.config))
-    for test_suite in test_suites:
+    profiles = load_profiles()
+    for test_index, test_suite in enumerate(test_suites):
+        runner_config, limits = resolve_limits(test_suite.execution.get('limits'),
+                                               profiles.get(calibration_key(cli_args.config, test_index)))
         with prepare_for_execution(test_suite.preparation, cli_args.solution) as execution_dir_name:
             execution_dir = Path(execution_dir_name)
-            with run_execution(execution_dir, test_suite.execution, Path(cli_args.runner)) as execution_status_dir_name:
-                validate_execution_results(Path(execution_status_dir_name), test_suite.validation)
+            with run_execution(execution_dir, test_suite.execution, Path(cli_args.runner),
+                               runner_config) as execution_status_dir_name:
+                validate_execution_results(Path(execution_status_dir_name), test_suite.validation, limits,
+                                           runner_config)
@@ -0,0 +1,168 @@
+import argparse
+import json
+import os
+import pathlib
+import platform
+import sys
+import tempfile
+from typing import Optional, Tuple
+
+import munch
+
+from agent.config import load_config
+from agent.execution import run_execution, EXIT_STATUS_FILE
+from agent.preparation import prepare_for_execution, CACHE_DIR_ENV_VARIABLE
+from agent.results import read_exit_status
+from agent.validation import validate_execution_results
+
+# Measured resource profiles of the reference solutions are kept in this file, keyed by the host CPU model.
+CALIBRATION_FILE_ENV_VARIABLE = 'KOURT_CALIBRATION_FILE'
+_DEFAULT_CACHE_DIR = pathlib.Path.home() / '.cache' / 'kourt'
+
+# Runner config a reference solution is measured with: a few repeated runs, counting the instructions retired.
+_CALIBRATION_RUNNER_CONFIG = {
+    'repeat': {'warmupRuns': 1, 'measuredRuns': 5},
+    # large enough never to be hit, it only makes the runner count the instructions
+    'instructionLimit': 1 << 62,
+}
+# CPU time is accounted with a granularity of a scheduler tick, shorter limits would fail correct solutions at random
+_MIN_CPU_MICROS_LIMIT = 10_000
+
+
+def calibration_file() -> pathlib.Path:
+    if CALIBRATION_FILE_ENV_VARIABLE in os.environ:
+        return pathlib.Path(os.environ[CALIBRATION_FILE_ENV_VARIABLE])
+    return pathlib.Path(os.environ.get(CACHE_DIR_ENV_VARIABLE, _DEFAULT_CACHE_DIR)) / 'calibration.json'
+
+
+def host_cpu_model() -> str:
+    try:
+        with open('/proc/cpuinfo', 'r') as f:
+            for line in f:
+                name, _, value = line.partition(':')
+                if name.strip() == 'model name':
+                    return value.strip()
+    except OSError:
+        pass
+    return platform.processor() or platform.machine()
+
+
+def calibration_key(test_suite_file: pathlib.Path, test_index: int) -> str:
+    """
+    Identify a test regardless of where the problems are checked out, so that hosts may share the calibration file.
+
+    :return: ``<problem>/<test suite file name>#<index of the test>``
+    """
+    return f'{test_suite_file.absolute().parent.parent.name}/{test_suite_file.name}#{test_index}'
+
+
+def load_profiles(cpu_model: Optional[str] = None) -> dict:
+    """:return: profiles of the tests measured on hosts with ``cpu_model``, the current host's one by default"""
+    path = calibration_file()
+    if not path.exists():
+        return {}
+    with path.open('r') as f:
+        return json.load(f).get(cpu_model or host_cpu_model(), {})
+
+
+def save_profiles(profiles: dict, cpu_model: Optional[str] = None):
+    """Replace the profiles of ``cpu_model`` in the calibration file, keeping the ones of other hosts."""
+    path = calibration_file()
+    calibration = {}
+    if path.exists():
+        with path.open('r') as f:
+            calibration = json.load(f)
+    calibration[cpu_model or host_cpu_model()] = profiles
+    path.parent.mkdir(parents=True, exist_ok=True)
+    # written aside and renamed into place, so concurrent agents never read a half-written file
+    with tempfile.NamedTemporaryFile('w', dir=str(path.parent), delete=False) as f:
+        json.dump(calibration, f, indent=2, sort_keys=True)
+    os.replace(f.name, path)
+
+
+def profile_from_exit_status(exit_status: dict) -> dict:
+    """:return: median CPU and wall time and the instructions of a run made with the calibration runner config"""
+    repeat = exit_status['repeat']
+    profile = {
+        'cpuMicros': repeat['cpuMicros']['median'],
+        'wallMicros': repeat['wallMicros']['median'],
+    }
+    if 'instructions' in exit_status:
+        profile[exit_status['instructions']['event']] = exit_status['instructions']['count']
+    return profile
+
+
+def resolve_limits(limits: Optional[munch.Munch], profile: Optional[dict]) -> Tuple[dict, dict]:
+    """
+    Turn the limits of a test, written as multiples of the reference's measurements, into absolute ones.
+
+    :return: runner config enforcing the limits and the limits checked by the validation
+    """
+    runner_config = {}
+    validation_limits = {}
+    if not limits:
+        return runner_config, validation_limits
+    if profile is None:
+        print('Test has no calibrated profile for this host, its limits are not applied', file=sys.stderr)
+        return runner_config, validation_limits
+    if 'instructionFactor' in limits:
+        # the task-clock fallback of the runner counts nanoseconds rather than instructions
+        measured = profile.get('instructions', profile.get('taskClockNanos'))
+        if measured is not None:
+            runner_config['instructionLimit'] = max(1, int(measured * limits.instructionFactor))
+    if 'timeFactor' in limits:
+        validation_limits['cpuMicros'] = max(_MIN_CPU_MICROS_LIMIT, profile['cpuMicros'] * limits.timeFactor)
+    return runner_config, validation_limits
+
+
+def calibrate(runner: pathlib.Path, problems_dir: pathlib.Path) -> dict:
+    """
+    Measure every correct solution on every test of its problem on this host.
+
+    :return: profile of the slowest correct solution for each test, keyed by ``calibration_key``
+    """
+    profiles = {}
+    for problem_dir in sorted(filter(pathlib.Path.is_dir, problems_dir.iterdir())):
+        correct_solutions_dir = problem_dir / 'correct-solutions'
+        test_suites_dir = problem_dir / 'test-suites'
+        if not correct_solutions_dir.exists() or not test_suites_dir.exists():
+            continue
+        for test_suite_file in sorted(test_suites_dir.iterdir()):
+            for test_index, test in enumerate(load_config(test_suite_file)):
+                key = calibration_key(test_suite_file, test_index)
+                for solution in sorted(correct_solutions_dir.iterdir()):
+                    profile = _measure(runner, solution, test)
+                    if key not in profiles or profiles[key]['cpuMicros'] < profile['cpuMicros']:
+                        profiles[key] = profile
+    return profiles
+
+
+def _measure(runner: pathlib.Path, solution: pathlib.Path, test: munch.Munch) -> dict:
+    with prepare_for_execution(test.preparation, solution) as execution_dir:
+        with run_execution(pathlib.Path(execution_dir), test.execution, runner,
+                           _CALIBRATION_RUNNER_CONFIG) as status_dir:
+            # a reference which fails the test can't calibrate it
+            validate_execution_results(pathlib.Path(status_dir), test.validation)
+            return profile_from_exit_status(read_exit_status(pathlib.Path(status_dir) / EXIT_STATUS_FILE))
+
+
+def _parse_args():
+    project_root_dir = pathlib.Path(__file__).absolute().parent.parent
+    parser = argparse.ArgumentParser(
+        description='Measure the correct solutions of all problems on this host, '
+                    'so that test limits can be written relative to them.'
+    )
+    parser.add_argument('-r', '--runner', type=pathlib.Path, default=os.environ.get('KOURT_RUNNER_PATH'),
+                        help='Path to runner executable, KOURT_RUNNER_PATH by default')
+    parser.add_argument('-p', '--problems', type=pathlib.Path, default=project_root_dir / 'problems',
+                        help='Directory of the problems')
+    args = parser.parse_args()
+    if args.runner is None:
+        raise ValueError('Path to runner is not provided')
+    return args
+
+
+if __name__ == '__main__':
+    cli_args = _parse_args()
+    save_profiles(calibrate(cli_args.runner.absolute(), cli_args.problems.absolute()))
+    print(f'Calibrated {host_cpu_model()} into {calibration_file()}')
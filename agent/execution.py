@@ -1,7 +1,10 @@
 import json
+import os
+import socket
 import subprocess
 from pathlib import Path
 from tempfile import TemporaryDirectory
+from typing import Optional
 
 from munch import Munch
 
@@ -11,22 +14,42 @@ STDERR_FILE = Path('stderr.txt')
 EXIT_STATUS_FILE = Path('exit-status.json')
 RUNNER_CONFIG_FILE = Path('runnner-config.json')
 
+# If set, executions are submitted to the runner daemon listening on this Unix socket
+# (see `runner --daemon`) instead of spawning a runner per execution.
+RUNNER_SOCKET_ENV_VARIABLE = 'KOURT_RUNNER_SOCKET'
 
-def run_execution(execution_dir: Path, execution_config: Munch, path_to_runner: Path) -> TemporaryDirectory:
+
+def run_execution(
+        execution_dir: Path,
+        execution_config: Munch,
+        path_to_runner: Path,
+        runner_config: Optional[dict] = None) -> TemporaryDirectory:
+    """
+    :param runner_config: additional runner config, e.g. the limits of the test
+    """
     status_dir_cm = TemporaryDirectory()
     status_dir = Path(status_dir_cm.name)
 
-    _prepare_runner_configuration(execution_dir, status_dir)
-    _execute_runner(execution_dir, execution_config, path_to_runner, status_dir)
+    runner_socket = os.environ.get(RUNNER_SOCKET_ENV_VARIABLE)
+    if runner_socket:
+        _submit_to_runner_daemon(execution_dir, execution_config, Path(runner_socket), status_dir, runner_config)
+    else:
+        _prepare_runner_configuration(execution_dir, status_dir, runner_config)
+        _execute_runner(execution_dir, execution_config, path_to_runner, status_dir)
     return status_dir_cm
 
 
-def _prepare_runner_configuration(execution_dir: Path, status_dir: Path):
-    config = {
+def _runner_configuration(status_dir: Path, runner_config: Optional[dict]) -> dict:
+    return {
+        **(runner_config or {}),
         "stdoutFile": str(status_dir / STDOUT_FILE),
         "stderrFile": str(status_dir / STDERR_FILE),
         "exitStatusFile": str(status_dir / EXIT_STATUS_FILE)
     }
+
+
+def _prepare_runner_configuration(execution_dir: Path, status_dir: Path, runner_config: Optional[dict]):
+    config = _runner_configuration(status_dir, runner_config)
     with (status_dir / RUNNER_CONFIG_FILE).open('w') as f:
         json.dump(config, f)
 
@@ -43,3 +66,28 @@ def _execute_runner(execution_dir: Path, execution_config: Munch, path_to_runner
         input=execution_config.stdin.text
         # TODO: capture runner's stdout and stderr
     )
+
+
+def _submit_to_runner_daemon(
+        execution_dir: Path,
+        execution_config: Munch,
+        runner_socket: Path,
+        status_dir: Path,
+        runner_config: Optional[dict]):
+    config = _runner_configuration(status_dir, runner_config)
+    config['workingDirectory'] = str(execution_dir)
+    job = {
+        'id': str(status_dir),
+        'executable': str(execution_dir / execution_config.executable),
+        'argv': execution_config.get('cmdArgs', []),
+        # TODO: support other stdin options
+        'stdin': execution_config.stdin.text,
+        'config': config
+    }
+    with socket.socket(socket.AF_UNIX, socket.SOCK_STREAM) as connection:
+        connection.connect(str(runner_socket))
+        connection.sendall((json.dumps(job) + '\n').encode())
+        with connection.makefile('r') as responses:
+            response = json.loads(responses.readline())
+    if 'error' in response:
+        raise RuntimeError(f'Runner daemon failed to execute {job["executable"]}: {response["error"]}')
@@ -1,17 +1,137 @@
+import functools
+import hashlib
+import os
 import pathlib
+import shlex
 import shutil
 import subprocess
 import tempfile
 
 import munch
 
+# Compiled solutions are cached in this directory, keyed by everything the compilation result depends on.
+CACHE_DIR_ENV_VARIABLE = 'KOURT_CACHE_DIR'
+_DEFAULT_CACHE_DIR = pathlib.Path.home() / '.cache' / 'kourt'
+# Entries are evicted least recently used first, an entry is as big as the prepared solution with its build files.
+MAX_CACHED_PREPARATIONS = 256
+
 
 def prepare_for_execution(preparation_config: munch.Munch, solution_file: pathlib.Path) -> tempfile.TemporaryDirectory:
-    execution_dir_cm = tempfile.TemporaryDirectory()
-    execution_dir = execution_dir_cm.name
+    """
+    Create a directory with the prepared (e.g. compiled) solution.
 
-    dst_path = pathlib.Path(execution_dir) / preparation_config.solutionFileName
-    shutil.copy2(solution_file, dst_path)
+    Preparation is done once per distinct solution, command and compiler: its results are kept in a content-addressed
+    cache and copied into every new execution directory, so a test suite compiles the solution once and an execution
+    can't alter what the next one gets. Failed preparations are not cached. The cache keeps the
+    ``MAX_CACHED_PREPARATIONS`` most recently used entries.
+    """
+    execution_dir_cm = tempfile.TemporaryDirectory()
+    execution_dir = pathlib.Path(execution_dir_cm.name)
 
-    subprocess.run(preparation_config.command, shell=True, cwd=execution_dir)
+    cache_entry = _cache_dir() / 'preparation' / _preparation_key(preparation_config, solution_file)
+    if cache_entry.is_dir() or _prepare_into_cache(preparation_config, solution_file, cache_entry, execution_dir):
+        try:
+            shutil.copytree(cache_entry, execution_dir, dirs_exist_ok=True)
+            os.utime(cache_entry)
+        except OSError:
+            # another agent has evicted the entry meanwhile
+            _clear_dir(execution_dir)
+            _prepare(preparation_config, solution_file, execution_dir)
     return execution_dir_cm
+
+
+def _cache_dir() -> pathlib.Path:
+    return pathlib.Path(os.environ.get(CACHE_DIR_ENV_VARIABLE, _DEFAULT_CACHE_DIR))
+
+
+def _prepare(preparation_config: munch.Munch, solution_file: pathlib.Path, target_dir: pathlib.Path) -> bool:
+    shutil.copy2(solution_file, target_dir / preparation_config.solutionFileName)
+    return subprocess.run(preparation_config.command, shell=True, cwd=str(target_dir)).returncode == 0
+
+
+def _prepare_into_cache(
+        preparation_config: munch.Munch,
+        solution_file: pathlib.Path,
+        cache_entry: pathlib.Path,
+        execution_dir: pathlib.Path) -> bool:
+    """
+    :return: whether the cache entry is ready; if the preparation has failed, its results are put into
+             ``execution_dir`` instead
+    """
+    cache_entry.parent.mkdir(parents=True, exist_ok=True)
+    # Prepared aside and renamed into place, so concurrent agents never see a half-prepared entry.
+    with tempfile.TemporaryDirectory(prefix='.staging-', dir=str(cache_entry.parent)) as staging_dir_name:
+        staging_dir = pathlib.Path(staging_dir_name) / 'entry'
+        staging_dir.mkdir()
+        if not _prepare(preparation_config, solution_file, staging_dir):
+            shutil.copytree(staging_dir, execution_dir, dirs_exist_ok=True)
+            return False
+        try:
+            staging_dir.rename(cache_entry)
+        except OSError:
+            # another agent has prepared the same entry meanwhile
+            pass
+    _evict_least_recently_used(cache_entry.parent)
+    return True
+
+
+def _evict_least_recently_used(preparation_dir: pathlib.Path):
+    entries = []
+    for entry in preparation_dir.iterdir():
+        if entry.name.startswith('.'):
+            continue
+        try:
+            entries.append((entry.stat().st_mtime, entry))
+        except FileNotFoundError:
+            pass
+    entries.sort(reverse=True)
+    for _, entry in entries[MAX_CACHED_PREPARATIONS:]:
+        # Renamed away first, so that other agents either copy the whole entry or don't find it.
+        evicted_dir = pathlib.Path(tempfile.mkdtemp(prefix='.evicted-', dir=str(preparation_dir)))
+        try:
+            entry.rename(evicted_dir / 'entry')
+        except OSError:
+            pass
+        shutil.rmtree(evicted_dir, ignore_errors=True)
+
+
+def _clear_dir(directory: pathlib.Path):
+    for path in directory.iterdir():
+        if path.is_dir() and not path.is_symlink():
+            shutil.rmtree(path)
+        else:
+            path.unlink()
+
+
+def _preparation_key(preparation_config: munch.Munch, solution_file: pathlib.Path) -> str:
+    digest = hashlib.sha256()
+    for part in (
+            solution_file.read_bytes(),
+            preparation_config.solutionFileName.encode(),
+            preparation_config.command.encode(),
+            _compiler_identity(preparation_config.command).encode()
+    ):
+        digest.update(len(part).to_bytes(8, 'little'))
+        digest.update(part)
+    return digest.hexdigest()
+
+
+@functools.lru_cache(maxsize=None)
+def _compiler_identity(command: str) -> str:
+    """
+    Identify the program the preparation command runs, so that upgrading the compiler invalidates the cache.
+
+    :return: resolved path and ``--version`` output of the first word of the command, or an empty string
+             if it can't be determined
+    """
+    try:
+        program = shutil.which(shlex.split(command)[0])
+    except (ValueError, IndexError):
+        return ''
+    if program is None:
+        return ''
+    try:
+        version = subprocess.run([program, '--version'], capture_output=True, text=True, timeout=10).stdout
+    except (OSError, subprocess.SubprocessError):
+        version = ''
+    return f'{os.path.realpath(program)}\n{version}'
@@ -0,0 +1,106 @@
+import json
+import struct
+from pathlib import Path
+from typing import Any, Iterator, Tuple
+
+# Must match kResultSchemaVersion of the runner (see runner/src/include/kourt/runner/results.h)
+SCHEMA_VERSION = 1
+
+_RECORD_MAGIC = b'KR'
+_RECORD_HEADER = struct.Struct('<2sBxI')
+
+
+def read_results(path: Path) -> Iterator[dict]:
+    """
+    Read results written by the runner in the ``json``, ``ndjson`` or ``binary`` result format.
+
+    The format is detected by the first byte of each entry, as the runner's ``ResultReader`` does.
+    """
+    with path.open('rb') as f:
+        while True:
+            first = f.read(1)
+            while first == b'\n':
+                first = f.read(1)
+            if not first:
+                return
+            if first != _RECORD_MAGIC[:1]:
+                yield json.loads(first + f.readline())
+                continue
+            header = first + f.read(_RECORD_HEADER.size - 1)
+            if len(header) != _RECORD_HEADER.size:
+                raise ValueError('Truncated result record header')
+            magic, version, size = _RECORD_HEADER.unpack(header)
+            if magic != _RECORD_MAGIC:
+                raise ValueError('Malformed result record header')
+            if version > SCHEMA_VERSION:
+                raise ValueError(f'Unsupported result schema version {version}')
+            payload = f.read(size)
+            if len(payload) != size:
+                raise ValueError('Truncated result record')
+            value, end = _decode_cbor(payload, 0)
+            if end != size:
+                raise ValueError('Trailing bytes in result record')
+            yield value
+
+
+def read_exit_status(path: Path) -> dict:
+    """
+    Read the exit status of a single execution, whatever result format the runner has been configured with.
+
+    A file shared by several executions holds all their results; the last one is returned then.
+    """
+    exit_status = None
+    for exit_status in read_results(path):
+        pass
+    if exit_status is None:
+        raise ValueError(f'No result in {path}')
+    return exit_status
+
+
+def _decode_cbor(data: bytes, offset: int) -> Tuple[Any, int]:
+    """Decode the subset of CBOR (RFC 8949) produced for JSON values: no tags and no indefinite lengths."""
+    initial = data[offset]
+    major, info = initial >> 5, initial & 0x1f
+    offset += 1
+    if major == 7:
+        if info == 20:
+            return False, offset
+        if info == 21:
+            return True, offset
+        if info == 22:
+            return None, offset
+        if info in (25, 26, 27):
+            size, fmt = {25: (2, '>e'), 26: (4, '>f'), 27: (8, '>d')}[info]
+            return struct.unpack_from(fmt, data, offset)[0], offset + size
+        raise ValueError(f'Unsupported CBOR simple value {info}')
+
+    if info < 24:
+        argument = info
+    elif info <= 27:
+        size = 1 << (info - 24)
+        argument = int.from_bytes(data[offset:offset + size], 'big')
+        offset += size
+    else:
+        raise ValueError(f'Unsupported CBOR additional information {info}')
+
+    if major == 0:
+        return argument, offset
+    if major == 1:
+        return -1 - argument, offset
+    if major == 2:
+        return data[offset:offset + argument], offset + argument
+    if major == 3:
+        return data[offset:offset + argument].decode('utf-8', errors='replace'), offset + argument
+    if major == 4:
+        items = []
+        for _ in range(argument):
+            item, offset = _decode_cbor(data, offset)
+            items.append(item)
+        return items, offset
+    if major == 5:
+        mapping = {}
+        for _ in range(argument):
+            key, offset = _decode_cbor(data, offset)
+            mapping[key], offset = _decode_cbor(data, offset)
+        return mapping, offset
+    raise ValueError(f'Unsupported CBOR major type {major}')
@@ -1,16 +1,25 @@
-import json
 from pathlib import Path
+from typing import Optional
 
 from munch import Munch
 
 from agent.execution import STDOUT_FILE, EXIT_STATUS_FILE
+from agent.results import read_exit_status
 
 
-def validate_execution_results(execution_status_dir: Path, validation_config: Munch):
+def validate_execution_results(execution_status_dir: Path, validation_config: Munch, limits: Optional[dict] = None,
+                               runner_config: Optional[dict] = None):
+    """
+    :param limits: resource limits checked after the execution, e.g. ``cpuMicros`` resolved from the calibration
+    :param runner_config: limits the runner enforced itself, e.g. ``instructionLimit``; the verdict is checked whenever
+                          one is set
+    """
     if 'stdout' in validation_config:
         _validate_stdout(execution_status_dir / STDOUT_FILE, validation_config.stdout)
     if 'returnStatus' in validation_config:
         _validate_return_status(execution_status_dir / EXIT_STATUS_FILE, validation_config.returnStatus)
+    if limits or runner_config:
+        _validate_limits(execution_status_dir / EXIT_STATUS_FILE, limits)
 
 
 def _validate_stdout(stdout_file: Path, requirements: Munch):
@@ -26,9 +35,20 @@ def _validate_stdout(stdout_file: Path, requirements: Munch):
 
 
 def _validate_return_status(exit_status_file: Path, requirements: Munch):
-    with exit_status_file.open('r') as f:
-        exit_status = json.load(f)
-        actual_exit_code = exit_status.get('exitCode', None)
-        expected_exit_code = requirements.expectedValue
-        if actual_exit_code != expected_exit_code:
-            raise AssertionError(f"Expected exit code {expected_exit_code} but got {actual_exit_code}")
+    exit_status = read_exit_status(exit_status_file)
+    actual_exit_code = exit_status.get('exitCode', None)
+    expected_exit_code = requirements.expectedValue
+    if actual_exit_code != expected_exit_code:
+        raise AssertionError(f"Expected exit code {expected_exit_code} but got {actual_exit_code}")
+
+
+def _validate_limits(exit_status_file: Path, limits: dict):
+    exit_status = read_exit_status(exit_status_file)
+    if exit_status.get('verdict') == 'instructionLimitExceeded':
+        raise AssertionError(f"Instruction limit {exit_status['instructions']['limit']} exceeded")
+    if 'cpuMicros' in limits:
+        usage = exit_status['resourceUsage']
+        cpu_micros = usage['userMicros'] + usage['systemMicros']
+        if cpu_micros > limits['cpuMicros']:
+            raise AssertionError(
+                f"Time limit exceeded: {cpu_micros} us of CPU time used, {limits['cpuMicros']:.0f} us allowed")
@@ -0,0 +1,133 @@
+#include <kourt/runner/buffering_detector_interceptor.h>
+#include <kourt/runner/tracing.h>
+
+#include <sys/uio.h>
+#include <cmath>
+#include <cstdint>
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+static const char *kSmallCallBytesKey = "smallCallBytes";
+static const char *kSmallCallShareKey = "smallCallShare";
+static const char *kMinCallsKey = "minCalls";
+
+// Same as UIO_MAXIOV of the kernel: longer vectors fail with EINVAL.
+static const int kMaxIovecs = 1024;
+
+BufferingDetectorInterceptor::BufferingDetectorInterceptor(const nlohmann::json &config) :
+    small_call_bytes_(config.value(kSmallCallBytesKey, uint64_t{16})),
+    small_call_share_(config.value(kSmallCallShareKey, 0.9)),
+    min_calls_(config.value(kMinCallsKey, uint64_t{1000})) {
+  if (small_call_share_ < 0 || small_call_share_ > 1) {
+    throw std::invalid_argument("BufferingDetectorInterceptor: 'smallCallShare' should be in [0, 1]");
+  }
+}
+
+std::optional<std::vector<unsigned long>> BufferingDetectorInterceptor::InterceptedSyscalls() const {
+  return std::vector<unsigned long>{ReadCall::kNumber, WriteCall::kNumber, ReadvCall::kNumber, WritevCall::kNumber};
+}
+
+bool BufferingDetectorInterceptor::InterceptsSyscallExits() const {
+  // the requested sizes are known at the entry already
+  return false;
+}
+
+bool BufferingDetectorInterceptor::Intercept(BeforeSyscallStoppedTracee &tracee) {
+  if (auto read = tracee.As<ReadCall>()) {
+    Record(read->fd, true, read->count);
+  } else if (auto write = tracee.As<WriteCall>()) {
+    Record(write->fd, false, write->count);
+  } else if (auto readv = tracee.As<ReadvCall>()) {
+    Record(readv->fd, true, VectorSize(tracee, readv->iov, readv->iovcnt));
+  } else if (auto writev = tracee.As<WritevCall>()) {
+    Record(writev->fd, false, VectorSize(tracee, writev->iov, writev->iovcnt));
+  }
+  return false;
+}
+
+void BufferingDetectorInterceptor::Record(int fd, bool is_read, uint64_t size) {
+  if (fd < 0) {
+    return;
+  }
+  FdStatistics &fd_statistics = fds_[std::min(fd, kMaxTrackedFd)];
+  DirectionStatistics &statistics = is_read ? fd_statistics.reads : fd_statistics.writes;
+  ++statistics.calls;
+  statistics.bytes += size;
+  if (size < small_call_bytes_) {
+    ++statistics.small_calls;
+  }
+  size_t bucket = size == 0 ? 0 : 64 - __builtin_clzll(size);
+  ++statistics.histogram[std::min(bucket, kHistogramBuckets - 1)];
+}
+
+uint64_t BufferingDetectorInterceptor::VectorSize(SyscallStoppedTracee &tracee, unsigned long iov, int iovcnt) {
+  if (iovcnt <= 0 || iovcnt > kMaxIovecs) {
+    return 0;
+  }
+  uint64_t size = 0;
+  if (tracee.Abi() == SyscallAbi::kI386) {
+    std::vector<uint32_t> iovecs(2 * iovcnt);
+    size_t copied = tracee.ReadMemory(iov, iovecs.data(), iovecs.size() * sizeof(uint32_t));
+    for (size_t i = 0; (i + 1) * 2 * sizeof(uint32_t) <= copied; ++i) {
+      size += iovecs[2 * i + 1];
+    }
+  } else {
+    std::vector<iovec> iovecs(iovcnt);
+    size_t copied = tracee.ReadMemory(iov, iovecs.data(), iovecs.size() * sizeof(iovec));
+    for (size_t i = 0; (i + 1) * sizeof(iovec) <= copied; ++i) {
+      size += iovecs[i].iov_len;
+    }
+  }
+  return size;
+}
+
+nlohmann::json BufferingDetectorInterceptor::DirectionToJson(const DirectionStatistics &statistics) const {
+  return {
+      {"calls", statistics.calls},
+      {"smallCalls", statistics.small_calls},
+      {"bytes", statistics.bytes},
+      {"histogram", statistics.histogram},
+  };
+}
+
+void BufferingDetectorInterceptor::MaybeReport(const std::string &fd,
+                                               const char *direction,
+                                               const DirectionStatistics &statistics,
+                                               nlohmann::json *findings) const {
+  if (statistics.calls == 0 || statistics.calls < min_calls_) {
+    return;
+  }
+  const double share = static_cast<double>(statistics.small_calls) / static_cast<double>(statistics.calls);
+  if (share <= small_call_share_) {
+    return;
+  }
+  const bool is_read = std::string(direction) == "reads";
+  findings->push_back({
+      {"fd", fd},
+      {"direction", direction},
+      {"calls", statistics.calls},
+      {"smallCallShare", share},
+      {"message", std::to_string(static_cast<int>(std::floor(share * 100))) + "% of " + std::to_string(statistics.calls)
+          + (is_read ? " reads from fd " : " writes to fd ") + fd + " request less than "
+          + std::to_string(small_call_bytes_) + " bytes, consider buffering the "
+          + (is_read ? "input" : "output")},
+  });
+}
+
+nlohmann::json BufferingDetectorInterceptor::CollectStatistics() const {
+  nlohmann::json fds = nlohmann::json::object();
+  nlohmann::json findings = nlohmann::json::array();
+  for (int fd = 0; fd <= kMaxTrackedFd; ++fd) {
+    const FdStatistics &statistics = fds_[fd];
+    if (statistics.reads.calls == 0 && statistics.writes.calls == 0) {
+      continue;
+    }
+    const std::string fd_name = fd < kMaxTrackedFd ? std::to_string(fd) : "other";
+    fds[fd_name] = {{"reads", DirectionToJson(statistics.reads)}, {"writes", DirectionToJson(statistics.writes)}};
+    MaybeReport(fd_name, "reads", statistics.reads, &findings);
+    MaybeReport(fd_name, "writes", statistics.writes, &findings);
+  }
+  return {{"fds", fds}, {"findings", findings}};
+}
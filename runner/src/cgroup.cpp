@@ -0,0 +1,165 @@
+#include <kourt/runner/cgroup.h>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+
+#include <kourt/runner/config.h>
+#include <kourt/runner/logging.h>
+
+static const char *kCgroupParentKey = "parent";
+static const char *kDefaultCgroupParent = "/sys/fs/cgroup";
+
+// Limit config keys and the control files they are written to
+static const std::pair<const char *, const char *> kCgroupLimits[] = {
+    {"memoryMax", "memory.max"},
+    {"cpuMax", "cpu.max"},
+    {"pidsMax", "pids.max"},
+};
+
+static std::string NextCgroupName() {
+  static std::atomic<unsigned> counter{0};
+  return "kourt-runner-" + std::to_string(getpid()) + "-" + std::to_string(counter++);
+}
+
+static bool ReadControlFile(const std::string &path, std::string *content) {
+  std::ifstream in(path);
+  if (!in) {
+    return false;
+  }
+  std::stringstream buffer;
+  buffer << in.rdbuf();
+  *content = buffer.str();
+  return true;
+}
+
+/// Parses flat-keyed files like <code>cpu.stat</code> and <code>memory.events</code>.
+static std::unordered_map<std::string, unsigned long long> ParseKeyedFile(const std::string &content) {
+  std::unordered_map<std::string, unsigned long long> result;
+  std::istringstream in(content);
+  std::string key;
+  unsigned long long value;
+  while (in >> key >> value) {
+    result[key] = value;
+  }
+  return result;
+}
+
+Cgroup::Cgroup(const std::string &parent_path) :
+    parent_path_(parent_path),
+    path_(parent_path + "/" + NextCgroupName()) {
+  if (0 != mkdir(path_.c_str(), 0755)) {
+    int error_code = errno;
+    throw std::runtime_error("Failed to create cgroup " + path_ + ": " + strerror(error_code));
+  }
+  directory_fd_ = open(path_.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (directory_fd_ < 0) {
+    int error_code = errno;
+    rmdir(path_.c_str());
+    throw std::runtime_error("Failed to open cgroup " + path_ + ": " + strerror(error_code));
+  }
+  DEBUG("Created cgroup %s", path_.c_str());
+}
+
+Cgroup::~Cgroup() {
+  KillRemainingProcesses();
+  close(directory_fd_);
+  // The kernel may need a moment to release the group after its last process has been reaped.
+  for (int attempt = 0; attempt < 100; ++attempt) {
+    if (0 == rmdir(path_.c_str()) || errno != EBUSY) {
+      DEBUG("Removed cgroup %s", path_.c_str());
+      return;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  WARN("Failed to remove cgroup %s: %s", path_.c_str(), strerror(errno));
+}
+
+void Cgroup::KillRemainingProcesses() {
+  // cgroup.kill appeared in Linux 5.14; on older kernels descendants of the tracee are left alone.
+  int kill_fd = openat(directory_fd_, "cgroup.kill", O_WRONLY | O_CLOEXEC);
+  if (kill_fd >= 0) {
+    if (write(kill_fd, "1", 1) != 1) {
+      WARN("Failed to kill processes of cgroup %s: %s", path_.c_str(), strerror(errno));
+    }
+    close(kill_fd);
+  }
+}
+
+void Cgroup::EnableControllerInParent(const std::string &controller) {
+  std::ofstream subtree_control(parent_path_ + "/cgroup.subtree_control");
+  subtree_control << "+" << controller;
+  subtree_control.flush();
+  if (!subtree_control) {
+    WARN("Failed to enable %s controller in %s", controller.c_str(), parent_path_.c_str());
+  }
+}
+
+void Cgroup::SetLimit(const std::string &control_file, const std::string &value) {
+  const std::string file_path = path_ + "/" + control_file;
+  if (0 != access(file_path.c_str(), F_OK)) {
+    EnableControllerInParent(control_file.substr(0, control_file.find('.')));
+  }
+  std::ofstream out(file_path);
+  out << value;
+  out.flush();
+  if (!out) {
+    throw std::runtime_error("Failed to write '" + value + "' to " + file_path);
+  }
+  DEBUG("Set %s to '%s' for cgroup %s", control_file.c_str(), value.c_str(), path_.c_str());
+}
+
+nlohmann::json Cgroup::CollectStatistics() const {
+  nlohmann::json statistics = nlohmann::json::object();
+  std::string content;
+  if (ReadControlFile(path_ + "/memory.peak", &content)) {
+    statistics["memoryPeak"] = std::stoull(content);
+  }
+  if (ReadControlFile(path_ + "/cpu.stat", &content)) {
+    auto cpu_stat = ParseKeyedFile(content);
+    statistics["cpuUsageMicros"] = cpu_stat["usage_usec"];
+    statistics["cpuUserMicros"] = cpu_stat["user_usec"];
+    statistics["cpuSystemMicros"] = cpu_stat["system_usec"];
+    if (cpu_stat.count("nr_throttled")) {
+      statistics["cpuThrottledPeriods"] = cpu_stat["nr_throttled"];
+    }
+  }
+  if (ReadControlFile(path_ + "/memory.events", &content)) {
+    auto memory_events = ParseKeyedFile(content);
+    statistics["memoryMaxEvents"] = memory_events["max"];
+    statistics["oomKills"] = memory_events["oom_kill"];
+  }
+  if (ReadControlFile(path_ + "/pids.events", &content)) {
+    statistics["pidsMaxEvents"] = ParseKeyedFile(content)["max"];
+  }
+  return statistics;
+}
+
+static std::string LimitToString(const nlohmann::json &value) {
+  return value.is_string() ? value.get<std::string>() : value.dump();
+}
+
+std::unique_ptr<Cgroup> CreateCgroupIfConfigured(const nlohmann::json &config) {
+  if (!config.contains(kCgroupKey)) {
+    return nullptr;
+  }
+  const nlohmann::json &cgroup_config = config[kCgroupKey];
+  auto cgroup = std::make_unique<Cgroup>(cgroup_config.value(kCgroupParentKey, kDefaultCgroupParent));
+  for (auto &[config_key, control_file] : kCgroupLimits) {
+    if (cgroup_config.contains(config_key)) {
+      cgroup->SetLimit(control_file, LimitToString(cgroup_config[config_key]));
+    }
+  }
+  return cgroup;
+}
@@ -0,0 +1,490 @@
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <csignal>
+#include <cstring>
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+
+#include <kourt/runner/config.h>
+#include <kourt/runner/daemon.h>
+#include <kourt/runner/logging.h>
+#include <kourt/runner/metrics.h>
+#include <kourt/runner/runner_main.h>
+#include <kourt/runner/system.h>
+
+namespace fs = std::filesystem;
+
+const char *kDaemonFlag = "--daemon";
+
+static const char *kWorkersKey = "workers";
+static const char *kPinWorkersKey = "pinWorkers";
+static const char *kMetricsSocketKey = "metricsSocket";
+
+static const int kMetricsFilePeriodMillis = 1000;
+
+static const char *kJobIdKey = "id";
+static const char *kJobExecutableKey = "executable";
+static const char *kJobArgvKey = "argv";
+static const char *kJobStdinKey = "stdin";
+static const char *kJobConfigKey = "config";
+static const char *kJobShutdownKey = "shutdown";
+static const char *kJobStatisticsKey = "statistics";
+static const char *kJobExitStatusKey = "exitStatus";
+static const char *kJobSchedulingKey = "scheduling";
+static const char *kJobErrorKey = "error";
+
+// Requests carry the whole stdin of a test, but a line of this size is certainly not a request.
+static const size_t kMaxRequestSize = 256 * 1024 * 1024;
+
+static sigset_t ShutdownSignals() {
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  return signals;
+}
+
+/// @return CPUs the daemon is allowed to run on.
+static std::vector<int> AllowedCpus() {
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  if (0 != sched_getaffinity(0, sizeof(cpu_set), &cpu_set)) {
+    throw SystemError("sched_getaffinity");
+  }
+  std::vector<int> cpus;
+  for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+    if (CPU_ISSET(cpu, &cpu_set)) {
+      cpus.push_back(cpu);
+    }
+  }
+  return cpus;
+}
+
+/// @return in-memory file with <code>content</code>, positioned at its beginning.
+static int CreateStdinFile(const std::string &content) {
+  int fd = memfd_create("kourt-stdin", MFD_CLOEXEC);
+  if (fd < 0) {
+    throw SystemError("memfd_create");
+  }
+  for (size_t written = 0; written < content.size();) {
+    ssize_t result = write(fd, content.data() + written, content.size() - written);
+    if (result < 0 && errno != EINTR) {
+      auto error = SystemError("write stdin");
+      close(fd);
+      throw error;
+    }
+    written += std::max<ssize_t>(result, 0);
+  }
+  lseek(fd, 0, SEEK_SET);
+  return fd;
+}
+
+DaemonConnection::DaemonConnection(int socket_fd) :
+    socket_fd_(socket_fd) {
+  // nop
+}
+
+DaemonConnection::~DaemonConnection() {
+  close(socket_fd_);
+}
+
+bool DaemonConnection::ReadLine(std::string *line) {
+  for (;;) {
+    auto newline = buffer_.find('\n');
+    if (newline != std::string::npos) {
+      *line = buffer_.substr(0, newline);
+      buffer_.erase(0, newline + 1);
+      return true;
+    }
+    if (buffer_.size() > kMaxRequestSize) {
+      throw std::runtime_error("Request exceeds " + std::to_string(kMaxRequestSize) + " bytes");
+    }
+    char chunk[64 * 1024];
+    ssize_t bytes_read = read(socket_fd_, chunk, sizeof(chunk));
+    if (bytes_read < 0 && errno == EINTR) {
+      continue;
+    }
+    if (bytes_read <= 0) {
+      return false;
+    }
+    buffer_.append(chunk, bytes_read);
+  }
+}
+
+void DaemonConnection::Send(const nlohmann::json &message) {
+  // inlined outputs of the tracee may be arbitrary bytes rather than UTF-8
+  const std::string line = message.dump(-1, ' ', false, nlohmann::json::error_handler_t::replace) + "\n";
+  std::scoped_lock lock(send_mutex_);
+  for (size_t sent = 0; sent < line.size();) {
+    ssize_t result = send(socket_fd_, line.data() + sent, line.size() - sent, MSG_NOSIGNAL);
+    if (result < 0 && errno == EINTR) {
+      continue;
+    }
+    if (result < 0) {
+      WARN("Failed to send response to a client: %s", strerror(errno))
+      return;
+    }
+    sent += result;
+  }
+}
+
+void DaemonConnection::StopReading() {
+  shutdown(socket_fd_, SHUT_RD);
+}
+
+/// @return descriptor of a socket listening on <code>socket_path</code>, accessible to the current user only.
+static int ListenOnUnixSocket(const std::string &socket_path) {
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  if (socket_path.size() >= sizeof(address.sun_path)) {
+    throw std::invalid_argument("Socket path is too long: " + socket_path);
+  }
+  strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+  if (fs::is_socket(socket_path)) {
+    // left by a previous daemon which hasn't been shut down properly
+    fs::remove(socket_path);
+  }
+
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    throw SystemError("socket");
+  }
+  if (0 != bind(fd, (sockaddr *) &address, sizeof(address))) {
+    auto error = SystemError("bind " + socket_path);
+    close(fd);
+    throw error;
+  }
+  chmod(socket_path.c_str(), 0600);
+  if (0 != listen(fd, SOMAXCONN)) {
+    auto error = SystemError("listen " + socket_path);
+    close(fd);
+    throw error;
+  }
+  return fd;
+}
+
+/// Answers a scrape with the metrics as a minimal HTTP/1.0 response, e.g. for
+/// <code>curl --unix-socket metrics.sock http://localhost/metrics</code>.
+static void ServeMetricsScrape(int listen_fd) {
+  int client_fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+  if (client_fd < 0) {
+    return;
+  }
+  // The scrape is served on the accepting thread, so a stalled client must not block it for long.
+  timeval timeout{1, 0};
+  setsockopt(client_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  setsockopt(client_fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+  std::string request;
+  char chunk[4096];
+  while (request.find("\r\n\r\n") == std::string::npos && request.size() < 64 * 1024) {
+    ssize_t bytes_read = read(client_fd, chunk, sizeof(chunk));
+    if (bytes_read <= 0) {
+      break;
+    }
+    request.append(chunk, bytes_read);
+  }
+  const std::string metrics = RenderMetrics();
+  const std::string response = "HTTP/1.0 200 OK\r\n"
+                               "Content-Type: text/plain; version=0.0.4\r\n"
+                               "Content-Length: " + std::to_string(metrics.size()) + "\r\n\r\n" + metrics;
+  for (size_t sent = 0; sent < response.size();) {
+    ssize_t result = send(client_fd, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+    if (result <= 0) {
+      break;
+    }
+    sent += result;
+  }
+  close(client_fd);
+}
+
+/// A failed write is retried on the next period: the file is a view of the metrics, not a reason to stop serving.
+static void TryWriteMetricsFile(const std::string &path) {
+  try {
+    WriteMetricsFile(path);
+  } catch (std::runtime_error &e) {
+    WARN("%s", e.what())
+  }
+}
+
+/// @return number of workers set by the daemon config, one per allowed CPU by default.
+static unsigned WorkerCount(const nlohmann::json &daemon_config, size_t allowed_cpus) {
+  const long long workers = daemon_config.value(kWorkersKey, static_cast<long long>(std::max<size_t>(1, allowed_cpus)));
+  if (workers < 1) {
+    throw std::invalid_argument(std::string(kWorkersKey) + " should be at least 1: " + std::to_string(workers));
+  }
+  return static_cast<unsigned>(workers);
+}
+
+Daemon::Daemon(std::string socket_path, const nlohmann::json &daemon_config) :
+    socket_path_(std::move(socket_path)),
+    metrics_socket_path_(daemon_config.value(kMetricsSocketKey, "")),
+    metrics_file_(daemon_config.value(kMetricsFileKey, "")) {
+  const std::vector<int> cpus = AllowedCpus();
+  const bool pin_workers = daemon_config.value(kPinWorkersKey, true);
+  const unsigned workers = WorkerCount(daemon_config, cpus.size());
+
+  listen_fd_ = ListenOnUnixSocket(socket_path_);
+  if (!metrics_socket_path_.empty()) {
+    metrics_listen_fd_ = ListenOnUnixSocket(metrics_socket_path_);
+  }
+
+  shutdown_event_fd_ = eventfd(0, EFD_CLOEXEC);
+  sigset_t signals = ShutdownSignals();
+  signal_fd_ = signalfd(-1, &signals, SFD_CLOEXEC);
+  if (shutdown_event_fd_ < 0 || signal_fd_ < 0) {
+    throw SystemError("eventfd/signalfd");
+  }
+
+  for (unsigned i = 0; i < workers; ++i) {
+    // A tracer and its tracee take turns rather than run in parallel, so they share the core:
+    // that saves a cross-CPU wakeup on every stop, and the tracees of different workers don't disturb each other.
+    workers_.emplace_back(&Daemon::RunWorker, this, pin_workers ? cpus[i % cpus.size()] : -1);
+  }
+  INFO("Listening on %s with %u workers", socket_path_.c_str(), workers)
+}
+
+Daemon::~Daemon() {
+  {
+    std::scoped_lock lock(mutex_);
+    stopping_ = true;
+  }
+  jobs_available_.notify_all();
+  for (auto &worker : workers_) {
+    if (worker.joinable()) {
+      worker.join();
+    }
+  }
+  close(listen_fd_);
+  close(metrics_listen_fd_);
+  close(shutdown_event_fd_);
+  close(signal_fd_);
+  unlink(socket_path_.c_str());
+  if (!metrics_socket_path_.empty()) {
+    unlink(metrics_socket_path_.c_str());
+  }
+}
+
+void Daemon::Serve() {
+  auto metrics_written_at = std::chrono::steady_clock::now();
+  for (;;) {
+    pollfd fds[] = {
+        {shutdown_event_fd_, POLLIN, 0},
+        {signal_fd_, POLLIN, 0},
+        {listen_fd_, POLLIN, 0},
+        {metrics_listen_fd_, POLLIN, 0},
+    };
+    const int timeout_millis = metrics_file_.empty() ? -1 : kMetricsFilePeriodMillis;
+    // poll ignores negative descriptors, e.g. the metrics socket when it is not configured
+    if (poll(fds, std::size(fds), timeout_millis) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw SystemError("poll");
+    }
+    if (fds[0].revents || fds[1].revents) {
+      break;
+    }
+    const auto now = std::chrono::steady_clock::now();
+    if (!metrics_file_.empty() && now - metrics_written_at >= std::chrono::milliseconds(kMetricsFilePeriodMillis)) {
+      TryWriteMetricsFile(metrics_file_);
+      metrics_written_at = now;
+    }
+    if (fds[3].revents) {
+      ServeMetricsScrape(metrics_listen_fd_);
+    }
+    if (!fds[2].revents) {
+      continue;
+    }
+    int client_fd = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+    if (client_fd < 0) {
+      WARN("accept4: %s", strerror(errno))
+      continue;
+    }
+    auto connection = std::make_shared<DaemonConnection>(client_fd);
+    {
+      std::scoped_lock lock(mutex_);
+      ++active_connections_;
+      connections_.erase(
+          std::remove_if(connections_.begin(), connections_.end(), [](auto &weak) { return weak.expired(); }),
+          connections_.end());
+      connections_.emplace_back(connection);
+    }
+    std::thread(&Daemon::ServeConnection, this, connection).detach();
+  }
+
+  INFO("Shutting down")
+  close(listen_fd_);
+  listen_fd_ = -1;
+  if (!metrics_file_.empty()) {
+    TryWriteMetricsFile(metrics_file_);
+  }
+  unlink(socket_path_.c_str());
+  {
+    // Clients can't submit jobs anymore, but get responses to the accepted ones.
+    std::unique_lock lock(mutex_);
+    for (auto &weak_connection : connections_) {
+      if (auto connection = weak_connection.lock()) {
+        connection->StopReading();
+      }
+    }
+    connections_closed_.wait(lock, [this] { return active_connections_ == 0; });
+    stopping_ = true;
+  }
+  jobs_available_.notify_all();
+  for (auto &worker : workers_) {
+    worker.join();
+  }
+}
+
+void Daemon::ServeConnection(const std::shared_ptr<DaemonConnection> &connection) {
+  try {
+    for (std::string line; connection->ReadLine(&line);) {
+      if (line.empty()) {
+        continue;
+      }
+      nlohmann::json request;
+      try {
+        request = nlohmann::json::parse(line);
+      } catch (nlohmann::json::exception &e) {
+        connection->Send({{kJobIdKey, nullptr}, {kJobErrorKey, e.what()}});
+        continue;
+      }
+      if (request.value(kJobShutdownKey, false)) {
+        RequestShutdown();
+      } else if (request.value(kJobStatisticsKey, false)) {
+        std::unique_lock lock(mutex_);
+        nlohmann::json statistics = scheduler_.CollectStatistics();
+        lock.unlock();
+        connection->Send({{kJobIdKey, request.value(kJobIdKey, nlohmann::json())}, {kJobStatisticsKey, statistics}});
+      } else {
+        // the request is moved into the job, so its id is kept for the error response
+        nlohmann::json job_id = request.value(kJobIdKey, nlohmann::json());
+        try {
+          Submit(DaemonJob{std::move(request), connection});
+        } catch (std::invalid_argument &e) {
+          connection->Send({{kJobIdKey, std::move(job_id)}, {kJobErrorKey, e.what()}});
+        }
+      }
+    }
+  } catch (std::exception &e) {
+    connection->Send({{kJobIdKey, nullptr}, {kJobErrorKey, e.what()}});
+  }
+
+  std::scoped_lock lock(mutex_);
+  --active_connections_;
+  connections_closed_.notify_all();
+}
+
+void Daemon::Submit(DaemonJob &&job) {
+  {
+    std::scoped_lock lock(mutex_);
+    scheduler_.Push(std::move(job));
+  }
+  jobs_available_.notify_one();
+}
+
+void Daemon::RunWorker(int cpu) {
+  if (cpu >= 0) {
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET(cpu, &cpu_set);
+    if (int error = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set)) {
+      WARN("Failed to pin worker to CPU %d: %s", cpu, strerror(error))
+      cpu = -1;
+    }
+  }
+  for (;;) {
+    std::optional<DaemonJob> job;
+    {
+      std::unique_lock lock(mutex_);
+      jobs_available_.wait(lock, [this] { return stopping_ || !scheduler_.Empty(); });
+      job = scheduler_.Pop();
+      if (!job) {
+        return;
+      }
+    }
+    ExecuteJob(*job, cpu);
+  }
+}
+
+void Daemon::ExecuteJob(const DaemonJob &job, int cpu) {
+  const nlohmann::json &request = job.request;
+  nlohmann::json response = {{kJobIdKey, request.value(kJobIdKey, nlohmann::json())}};
+  int stdin_fd = -1;
+  try {
+    const std::string executable = request.at(kJobExecutableKey);
+    nlohmann::json config = request.value(kJobConfigKey, nlohmann::json::object());
+    if (cpu >= 0 && !config.contains(kCpuAffinityKey)) {
+      config[kCpuAffinityKey] = {cpu};
+    }
+    if (request.contains(kJobIdKey) && !config.contains(kResultIdKey)) {
+      // results of many jobs may be appended to a single file, so they are told apart by the job id
+      config[kResultIdKey] = request[kJobIdKey];
+    }
+    std::vector<std::string> args{executable};
+    for (auto &arg : request.value(kJobArgvKey, nlohmann::json::array())) {
+      args.push_back(arg);
+    }
+    std::vector<char *> argv;
+    for (auto &arg : args) {
+      argv.push_back(arg.data());
+    }
+    argv.push_back(nullptr);
+    if (request.contains(kJobStdinKey)) {
+      stdin_fd = CreateStdinFile(request[kJobStdinKey]);
+    }
+
+    nlohmann::json exit_status = LaunchRunner(config, executable.c_str(), argv.data(), stdin_fd);
+    if (config.contains(kExitStatusFileKey)) {
+      PrintExitStatus(exit_status, config);
+    }
+    response[kJobExitStatusKey] = std::move(exit_status);
+    response[kJobSchedulingKey] = {
+        {"waitMicros", job.wait.count()},
+        {kCpuAffinityKey, config.value(kCpuAffinityKey, nlohmann::json())},
+    };
+  } catch (std::exception &e) {
+    IncrementCounter(Counter::kLaunchFailures);
+    ERROR("Job %s failed: %s", response[kJobIdKey].dump().c_str(), e.what())
+    response[kJobErrorKey] = e.what();
+  }
+  if (stdin_fd >= 0) {
+    close(stdin_fd);
+  }
+  job.connection->Send(response);
+}
+
+void Daemon::RequestShutdown() {
+  uint64_t one = 1;
+  (void) !write(shutdown_event_fd_, &one, sizeof(one));
+}
+
+int DaemonMain(const char *socket_path, const char *path_to_config) {
+  nlohmann::json config = nlohmann::json::object();
+  if (path_to_config) {
+    std::ifstream config_stream(path_to_config);
+    config_stream >> config;
+  }
+
+  // Blocked before any thread is started, so that the signals are consumed by the signalfd only.
+  sigset_t signals = ShutdownSignals();
+  sigset_t previous_signals;
+  pthread_sigmask(SIG_BLOCK, &signals, &previous_signals);
+  {
+    Daemon daemon(socket_path, config);
+    daemon.Serve();
+  }
+  pthread_sigmask(SIG_SETMASK, &previous_signals, nullptr);
+  return 0;
+}
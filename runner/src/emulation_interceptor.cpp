@@ -0,0 +1,142 @@
+#include <kourt/runner/emulation_interceptor.h>
+#include <kourt/runner/tracing.h>
+
+#include <sys/auxv.h>
+#include <cerrno>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+static const char *kStdinFileKey = "stdinFile";
+static const char *kClockKey = "clock";
+static const char *kClockStartNanosKey = "startNanos";
+static const char *kClockStepNanosKey = "stepNanos";
+static const char *kRandomSeedKey = "randomSeed";
+
+// Emulated syscalls transfer the data in chunks of this size, so that a huge count doesn't allocate a huge buffer.
+static const size_t kMaxChunkSize = 1 << 20;
+
+EmulationInterceptor::EmulationInterceptor(const nlohmann::json &config) {
+  if (config.contains(kStdinFileKey)) {
+    const std::string stdin_file = config[kStdinFileKey];
+    std::ifstream in(stdin_file, std::ifstream::binary);
+    if (!in) {
+      throw std::runtime_error("Failed to open " + stdin_file);
+    }
+    std::ostringstream content;
+    content << in.rdbuf();
+    stdin_content_ = content.str();
+  }
+  if (config.contains(kClockKey)) {
+    emulate_clock_ = true;
+    clock_nanos_ = config[kClockKey].value(kClockStartNanosKey, int64_t{0});
+    clock_step_nanos_ = config[kClockKey].value(kClockStepNanosKey, int64_t{1'000});
+  }
+  if (config.contains(kRandomSeedKey)) {
+    random_.emplace(config[kRandomSeedKey].get<uint64_t>());
+  }
+}
+
+void EmulationInterceptor::OnExec(Tracee &tracee) {
+  if (!emulate_clock_) {
+    return;
+  }
+  // The loader finds the vDSO through AT_SYSINFO_EHDR in the auxiliary vector, which lies on the initial stack
+  // after argv and envp. Once the entry is ignored, the libc makes real syscalls for the time.
+  SyscallRegisters registers;
+  registers.Load(tracee);
+  const size_t word_size = (registers.Abi() == SyscallAbi::kI386) ? 4 : 8;
+  unsigned long address = registers.StackPointer();
+  auto read_word = [&]() {
+    uint64_t word = 0;
+    if (word_size != tracee.ReadMemory(address, &word, word_size)) {
+      throw std::runtime_error("Failed to read the initial stack of the tracee");
+    }
+    address += word_size;
+    return word;
+  };
+
+  const uint64_t argc = read_word();
+  address += (argc + 1) * word_size;
+  while (read_word() != 0) {
+    // skip envp
+  }
+  for (uint64_t type = read_word(); type != AT_NULL; type = read_word()) {
+    if (type == AT_SYSINFO_EHDR) {
+      const uint64_t ignored = AT_IGNORE;
+      tracee.WriteMemory(address - word_size, &ignored, word_size);
+      DEBUG("Hid the vDSO from the tracee")
+    }
+    read_word();  // value
+  }
+}
+
+std::optional<std::vector<unsigned long>> EmulationInterceptor::InterceptedSyscalls() const {
+  return std::vector<unsigned long>{ReadCall::kNumber, ClockGettimeCall::kNumber, GetrandomCall::kNumber};
+}
+
+bool EmulationInterceptor::InterceptsSyscallExits() const {
+  // the results of the emulated syscalls are set by skipping them
+  return false;
+}
+
+nlohmann::json EmulationInterceptor::CollectStatistics() const {
+  return {
+      {"emulatedReads", emulated_reads_},
+      {"emulatedClockReads", emulated_clock_reads_},
+      {"emulatedGetrandoms", emulated_getrandoms_},
+  };
+}
+
+bool EmulationInterceptor::Intercept(BeforeSyscallStoppedTracee &tracee) {
+  if (auto read = tracee.As<ReadCall>()) {
+    if (stdin_content_ && read->fd == 0) {
+      EmulateRead(tracee, read->buf, read->count);
+    }
+  } else if (auto clock_gettime = tracee.As<ClockGettimeCall>()) {
+    if (emulate_clock_ && tracee.Abi() == SyscallAbi::kX86_64) {
+      EmulateClockGettime(tracee, clock_gettime->tp);
+    }
+  } else if (auto getrandom = tracee.As<GetrandomCall>()) {
+    if (random_) {
+      EmulateGetrandom(tracee, getrandom->buf, getrandom->buflen);
+    }
+  }
+  return false;
+}
+
+void EmulationInterceptor::EmulateRead(BeforeSyscallStoppedTracee &tracee, unsigned long buffer, size_t count) {
+  count = std::min({count, stdin_content_->size() - stdin_offset_, kMaxChunkSize});
+  size_t written = tracee.WriteMemory(buffer, stdin_content_->data() + stdin_offset_, count);
+  if (written == 0 && count > 0) {
+    tracee.SkipSyscall(-EFAULT);
+    return;
+  }
+  stdin_offset_ += written;
+  ++emulated_reads_;
+  tracee.SkipSyscall(static_cast<long>(written));
+}
+
+void EmulationInterceptor::EmulateClockGettime(BeforeSyscallStoppedTracee &tracee, unsigned long timespec_address) {
+  const int64_t time[2] = {clock_nanos_ / 1'000'000'000, clock_nanos_ % 1'000'000'000};
+  if (sizeof(time) != tracee.WriteMemory(timespec_address, time, sizeof(time))) {
+    tracee.SkipSyscall(-EFAULT);
+    return;
+  }
+  clock_nanos_ += clock_step_nanos_;
+  ++emulated_clock_reads_;
+  tracee.SkipSyscall(0);
+}
+
+void EmulationInterceptor::EmulateGetrandom(BeforeSyscallStoppedTracee &tracee, unsigned long buffer, size_t length) {
+  std::vector<uint64_t> words((std::min(length, kMaxChunkSize) + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+  for (auto &word : words) {
+    word = (*random_)();
+  }
+  size_t written = tracee.WriteMemory(buffer, words.data(), std::min(length, kMaxChunkSize));
+  ++emulated_getrandoms_;
+  tracee.SkipSyscall((written == 0 && length > 0) ? -EFAULT : static_cast<long>(written));
+}
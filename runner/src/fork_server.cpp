@@ -0,0 +1,180 @@
+#include <kourt/runner/fork_server.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <climits>
+#include <csignal>
+#include <cstring>
+
+#include <stdexcept>
+#include <string>
+
+// Code segment selector of 64-bit user code on x86-64 Linux.
+static const unsigned long kX86_64UserCodeSegment = 0x33;
+// Encoding of the syscall instruction.
+static const unsigned char kSyscallInstruction[] = {0x0f, 0x05};
+// Room for the paths of the test files.
+static const unsigned long kScratchSize = 2 * PATH_MAX;
+
+static bool IsSyscallError(long result) {
+  return result < 0 && result > -4096;
+}
+
+/**
+ * Resumes <code>process</code> until the exit of a syscall, discarding the signals delivered in the meantime.
+ *
+ * @param in_syscall whether the process is stopped at the entry of the syscall already
+ * @param forked_pid set to the pid of a process forked in the meantime, if it is not null
+ */
+static void ContinueToSyscallExit(Tracee &process, bool in_syscall, pid_t *forked_pid) {
+  process.Ptrace(PTRACE_SYSCALL, nullptr, nullptr);
+  for (;;) {
+    int wait_status = process.Wait();
+    if (!WIFSTOPPED(wait_status)) {
+      throw std::runtime_error("Fork server process has terminated with status " + std::to_string(wait_status));
+    }
+    if (WSTOPSIG(wait_status) == (SIGTRAP | 0x80)) {
+      // syscall-enter-stops and syscall-exit-stops alternate, seccomp stops are reported as events
+      if (in_syscall) {
+        return;
+      }
+      in_syscall = true;
+    } else if (wait_status >> 8 == (SIGTRAP | (PTRACE_EVENT_FORK << 8)) && forked_pid) {
+      unsigned long message = 0;
+      process.Ptrace(PTRACE_GETEVENTMSG, nullptr, &message);
+      *forked_pid = static_cast<pid_t>(message);
+    }
+    // other event stops, signal-delivery-stops and group-stops
+    process.Ptrace(PTRACE_SYSCALL, nullptr, nullptr);
+  }
+}
+
+ForkServer::ForkServer(Tracee &snapshot) :
+    snapshot_(snapshot) {
+  snapshot_.Ptrace(PTRACE_GETREGS, nullptr, &snapshot_registers_);
+  if (snapshot_registers_.cs != kX86_64UserCodeSegment) {
+    throw std::runtime_error("Fork server supports 64-bit solutions only");
+  }
+  syscall_instruction_ = snapshot_registers_.rip - sizeof(kSyscallInstruction);
+  unsigned char instruction[sizeof(kSyscallInstruction)];
+  if (sizeof(instruction) != snapshot_.ReadMemory(syscall_instruction_, instruction, sizeof(instruction))
+      || 0 != memcmp(instruction, kSyscallInstruction, sizeof(instruction))) {
+    throw std::runtime_error("Snapshot syscall is not made with the syscall instruction");
+  }
+  // The forked processes inherit the options, so injected syscalls selected by a seccomp filter don't fail.
+  long options = PTRACE_O_EXITKILL | PTRACE_O_TRACEEXIT | PTRACE_O_TRACESYSGOOD | PTRACE_O_TRACESECCOMP
+      | PTRACE_O_TRACEFORK;
+  snapshot_.Ptrace(PTRACE_SETOPTIONS, nullptr, (void *) options);
+
+  // The snapshot syscall is skipped, so the snapshot is parked at a syscall exit like after an injected syscall.
+  user_regs_struct registers = snapshot_registers_;
+  registers.orig_rax = -1;
+  snapshot_.Ptrace(PTRACE_SETREGS, nullptr, &registers);
+  ContinueToSyscallExit(snapshot_, true, nullptr);
+
+  long scratch_page = InjectSyscall(snapshot_,
+                                    __NR_mmap,
+                                    {0, kScratchSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+                                     static_cast<unsigned long>(-1), 0},
+                                    nullptr);
+  if (IsSyscallError(scratch_page)) {
+    throw std::runtime_error(std::string("mmap in the snapshot: ") + strerror(static_cast<int>(-scratch_page)));
+  }
+  scratch_page_ = scratch_page;
+}
+
+ForkServer::~ForkServer() {
+  try {
+    snapshot_.Kill(SIGKILL);
+    // the exit event may still be reported
+    while (WIFSTOPPED(snapshot_.Wait())) {
+      snapshot_.Ptrace(PTRACE_CONT, nullptr, nullptr);
+    }
+  } catch (std::exception &exc) {
+    WARN("Failed to kill fork server: %s", exc.what())
+  }
+}
+
+pid_t ForkServer::Fork(const std::string &stdin_file, const std::string &stdout_file) {
+  const std::string paths = stdin_file + '\0' + stdout_file + '\0';
+  if (paths.size() > kScratchSize) {
+    throw std::invalid_argument("Test file paths are too long: " + stdin_file + ", " + stdout_file);
+  }
+  if (paths.size() != snapshot_.WriteMemory(scratch_page_, paths.data(), paths.size())) {
+    throw std::runtime_error("Failed to pass test file paths to the snapshot");
+  }
+  pid_t pid = -1;
+  long result = InjectSyscall(snapshot_, __NR_fork, {}, &pid);
+  if (IsSyscallError(result)) {
+    throw std::runtime_error(std::string("fork in the snapshot: ") + strerror(static_cast<int>(-result)));
+  }
+  Tracee process(pid);
+  // the initial SIGSTOP of an automatically attached process
+  process.Wait();
+
+  const unsigned long stdin_path = scratch_page_;
+  const unsigned long stdout_path = scratch_page_ + stdin_file.size() + 1;
+  const auto at_cwd = static_cast<unsigned long>(AT_FDCWD);
+  long stdin_fd = InjectSyscallOrKill(process, __NR_openat, {at_cwd, stdin_path, O_RDONLY});
+  if (stdin_fd != 0) {
+    InjectSyscallOrKill(process, __NR_dup2, {static_cast<unsigned long>(stdin_fd), 0});
+    InjectSyscallOrKill(process, __NR_close, {static_cast<unsigned long>(stdin_fd)});
+  }
+  long stdout_fd = InjectSyscallOrKill(process, __NR_openat, {at_cwd, stdout_path, O_WRONLY});
+  InjectSyscallOrKill(process, __NR_lseek, {static_cast<unsigned long>(stdout_fd), 0, SEEK_END});
+  if (stdout_fd != 1) {
+    InjectSyscallOrKill(process, __NR_dup2, {static_cast<unsigned long>(stdout_fd), 1});
+    InjectSyscallOrKill(process, __NR_close, {static_cast<unsigned long>(stdout_fd)});
+  }
+
+  // the process repeats the snapshot syscall once resumed
+  user_regs_struct registers = snapshot_registers_;
+  registers.rip = syscall_instruction_;
+  registers.rax = snapshot_registers_.orig_rax;
+  process.Ptrace(PTRACE_SETREGS, nullptr, &registers);
+  return pid;
+}
+
+void ForkServer::Reap(pid_t pid) {
+  InjectSyscall(snapshot_, __NR_wait4, {static_cast<unsigned long>(pid), 0, __WALL, 0}, nullptr);
+}
+
+long ForkServer::InjectSyscall(Tracee &process,
+                               long number,
+                               std::initializer_list<unsigned long> args,
+                               pid_t *forked_pid) {
+  user_regs_struct registers{};
+  process.Ptrace(PTRACE_GETREGS, nullptr, &registers);
+  registers.rip = syscall_instruction_;
+  registers.rax = number;
+  // not in a syscall, so that the kernel doesn't try to restart one
+  registers.orig_rax = -1;
+  unsigned long long *arg_registers[] =
+      {&registers.rdi, &registers.rsi, &registers.rdx, &registers.r10, &registers.r8, &registers.r9};
+  int index = 0;
+  for (unsigned long arg : args) {
+    *arg_registers[index++] = arg;
+  }
+  process.Ptrace(PTRACE_SETREGS, nullptr, &registers);
+  ContinueToSyscallExit(process, false, forked_pid);
+  process.Ptrace(PTRACE_GETREGS, nullptr, &registers);
+  return static_cast<long>(registers.rax);
+}
+
+long ForkServer::InjectSyscallOrKill(Tracee &process, long number, std::initializer_list<unsigned long> args) {
+  long result = InjectSyscall(process, number, args, nullptr);
+  if (IsSyscallError(result)) {
+    process.Kill(SIGKILL);
+    while (WIFSTOPPED(process.Wait())) {
+      process.Ptrace(PTRACE_CONT, nullptr, nullptr);
+    }
+    Reap(process.Pid());
+    const SyscallDescriptor *descriptor = FindSyscallDescriptor(number);
+    throw std::runtime_error(std::string(descriptor ? descriptor->name : std::to_string(number).c_str())
+                                 + " injected into a forked process failed: " + strerror(static_cast<int>(-result)));
+  }
+  return result;
+}
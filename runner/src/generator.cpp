@@ -0,0 +1,217 @@
+#include <kourt/runner/generator.h>
+
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <climits>
+#include <csignal>
+#include <cerrno>
+#include <cstring>
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <kourt/runner/config.h>
+#include <kourt/runner/digest.h>
+#include <kourt/runner/logging.h>
+#include <kourt/runner/runner_main.h>
+#include <kourt/runner/spawn.h>
+#include <kourt/runner/system.h>
+
+static const char *kGeneratorExecutableKey = "executable";
+static const char *kGeneratorArgvKey = "argv";
+static const char *kGeneratorSeedKey = "seed";
+static const char *kGeneratorStderrFileKey = "stderrFile";
+static const char *kExpectedSha256Key = "expectedSha256";
+static const char *kFinishTimeoutMillisKey = "finishTimeoutMillis";
+
+static const char *kDefaultGeneratorStderrFile = "generator-stderr.txt";
+static const long kDefaultFinishTimeoutMillis = 10'000;
+static const size_t kHashBufferSize = 1 << 16;
+
+static void CloseIfOpen(int *fd) {
+  if (*fd >= 0) {
+    close(*fd);
+    *fd = -1;
+  }
+}
+
+static std::vector<std::string> GeneratorArgv(const nlohmann::json &generator_config) {
+  const std::string executable = generator_config.at(kGeneratorExecutableKey);
+  auto argv = generator_config.value(kGeneratorArgvKey, std::vector<std::string>{executable});
+  if (generator_config.contains(kGeneratorSeedKey)) {
+    const nlohmann::json &seed = generator_config[kGeneratorSeedKey];
+    argv.push_back(seed.is_string() ? seed.get<std::string>() : seed.dump());
+  }
+  return argv;
+}
+
+Generator::Generator(const nlohmann::json &generator_config, const std::string &working_directory) :
+    executable_(generator_config.at(kGeneratorExecutableKey).get<std::string>()),
+    argv_(GeneratorArgv(generator_config)),
+    stderr_file_(generator_config.value(kGeneratorStderrFileKey, kDefaultGeneratorStderrFile)),
+    working_directory_(working_directory),
+    expected_sha256_(generator_config.value(kExpectedSha256Key, "")),
+    finish_timeout_(generator_config.value(kFinishTimeoutMillisKey, kDefaultFinishTimeoutMillis)),
+    relay_state_(std::make_shared<RelayState>()) {
+  for (auto &arg : argv_) {
+    argv_pointers_.push_back(arg.data());
+  }
+  argv_pointers_.push_back(nullptr);
+  int fds[2];
+  if (0 != pipe2(fds, O_CLOEXEC)) {
+    throw SystemError("pipe2");
+  }
+  relay_state_->source_fd = fds[0];
+  generator_stdout_fd_ = fds[1];
+  if (0 != pipe2(fds, O_CLOEXEC)) {
+    CloseIfOpen(&relay_state_->source_fd);
+    CloseIfOpen(&generator_stdout_fd_);
+    throw SystemError("pipe2");
+  }
+  tracee_stdin_fd_ = fds[0];
+  relay_state_->target_fd = fds[1];
+}
+
+Generator::~Generator() {
+  if (pid_ > 0) {
+    kill(pid_, SIGKILL);
+    waitpid(pid_, nullptr, 0);
+  }
+  CloseIfOpen(&generator_stdout_fd_);
+  CloseIfOpen(&tracee_stdin_fd_);
+  if (relay_.joinable()) {
+    // Finish hasn't been called, so the tracee may still hold its stdin and the relay may never end.
+    relay_.detach();
+  } else {
+    CloseIfOpen(&relay_state_->source_fd);
+    CloseIfOpen(&relay_state_->target_fd);
+  }
+}
+
+void Generator::ExecInChild() {
+  ResetSignalMaskInChild();
+  if (!working_directory_.empty() && 0 != chdir(working_directory_.c_str())) {
+    perror("chdir");
+    _exit(1);
+  }
+  int stderr_fd = creat(stderr_file_.c_str(), 0644);
+  if (stderr_fd < 0) {
+    perror("creat");
+    _exit(1);
+  }
+  int stdin_fd = open("/dev/null", O_RDONLY);
+  if (stdin_fd >= 0) {
+    dup2(stdin_fd, 0);
+    close(stdin_fd);
+  }
+  dup2(generator_stdout_fd_, 1);
+  dup2(stderr_fd, 2);
+  close(stderr_fd);
+  execv(executable_.c_str(), argv_pointers_.data());
+  perror("execv");
+  _exit(1);
+}
+
+void Generator::Start() {
+  pid_t pid = SpawnProcess(SpawnOptions{});
+  if (0 == pid) {
+    ExecInChild();
+  }
+  pid_ = pid;
+  CloseIfOpen(&generator_stdout_fd_);
+  relay_ = std::thread(Relay, relay_state_);
+}
+
+void Generator::Relay(const std::shared_ptr<RelayState> &state) {
+  // The tracee may exit without reading the whole input: the relay should get EPIPE then rather than kill the runner.
+  sigset_t sigpipe;
+  sigemptyset(&sigpipe);
+  sigaddset(&sigpipe, SIGPIPE);
+  pthread_sigmask(SIG_BLOCK, &sigpipe, nullptr);
+
+  Sha256 sha256;
+  std::vector<char> buffer(kHashBufferSize);
+  for (;;) {
+    // how much to consume from the source: what has been passed to the tracee, or anything once it is gone
+    size_t to_hash = buffer.size();
+    if (state->target_fd >= 0) {
+      ssize_t relayed = tee(state->source_fd, state->target_fd, INT_MAX, 0);
+      if (relayed < 0 && errno == EINTR) {
+        continue;
+      }
+      if (relayed < 0) {
+        if (errno != EPIPE) {
+          WARN("Generator relay failed, the rest of the stream is only hashed: %s", strerror(errno))
+        }
+        CloseIfOpen(&state->target_fd);
+        continue;
+      }
+      if (relayed == 0) {
+        break;
+      }
+      state->relayed_bytes += relayed;
+      to_hash = relayed;
+    }
+    // tee doesn't consume the data, so it is read out of the source pipe into the hash
+    bool end_of_stream = false;
+    while (to_hash > 0) {
+      ssize_t bytes_read = read(state->source_fd, buffer.data(), std::min(to_hash, buffer.size()));
+      if (bytes_read < 0 && errno == EINTR) {
+        continue;
+      }
+      if (bytes_read <= 0) {
+        end_of_stream = true;
+        break;
+      }
+      sha256.Update(buffer.data(), bytes_read);
+      state->generated_bytes += bytes_read;
+      // once the tracee is gone, every read is a chunk of its own
+      to_hash = state->target_fd >= 0 ? to_hash - bytes_read : 0;
+    }
+    if (end_of_stream) {
+      break;
+    }
+  }
+  state->sha256 = "sha256:" + sha256.HexDigest();
+  CloseIfOpen(&state->source_fd);
+  CloseIfOpen(&state->target_fd);
+}
+
+void Generator::CloseTraceeEnd() {
+  CloseIfOpen(&tracee_stdin_fd_);
+}
+
+nlohmann::json Generator::Finish() {
+  CloseTraceeEnd();
+  int status = 0;
+  bool timed_out = !WaitWithTimeout(pid_, finish_timeout_, &status);
+  if (timed_out) {
+    WARN("Generator %d hasn't finished in %ld ms after the tracee, killing it", pid_, (long) finish_timeout_.count())
+    kill(pid_, SIGKILL);
+    waitpid(pid_, &status, 0);
+  }
+  pid_ = -1;
+  relay_.join();
+
+  nlohmann::json exit_status = ExitStatusToJson(status);
+  exit_status["bytes"] = relay_state_->generated_bytes;
+  exit_status["relayedBytes"] = relay_state_->relayed_bytes;
+  exit_status["sha256"] = relay_state_->sha256;
+  failed_ = timed_out || !WIFEXITED(status) || 0 != WEXITSTATUS(status);
+  if (timed_out) {
+    exit_status["timedOut"] = true;
+  }
+  if (!expected_sha256_.empty()) {
+    exit_status["sha256Matches"] = relay_state_->sha256 == expected_sha256_;
+    failed_ = failed_ || relay_state_->sha256 != expected_sha256_;
+  }
+  return exit_status;
+}
+
+std::unique_ptr<Generator> CreateGeneratorIfConfigured(const nlohmann::json &config) {
+  if (!config.contains(kGeneratorKey)) {
+    return nullptr;
+  }
+  return std::make_unique<Generator>(config[kGeneratorKey], config.value(kWorkingDirectoryKey, ""));
+}
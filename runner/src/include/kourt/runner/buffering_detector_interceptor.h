@@ -0,0 +1,69 @@
+#ifndef RUNNER_SRC_BUFFERING_DETECTOR_INTERCEPTOR_H_
+#define RUNNER_SRC_BUFFERING_DETECTOR_INTERCEPTOR_H_
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+#include <nlohmann/json.hpp>
+
+#include "interceptors.h"
+
+/**
+ * Collects the distribution of the sizes requested by <code>read</code>, <code>write</code>, <code>readv</code> and
+ * <code>writev</code> per file descriptor, and reports unbuffered I/O, e.g. <code>fflush</code> after each character,
+ * as findings in the exit status. The tracee stops on these syscalls only, at their entries.
+ *
+ * Config:
+ * <ul>
+ *   <li><code>smallCallBytes</code> --- calls requesting fewer bytes are small, 16 by default;</li>
+ *   <li><code>smallCallShare</code> --- an fd is reported if the share of small calls of a direction exceeds it,
+ *       0.9 by default;</li>
+ *   <li><code>minCalls</code> --- directions with fewer calls are never reported, 1000 by default.</li>
+ * </ul>
+ */
+class BufferingDetectorInterceptor : public virtual NoOpStoppedTraceeInterceptor {
+ public:
+  explicit BufferingDetectorInterceptor(const nlohmann::json &config);
+
+  [[nodiscard]] std::optional<std::vector<unsigned long>> InterceptedSyscalls() const override;
+  [[nodiscard]] bool InterceptsSyscallExits() const override;
+  [[nodiscard]] nlohmann::json CollectStatistics() const override;
+
+ protected:
+  bool Intercept(BeforeSyscallStoppedTracee &tracee) override;
+
+ private:
+  // Bucket 0 counts empty calls, bucket i counts sizes in [2^(i-1), 2^i), the last one counts the larger ones.
+  static constexpr size_t kHistogramBuckets = 18;
+  // Descriptors starting with this one share the last slot.
+  static constexpr int kMaxTrackedFd = 64;
+
+  struct DirectionStatistics {
+    uint64_t calls{0};
+    uint64_t small_calls{0};
+    uint64_t bytes{0};
+    std::array<uint64_t, kHistogramBuckets> histogram{};
+  };
+
+  struct FdStatistics {
+    DirectionStatistics reads;
+    DirectionStatistics writes;
+  };
+
+  void Record(int fd, bool is_read, uint64_t size);
+  static uint64_t VectorSize(SyscallStoppedTracee &tracee, unsigned long iov, int iovcnt);
+  [[nodiscard]] nlohmann::json DirectionToJson(const DirectionStatistics &statistics) const;
+  void MaybeReport(const std::string &fd,
+                   const char *direction,
+                   const DirectionStatistics &statistics,
+                   nlohmann::json *findings) const;
+
+  uint64_t small_call_bytes_;
+  double small_call_share_;
+  uint64_t min_calls_;
+
+  std::array<FdStatistics, kMaxTrackedFd + 1> fds_{};
+};
+
+#endif //RUNNER_SRC_BUFFERING_DETECTOR_INTERCEPTOR_H_
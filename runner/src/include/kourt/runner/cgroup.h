@@ -0,0 +1,51 @@
+#ifndef RUNNER_SRC_CGROUP_H_
+#define RUNNER_SRC_CGROUP_H_
+
+#include <memory>
+#include <string>
+
+#include <nlohmann/json.hpp>
+
+/**
+ * A leaf cgroup v2 created for a single tracee launch.
+ *
+ * The group is created in the constructor and torn down (all remaining processes are killed) in the destructor,
+ * so its lifetime should enclose the whole tracee execution.
+ */
+class Cgroup {
+ public:
+  explicit Cgroup(const std::string &parent_path);
+  ~Cgroup();
+
+  Cgroup(const Cgroup &) = delete;
+  Cgroup &operator=(const Cgroup &) = delete;
+
+  /// Writes <code>value</code> to the control file, e.g. <code>SetLimit("memory.max", "268435456")</code>.
+  void SetLimit(const std::string &control_file, const std::string &value);
+
+  /// @return descriptor of the cgroup directory suitable for <code>CLONE_INTO_CGROUP</code>.
+  [[nodiscard]] int DirectoryFd() const {
+    return directory_fd_;
+  }
+
+  [[nodiscard]] const std::string &Path() const {
+    return path_;
+  }
+
+  /// Reads <code>memory.peak</code>, <code>cpu.stat</code> and <code>memory.events</code>.
+  /// Files which are absent (e.g. because the controller is disabled) are silently skipped.
+  [[nodiscard]] nlohmann::json CollectStatistics() const;
+
+ private:
+  void EnableControllerInParent(const std::string &controller);
+  void KillRemainingProcesses();
+
+  std::string parent_path_;
+  std::string path_;
+  int directory_fd_{-1};
+};
+
+/// Creates a cgroup as described by the <code>cgroup</code> section of the runner config, if it is present.
+std::unique_ptr<Cgroup> CreateCgroupIfConfigured(const nlohmann::json &config);
+
+#endif //RUNNER_SRC_CGROUP_H_
@@ -10,5 +10,24 @@ extern const char *kDefaultExitStatusFile;
 extern const char *kStdoutFileKey;
 extern const char *kStderrFileKey;
 extern const char *kExitStatusFileKey;
+extern const char *kCgroupKey;
+extern const char *kSandboxKey;
+extern const char *kStdinFileKey;
+extern const char *kWorkingDirectoryKey;
+extern const char *kCpuAffinityKey;
+extern const char *kMetricsFileKey;
+extern const char *kExecutableInMemoryKey;
+extern const char *kOutputsInMemoryKey;
+extern const char *kInteractorKey;
+extern const char *kResultFormatKey;
+extern const char *kResultIdKey;
+extern const char *kOutputDigestsKey;
+extern const char *kSyscallFilterKey;
+extern const char *kTraceAllSyscallsKey;
+extern const char *kForkServerKey;
+extern const char *kInstructionLimitKey;
+extern const char *kReproducibleTimingKey;
+extern const char *kRepeatKey;
+extern const char *kGeneratorKey;
 
 #endif //RUNNER_SRC_INCLUDE_KOURT_RUNNER_CONFIG_H_
@@ -0,0 +1,112 @@
+#ifndef RUNNER_SRC_DAEMON_H_
+#define RUNNER_SRC_DAEMON_H_
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "scheduler.h"
+
+extern const char *kDaemonFlag;
+
+/// A client connected to the daemon. Responses may be sent from several worker threads.
+class DaemonConnection {
+ public:
+  explicit DaemonConnection(int socket_fd);
+  ~DaemonConnection();
+
+  DaemonConnection(const DaemonConnection &) = delete;
+  DaemonConnection &operator=(const DaemonConnection &) = delete;
+
+  /// @return false on end of stream
+  bool ReadLine(std::string *line);
+  /// Sends <code>message</code> as a single line. Errors are ignored: the client may have gone away.
+  void Send(const nlohmann::json &message);
+  /// Makes pending and future <code>ReadLine</code> calls return false.
+  void StopReading();
+
+ private:
+  int socket_fd_;
+  std::string buffer_;
+  std::mutex send_mutex_;
+};
+
+/**
+ * A long-lived runner serving jobs submitted through a Unix domain socket, so that clients don't pay for process
+ * creation and config parsing on every test.
+ *
+ * The protocol is newline-delimited JSON. Each request line is a job:
+ * <pre>
+ * {"id": 1, "executable": "/path/to/solution", "argv": ["arg"], "stdin": "input text", "config": {...}}
+ * </pre>
+ * where <code>config</code> is the same as the runner config file (interceptors, limits, output files,
+ * <code>workingDirectory</code>, ...), and all the fields but <code>executable</code> are optional.
+ * A job may also carry <code>submission</code>, <code>weight</code>, <code>interactive</code> and
+ * <code>estimatedCost</code> fields, which are used by the <code>JobScheduler</code> to order the queued jobs.
+ *
+ * Jobs are executed concurrently by a pool of workers, and for each one a response line is sent once it finishes,
+ * in completion order, either of:
+ * <pre>
+ * {"id": 1, "exitStatus": {...}, "scheduling": {"waitMicros": 120, "cpuAffinity": [3]}}
+ * {"id": 1, "error": "..."}
+ * </pre>
+ * Each worker is pinned to its own CPU core (unless <code>"pinWorkers": false</code> is set in the daemon config),
+ * and so are the tracees it launches, unless the job config sets <code>cpuAffinity</code> itself.
+ * A <code>{"statistics": true}</code> request is answered immediately with the scheduler statistics.
+ * The exit status is also written to <code>exitStatusFile</code> if the job config sets it.
+ * Runner metrics (see <code>metrics.h</code>) can be scraped over HTTP from the <code>metricsSocket</code> and
+ * are periodically written to the <code>metricsFile</code>, if these are set in the daemon config.
+ * A <code>{"shutdown": true}</code> request, <code>SIGINT</code> or <code>SIGTERM</code> stop the daemon
+ * once the accepted jobs are finished.
+ */
+class Daemon {
+ public:
+  Daemon(std::string socket_path, const nlohmann::json &daemon_config);
+  ~Daemon();
+
+  Daemon(const Daemon &) = delete;
+  Daemon &operator=(const Daemon &) = delete;
+
+  /// Accepts clients until a shutdown is requested. Should be called with <code>SIGINT</code> and
+  /// <code>SIGTERM</code> blocked in all threads.
+  void Serve();
+
+ private:
+  void ServeConnection(const std::shared_ptr<DaemonConnection> &connection);
+  void RunWorker(int cpu);
+  void ExecuteJob(const DaemonJob &job, int cpu);
+  void Submit(DaemonJob &&job);
+  void RequestShutdown();
+
+  std::string socket_path_;
+  std::string metrics_socket_path_;
+  std::string metrics_file_;
+  int listen_fd_{-1};
+  int metrics_listen_fd_{-1};
+  int shutdown_event_fd_{-1};
+  int signal_fd_{-1};
+
+  std::mutex mutex_;
+  std::condition_variable jobs_available_;
+  std::condition_variable connections_closed_;
+  JobScheduler scheduler_;
+  std::vector<std::weak_ptr<DaemonConnection>> connections_;
+  size_t active_connections_{0};
+  bool stopping_{false};
+  std::vector<std::thread> workers_;
+};
+
+/**
+ * Runs the daemon until it is shut down.
+ *
+ * @param path_to_config optional daemon config, e.g. <code>{"workers": 8, "pinWorkers": true}</code>
+ * @return exit code of the runner
+ */
+int DaemonMain(const char *socket_path, const char *path_to_config);
+
+#endif //RUNNER_SRC_DAEMON_H_
@@ -0,0 +1,32 @@
+#ifndef RUNNER_SRC_DIGEST_H_
+#define RUNNER_SRC_DIGEST_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/// Incremental SHA-256, used to identify outputs without storing or comparing them byte by byte.
+class Sha256 {
+ public:
+  Sha256();
+
+  void Update(const void *data, size_t size);
+
+  /// @return lowercase hex digest of everything passed to <code>Update</code>. Finishes the computation.
+  std::string HexDigest();
+
+ private:
+  void ProcessBlock(const uint8_t *block);
+
+  std::array<uint32_t, 8> state_;
+  std::array<uint8_t, 64> buffer_{};
+  size_t buffered_{0};
+  uint64_t total_size_{0};
+};
+
+/// @return <code>"sha256:"</code> followed by the hex digest of the whole content of <code>fd</code>, read with
+///         <code>pread</code> regardless of the file offset.
+std::string DigestFile(int fd);
+
+#endif //RUNNER_SRC_DIGEST_H_
@@ -0,0 +1,59 @@
+#ifndef RUNNER_SRC_EMULATION_INTERCEPTOR_H_
+#define RUNNER_SRC_EMULATION_INTERCEPTOR_H_
+
+#include <cstdint>
+#include <optional>
+#include <random>
+#include <string>
+
+#include <nlohmann/json.hpp>
+
+#include "interceptors.h"
+
+/**
+ * Serves some syscalls from the runner instead of the kernel, skipping them and writing their results directly into
+ * the tracee's memory. This makes runs deterministic and saves the kernel pipe path for the input.
+ *
+ * Config:
+ * <ul>
+ *   <li><code>stdinFile</code> --- <code>read</code>s from fd 0 are served from the content of this file, loaded
+ *       into memory beforehand; the tracee is assumed not to replace its stdin;</li>
+ *   <li><code>clock</code> --- <code>{"startNanos": ..., "stepNanos": ...}</code>: <code>clock_gettime</code> of
+ *       any clock returns <code>startNanos</code> and advances by <code>stepNanos</code> with each call. The vDSO is
+ *       hidden from the tracee, so that the calls reach the kernel at all. 64-bit tracees only;</li>
+ *   <li><code>randomSeed</code> --- <code>getrandom</code> returns bytes of a PRNG seeded with it.</li>
+ * </ul>
+ */
+class EmulationInterceptor : public virtual NoOpStoppedTraceeInterceptor {
+ public:
+  explicit EmulationInterceptor(const nlohmann::json &config);
+
+  void OnExec(Tracee &tracee) override;
+
+  [[nodiscard]] std::optional<std::vector<unsigned long>> InterceptedSyscalls() const override;
+  [[nodiscard]] bool InterceptsSyscallExits() const override;
+  [[nodiscard]] nlohmann::json CollectStatistics() const override;
+
+ protected:
+  bool Intercept(BeforeSyscallStoppedTracee &tracee) override;
+
+ private:
+  void EmulateRead(BeforeSyscallStoppedTracee &tracee, unsigned long buffer, size_t count);
+  void EmulateClockGettime(BeforeSyscallStoppedTracee &tracee, unsigned long timespec_address);
+  void EmulateGetrandom(BeforeSyscallStoppedTracee &tracee, unsigned long buffer, size_t length);
+
+  std::optional<std::string> stdin_content_;
+  size_t stdin_offset_{0};
+
+  bool emulate_clock_{false};
+  int64_t clock_nanos_{0};
+  int64_t clock_step_nanos_{0};
+
+  std::optional<std::mt19937_64> random_;
+
+  uint64_t emulated_reads_{0};
+  uint64_t emulated_clock_reads_{0};
+  uint64_t emulated_getrandoms_{0};
+};
+
+#endif //RUNNER_SRC_EMULATION_INTERCEPTOR_H_
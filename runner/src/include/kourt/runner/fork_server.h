@@ -0,0 +1,72 @@
+#ifndef RUNNER_SRC_FORK_SERVER_H_
+#define RUNNER_SRC_FORK_SERVER_H_
+
+#include <sys/types.h>
+#include <sys/user.h>
+
+#include <initializer_list>
+#include <string>
+
+#include "tracing.h"
+
+/**
+ * Serves tests from a snapshot of a solution which has already been loaded, linked and initialised, in the manner
+ * of the AFL fork server: the runner injects a <code>fork</code> into the stopped solution for each test, so a test
+ * costs a fork and a few more injected syscalls instead of an exec and the start-up of the solution.
+ *
+ * The solution is held at the entry of the snapshot syscall (see <code>TraceeController::ExecuteTraceeUntil</code>),
+ * which is then skipped, and the solution stays stopped for the rest of its life, serving as the snapshot.
+ * A forked process gets the test's files as its stdin and stdout and repeats the snapshot syscall once resumed.
+ * Signals sent to the snapshot are discarded.
+ *
+ * Only 64-bit solutions are supported, the snapshot syscall must be made with the <code>syscall</code> instruction.
+ */
+class ForkServer {
+ public:
+  /**
+   * Skips the snapshot syscall and prepares a scratch page for the paths of test files in the snapshot.
+   *
+   * @param snapshot the solution, stopped at the entry of the snapshot syscall
+   * @throws std::runtime_error if the snapshot can't be served, e.g. it is a 32-bit process
+   */
+  explicit ForkServer(Tracee &snapshot);
+  /// Kills the snapshot.
+  ~ForkServer();
+
+  ForkServer(const ForkServer &) = delete;
+  ForkServer &operator=(const ForkServer &) = delete;
+
+  /**
+   * Forks a process off the snapshot. Its stdout is positioned at the end of <code>stdout_file</code>, so the file may
+   * hold the output the solution has written before the snapshot.
+   *
+   * @param stdin_file absolute path of an existing file
+   * @param stdout_file absolute path of an existing file
+   * @return pid of the process, traced and stopped before the snapshot syscall; see
+   *         <code>TraceeController::ResumeTracee</code>
+   */
+  pid_t Fork(const std::string &stdin_file, const std::string &stdout_file);
+
+  /// Collects the zombie of a forked process after the runner has waited for it as the tracer.
+  void Reap(pid_t pid);
+
+ private:
+  /**
+   * Makes <code>process</code>, which is stopped outside of a syscall or at a syscall exit, execute the syscall
+   * instruction of the snapshot with <code>number</code> and <code>args</code>.
+   *
+   * @param forked_pid set to the pid of a process forked by the syscall, if it is not null
+   * @return the result of the syscall, a negated errno value on failure
+   */
+  long InjectSyscall(Tracee &process, long number, std::initializer_list<unsigned long> args, pid_t *forked_pid);
+  /// Injects a syscall into a forked process, killing and reaping the process if it fails.
+  long InjectSyscallOrKill(Tracee &process, long number, std::initializer_list<unsigned long> args);
+
+  Tracee &snapshot_;
+  // registers at the entry of the snapshot syscall
+  user_regs_struct snapshot_registers_{};
+  unsigned long syscall_instruction_{0};
+  unsigned long scratch_page_{0};
+};
+
+#endif //RUNNER_SRC_FORK_SERVER_H_
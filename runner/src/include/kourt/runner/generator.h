@@ -0,0 +1,96 @@
+#ifndef RUNNER_SRC_GENERATOR_H_
+#define RUNNER_SRC_GENERATOR_H_
+
+#include <sys/types.h>
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+/**
+ * An untraced program producing the input of the tracee on the fly, so that huge tests are never stored.
+ * The generator runs outside of the tracee's cgroup and limits, with the <code>seed</code> appended to its arguments.
+ *
+ * The stream goes through two pipes and a relay thread, which passes the data on to the tracee with <code>tee</code>
+ * and hashes it with SHA-256. If the tracee stops reading, the rest of the stream is still hashed, so the digest
+ * always covers the whole test and can be checked against <code>expectedSha256</code>.
+ *
+ * Usage mirrors <code>Interactor</code>:
+ * <ol>
+ *   <li>call <code>Start</code> before spawning the tracee;</li>
+ *   <li>make <code>TraceeStdinFd</code> the tracee's stdin;</li>
+ *   <li>call <code>CloseTraceeEnd</code> in the parent once the tracee is spawned;</li>
+ *   <li>call <code>Finish</code> after the tracee has finished.</li>
+ * </ol>
+ */
+class Generator {
+ public:
+  /// @param working_directory directory the generator is started in, the current one if empty
+  Generator(const nlohmann::json &generator_config, const std::string &working_directory);
+  /// Kills the generator if it is still running.
+  ~Generator();
+
+  Generator(const Generator &) = delete;
+  Generator &operator=(const Generator &) = delete;
+
+  /// Spawns the generator and the relay.
+  void Start();
+
+  [[nodiscard]] int TraceeStdinFd() const {
+    return tracee_stdin_fd_;
+  }
+
+  /// Closes the tracee's descriptor in the runner, so that the relay sees a broken pipe once the tracee exits.
+  void CloseTraceeEnd();
+
+  /**
+   * Waits for the generator to produce the whole stream, killing it if it doesn't in the configured time after
+   * the tracee has finished.
+   *
+   * @return exit status of the generator, the size and the digest of the stream and whether it is as expected
+   */
+  nlohmann::json Finish();
+
+  /// @return whether the stream is incomplete or differs from the expected one; valid after <code>Finish</code>
+  [[nodiscard]] bool Failed() const {
+    return failed_;
+  }
+
+ private:
+  /// What the relay thread owns: it may outlive the generator if the tracee never closes its stdin.
+  struct RelayState {
+    int source_fd{-1};
+    int target_fd{-1};
+    uint64_t relayed_bytes{0};
+    uint64_t generated_bytes{0};
+    std::string sha256;
+  };
+
+  [[noreturn]] void ExecInChild();
+  static void Relay(const std::shared_ptr<RelayState> &state);
+
+  std::string executable_;
+  std::vector<std::string> argv_;
+  std::vector<char *> argv_pointers_;
+  std::string stderr_file_;
+  std::string working_directory_;
+  std::string expected_sha256_;
+  std::chrono::milliseconds finish_timeout_;
+
+  int generator_stdout_fd_{-1};
+  int tracee_stdin_fd_{-1};
+  std::shared_ptr<RelayState> relay_state_;
+  std::thread relay_;
+  pid_t pid_{-1};
+  bool failed_{false};
+};
+
+/// Creates a generator as described by the <code>generator</code> section of the runner config, if it is present.
+std::unique_ptr<Generator> CreateGeneratorIfConfigured(const nlohmann::json &config);
+
+#endif //RUNNER_SRC_GENERATOR_H_
@@ -0,0 +1,66 @@
+#ifndef RUNNER_SRC_INSTRUCTION_COUNTER_H_
+#define RUNNER_SRC_INSTRUCTION_COUNTER_H_
+
+#include <sys/types.h>
+#include <csignal>
+#include <cstdint>
+
+#include <memory>
+
+#include <nlohmann/json.hpp>
+
+/**
+ * A <code>perf_event_open</code> counter of the user-space instructions retired by the tracee, enforcing
+ * an instruction budget. Unlike CPU time, the number of instructions doesn't depend on the load of the host.
+ *
+ * Where the hardware PMU is unavailable or not permitted, e.g. in many VMs and containers, the counter falls back to
+ * the <code>task-clock</code> software event, the budget being taken as nanoseconds then, i.e. one instruction per
+ * nanosecond. If perf events aren't permitted at all, attaching fails with an error naming the limit.
+ *
+ * The threads and the child processes of the tracee are counted too, each on its own: the kernel sends
+ * <code>kOverflowSignal</code> to the main thread of the tracee every sixteenth of the budget one of them retires.
+ * The controller then checks the total, suppressing the signal, and replaces it with <code>SIGKILL</code> once
+ * the budget is exhausted. The budget may be overshot by a sixteenth per thread, and isn't enforced any more once
+ * the main thread has exited while the others run on.
+ */
+class InstructionCounter {
+ public:
+  static constexpr int kOverflowSignal = SIGXCPU;
+
+  explicit InstructionCounter(uint64_t limit);
+  ~InstructionCounter();
+
+  InstructionCounter(const InstructionCounter &) = delete;
+  InstructionCounter &operator=(const InstructionCounter &) = delete;
+
+  /// Starts counting for the stopped process <code>pid</code>, which should not have run its code yet.
+  void Attach(pid_t pid);
+
+  /// @return whether <code>info</code> describes an overflow of this counter, which is no signal for the tracee.
+  [[nodiscard]] bool IsOverflowSignal(const siginfo_t &info) const;
+
+  /// @return whether the total count has reached the limit; it is then remembered as exceeded.
+  bool CheckLimit();
+
+  [[nodiscard]] bool LimitExceeded() const {
+    return limit_exceeded_;
+  }
+
+  /// @return the event, its count and the limit.
+  [[nodiscard]] nlohmann::json CollectStatistics() const;
+
+ private:
+  [[nodiscard]] uint64_t Count() const;
+
+  uint64_t limit_;
+  // instructions retired by a thread between two checks of the total
+  uint64_t check_period_;
+  int fd_{-1};
+  bool hardware_{true};
+  bool limit_exceeded_{false};
+};
+
+/// Creates a counter if the runner config has an <code>instructionLimit</code>.
+std::unique_ptr<InstructionCounter> CreateInstructionCounterIfConfigured(const nlohmann::json &config);
+
+#endif //RUNNER_SRC_INSTRUCTION_COUNTER_H_
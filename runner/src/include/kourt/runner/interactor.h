@@ -0,0 +1,102 @@
+#ifndef RUNNER_SRC_INTERACTOR_H_
+#define RUNNER_SRC_INTERACTOR_H_
+
+#include <sys/types.h>
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include <kourt/runner/cgroup.h>
+
+/**
+ * An untraced program talking to the tracee of an interactive problem: the interactor's stdout becomes
+ * the tracee's stdin and the tracee's stdout becomes the interactor's stdin.
+ *
+ * Unless the traffic of a direction is logged, the two processes share a single pipe and the runner doesn't touch
+ * the data at all. A logged direction goes through two pipes and a relay thread, which duplicates the data into
+ * the log with <code>tee</code> and then moves it on with <code>splice</code>, so the payload is never copied to
+ * user space either way.
+ *
+ * Usage:
+ * <ol>
+ *   <li>call <code>Start</code> before spawning the tracee;</li>
+ *   <li>make <code>TraceeStdinFd</code> and <code>TraceeStdoutFd</code> the tracee's stdin and stdout;</li>
+ *   <li>call <code>CloseTraceeEnds</code> in the parent once the tracee is spawned;</li>
+ *   <li>call <code>Finish</code> after the tracee has finished.</li>
+ * </ol>
+ */
+class Interactor {
+ public:
+  /// @param working_directory directory the interactor is started in, the current one if empty
+  Interactor(const nlohmann::json &interactor_config, const std::string &working_directory);
+  /// Kills the interactor if it is still running.
+  ~Interactor();
+
+  Interactor(const Interactor &) = delete;
+  Interactor &operator=(const Interactor &) = delete;
+
+  /// Spawns the interactor and the relays of the logged directions.
+  void Start();
+
+  [[nodiscard]] int TraceeStdinFd() const {
+    return from_interactor_.consumer_fd;
+  }
+  [[nodiscard]] int TraceeStdoutFd() const {
+    return to_interactor_.producer_fd;
+  }
+
+  /// Closes the tracee's descriptors in the runner, so that each side sees the end of file once the other exits.
+  void CloseTraceeEnds();
+
+  /**
+   * Waits for the interactor to exit, killing it if it doesn't in the configured time after the tracee has finished.
+   *
+   * @return exit status of the interactor, in the same format as the tracee's one
+   */
+  nlohmann::json Finish();
+
+  /// @return whether the interactor has exited with a non-zero code, been killed or timed out; valid after
+  ///         <code>Finish</code>
+  [[nodiscard]] bool Failed() const {
+    return failed_;
+  }
+
+ private:
+  /// One direction of the traffic.
+  struct Channel {
+    int producer_fd{-1};
+    int consumer_fd{-1};
+    // set for a logged direction only, owned by the relay once it is started
+    int relay_source_fd{-1};
+    int relay_target_fd{-1};
+    int log_fd{-1};
+    std::thread relay;
+  };
+
+  static void OpenChannel(const std::string &log_file, Channel *channel);
+  static void CloseChannel(Channel *channel);
+  [[noreturn]] void ExecInChild();
+
+  std::string executable_;
+  std::vector<std::string> argv_;
+  std::vector<char *> argv_pointers_;
+  std::string stderr_file_;
+  std::string working_directory_;
+  std::chrono::milliseconds finish_timeout_;
+  std::unique_ptr<Cgroup> cgroup_;
+
+  Channel to_interactor_;
+  Channel from_interactor_;
+  pid_t pid_{-1};
+  bool failed_{false};
+};
+
+/// Creates an interactor as described by the <code>interactor</code> section of the runner config, if it is present.
+std::unique_ptr<Interactor> CreateInteractorIfConfigured(const nlohmann::json &config);
+
+#endif //RUNNER_SRC_INTERACTOR_H_
@@ -5,6 +5,8 @@
 #include <string>
 #include <unordered_map>
 
+#include <nlohmann/json.hpp>
+
 #include "tracing.h"
 
 class NoOpStoppedTraceeInterceptor : public virtual StoppedTraceeInterceptor {
@@ -26,6 +28,8 @@ class NoOpStoppedTraceeInterceptor : public virtual StoppedTraceeInterceptor {
   }
 };
 
-std::unique_ptr<StoppedTraceeInterceptor> CreateInterceptor(const std::string &interceptor_name, Tracee &tracee);
+/// @param interceptor_config an element of the <code>interceptors</code> config array, with the <code>name</code> of
+///                           the interceptor and its own parameters
+std::unique_ptr<StoppedTraceeInterceptor> CreateInterceptor(const nlohmann::json &interceptor_config);
 
 #endif //RUNNER_SRC_INTERCEPTORS_H_
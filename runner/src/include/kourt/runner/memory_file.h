@@ -0,0 +1,44 @@
+#ifndef RUNNER_SRC_MEMORY_FILE_H_
+#define RUNNER_SRC_MEMORY_FILE_H_
+
+#include <memory>
+#include <string>
+
+/// An anonymous in-memory file created with <code>memfd_create</code>. Closes the descriptor on destruction.
+class MemoryFile {
+ public:
+  /// @param name shown in <code>/proc/pid/fd</code>, for debugging only
+  explicit MemoryFile(const char *name);
+  ~MemoryFile();
+
+  MemoryFile(const MemoryFile &) = delete;
+  MemoryFile &operator=(const MemoryFile &) = delete;
+
+  [[nodiscard]] int Fd() const {
+    return fd_;
+  }
+
+  /// Forbids any further modification of the content.
+  void Seal();
+
+  /// @return the whole content, regardless of the file offset.
+  [[nodiscard]] std::string ReadAll() const;
+
+  /// Writes the whole content to a regular file at <code>path</code>, replacing it.
+  void PersistTo(const std::string &path) const;
+
+ private:
+  int fd_;
+};
+
+/**
+ * Loads the executable at <code>path</code> into a sealed memory file, suitable for <code>fexecve</code>.
+ *
+ * Loaded executables are cached for the lifetime of the process and reloaded only if the file at <code>path</code>
+ * changes (by inode, size or modification time), so running many tests of the same solution costs a single
+ * <code>stat</code> per launch rather than a path lookup and page cache reads by <code>execve</code>.
+ * The descriptor is close-on-exec, so scripts with an interpreter line can't be executed this way.
+ */
+std::shared_ptr<const MemoryFile> LoadExecutableIntoMemory(const std::string &path);
+
+#endif //RUNNER_SRC_MEMORY_FILE_H_
@@ -0,0 +1,93 @@
+#ifndef RUNNER_SRC_MEMORY_TIMELINE_INTERCEPTOR_H_
+#define RUNNER_SRC_MEMORY_TIMELINE_INTERCEPTOR_H_
+
+#include <sys/types.h>
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "interceptors.h"
+
+/**
+ * Tracks how the memory of the tracee grows: the heap (<code>brk</code>) and the anonymous and private writable
+ * mappings (<code>mmap</code>, <code>mremap</code>, <code>munmap</code>), kept as an interval map of address ranges.
+ * The tracee stops on these syscalls only. The resident set size is sampled from <code>/proc/pid/statm</code>
+ * at those stops, at most once per interval, and at the exit.
+ *
+ * The memory-over-time series is written to a file; the exit status gets the peak with the index of the memory
+ * syscall where it happened. With a limit, an allocation exceeding it fails with <code>ENOMEM</code> right away
+ * (<code>brk</code> leaves the break as is), so the tracee sees the failure instead of being killed by the OOM killer.
+ * The limit is advisory: a private file mapping made writable later by <code>mprotect</code> isn't counted, and
+ * neither is the memory of the tracee's children; a memory cgroup is what enforces a hard limit.
+ *
+ * Config:
+ * <ul>
+ *   <li><code>timelineFile</code> --- the series, relative to the working directory of the tracee,
+ *       <code>memory-timeline.json</code> by default;</li>
+ *   <li><code>rssSampleIntervalMillis</code> --- 10 by default, 0 samples at every memory syscall;</li>
+ *   <li><code>maxPoints</code> --- the series is thinned out by half each time it gets longer, 10000 by default;</li>
+ *   <li><code>limitBytes</code> --- limit of the heap and the mappings together, none by default.</li>
+ * </ul>
+ */
+class MemoryTimelineInterceptor : public virtual NoOpStoppedTraceeInterceptor {
+ public:
+  explicit MemoryTimelineInterceptor(const nlohmann::json &config);
+
+  [[nodiscard]] std::optional<std::vector<unsigned long>> InterceptedSyscalls() const override;
+  void OnFinish(const std::string &working_directory) override;
+  [[nodiscard]] nlohmann::json CollectStatistics() const override;
+
+ protected:
+  bool Intercept(BeforeSyscallStoppedTracee &tracee) override;
+  bool Intercept(AfterSyscallStoppedTracee &tracee) override;
+  bool Intercept(BeforeTerminationStoppedTracee &tracee) override;
+
+ private:
+  struct Point {
+    uint64_t syscall_index;
+    int64_t micros;
+    uint64_t heap_bytes;
+    uint64_t anonymous_bytes;
+    // -1 if not sampled at this point
+    int64_t rss_bytes;
+  };
+
+  [[nodiscard]] uint64_t TotalBytes() const {
+    return heap_bytes_ + anonymous_bytes_;
+  }
+  /// @return the growth of <code>TotalBytes</code> the syscall would cause if it succeeded
+  uint64_t RequestedGrowth(BeforeSyscallStoppedTracee &tracee);
+  void AddMapping(unsigned long start, unsigned long end);
+  /// @return number of the bytes of <code>[start, end)</code> which have been mapped
+  uint64_t RemoveMapping(unsigned long start, unsigned long end);
+  void Record(pid_t pid, bool force_rss_sample);
+
+  std::string timeline_file_;
+  std::chrono::milliseconds rss_sample_interval_;
+  size_t max_points_;
+  std::optional<uint64_t> limit_bytes_;
+  unsigned long page_size_;
+
+  // anonymous and private writable mappings, start to end; adjacent ranges are merged
+  std::map<unsigned long, unsigned long> mappings_;
+  uint64_t anonymous_bytes_{0};
+  unsigned long initial_break_{0};
+  unsigned long current_break_{0};
+  uint64_t heap_bytes_{0};
+
+  uint64_t syscalls_{0};
+  uint64_t denied_allocations_{0};
+  std::optional<std::chrono::steady_clock::time_point> started_;
+  std::optional<std::chrono::steady_clock::time_point> last_rss_sample_;
+  std::vector<Point> points_;
+  Point peak_{};
+  int64_t peak_rss_bytes_{-1};
+};
+
+#endif //RUNNER_SRC_MEMORY_TIMELINE_INTERCEPTOR_H_
@@ -0,0 +1,45 @@
+#ifndef RUNNER_SRC_METRICS_H_
+#define RUNNER_SRC_METRICS_H_
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+
+/**
+ * Operational metrics of the runner, exposed in the Prometheus text format.
+ *
+ * Every thread updates its own shard of counters and histograms, so recording a value is a couple of uncontended
+ * relaxed memory accesses and never takes a lock. Shards are summed up only when the metrics are rendered.
+ */
+enum class Counter : size_t {
+  kStopsBeforeSyscall,
+  kStopsAfterSyscall,
+  kStopsBeforeSignalDelivery,
+  kStopsOnGroupStop,
+  kStopsBeforeTermination,
+  kLaunches,
+  kLaunchFailures,
+  kVerdictsExitedZero,
+  kVerdictsExitedNonZero,
+  kVerdictsSignaled,
+  kCount,
+};
+
+enum class Histogram : size_t {
+  kTraceeRunTime,
+  kInterceptorTime,
+  kLaunchDuration,
+  kCount,
+};
+
+void IncrementCounter(Counter counter);
+
+void ObserveHistogram(Histogram histogram, std::chrono::nanoseconds value);
+
+/// @return all the metrics in the Prometheus text exposition format.
+std::string RenderMetrics();
+
+/// Atomically replaces <code>path</code> with the rendered metrics, e.g. for the node exporter textfile collector.
+void WriteMetricsFile(const std::string &path);
+
+#endif //RUNNER_SRC_METRICS_H_
@@ -0,0 +1,126 @@
+#ifndef RUNNER_SRC_PATH_POLICY_INTERCEPTOR_H_
+#define RUNNER_SRC_PATH_POLICY_INTERCEPTOR_H_
+
+#include <sys/types.h>
+
+#include <bitset>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "interceptors.h"
+#include "syscalls.h"
+
+/**
+ * Allow and deny rules for absolute paths, compiled into a character trie. A rule covers its path and everything
+ * under it, and the longest rule covering a path decides, so a lookup walks the path once whatever the number of
+ * rules is.
+ */
+class PathRuleTrie {
+ public:
+  enum class Access : int8_t {
+    kNone = -1,
+    kDeny = 0,
+    kAllow = 1,
+  };
+
+  /// @param rules normalized absolute paths (see <code>NormalizePath</code>) with their access
+  explicit PathRuleTrie(const std::vector<std::pair<std::string, Access>> &rules);
+
+  /// @param path normalized absolute path
+  /// @return access of the longest rule covering the path, <code>kNone</code> if there is no such rule
+  [[nodiscard]] Access Match(std::string_view path) const;
+
+  /**
+   * Resolves <code>.</code>, <code>..</code> and repeated slashes lexically, without following symbolic links.
+   *
+   * @param base normalized absolute directory a relative <code>path</code> is resolved against
+   */
+  static std::string NormalizePath(std::string_view base, std::string_view path);
+
+ private:
+  struct Node {
+    // children are the edges [first_edge, last_edge), sorted by the character
+    uint32_t first_edge;
+    uint32_t last_edge;
+    Access access;
+  };
+  struct Edge {
+    char character;
+    uint32_t child;
+  };
+
+  std::vector<Node> nodes_;
+  std::vector<Edge> edges_;
+};
+
+/**
+ * Enforces a filesystem access policy: the path arguments of the selected syscalls are matched against the rules
+ * and a denied syscall fails with <code>EACCES</code> without being executed. The tracee stops on the entries of
+ * these syscalls only.
+ *
+ * A path is resolved the way the kernel will resolve it, and its canonical form is matched. The lookup walks one
+ * component at a time from the tracee's root, its current directory or the syscall's descriptor, all reached through
+ * <code>/proc/pid</code>. The symbolic links met on the way are read and spliced in, while the magic links of procfs
+ * (<code>/proc/self/root</code>, <code>/proc/self/cwd</code>, descriptors) are followed by the kernel, and
+ * <code>/proc/self</code> names the tracee. The part of the path which doesn't exist yet is taken as spelled.
+ * A symbolic link at the end is checked as well as its target, as is the target of a link being created.
+ *
+ * The check reads the path and the filesystem before the kernel does, so a sibling thread or another process may
+ * change them in between: the policy is meant for single-threaded solutions, a sandbox should confine the rest.
+ * <code>openat2</code> fails with <code>ENOSYS</code>, which makes the C library fall back to <code>openat</code>.
+ *
+ * Config:
+ * <ul>
+ *   <li><code>rules</code> --- array of <code>{"path": "/etc", "access": "deny"}</code>, a path covers everything
+ *       under it;</li>
+ *   <li><code>defaultAccess</code> --- <code>"allow"</code> (default) or <code>"deny"</code> for paths no rule
+ *       covers;</li>
+ *   <li><code>syscalls</code> --- names of the syscalls to check, the ones opening, creating, removing, linking and
+ *       executing files by default;</li>
+ *   <li><code>maxReportedDenials</code> --- number of the denied syscalls listed in the exit status, 10 by
+ *       default.</li>
+ * </ul>
+ */
+class PathPolicyInterceptor : public virtual NoOpStoppedTraceeInterceptor {
+ public:
+  explicit PathPolicyInterceptor(const nlohmann::json &config);
+
+  [[nodiscard]] std::optional<std::vector<unsigned long>> InterceptedSyscalls() const override;
+  [[nodiscard]] bool InterceptsSyscallExits() const override;
+  [[nodiscard]] nlohmann::json CollectStatistics() const override;
+
+ protected:
+  bool Intercept(BeforeSyscallStoppedTracee &tracee) override;
+
+ private:
+  /// @return the path argument, <code>std::nullopt</code> if it isn't a readable string the kernel would accept
+  static std::optional<std::string> ReadPath(BeforeSyscallStoppedTracee &tracee, unsigned long address);
+  /**
+   * Resolves a path of the tracee the way the kernel will, see the class comment.
+   *
+   * @param dirfd descriptor of the tracee a relative path is resolved against, <code>AT_FDCWD</code> for its current
+   *              directory
+   * @return the canonical absolute paths to check: the symbolic links found at the end of the path, outermost first,
+   *         then what they lead to; <code>std::nullopt</code> if the kernel would fail the lookup itself
+   */
+  static std::optional<std::vector<std::string>> ResolvePath(pid_t pid, int dirfd, const std::string &path);
+  [[nodiscard]] bool Allows(std::string_view path) const;
+  void Deny(BeforeSyscallStoppedTracee &tracee, const std::string &path);
+
+  PathRuleTrie trie_;
+  bool allow_by_default_;
+  std::bitset<kMaxSyscallNumber> syscalls_;
+  size_t max_reported_denials_;
+
+  uint64_t checked_{0};
+  uint64_t denied_{0};
+  std::vector<std::string> reported_denials_;
+};
+
+#endif //RUNNER_SRC_PATH_POLICY_INTERCEPTOR_H_
@@ -2,6 +2,7 @@
 #define RUNNER_SRC_READ_SIZE_SHRINK_INTERCEPTOR_H_
 
 #include <sys/types.h>
+#include <cstdint>
 
 #include "interceptors.h"
 
@@ -9,6 +10,9 @@ class ReadSizeShrinkInterceptor : public virtual NoOpStoppedTraceeInterceptor {
  public:
   ReadSizeShrinkInterceptor();
 
+  [[nodiscard]] std::optional<std::vector<unsigned long>> InterceptedSyscalls() const override;
+  [[nodiscard]] nlohmann::json CollectStatistics() const override;
+
  protected:
   bool Intercept(BeforeSyscallStoppedTracee &tracee) override;
   bool Intercept(AfterSyscallStoppedTracee &tracee) override;
@@ -18,6 +22,7 @@ class ReadSizeShrinkInterceptor : public virtual NoOpStoppedTraceeInterceptor {
 
   bool should_restore_size_{false};
   size_t size_to_restore_{0};
+  uint64_t shrunk_reads_{0};
 };
 
 #endif //RUNNER_SRC_READ_SIZE_SHRINK_INTERCEPTOR_H_
@@ -0,0 +1,84 @@
+#ifndef RUNNER_SRC_REGISTERS_H_
+#define RUNNER_SRC_REGISTERS_H_
+
+#include <sys/ptrace.h>
+#include <sys/user.h>
+#include <cstddef>
+#include <cstdint>
+
+#include "syscalls.h"
+
+class Tracee;
+
+/// General purpose registers of an ia32 task, laid out as <code>struct user_regs_struct32</code> of the kernel.
+struct I386UserRegisters {
+  uint32_t ebx, ecx, edx, esi, edi, ebp, eax;
+  uint32_t xds, xes, xfs, xgs;
+  uint32_t orig_eax, eip, xcs, eflags, esp, xss;
+};
+
+/**
+ * A single <code>PTRACE_GETREGSET(NT_PRSTATUS)</code> snapshot of the tracee registers, interpreted according to
+ * the syscall ABI of the tracee.
+ *
+ * The kernel reports the register set of an ia32 task in its 32-bit layout, so the ABI is detected by the size of
+ * the snapshot, and additionally by the code segment selector for 64-bit tasks executing 32-bit code.
+ * Syscall numbers are exposed as native x86-64 ones regardless of the ABI (see <code>syscalls.h</code>).
+ *
+ * The snapshot may instead be filled from <code>PTRACE_GET_SYSCALL_INFO</code>, which reports the syscall number,
+ * arguments, return value and ABI of the current stop in one call. Such a snapshot answers the getters only;
+ * the register set must be loaded with <code>Load</code> before modifying it.
+ */
+class SyscallRegisters {
+ public:
+  void Load(Tracee &tracee);
+  void Store(Tracee &tracee);
+#ifdef PTRACE_GET_SYSCALL_INFO
+  void LoadSyscallInfo(const __ptrace_syscall_info &info);
+#endif
+
+  /// @return whether the register set has been loaded, as opposed to the syscall info only.
+  [[nodiscard]] bool HasRegisterSet() const {
+    return size_ != 0;
+  }
+
+  [[nodiscard]] SyscallAbi Abi() const {
+    return abi_;
+  }
+  /// Overrides the ABI detected by <code>Load</code>, e.g. with the one reported by the kernel for the syscall.
+  void SetAbi(SyscallAbi abi) {
+    abi_ = abi;
+  }
+
+  [[nodiscard]] unsigned long SyscallNumber() const;
+  void SetSyscallNumber(unsigned long syscall_no);
+  [[nodiscard]] unsigned long Arg(int index) const;
+  void SetArg(int index, unsigned long arg);
+  [[nodiscard]] long ReturnValue() const;
+  void SetReturnValue(long return_value);
+  [[nodiscard]] unsigned long InstructionPointer() const;
+  void SetInstructionPointer(unsigned long address);
+  [[nodiscard]] unsigned long StackPointer() const;
+  /// Requires the register set.
+  [[nodiscard]] unsigned long FramePointer() const;
+
+ private:
+  struct SyscallInfo {
+    unsigned long number;
+    unsigned long args[6];
+    long return_value;
+    unsigned long instruction_pointer;
+    unsigned long stack_pointer;
+  };
+
+  union {
+    user_regs_struct x86_64;
+    I386UserRegisters i386;
+  } registers_{};
+  size_t size_{0};
+  SyscallInfo info_{};
+  bool has_info_{false};
+  SyscallAbi abi_{SyscallAbi::kX86_64};
+};
+
+#endif //RUNNER_SRC_REGISTERS_H_
@@ -0,0 +1,33 @@
+#ifndef RUNNER_SRC_REPEATED_RUNS_H_
+#define RUNNER_SRC_REPEATED_RUNS_H_
+
+#include <cstddef>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+/**
+ * Launches the tracee as described by the <code>repeat</code> section of <code>config</code> to measure its running
+ * time: first <code>warmupRuns</code> runs, whose results are dropped, then up to <code>measuredRuns</code> runs.
+ * Measuring stops early once at least <code>minMeasuredRuns</code> runs are done and the 95% confidence interval
+ * of the mean wall time, built with Student's t-distribution, is within <code>relativeConfidence</code> of the mean.
+ * It also stops at the first run whose verdict isn't <code>"ok"</code>: a failing solution isn't benchmarked.
+ *
+ * The executable is loaded into memory once and the input is rewound for each run.
+ *
+ * @return exit status of the last run with the <code>repeat</code> section added: the number of runs and
+ *         the min/median/p90/max, mean and standard deviation of <code>wallMicros</code> and <code>cpuMicros</code>
+ */
+nlohmann::json LaunchRepeatedly(const nlohmann::json &config,
+                                const char *path_to_executable,
+                                char *const *executable_argv,
+                                int stdin_fd);
+
+/// @return min, median, p90, max, mean, standard deviation and relative spread of <code>samples</code>
+nlohmann::json DescribeSamples(std::vector<double> samples);
+
+/// @return two-sided 95% quantile of Student's t-distribution, e.g. 4.303 for the mean of three samples; infinity for
+///         zero degrees of freedom
+double StudentTQuantile95(size_t degrees_of_freedom);
+
+#endif //RUNNER_SRC_REPEATED_RUNS_H_
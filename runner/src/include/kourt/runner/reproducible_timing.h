@@ -0,0 +1,54 @@
+#ifndef RUNNER_SRC_REPRODUCIBLE_TIMING_H_
+#define RUNNER_SRC_REPRODUCIBLE_TIMING_H_
+
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+/**
+ * Settings which make the running time of the tracee less dependent on the host and on the runner:
+ * <ul>
+ *   <li>the tracee is pinned to a single core, the first one of <code>cpuAffinity</code> unless configured,
+ *       otherwise the last core the runner may use;</li>
+ *   <li>address space layout randomization is disabled;</li>
+ *   <li>the tracee gets a fixed minimal environment instead of the runner's one;</li>
+ *   <li>optionally, the tracee runs with <code>SCHED_FIFO</code> or with a nice value.</li>
+ * </ul>
+ */
+class ReproducibleTiming {
+ public:
+  /// @param config the whole runner config
+  explicit ReproducibleTiming(const nlohmann::json &config);
+
+  ReproducibleTiming(const ReproducibleTiming &) = delete;
+  ReproducibleTiming &operator=(const ReproducibleTiming &) = delete;
+
+  /// Applies the settings to the calling process, which is about to exec the tracee. Doesn't allocate memory.
+  /// @return false if a setting can't be applied, <code>errno</code> tells why
+  bool ApplyInChild() const;
+
+  /// @return the environment for <code>execve</code>
+  [[nodiscard]] char *const *Environment() const {
+    return environment_pointers_.data();
+  }
+
+  /// @return the core and the applied settings.
+  [[nodiscard]] nlohmann::json CollectStatistics() const;
+
+ private:
+  int cpu_;
+  std::optional<int> realtime_priority_;
+  std::optional<int> nice_;
+  std::vector<std::string> environment_;
+  std::vector<char *> environment_pointers_;
+};
+
+/// Creates the settings as described by the <code>reproducibleTiming</code> section of the runner config,
+/// if it is present.
+std::unique_ptr<ReproducibleTiming> CreateReproducibleTimingIfConfigured(const nlohmann::json &config);
+
+#endif //RUNNER_SRC_REPRODUCIBLE_TIMING_H_
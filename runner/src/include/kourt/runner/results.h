@@ -0,0 +1,74 @@
+#ifndef RUNNER_SRC_RESULTS_H_
+#define RUNNER_SRC_RESULTS_H_
+
+#include <cstdio>
+#include <optional>
+#include <string>
+
+#include <nlohmann/json.hpp>
+
+/**
+ * Results of launches (the exit status) and the formats they are written in.
+ *
+ * Every result carries <code>schemaVersion</code>; fields are only ever added within a version.
+ * Schema version 1:
+ * <ul>
+ *   <li><code>verdict</code> --- <code>"ok"</code>, <code>"nonZeroExitCode"</code>, <code>"killedBySignal"</code>,
+ *       <code>"memoryLimitExceeded"</code>, <code>"instructionLimitExceeded"</code>, <code>"generatorFailed"</code>
+ *       if the generated input is incomplete or not the expected one, or <code>"interactorFailed"</code> if the
+ *       tracee is otherwise fine but the interactor has not exited with zero;</li>
+ *   <li><code>id</code> --- the <code>resultId</code> of the config, if it is set, which tells apart the results
+ *       appended to a shared file; the daemon sets it to the id of the job unless the config has one;</li>
+ *   <li><code>exitCode</code> or <code>signal</code>;</li>
+ *   <li><code>limitsHit</code> --- names of the limits the tracee has run into: the cgroup ones, e.g.
+ *       <code>"memory"</code>, and <code>"instructions"</code>;</li>
+ *   <li><code>resourceUsage</code> --- <code>userMicros</code>, <code>systemMicros</code>, <code>maxRssKiB</code>
+ *       from <code>wait4</code> and <code>wallMicros</code> of the launch;</li>
+ *   <li><code>outputDigests</code> --- SHA-256 of <code>stdout</code> and <code>stderr</code>, if requested;</li>
+ *   <li><code>interceptors</code> --- statistics of the configured interceptors, in the config order;</li>
+ *   <li>sections of optional features: <code>cgroup</code>, <code>sandbox</code>, <code>interactor</code>,
+ *       <code>instructions</code> etc.</li>
+ * </ul>
+ *
+ * Formats, selected by <code>resultFormat</code> of the config:
+ * <ul>
+ *   <li><code>json</code> --- a single result replaces the file;</li>
+ *   <li><code>ndjson</code> --- a result is appended to the file as a line;</li>
+ *   <li><code>binary</code> --- a result is appended as a record: the magic <code>"KR"</code>, the schema version
+ *       byte, a reserved byte, the little-endian 32-bit size of the payload and the payload in CBOR.</li>
+ * </ul>
+ * Appending is a single <code>write</code> to a file opened with <code>O_APPEND</code>, so concurrent runners
+ * can share a result file and a batch of results is read back sequentially from one file.
+ */
+inline constexpr int kResultSchemaVersion = 1;
+
+enum class ResultFormat {
+  kJson,
+  kNdjson,
+  kBinary,
+};
+
+/// @throws std::invalid_argument if the name is unknown
+ResultFormat ParseResultFormat(const std::string &name);
+
+void WriteResult(const nlohmann::json &result, ResultFormat format, const std::string &path);
+
+/// Reads results written in either the <code>ndjson</code> or the <code>binary</code> format, or a single
+/// <code>json</code> result. The format is detected by the first byte of the file.
+class ResultReader {
+ public:
+  explicit ResultReader(const std::string &path);
+  ~ResultReader();
+
+  ResultReader(const ResultReader &) = delete;
+  ResultReader &operator=(const ResultReader &) = delete;
+
+  /// @return the next result, or <code>std::nullopt</code> at the end of the file
+  /// @throws std::runtime_error if the file is malformed
+  std::optional<nlohmann::json> Next();
+
+ private:
+  FILE *file_;
+};
+
+#endif //RUNNER_SRC_RESULTS_H_
@@ -1,7 +1,26 @@
-
 #ifndef RUNNER_SRC_RUNNER_MAIN_H_
 #define RUNNER_SRC_RUNNER_MAIN_H_
 
+#include <nlohmann/json.hpp>
+
 int RunnerMain(int argc, char *const *argv);
 
+/**
+ * Executes a single tracee as described by <code>config</code>, or several times if it has a <code>repeat</code>
+ * section (see <code>LaunchRepeatedly</code>).
+ *
+ * @param stdin_fd file descriptor to become stdin of the tracee; if -1, the <code>stdinFile</code> config key or
+ *                 the stdin of the runner is used
+ * @return exit status of the tracee as written to the exit status file
+ */
+nlohmann::json LaunchRunner(const nlohmann::json &config,
+                            const char *path_to_executable,
+                            char *const *executable_argv,
+                            int stdin_fd = -1);
+
+/// @return exit status of a process as reported by <code>waitpid</code>, in the format of the exit status file
+nlohmann::json ExitStatusToJson(int exit_status);
+
+void PrintExitStatus(const nlohmann::json &exit_status, const nlohmann::json &config);
+
 #endif //RUNNER_SRC_RUNNER_MAIN_H_
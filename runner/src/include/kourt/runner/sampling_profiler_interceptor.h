@@ -0,0 +1,122 @@
+#ifndef RUNNER_SRC_SAMPLING_PROFILER_INTERCEPTOR_H_
+#define RUNNER_SRC_SAMPLING_PROFILER_INTERCEPTOR_H_
+
+#include <sys/types.h>
+#include <csignal>
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "interceptors.h"
+
+/**
+ * Statistical profiler of the tracee. A task-clock perf event attached at the exec stop overflows every
+ * <code>1 / frequencyHz</code> seconds of the tracee's CPU time and sends it <code>SIGPROF</code>; the signal is
+ * caught at its signal-delivery-stop and suppressed, so the tracee never observes it. At each such stop the
+ * interceptor takes the instruction pointer and walks the frame pointer chain, reading the stack with a single
+ * <code>process_vm_readv</code> where possible. Equal stacks are aggregated in a hash table.
+ *
+ * The tracee stops on no syscalls. Frames are symbolized against the ELF symbol tables of the executable and of
+ * the libraries mapped, which are read while the tracee is alive; the result is a folded-stack file
+ * (<code>main;solve;dfs 42</code> per line) ready for flame graph tools, and the exit status gets the functions
+ * sampled most often.
+ *
+ * Stacks are complete for code built with <code>-fno-omit-frame-pointer</code>; otherwise they are cut short
+ * where a frame doesn't keep the pointer. A leaf function which sets up no frame of its own (as optimized code
+ * often does) appears called by its caller's caller. A test served by a fork server is not profiled, since its
+ * process isn't exec'ed. Only the main thread is sampled: the other threads of the tracee aren't traced, so their
+ * time is missing from the profile.
+ *
+ * Config:
+ * <ul>
+ *   <li><code>frequencyHz</code> --- samples per second of CPU time, 100 by default, at most 1000 so that the stops
+ *       don't distort the timing of the tracee;</li>
+ *   <li><code>maxFrames</code> --- depth of the stack walk, 64 by default;</li>
+ *   <li><code>foldedStacksFile</code> --- the profile, relative to the working directory of the tracee,
+ *       <code>profile.folded</code> by default;</li>
+ *   <li><code>topFunctions</code> --- number of the functions reported in the exit status, 10 by default.</li>
+ * </ul>
+ */
+class SamplingProfilerInterceptor : public virtual NoOpStoppedTraceeInterceptor {
+ public:
+  static const int kSampleSignal = SIGPROF;
+  static const long kMaxFrequencyHz = 1000;
+
+  explicit SamplingProfilerInterceptor(const nlohmann::json &config);
+  ~SamplingProfilerInterceptor();
+
+  SamplingProfilerInterceptor(const SamplingProfilerInterceptor &) = delete;
+  SamplingProfilerInterceptor &operator=(const SamplingProfilerInterceptor &) = delete;
+
+  void OnExec(Tracee &tracee) override;
+  void OnFinish(const std::string &working_directory) override;
+  [[nodiscard]] std::optional<std::vector<unsigned long>> InterceptedSyscalls() const override;
+  [[nodiscard]] nlohmann::json CollectStatistics() const override;
+
+ protected:
+  bool Intercept(BeforeSignalDeliveryStoppedTracee &tracee) override;
+  bool Intercept(BeforeTerminationStoppedTracee &tracee) override;
+
+ private:
+  struct Symbol {
+    unsigned long start;
+    unsigned long end;
+    std::string name;
+  };
+
+  /// An ELF file mapped into the tracee.
+  struct Module {
+    std::string name;
+    // sorted by the start address
+    std::vector<Symbol> symbols;
+    // the link-time address of the first loadable segment, rounded down to a page
+    unsigned long first_segment_address{0};
+  };
+
+  struct Mapping {
+    unsigned long end;
+    // the address the module is mapped at minus its link-time address
+    unsigned long load_bias;
+    const Module *module;
+  };
+
+  struct StackHash {
+    size_t operator()(const std::vector<unsigned long> &stack) const;
+  };
+
+  /// Records the stack of the tracee: the instruction pointer followed by the return addresses, innermost first.
+  void Sample(StoppedTracee &tracee);
+  /// Reads the mappings of the tracee and the symbol tables of the modules not seen before.
+  void RefreshMappings(pid_t pid);
+  const Module *LoadModule(const std::string &path, const std::string &file_to_read);
+  /// @return number of the samples of each stack, its frames symbolized and joined outermost first
+  [[nodiscard]] std::map<std::string, uint64_t> FoldStacks() const;
+  /// @param return_address whether the address follows a call, rather than being the sampled instruction
+  [[nodiscard]] std::string Symbolize(unsigned long address, bool return_address) const;
+
+  long frequency_hz_;
+  size_t max_frames_;
+  std::string folded_stacks_file_;
+  size_t top_functions_;
+
+  int fd_{-1};
+  std::string executable_path_;
+  std::unordered_map<std::string, Module> modules_;
+  // start to the rest of the mapping, for the mappings of the ELF files only
+  std::map<unsigned long, Mapping> mappings_;
+
+  // the top of the stack copied at a sample, kept to avoid an allocation per sample
+  std::vector<unsigned char> stack_snapshot_;
+  std::unordered_map<std::vector<unsigned long>, uint64_t, StackHash> stacks_;
+  uint64_t samples_{0};
+  std::chrono::steady_clock::duration sampling_time_{};
+};
+
+#endif //RUNNER_SRC_SAMPLING_PROFILER_INTERCEPTOR_H_
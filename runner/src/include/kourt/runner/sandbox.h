@@ -0,0 +1,103 @@
+#ifndef RUNNER_SRC_SANDBOX_H_
+#define RUNNER_SRC_SANDBOX_H_
+
+#include <sched.h>
+#include <sys/types.h>
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+/**
+ * Namespace-based isolation of a single tracee launch.
+ *
+ * The child is spawned in fresh user, mount, pid, network and ipc namespaces. It mounts a copy-on-write view of
+ * a minimal root filesystem (an overlay over the cached read-only rootfs with a per-launch tmpfs upper layer),
+ * bind-mounts read-only system directories and the current working directory into it and pivots into it.
+ *
+ * Being pid 1 of its namespace, the child can't be the tracee itself: the kernel drops signals with default
+ * disposition sent to a namespace init. So the child stays in the sandbox as a reaper and forks the process
+ * which will exec the solution. That process is not a child of the runner, so it reports its pid through
+ * a socket and waits until the runner seizes it.
+ *
+ * Usage:
+ * <ol>
+ *   <li>spawn the child with <code>kNamespaceFlags</code>;</li>
+ *   <li>call <code>EnterInChild</code> in the child; it returns in the future tracee only;</li>
+ *   <li>call <code>AttachToTracee</code> in the parent;</li>
+ *   <li>call <code>ReleaseTracee</code> in the tracee right before exec;</li>
+ *   <li>after the tracee has finished, call <code>ReapInit</code> in the parent.</li>
+ * </ol>
+ */
+class Sandbox {
+ public:
+  static constexpr unsigned long kNamespaceFlags =
+      CLONE_NEWUSER | CLONE_NEWNS | CLONE_NEWPID | CLONE_NEWNET | CLONE_NEWIPC;
+
+  /// @param working_directory directory to be bound at <code>/work</code>, the current one if empty
+  Sandbox(const nlohmann::json &sandbox_config, const std::string &working_directory);
+  ~Sandbox();
+
+  Sandbox(const Sandbox &) = delete;
+  Sandbox &operator=(const Sandbox &) = delete;
+
+  /// Sets up the sandbox in a child spawned with <code>kNamespaceFlags</code>.
+  /// Only async-signal-safe functions are used here.
+  void EnterInChild();
+
+  /// Makes the tracee continue to exec. Should be called by the tracee.
+  void ReleaseTracee();
+
+  /**
+   * Waits until the tracee is ready and seizes it with <code>ptrace_options</code>.
+   *
+   * @param init_pid pid of the spawned child, i.e. the namespace init
+   * @param spawn_started when the child was spawned; the setup time reported covers the creation of the namespaces,
+   *                      the filesystem set-up and the handshake
+   * @return pid of the tracee in the runner's pid namespace
+   */
+  pid_t AttachToTracee(pid_t init_pid, long ptrace_options, std::chrono::steady_clock::time_point spawn_started);
+
+  /// Waits for the namespace init to exit after the tracee has been reaped.
+  void ReapInit();
+
+  [[nodiscard]] nlohmann::json CollectStatistics() const;
+
+ private:
+  struct BindMount {
+    std::string source;
+    std::string target;
+    unsigned long flags;
+  };
+
+  void PrepareRootfs(const std::vector<std::string> &bind_paths);
+  void SetUpFilesystem();
+  [[noreturn]] void FailInChild(const char *what);
+
+  std::string rootfs_;
+  std::string scratch_;
+  std::string upper_;
+  std::string work_;
+  std::string new_root_;
+  std::string new_root_tmp_;
+  std::string new_root_proc_;
+  std::string new_root_work_;
+  std::string overlay_options_;
+  std::string current_directory_;
+  std::string uid_map_;
+  std::string gid_map_;
+  std::vector<BindMount> bind_mounts_;
+
+  int parent_socket_{-1};
+  int child_socket_{-1};
+  pid_t init_pid_{-1};
+  std::chrono::microseconds setup_time_{0};
+};
+
+/// Creates a sandbox as described by the <code>sandbox</code> section of the runner config, if it is present.
+std::unique_ptr<Sandbox> CreateSandboxIfConfigured(const nlohmann::json &config);
+
+#endif //RUNNER_SRC_SANDBOX_H_
@@ -0,0 +1,104 @@
+#ifndef RUNNER_SRC_SCHEDULER_H_
+#define RUNNER_SRC_SCHEDULER_H_
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <queue>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+class DaemonConnection;
+
+/// A job submitted to the daemon together with the connection its response should be sent to.
+struct DaemonJob {
+  nlohmann::json request;
+  std::shared_ptr<DaemonConnection> connection;
+  std::chrono::steady_clock::time_point enqueued_at{};
+  /// Time the job has spent in the queue, set when it is dispatched.
+  std::chrono::microseconds wait{0};
+};
+
+/**
+ * Decides which of the queued daemon jobs runs next.
+ *
+ * Jobs are grouped by the <code>submission</code> they belong to, and submissions share the workers in proportion
+ * to their <code>weight</code> (stride scheduling): each submission has a virtual time advanced by
+ * <code>estimatedCost / weight</code> per dispatched job, and the submission with the least virtual time goes
+ * next. A submission which becomes active starts at the current virtual time, so it neither waits behind the
+ * backlog of a heavy submission nor gets a burst for the time it was idle.
+ *
+ * <code>interactive</code> jobs (e.g. sample tests run from an editor) bypass the fair share and are dispatched
+ * before any batch job, shortest <code>estimatedCost</code> first.
+ *
+ * The class is not thread-safe: it is guarded by the daemon's queue mutex.
+ */
+class JobScheduler {
+ public:
+  void Push(DaemonJob &&job);
+  /// @return the next job to execute, or nothing if the queue is empty.
+  std::optional<DaemonJob> Pop();
+
+  [[nodiscard]] bool Empty() const {
+    return Depth() == 0;
+  }
+  [[nodiscard]] size_t Depth() const {
+    return interactive_jobs_.size() + batch_jobs_;
+  }
+
+  /// @return queue depth, wait time and dispatch counters.
+  [[nodiscard]] nlohmann::json CollectStatistics() const;
+
+ private:
+  struct InteractiveEntry {
+    double cost;
+    uint64_t sequence_number;
+    // mutable, so that the job can be moved out of the priority queue before popping it
+    mutable DaemonJob job;
+
+    bool operator<(const InteractiveEntry &other) const {
+      // std::priority_queue is a max-heap
+      return std::tie(cost, sequence_number) > std::tie(other.cost, other.sequence_number);
+    }
+  };
+
+  struct BatchEntry {
+    double cost;
+    uint64_t sequence_number;
+    DaemonJob job;
+  };
+
+  struct Submission {
+    double weight{1};
+    double virtual_time{0};
+    std::deque<BatchEntry> jobs;
+  };
+
+  struct WaitStatistics {
+    uint64_t dispatched{0};
+    std::chrono::microseconds total_wait{0};
+    std::chrono::microseconds max_wait{0};
+
+    void Record(std::chrono::microseconds wait);
+    [[nodiscard]] nlohmann::json ToJson() const;
+  };
+
+  DaemonJob Dispatch(DaemonJob &&job, WaitStatistics *statistics);
+
+  std::priority_queue<InteractiveEntry> interactive_jobs_;
+  std::unordered_map<std::string, Submission> submissions_;
+  size_t batch_jobs_{0};
+  double virtual_time_{0};
+  uint64_t next_sequence_number_{0};
+
+  WaitStatistics interactive_statistics_;
+  WaitStatistics batch_statistics_;
+};
+
+#endif //RUNNER_SRC_SCHEDULER_H_
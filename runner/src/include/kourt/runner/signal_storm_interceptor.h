@@ -0,0 +1,54 @@
+#ifndef RUNNER_SRC_SIGNAL_STORM_INTERCEPTOR_H_
+#define RUNNER_SRC_SIGNAL_STORM_INTERCEPTOR_H_
+
+#include <bitset>
+#include <cstdint>
+
+#include <nlohmann/json.hpp>
+
+#include "interceptors.h"
+#include "syscalls.h"
+
+/**
+ * Injects a signal at syscall boundaries to exercise the tracee's signal handling, e.g. its <code>EINTR</code> paths.
+ *
+ * Config:
+ * <ul>
+ *   <li><code>signal</code> --- number of the signal to inject;</li>
+ *   <li><code>syscalls</code> --- names of the syscalls to inject the signal at, all syscalls if absent;</li>
+ *   <li><code>boundary</code> --- <code>"entry"</code> (default) to interrupt the syscall, <code>"exit"</code> to
+ *       deliver the signal right after it;</li>
+ *   <li><code>every</code> --- inject at every n-th matching syscall, 1 by default;</li>
+ *   <li><code>skip</code> --- number of matching syscalls to leave alone first, e.g. those made during start-up;</li>
+ *   <li><code>limit</code> --- maximum number of signals to inject.</li>
+ * </ul>
+ *
+ * Matching a syscall costs a bit test and a counter increment, so storms of any rate don't slow down the tracer.
+ */
+class SignalStormInterceptor : public virtual NoOpStoppedTraceeInterceptor {
+ public:
+  explicit SignalStormInterceptor(const nlohmann::json &config);
+
+  [[nodiscard]] std::optional<std::vector<unsigned long>> InterceptedSyscalls() const override;
+  [[nodiscard]] bool InterceptsSyscallExits() const override;
+  [[nodiscard]] nlohmann::json CollectStatistics() const override;
+
+ protected:
+  bool Intercept(BeforeSyscallStoppedTracee &tracee) override;
+  bool Intercept(AfterSyscallStoppedTracee &tracee) override;
+
+ private:
+  void MaybeInject(SyscallStoppedTracee &tracee);
+
+  int signal_number_;
+  std::bitset<kMaxSyscallNumber> syscalls_;
+  bool on_entry_;
+  uint64_t every_;
+  uint64_t skip_;
+  uint64_t limit_;
+
+  uint64_t matched_{0};
+  uint64_t injected_{0};
+};
+
+#endif //RUNNER_SRC_SIGNAL_STORM_INTERCEPTOR_H_
@@ -0,0 +1,31 @@
+#ifndef RUNNER_SRC_SPAWN_H_
+#define RUNNER_SRC_SPAWN_H_
+
+#include <sys/types.h>
+
+#include <chrono>
+
+struct SpawnOptions {
+  /// File descriptor of a cgroup v2 directory the child should be placed into, or -1.
+  int cgroup_fd{-1};
+  /// <code>CLONE_NEW*</code> flags of the namespaces the child should be created in.
+  unsigned long namespace_flags{0};
+};
+
+/**
+ * Creates a child process the same way <code>fork</code> does, but applies <code>options</code> to it.
+ *
+ * Without namespaces this is plain <code>fork</code>, which keeps the C library consistent in the child of
+ * the multithreaded runner; the child moves itself to the cgroup before returning. With namespaces
+ * <code>clone3</code> is used when the kernel supports it, so that the child is born inside the requested cgroup and
+ * namespaces. Failing that, the function falls back to <code>clone</code> and the child joins the cgroup itself.
+ *
+ * @return 0 in the child, pid of the child in the parent.
+ */
+pid_t SpawnProcess(const SpawnOptions &options);
+
+/// Waits for the child <code>pid</code> to exit, with a pidfd where the kernel supports it.
+/// @return whether the process has exited in <code>timeout</code>; its status is then stored to <code>status</code>
+bool WaitWithTimeout(pid_t pid, std::chrono::milliseconds timeout, int *status);
+
+#endif //RUNNER_SRC_SPAWN_H_
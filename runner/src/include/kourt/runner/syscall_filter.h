@@ -0,0 +1,44 @@
+#ifndef RUNNER_SRC_SYSCALL_FILTER_H_
+#define RUNNER_SRC_SYSCALL_FILTER_H_
+
+#include <linux/filter.h>
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * A seccomp filter making the kernel stop a traced process on the given syscalls only, with
+ * <code>PTRACE_EVENT_SECCOMP</code>. A tracer resuming the process with <code>PTRACE_CONT</code> then pays nothing for
+ * the rest of the syscalls, instead of two stops per syscall with <code>PTRACE_SYSCALL</code>.
+ *
+ * The tracer must set <code>PTRACE_O_TRACESECCOMP</code> before the process makes any of the syscalls, otherwise
+ * the kernel fails them with <code>ENOSYS</code>. A seccomp stop may be resumed with <code>PTRACE_SYSCALL</code>
+ * to stop at the exit of the syscall as well, which relies on the ordering of Linux 4.8+.
+ *
+ * The filter is inherited by the children of the process, which aren't traced and so get <code>ENOSYS</code> for
+ * the selected syscalls as well; the runner installs it only if the <code>syscallFilter</code> config key is set.
+ */
+class SyscallFilter {
+ public:
+  /// Maximum number of syscalls a filter can select, the conditional jumps of classic BPF are short.
+  static constexpr size_t kMaxSyscalls = 100;
+
+  /// @param syscalls native numbers of the syscalls to stop on, all their ia32 numbers are selected as well
+  explicit SyscallFilter(const std::vector<unsigned long> &syscalls);
+
+  SyscallFilter(const SyscallFilter &) = delete;
+  SyscallFilter &operator=(const SyscallFilter &) = delete;
+
+  /**
+   * Applies the filter to the calling process, which is irreversible and implies <code>PR_SET_NO_NEW_PRIVS</code>.
+   * Meant for a freshly spawned child, so it doesn't allocate memory.
+   *
+   * @return whether the filter is installed, <code>errno</code> is set otherwise
+   */
+  bool InstallInChild() const;
+
+ private:
+  std::vector<sock_filter> program_;
+};
+
+#endif //RUNNER_SRC_SYSCALL_FILTER_H_
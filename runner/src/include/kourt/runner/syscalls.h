@@ -0,0 +1,329 @@
+#ifndef RUNNER_SRC_SYSCALLS_H_
+#define RUNNER_SRC_SYSCALLS_H_
+
+#include <asm/unistd.h>
+#include <sys/types.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string_view>
+
+/**
+ * Catalogue of the system calls the runner knows about.
+ *
+ * Every row of <code>KOURT_SYSCALL_TABLE</code> describes a syscall as
+ * <code>X(name, ViewType, (kind, type, field)...)</code>, or <code>X0(name, ViewType)</code> for syscalls without
+ * arguments. The table is expanded twice: into the constexpr <code>kSyscallDescriptors</code> array used by generic
+ * tooling (tracing, statistics) and into typed views such as <code>ReadCall{fd, buf, count}</code> which interceptors
+ * obtain with <code>SyscallStoppedTracee::As<ReadCall>()</code>.
+ *
+ * Numbers are those of the native x86-64 ABI. Syscalls of ia32 tracees are translated to them through
+ * <code>KOURT_I386_SYSCALL_TABLE</code>, so interceptors deal with native numbers only.
+ */
+
+enum class SyscallAbi {
+  kX86_64,
+  kI386,
+};
+
+enum SyscallArgKind : unsigned char {
+  kArgNone = 0,
+  kArgFd,
+  kArgInBuffer,   // pointer to memory read by the kernel, its length is the next argument
+  kArgOutBuffer,  // pointer to memory written by the kernel, its length is the next argument
+  kArgSize,
+  kArgCString,
+  kArgFlags,
+  kArgMode,
+  kArgInt,
+  kArgPointer,
+  kArgOffset,
+};
+
+#define KOURT_SYSCALL_TABLE(X, X0) \
+  X(read, ReadCall, (kArgFd, int, fd), (kArgOutBuffer, unsigned long, buf), (kArgSize, size_t, count)) \
+  X(write, WriteCall, (kArgFd, int, fd), (kArgInBuffer, unsigned long, buf), (kArgSize, size_t, count)) \
+  X(open, OpenCall, (kArgCString, unsigned long, path), (kArgFlags, int, flags), (kArgMode, mode_t, mode)) \
+  X(close, CloseCall, (kArgFd, int, fd)) \
+  X(stat, StatCall, (kArgCString, unsigned long, path), (kArgPointer, unsigned long, statbuf)) \
+  X(fstat, FstatCall, (kArgFd, int, fd), (kArgPointer, unsigned long, statbuf)) \
+  X(lstat, LstatCall, (kArgCString, unsigned long, path), (kArgPointer, unsigned long, statbuf)) \
+  X(lseek, LseekCall, (kArgFd, int, fd), (kArgOffset, off_t, offset), (kArgInt, int, whence)) \
+  X(mmap, MmapCall, (kArgPointer, unsigned long, addr), (kArgSize, size_t, length), (kArgFlags, int, prot), \
+    (kArgFlags, int, flags), (kArgFd, int, fd), (kArgOffset, off_t, offset)) \
+  X(mprotect, MprotectCall, (kArgPointer, unsigned long, addr), (kArgSize, size_t, length), \
+    (kArgFlags, int, prot)) \
+  X(munmap, MunmapCall, (kArgPointer, unsigned long, addr), (kArgSize, size_t, length)) \
+  X(brk, BrkCall, (kArgPointer, unsigned long, addr)) \
+  X(rt_sigaction, RtSigactionCall, (kArgInt, int, signum), (kArgPointer, unsigned long, act), \
+    (kArgPointer, unsigned long, oldact), (kArgSize, size_t, sigsetsize)) \
+  X(rt_sigprocmask, RtSigprocmaskCall, (kArgInt, int, how), (kArgPointer, unsigned long, set), \
+    (kArgPointer, unsigned long, oldset), (kArgSize, size_t, sigsetsize)) \
+  X(ioctl, IoctlCall, (kArgFd, int, fd), (kArgInt, unsigned long, request), (kArgPointer, unsigned long, arg)) \
+  X(pread64, Pread64Call, (kArgFd, int, fd), (kArgOutBuffer, unsigned long, buf), (kArgSize, size_t, count), \
+    (kArgOffset, off_t, offset)) \
+  X(pwrite64, Pwrite64Call, (kArgFd, int, fd), (kArgInBuffer, unsigned long, buf), (kArgSize, size_t, count), \
+    (kArgOffset, off_t, offset)) \
+  X(readv, ReadvCall, (kArgFd, int, fd), (kArgPointer, unsigned long, iov), (kArgInt, int, iovcnt)) \
+  X(writev, WritevCall, (kArgFd, int, fd), (kArgPointer, unsigned long, iov), (kArgInt, int, iovcnt)) \
+  X(access, AccessCall, (kArgCString, unsigned long, path), (kArgMode, int, mode)) \
+  X(pipe, PipeCall, (kArgPointer, unsigned long, pipefd)) \
+  X(mremap, MremapCall, (kArgPointer, unsigned long, old_address), (kArgSize, size_t, old_size), \
+    (kArgSize, size_t, new_size), (kArgFlags, int, flags), (kArgPointer, unsigned long, new_address)) \
+  X(dup, DupCall, (kArgFd, int, oldfd)) \
+  X(dup2, Dup2Call, (kArgFd, int, oldfd), (kArgFd, int, newfd)) \
+  X0(pause, PauseCall) \
+  X(nanosleep, NanosleepCall, (kArgPointer, unsigned long, req), (kArgPointer, unsigned long, rem)) \
+  X0(getpid, GetpidCall) \
+  X(socket, SocketCall, (kArgInt, int, domain), (kArgInt, int, type), (kArgInt, int, protocol)) \
+  X(connect, ConnectCall, (kArgFd, int, sockfd), (kArgInBuffer, unsigned long, addr), \
+    (kArgSize, unsigned, addrlen)) \
+  X(clone, CloneCall, (kArgFlags, unsigned long, flags), (kArgPointer, unsigned long, stack), \
+    (kArgPointer, unsigned long, parent_tid), (kArgPointer, unsigned long, child_tid), \
+    (kArgPointer, unsigned long, tls)) \
+  X0(fork, ForkCall) \
+  X0(vfork, VforkCall) \
+  X(execve, ExecveCall, (kArgCString, unsigned long, path), (kArgPointer, unsigned long, argv), \
+    (kArgPointer, unsigned long, envp)) \
+  X(exit, ExitCall, (kArgInt, int, status)) \
+  X(kill, KillCall, (kArgInt, pid_t, pid), (kArgInt, int, sig)) \
+  X(fcntl, FcntlCall, (kArgFd, int, fd), (kArgInt, int, cmd), (kArgInt, unsigned long, arg)) \
+  X(truncate, TruncateCall, (kArgCString, unsigned long, path), (kArgOffset, off_t, length)) \
+  X(ftruncate, FtruncateCall, (kArgFd, int, fd), (kArgOffset, off_t, length)) \
+  X(getcwd, GetcwdCall, (kArgOutBuffer, unsigned long, buf), (kArgSize, size_t, size)) \
+  X(chdir, ChdirCall, (kArgCString, unsigned long, path)) \
+  X(rename, RenameCall, (kArgCString, unsigned long, oldpath), (kArgCString, unsigned long, newpath)) \
+  X(mkdir, MkdirCall, (kArgCString, unsigned long, path), (kArgMode, mode_t, mode)) \
+  X(rmdir, RmdirCall, (kArgCString, unsigned long, path)) \
+  X(creat, CreatCall, (kArgCString, unsigned long, path), (kArgMode, mode_t, mode)) \
+  X(link, LinkCall, (kArgCString, unsigned long, oldpath), (kArgCString, unsigned long, newpath)) \
+  X(unlink, UnlinkCall, (kArgCString, unsigned long, path)) \
+  X(symlink, SymlinkCall, (kArgCString, unsigned long, target), (kArgCString, unsigned long, linkpath)) \
+  X(readlink, ReadlinkCall, (kArgCString, unsigned long, path), (kArgOutBuffer, unsigned long, buf), \
+    (kArgSize, size_t, bufsiz)) \
+  X(chmod, ChmodCall, (kArgCString, unsigned long, path), (kArgMode, mode_t, mode)) \
+  X(gettimeofday, GettimeofdayCall, (kArgPointer, unsigned long, tv), (kArgPointer, unsigned long, tz)) \
+  X(getrusage, GetrusageCall, (kArgInt, int, who), (kArgPointer, unsigned long, usage)) \
+  X(arch_prctl, ArchPrctlCall, (kArgInt, int, code), (kArgPointer, unsigned long, addr)) \
+  X0(gettid, GettidCall) \
+  X(time, TimeCall, (kArgPointer, unsigned long, tloc)) \
+  X(futex, FutexCall, (kArgPointer, unsigned long, uaddr), (kArgInt, int, op), (kArgInt, int, val), \
+    (kArgPointer, unsigned long, timeout), (kArgPointer, unsigned long, uaddr2), (kArgInt, int, val3)) \
+  X(getdents64, Getdents64Call, (kArgFd, int, fd), (kArgOutBuffer, unsigned long, dirp), \
+    (kArgSize, size_t, count)) \
+  X(set_tid_address, SetTidAddressCall, (kArgPointer, unsigned long, tidptr)) \
+  X(clock_gettime, ClockGettimeCall, (kArgInt, clockid_t, clockid), (kArgPointer, unsigned long, tp)) \
+  X(clock_nanosleep, ClockNanosleepCall, (kArgInt, clockid_t, clockid), (kArgFlags, int, flags), \
+    (kArgPointer, unsigned long, request), (kArgPointer, unsigned long, remain)) \
+  X(exit_group, ExitGroupCall, (kArgInt, int, status)) \
+  X(tgkill, TgkillCall, (kArgInt, pid_t, tgid), (kArgInt, pid_t, tid), (kArgInt, int, sig)) \
+  X(openat, OpenatCall, (kArgFd, int, dirfd), (kArgCString, unsigned long, path), (kArgFlags, int, flags), \
+    (kArgMode, mode_t, mode)) \
+  X(mkdirat, MkdiratCall, (kArgFd, int, dirfd), (kArgCString, unsigned long, path), (kArgMode, mode_t, mode)) \
+  X(newfstatat, NewfstatatCall, (kArgFd, int, dirfd), (kArgCString, unsigned long, path), \
+    (kArgPointer, unsigned long, statbuf), (kArgFlags, int, flags)) \
+  X(unlinkat, UnlinkatCall, (kArgFd, int, dirfd), (kArgCString, unsigned long, path), (kArgFlags, int, flags)) \
+  X(renameat, RenameatCall, (kArgFd, int, olddirfd), (kArgCString, unsigned long, oldpath), \
+    (kArgFd, int, newdirfd), (kArgCString, unsigned long, newpath)) \
+  X(linkat, LinkatCall, (kArgFd, int, olddirfd), (kArgCString, unsigned long, oldpath), \
+    (kArgFd, int, newdirfd), (kArgCString, unsigned long, newpath), (kArgFlags, int, flags)) \
+  X(symlinkat, SymlinkatCall, (kArgCString, unsigned long, target), (kArgFd, int, newdirfd), \
+    (kArgCString, unsigned long, linkpath)) \
+  X(readlinkat, ReadlinkatCall, (kArgFd, int, dirfd), (kArgCString, unsigned long, path), \
+    (kArgOutBuffer, unsigned long, buf), (kArgSize, size_t, bufsiz)) \
+  X(faccessat, FaccessatCall, (kArgFd, int, dirfd), (kArgCString, unsigned long, path), (kArgMode, int, mode)) \
+  X(dup3, Dup3Call, (kArgFd, int, oldfd), (kArgFd, int, newfd), (kArgFlags, int, flags)) \
+  X(pipe2, Pipe2Call, (kArgPointer, unsigned long, pipefd), (kArgFlags, int, flags)) \
+  X(prlimit64, Prlimit64Call, (kArgInt, pid_t, pid), (kArgInt, int, resource), \
+    (kArgPointer, unsigned long, new_limit), (kArgPointer, unsigned long, old_limit)) \
+  X(renameat2, Renameat2Call, (kArgFd, int, olddirfd), (kArgCString, unsigned long, oldpath), \
+    (kArgFd, int, newdirfd), (kArgCString, unsigned long, newpath), (kArgFlags, unsigned, flags)) \
+  X(getrandom, GetrandomCall, (kArgOutBuffer, unsigned long, buf), (kArgSize, size_t, buflen), \
+    (kArgFlags, unsigned, flags)) \
+  X(execveat, ExecveatCall, (kArgFd, int, dirfd), (kArgCString, unsigned long, path), \
+    (kArgPointer, unsigned long, argv), (kArgPointer, unsigned long, envp), (kArgFlags, int, flags))
+
+/**
+ * ia32 compat syscalls mapped onto their x86-64 counterparts as <code>X(i386_number, native_name)</code>.
+ *
+ * The first row for a native syscall is the one used to translate a native number back. Rows for syscalls which
+ * take 64-bit values split across two registers (<code>pread64</code>, <code>truncate64</code>, ...) or page-sized
+ * offsets (<code>mmap2</code>) map only the name: such arguments are not reassembled.
+ */
+#define KOURT_I386_SYSCALL_TABLE(X) \
+  X(3, read) X(4, write) X(5, open) X(6, close) X(195, stat) X(106, stat) X(197, fstat) X(108, fstat) X(196, lstat) \
+  X(107, lstat) X(19, lseek) X(192, mmap) X(125, mprotect) X(91, munmap) X(45, brk) X(174, rt_sigaction) \
+  X(175, rt_sigprocmask) X(54, ioctl) X(180, pread64) X(181, pwrite64) X(145, readv) X(146, writev) X(33, access) \
+  X(42, pipe) X(163, mremap) X(41, dup) X(63, dup2) X(29, pause) X(162, nanosleep) X(20, getpid) X(359, socket) \
+  X(362, connect) X(120, clone) X(2, fork) X(190, vfork) X(11, execve) X(1, exit) X(37, kill) X(221, fcntl) \
+  X(55, fcntl) X(193, truncate) X(92, truncate) X(194, ftruncate) X(93, ftruncate) X(183, getcwd) X(12, chdir) \
+  X(38, rename) X(39, mkdir) X(40, rmdir) X(8, creat) X(9, link) X(10, unlink) X(83, symlink) X(85, readlink) \
+  X(15, chmod) X(78, gettimeofday) X(77, getrusage) X(384, arch_prctl) X(224, gettid) X(13, time) X(422, futex) \
+  X(240, futex) X(220, getdents64) X(258, set_tid_address) X(403, clock_gettime) X(265, clock_gettime) \
+  X(407, clock_nanosleep) X(267, clock_nanosleep) X(252, exit_group) X(270, tgkill) X(295, openat) X(296, mkdirat) \
+  X(300, newfstatat) X(301, unlinkat) X(302, renameat) X(303, linkat) X(304, symlinkat) X(305, readlinkat) \
+  X(307, faccessat) X(330, dup3) X(331, pipe2) X(340, prlimit64) X(353, renameat2) X(355, getrandom) \
+  X(358, execveat)
+
+//region preprocessor machinery
+
+#define KOURT_PP_CAT(a, b) KOURT_PP_CAT_I(a, b)
+#define KOURT_PP_CAT_I(a, b) a##b
+#define KOURT_PP_UNPACK(...) __VA_ARGS__
+#define KOURT_PP_APPLY(macro, args) macro args
+#define KOURT_PP_NARGS(...) KOURT_PP_NARGS_I(__VA_ARGS__, 6, 5, 4, 3, 2, 1, 0)
+#define KOURT_PP_NARGS_I(_1, _2, _3, _4, _5, _6, N, ...) N
+
+/// Expands to <code>macro(0, a1) macro(1, a2) ...</code>
+#define KOURT_PP_FOR_EACH(macro, ...) KOURT_PP_CAT(KOURT_PP_FOR_EACH_, KOURT_PP_NARGS(__VA_ARGS__))(macro, __VA_ARGS__)
+#define KOURT_PP_FOR_EACH_1(m, a1) m(0, a1)
+#define KOURT_PP_FOR_EACH_2(m, a1, a2) KOURT_PP_FOR_EACH_1(m, a1) m(1, a2)
+#define KOURT_PP_FOR_EACH_3(m, a1, a2, a3) KOURT_PP_FOR_EACH_2(m, a1, a2) m(2, a3)
+#define KOURT_PP_FOR_EACH_4(m, a1, a2, a3, a4) KOURT_PP_FOR_EACH_3(m, a1, a2, a3) m(3, a4)
+#define KOURT_PP_FOR_EACH_5(m, a1, a2, a3, a4, a5) KOURT_PP_FOR_EACH_4(m, a1, a2, a3, a4) m(4, a5)
+#define KOURT_PP_FOR_EACH_6(m, a1, a2, a3, a4, a5, a6) KOURT_PP_FOR_EACH_5(m, a1, a2, a3, a4, a5) m(5, a6)
+
+#define KOURT_SYSCALL_ARG(macro, index, arg) KOURT_PP_APPLY(macro, (index, KOURT_PP_UNPACK arg))
+#define KOURT_SYSCALL_ARG_KIND(index, arg) KOURT_SYSCALL_ARG(KOURT_SYSCALL_ARG_KIND_I, index, arg)
+#define KOURT_SYSCALL_ARG_KIND_I(index, kind, type, field) kind,
+#define KOURT_SYSCALL_ARG_NAME(index, arg) KOURT_SYSCALL_ARG(KOURT_SYSCALL_ARG_NAME_I, index, arg)
+#define KOURT_SYSCALL_ARG_NAME_I(index, kind, type, field) #field,
+#define KOURT_SYSCALL_FIELD(index, arg) KOURT_SYSCALL_ARG(KOURT_SYSCALL_FIELD_I, index, arg)
+#define KOURT_SYSCALL_FIELD_I(index, kind, type, field) type field;
+#define KOURT_SYSCALL_FIELD_INIT(index, arg) KOURT_SYSCALL_ARG(KOURT_SYSCALL_FIELD_INIT_I, index, arg)
+#define KOURT_SYSCALL_FIELD_INIT_I(index, kind, type, field) static_cast<type>(arguments.Arg(index)),
+
+//endregion
+
+struct SyscallDescriptor {
+  long number;
+  const char *name;
+  int arity;
+  SyscallArgKind arg_kinds[6];
+  const char *arg_names[6];
+};
+
+#define KOURT_DESCRIBE_SYSCALL(name, view, ...) \
+  SyscallDescriptor{__NR_##name, #name, KOURT_PP_NARGS(__VA_ARGS__), \
+                    {KOURT_PP_FOR_EACH(KOURT_SYSCALL_ARG_KIND, __VA_ARGS__)}, \
+                    {KOURT_PP_FOR_EACH(KOURT_SYSCALL_ARG_NAME, __VA_ARGS__)}},
+#define KOURT_DESCRIBE_SYSCALL0(name, view) SyscallDescriptor{__NR_##name, #name, 0, {}, {}},
+
+inline constexpr SyscallDescriptor kSyscallDescriptors[] = {
+    KOURT_SYSCALL_TABLE(KOURT_DESCRIBE_SYSCALL, KOURT_DESCRIBE_SYSCALL0)
+};
+
+#undef KOURT_DESCRIBE_SYSCALL
+#undef KOURT_DESCRIBE_SYSCALL0
+
+inline constexpr size_t kMaxSyscallNumber = 512;
+
+inline constexpr auto kSyscallDescriptorIndex = [] {
+  std::array<short, kMaxSyscallNumber> index{};
+  for (auto &entry : index) {
+    entry = -1;
+  }
+  for (size_t i = 0; i < std::size(kSyscallDescriptors); ++i) {
+    index[kSyscallDescriptors[i].number] = static_cast<short>(i);
+  }
+  return index;
+}();
+
+/// @return descriptor of the syscall or <code>nullptr</code> if the syscall is not in the catalogue.
+constexpr const SyscallDescriptor *FindSyscallDescriptor(unsigned long number) {
+  return (number < kMaxSyscallNumber && kSyscallDescriptorIndex[number] >= 0)
+      ? &kSyscallDescriptors[kSyscallDescriptorIndex[number]]
+      : nullptr;
+}
+
+/// @return descriptor of the syscall named <code>name</code> or <code>nullptr</code> if it is not in the catalogue.
+constexpr const SyscallDescriptor *FindSyscallDescriptorByName(std::string_view name) {
+  for (auto &descriptor : kSyscallDescriptors) {
+    if (name == descriptor.name) {
+      return &descriptor;
+    }
+  }
+  return nullptr;
+}
+
+inline constexpr size_t kMaxI386SyscallNumber = 512;
+
+/// Added to numbers of ia32 syscalls which have no native counterpart in the catalogue.
+inline constexpr unsigned long kUnmappedI386SyscallBit = 1UL << 32;
+
+/// Number of a syscall cancelled at its entry, see <code>BeforeSyscallStoppedTracee::SkipSyscall</code>.
+inline constexpr unsigned long kCancelledSyscall = ~0UL;
+
+/// Set in the numbers of x32 syscalls, which the kernel reports with the x86-64 ABI. They aren't in the catalogue.
+inline constexpr unsigned long kX32SyscallBit = 0x40000000;
+
+inline constexpr auto kI386ToNativeSyscall = [] {
+  std::array<long, kMaxI386SyscallNumber> mapping{};
+  for (auto &entry : mapping) {
+    entry = -1;
+  }
+#define KOURT_MAP_I386_SYSCALL(i386_number, name) mapping[i386_number] = __NR_##name;
+  KOURT_I386_SYSCALL_TABLE(KOURT_MAP_I386_SYSCALL)
+#undef KOURT_MAP_I386_SYSCALL
+  return mapping;
+}();
+
+inline constexpr auto kNativeToI386Syscall = [] {
+  std::array<long, kMaxSyscallNumber> mapping{};
+  for (auto &entry : mapping) {
+    entry = -1;
+  }
+#define KOURT_MAP_NATIVE_SYSCALL(i386_number, name) \
+  if (mapping[__NR_##name] < 0) mapping[__NR_##name] = i386_number;
+  KOURT_I386_SYSCALL_TABLE(KOURT_MAP_NATIVE_SYSCALL)
+#undef KOURT_MAP_NATIVE_SYSCALL
+  return mapping;
+}();
+
+/// @return native number of the ia32 syscall, or the number with <code>kUnmappedI386SyscallBit</code> set.
+constexpr unsigned long I386SyscallToNative(unsigned long i386_number) {
+  if (static_cast<uint32_t>(i386_number) == UINT32_MAX) {
+    return kCancelledSyscall;
+  }
+  return (i386_number < kMaxI386SyscallNumber && kI386ToNativeSyscall[i386_number] >= 0)
+      ? kI386ToNativeSyscall[i386_number]
+      : i386_number | kUnmappedI386SyscallBit;
+}
+
+/// @return ia32 number of the native syscall, or -1 if there is none.
+constexpr long NativeSyscallToI386(unsigned long native_number) {
+  if (native_number & kUnmappedI386SyscallBit) {
+    return static_cast<long>(native_number & ~kUnmappedI386SyscallBit);
+  }
+  return native_number < kMaxSyscallNumber ? kNativeToI386Syscall[native_number] : -1;
+}
+
+// Typed views. Each of them is an aggregate of the syscall arguments with a static <code>kNumber</code> and
+// a <code>Decode</code> function reading the arguments from a stopped tracee.
+
+#define KOURT_DEFINE_SYSCALL_VIEW(name, view, ...) \
+  struct view { \
+    static constexpr long kNumber = __NR_##name; \
+    KOURT_PP_FOR_EACH(KOURT_SYSCALL_FIELD, __VA_ARGS__) \
+    template<typename Arguments> \
+    static view Decode(Arguments &arguments) { \
+      return view{KOURT_PP_FOR_EACH(KOURT_SYSCALL_FIELD_INIT, __VA_ARGS__)}; \
+    } \
+  };
+#define KOURT_DEFINE_SYSCALL_VIEW0(name, view) \
+  struct view { \
+    static constexpr long kNumber = __NR_##name; \
+    template<typename Arguments> \
+    static view Decode(Arguments &) { \
+      return view{}; \
+    } \
+  };
+
+KOURT_SYSCALL_TABLE(KOURT_DEFINE_SYSCALL_VIEW, KOURT_DEFINE_SYSCALL_VIEW0)
+
+#undef KOURT_DEFINE_SYSCALL_VIEW
+#undef KOURT_DEFINE_SYSCALL_VIEW0
+
+#endif //RUNNER_SRC_SYSCALLS_H_
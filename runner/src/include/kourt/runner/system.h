@@ -0,0 +1,16 @@
+#ifndef RUNNER_SRC_SYSTEM_H_
+#define RUNNER_SRC_SYSTEM_H_
+
+#include <stdexcept>
+#include <string>
+
+/// @return exception telling that <code>what</code> has failed, with the reason taken from <code>errno</code>.
+std::runtime_error SystemError(const std::string &what);
+
+/**
+ * Unblocks all signals in a freshly spawned child before it executes another program: the runner may block signals
+ * in its threads (see daemon.h), and the mask would be inherited across exec. Async-signal-safe.
+ */
+void ResetSignalMaskInChild();
+
+#endif //RUNNER_SRC_SYSTEM_H_
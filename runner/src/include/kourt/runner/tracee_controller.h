@@ -1,30 +1,88 @@
 #ifndef RUNNER_SRC_TRACEE_CONTROLLER_H_
 #define RUNNER_SRC_TRACEE_CONTROLLER_H_
 
-#include <vector>
+#include <csignal>
+
+#include <functional>
 #include <memory>
+#include <optional>
+#include <string>
+#include <vector>
 
 #include "tracing.h"
+#include "instruction_counter.h"
 #include "interceptors.h"
 
 class TraceeController {
  public:
   // TODO: use smart pointers here
-  TraceeController(Tracee &tracee, std::vector<std::unique_ptr<StoppedTraceeInterceptor>> &&interceptors);
+  /// @param syscalls_filtered whether the tracee stops only on the syscalls returned by <code>FilteredSyscalls</code>
+  ///                          for the interceptors, selected by a <code>SyscallFilter</code> unless there are none
+  /// @param instruction_counter attached to the tracee before it runs, the tracee is killed once it overflows
+  TraceeController(Tracee &tracee,
+                   std::vector<std::unique_ptr<StoppedTraceeInterceptor>> &&interceptors,
+                   bool syscalls_filtered = false,
+                   InstructionCounter *instruction_counter = nullptr);
+
+  /**
+   * @return syscalls the tracee has to stop on for the interceptors, if they all name their syscalls and
+   *         a <code>SyscallFilter</code> can select them; <code>std::nullopt</code> if the tracee should stop
+   *         on every syscall.
+   */
+  static std::optional<std::vector<unsigned long>> FilteredSyscalls(
+      const std::vector<std::unique_ptr<StoppedTraceeInterceptor>> &interceptors);
 
   /**
    * @return status of the tracee as returned by <code>waitpid</code>
    */
   int ExecuteTracee();
+
+  /**
+   * Traces the tracee like <code>ExecuteTracee</code> until the entry of a syscall accepted by <code>hold</code>,
+   * where the tracee is left stopped. The interceptors don't observe that stop.
+   *
+   * @return <code>std::nullopt</code> if the tracee is held, its wait status if it has terminated before
+   */
+  std::optional<int> ExecuteTraceeUntil(const std::function<bool(BeforeSyscallStoppedTracee &)> &hold);
+
+  /// Traces a tracee which is in a ptrace-stop already, e.g. a process forked by <code>ForkServer</code>,
+  /// until it terminates. The interceptors' <code>OnExec</code> is not called.
+  /// @return status of the tracee as returned by <code>waitpid</code>
+  int ResumeTracee();
+
+  /// Calls <code>OnFinish</code> of the interceptors once the tracee has terminated.
+  void FinishInterceptors(const std::string &working_directory);
+
+  /// @return statistics of the interceptors passed to the constructor, in the same order.
+  [[nodiscard]] nlohmann::json CollectInterceptorStatistics() const;
  private:
+  void SetOptions();
+  std::optional<int> Trace(const std::function<bool(BeforeSyscallStoppedTracee &)> &hold);
   std::unique_ptr<StoppedTracee> DetermineStopMoment(int wait_status);
   std::unique_ptr<StoppedTracee> SyscallStop();
+  std::unique_ptr<StoppedTracee> SeccompStop();
+  /// Completes a syscall skipped at its entry.
+  std::unique_ptr<StoppedTracee> ExitFromSyscall(std::unique_ptr<AfterSyscallStoppedTracee> stop);
   std::unique_ptr<StoppedTracee> SignalDeliveryStop(int signal_number);
   std::unique_ptr<StoppedTracee> GroupStop();
   std::unique_ptr<StoppedTracee> ExitStop();
 
   std::vector<std::unique_ptr<StoppedTraceeInterceptor>> interceptors_;
   bool entered_syscall_;
+  // if filtered, the tracee is resumed with PTRACE_CONT except for the seccomp stops whose exits are intercepted
+  bool syscalls_filtered_;
+  bool intercepts_syscall_exits_{false};
+  bool syscall_info_supported_{true};
+  // details of the signal injected at a syscall stop, applied at the signal-delivery-stop following that syscall
+  std::optional<siginfo_t> pending_signal_info_;
+  // return value of the syscall skipped at the last syscall-enter-stop
+  std::optional<long> skipped_syscall_return_value_;
+  // whether the interceptors have modified the registers at the last syscall-enter-stop
+  bool entry_registers_stored_{false};
+  InstructionCounter *instruction_counter_;
+#ifdef PTRACE_GET_SYSCALL_INFO
+  __ptrace_syscall_info entry_info_{};
+#endif
   Tracee &tracee_;
 };
 
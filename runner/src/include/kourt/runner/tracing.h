@@ -2,16 +2,26 @@
 #define RUNNER_SRC_TRACING_H_
 
 #include <sys/ptrace.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
 #include <sys/user.h>
 #include <sys/wait.h>
+#include <csignal>
 #include <cerrno>
 
+#include <optional>
 #include <stdexcept>
 #include <cstring>
+#include <string>
 #include <utility>
+#include <vector>
+
+#include <nlohmann/json.hpp>
 
 #include "logging.h"
+#include "registers.h"
+#include "syscalls.h"
 
 class PtraceCallFailed : public std::exception {
  public:
@@ -45,8 +55,10 @@ class TraceeDead : public PtraceCallFailed {
 class Tracee {
  public:
 
-  explicit Tracee(pid_t tracee_pid) :
-      tracee_pid_(tracee_pid) {
+  /// @param ptrace_options options the tracee has been seized with, if it has
+  explicit Tracee(pid_t tracee_pid, long ptrace_options = 0) :
+      tracee_pid_(tracee_pid),
+      ptrace_options_(ptrace_options) {
     // nop
   }
 
@@ -98,26 +110,67 @@ class Tracee {
     int options = 0;
     pid_t pid;
     do {
-      pid = waitpid(tracee_pid_, &wait_status, options);
+      pid = wait4(tracee_pid_, &wait_status, options, &resource_usage_);
     } while (-1 == pid && EINTR == errno);
 
     if (-1 == pid) {
       int error = errno;
       switch (error) {
-        case EINVAL: throw std::invalid_argument("invalid options " + std::to_string(options) + " passed to waitpid");
-        case ECHILD: throw TraceeDead("waitpid failed with ECHILD");
-        default: throw std::runtime_error(std::string("waitpid: ") + strerror(error));
+        case EINVAL: throw std::invalid_argument("invalid options " + std::to_string(options) + " passed to wait4");
+        case ECHILD: throw TraceeDead("wait4 failed with ECHILD");
+        default: throw std::runtime_error(std::string("wait4: ") + strerror(error));
       }
     } else {
-      TRACE("waitpid(pid=%d, options=%d) returned wait status %d", tracee_pid_, options, wait_status);
+      TRACE("wait4(pid=%d, options=%d) returned wait status %d", tracee_pid_, options, wait_status);
       // TODO: возвращать удобный wrapper object
       return wait_status;
     }
   }
 
+  /**
+   * Copies the tracee's memory at <code>address</code> to <code>buffer</code> with <code>process_vm_readv</code>,
+   * i.e. without a ptrace call per word.
+   *
+   * @return number of bytes copied, less than <code>size</code> if the range is only partially accessible
+   */
+  size_t ReadMemory(unsigned long address, void *buffer, size_t size);
+
+  /// Copies <code>buffer</code> to the tracee's memory at <code>address</code>, see <code>ReadMemory</code>.
+  /// Pages which are read-only for the tracee can't be written this way.
+  size_t WriteMemory(unsigned long address, const void *buffer, size_t size);
+
+  [[nodiscard]] pid_t Pid() const {
+    return tracee_pid_;
+  }
+
+  /// Replaces the ptrace options, see <code>Options</code>.
+  void SetOptions(long ptrace_options) {
+    Ptrace(PTRACE_SETOPTIONS, nullptr, (void *) ptrace_options);
+    ptrace_options_ = ptrace_options;
+  }
+
+  /// @return the ptrace options in effect; <code>PTRACE_SETOPTIONS</code> replaces rather than adds to them.
+  [[nodiscard]] long Options() const {
+    return ptrace_options_;
+  }
+
+  /// Sends <code>signal_number</code> to the tracee directly rather than through a restarting ptrace request.
+  void Kill(int signal_number) {
+    if (0 != syscall(SYS_tgkill, tracee_pid_, tracee_pid_, signal_number)) {
+      throw std::runtime_error(std::string("tgkill: ") + strerror(errno));
+    }
+  }
+
+  /// @return resource usage reported by the last <code>Wait</code>; meaningful once the tracee has terminated.
+  [[nodiscard]] const rusage &ResourceUsage() const {
+    return resource_usage_;
+  }
+
  private:
 
   pid_t tracee_pid_;
+  long ptrace_options_;
+  rusage resource_usage_{};
 };
 
 class StoppedTraceeInterceptor;
@@ -131,7 +184,38 @@ class StoppedTracee {
   virtual ~StoppedTracee() = default;
 
   virtual void ContinueExecution() {
-    tracee_.Ptrace(PTRACE_SYSCALL, nullptr, nullptr);
+    tracee_.Ptrace(resume_request_, nullptr, nullptr);
+  }
+
+  /// Sets the request resuming the tracee: <code>PTRACE_SYSCALL</code> by default, <code>PTRACE_CONT</code> when
+  /// the tracee should run up to the next syscall picked by the seccomp filter (see <code>SyscallFilter</code>).
+  void SetResumeRequest(__ptrace_request resume_request) {
+    resume_request_ = resume_request;
+  }
+
+  [[nodiscard]] pid_t Pid() const {
+    return tracee_.Pid();
+  }
+
+  /// @return the registers of the tracee, fetched with a single <code>PTRACE_GETREGSET</code>.
+  SyscallRegisters LoadRegisters() {
+    SyscallRegisters registers;
+    registers.Load(tracee_);
+    return registers;
+  }
+
+  /// See <code>Tracee::ReadMemory</code>.
+  size_t ReadMemory(unsigned long address, void *buffer, size_t size) {
+    return tracee_.ReadMemory(address, buffer, size);
+  }
+  /// See <code>Tracee::WriteMemory</code>.
+  size_t WriteMemory(unsigned long address, const void *buffer, size_t size) {
+    return tracee_.WriteMemory(address, buffer, size);
+  }
+
+  /// @return details of a signal injected at this stop, which the controller should apply once it is delivered.
+  [[nodiscard]] virtual const siginfo_t *InjectedSignalInfo() const {
+    return nullptr;
   }
 
   /// @return whether this interceptor has restarted the tracee or not. If this method returns true,
@@ -140,27 +224,127 @@ class StoppedTracee {
 
  protected:
   Tracee &tracee_;
+  __ptrace_request resume_request_{PTRACE_SYSCALL};
 };
 
+/**
+ * Registers of a syscall-stopped tracee are fetched lazily, at most once per stop, and cached until the tracee is
+ * resumed. Setters update the cache and write the registers back immediately, so interceptors invoked later on the
+ * same stop observe the changes.
+ *
+ * The controller may supply a snapshot filled from <code>PTRACE_GET_SYSCALL_INFO</code>, in which case the register
+ * set is fetched only if an interceptor modifies the registers.
+ *
+ * Syscall numbers and arguments are presented in terms of the native x86-64 ABI even for ia32 tracees.
+ */
 class SyscallStoppedTracee : public StoppedTracee {
  public:
   using StoppedTracee::StoppedTracee;
+  SyscallStoppedTracee(Tracee &tracee, const SyscallRegisters &snapshot) :
+      StoppedTracee(tracee),
+      registers_(snapshot),
+      registers_loaded_(true) {
+    // nop
+  }
   ~SyscallStoppedTracee() override = default;
 
+  SyscallAbi Abi() {
+    return Registers().Abi();
+  }
+
   unsigned long SyscallNumber();
   void SetSyscallNumber(unsigned long syscall_no);
-  unsigned long Arg1();
-  void SetArg1(unsigned long arg);
-  unsigned long Arg2();
-  void SetArg2(unsigned long arg);
-  unsigned long Arg3();
-  void SetArg3(unsigned long arg);
-  unsigned long Arg4();
-  void SetArg4(unsigned long arg);
-  unsigned long Arg5();
-  void SetArg5(unsigned long arg);
-  unsigned long Arg6();
-  void SetArg6(unsigned long arg);
+
+  /// @param index zero-based index of the argument, less than 6
+  unsigned long Arg(int index);
+  /// @param index zero-based index of the argument, less than 6
+  void SetArg(int index, unsigned long arg);
+
+  unsigned long Arg1() { return Arg(0); }
+  void SetArg1(unsigned long arg) { SetArg(0, arg); }
+  unsigned long Arg2() { return Arg(1); }
+  void SetArg2(unsigned long arg) { SetArg(1, arg); }
+  unsigned long Arg3() { return Arg(2); }
+  void SetArg3(unsigned long arg) { SetArg(2, arg); }
+  unsigned long Arg4() { return Arg(3); }
+  void SetArg4(unsigned long arg) { SetArg(3, arg); }
+  unsigned long Arg5() { return Arg(4); }
+  void SetArg5(unsigned long arg) { SetArg(4, arg); }
+  unsigned long Arg6() { return Arg(5); }
+  void SetArg6(unsigned long arg) { SetArg(5, arg); }
+
+  /// @return descriptor of the current syscall or <code>nullptr</code> if it is not in the catalogue.
+  const SyscallDescriptor *Descriptor() {
+    return FindSyscallDescriptor(SyscallNumber());
+  }
+
+  /// @return typed view of the arguments if the current syscall is <code>Call</code>, e.g. <code>As<ReadCall>()</code>.
+  template<typename Call>
+  std::optional<Call> As() {
+    if (SyscallNumber() != static_cast<unsigned long>(Call::kNumber)) {
+      return std::nullopt;
+    }
+    return Call::Decode(*this);
+  }
+
+  /// @return human-readable representation like <code>read(fd=0, buf=0x7ffd5c1e, count=10)</code>.
+  std::string Describe();
+
+  /**
+   * Makes the kernel send <code>signal_number</code> to the tracee when it is resumed. Injected before a syscall,
+   * the signal interrupts it if it blocks, so the tracee observes <code>EINTR</code> or a restart as with
+   * a real signal. The signal is then reported in a signal-delivery-stop like any other one.
+   */
+  void InjectSignal(int signal_number) {
+    injected_signal_ = signal_number;
+    injected_signal_info_.reset();
+  }
+
+  /// Injects <code>info.si_signo</code> with the given details, e.g. for a <code>SA_SIGINFO</code> handler.
+  void InjectSignal(const siginfo_t &info) {
+    injected_signal_ = info.si_signo;
+    injected_signal_info_ = info;
+  }
+
+  void ContinueExecution() override {
+    if (seccomp_stop_ && injected_signal_ != 0) {
+      // The kernel ignores a signal passed on resuming from a ptrace event stop. Sent directly, the signal is pending
+      // once the syscall starts, so it interrupts the syscall just the same.
+      tracee_.Kill(injected_signal_);
+      tracee_.Ptrace(resume_request_, nullptr, nullptr);
+      return;
+    }
+    tracee_.Ptrace(resume_request_, nullptr, (void *) (long) injected_signal_);
+  }
+
+  /// Marks the stop as a <code>PTRACE_EVENT_SECCOMP</code> one rather than a syscall-enter-stop.
+  void SetSeccompStop() {
+    seccomp_stop_ = true;
+  }
+
+  [[nodiscard]] const siginfo_t *InjectedSignalInfo() const override {
+    return injected_signal_info_ ? &*injected_signal_info_ : nullptr;
+  }
+
+  /// @return whether an interceptor has modified the registers at this stop.
+  [[nodiscard]] bool RegistersStored() const {
+    return registers_stored_;
+  }
+
+ protected:
+  /// @return the snapshot of the current stop, which is sufficient for reading the syscall and its arguments.
+  SyscallRegisters &Registers();
+  /// @return the snapshot with the register set loaded, which is required for modifying the registers.
+  SyscallRegisters &RegisterSet();
+  void StoreRegisters();
+
+ private:
+  SyscallRegisters registers_;
+  bool registers_loaded_{false};
+  bool registers_stored_{false};
+  int injected_signal_{0};
+  std::optional<siginfo_t> injected_signal_info_;
+  bool seccomp_stop_{false};
 };
 
 class BeforeSyscallStoppedTracee : public SyscallStoppedTracee {
@@ -169,7 +353,21 @@ class BeforeSyscallStoppedTracee : public SyscallStoppedTracee {
 
   bool Intercept(StoppedTraceeInterceptor &visitor) override;
 
-  // TODO: add 'EnterSyscall'
+  /**
+   * Cancels the syscall: the kernel doesn't execute it and the tracee observes <code>return_value</code> as its
+   * result (a negated errno value for a failure). The interceptor is responsible for the side effects, e.g. for
+   * filling the buffer with <code>Tracee::WriteMemory</code>.
+   *
+   * The return value is set by the controller at the following syscall-exit-stop, before any interceptor observes it.
+   */
+  void SkipSyscall(long return_value);
+
+  [[nodiscard]] const std::optional<long> &SkippedSyscallReturnValue() const {
+    return skipped_syscall_return_value_;
+  }
+
+ private:
+  std::optional<long> skipped_syscall_return_value_;
 };
 
 class AfterSyscallStoppedTracee : public SyscallStoppedTracee {
@@ -195,13 +393,36 @@ class BeforeSignalDeliveryStoppedTracee : public StoppedTracee {
   bool Intercept(StoppedTraceeInterceptor &visitor) override;
 
   void ContinueExecution() override {
-    tracee_.Ptrace(PTRACE_SYSCALL, nullptr, (void *) signal_number_);
+    tracee_.Ptrace(resume_request_, nullptr, (void *) (long) signal_number_);
   }
 
   int SignalNumber() {
     return signal_number_;
   }
-  // TODO: add 'SetSignalNumber', 'SuppressSignal'
+
+  /// Delivers <code>signal_number</code> instead of the original signal. The kernel then reports the signal to
+  /// the tracee as sent by the tracer, unless the details are replaced with <code>SetSignalInfo</code>.
+  void SetSignalNumber(int signal_number) {
+    signal_number_ = signal_number;
+  }
+
+  /// The tracee continues as if the signal has never been sent.
+  void SuppressSignal() {
+    signal_number_ = 0;
+  }
+
+  /// @return details of the signal being delivered.
+  siginfo_t SignalInfo() {
+    siginfo_t info{};
+    tracee_.Ptrace(PTRACE_GETSIGINFO, nullptr, &info);
+    return info;
+  }
+
+  /// Replaces the details of the signal being delivered, as seen by a <code>SA_SIGINFO</code> handler.
+  void SetSignalInfo(const siginfo_t &info) {
+    tracee_.Ptrace(PTRACE_SETSIGINFO, nullptr, const_cast<siginfo_t *>(&info));
+  }
+
  private:
   int signal_number_;
 };
@@ -245,6 +466,41 @@ class StoppedTraceeInterceptor {
   /// @return whether this interceptor has restarted the tracee or not. If this method returns true,
   ///         controller should not consider this tracee stopped anymore, but it should wait for the next stop.
   virtual bool Intercept(BeforeTerminationStoppedTracee &stopped_tracee) = 0;
+
+  /// Called once the tracee has exec'ed the executable, before it runs a single instruction of it.
+  virtual void OnExec(Tracee & /*tracee*/) {
+    // nop
+  }
+
+  /**
+   * Called once the tracee has terminated, before the statistics are collected; the interceptor writes the files it
+   * produces here.
+   *
+   * @param working_directory the directory the tracee has been run in, the relative paths of those files are resolved
+   *                          against it; empty if it is the runner's own
+   */
+  virtual void OnFinish(const std::string & /*working_directory*/) {
+    // nop
+  }
+
+  /**
+   * @return native numbers of the syscalls the interceptor has to stop on, <code>std::nullopt</code> for all of them.
+   *         Once every interceptor names its syscalls and the <code>syscallFilter</code> config key is set, the
+   *         controller lets the tracee run through the rest of them without stopping at all.
+   */
+  [[nodiscard]] virtual std::optional<std::vector<unsigned long>> InterceptedSyscalls() const {
+    return std::nullopt;
+  }
+
+  /// @return whether the interceptor has to stop on exits of the syscalls named by <code>InterceptedSyscalls</code>.
+  [[nodiscard]] virtual bool InterceptsSyscallExits() const {
+    return true;
+  }
+
+  /// @return what the interceptor has done during the run, reported in the exit status; null if nothing to report.
+  [[nodiscard]] virtual nlohmann::json CollectStatistics() const {
+    return nullptr;
+  }
 };
 
 #endif //RUNNER_SRC_TRACING_H_
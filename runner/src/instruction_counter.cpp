@@ -0,0 +1,106 @@
+#include <kourt/runner/instruction_counter.h>
+
+#include <fcntl.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#include <kourt/runner/config.h>
+#include <kourt/runner/logging.h>
+#include <kourt/runner/system.h>
+
+// The total is checked this many times per limit, so the threads of the tracee overshoot it by a sixteenth each at most.
+static const uint64_t kChecksPerLimit = 16;
+
+static int OpenPerfEvent(pid_t pid, uint32_t type, uint64_t config, uint64_t sample_period) {
+  perf_event_attr attributes{};
+  attributes.size = sizeof(attributes);
+  attributes.type = type;
+  attributes.config = config;
+  attributes.sample_period = sample_period;
+  attributes.wakeup_events = 1;
+  // the threads and the child processes created from now on are counted as well; each of them overflows on its own,
+  // while reading the counter gives the total
+  attributes.inherit = 1;
+  // kernel instructions vary with the state of the host, they are excluded; this also doesn't require privileges
+  attributes.exclude_kernel = 1;
+  attributes.exclude_hv = 1;
+  return static_cast<int>(syscall(SYS_perf_event_open, &attributes, pid, -1, -1, PERF_FLAG_FD_CLOEXEC));
+}
+
+InstructionCounter::InstructionCounter(uint64_t limit) :
+    limit_(limit),
+    check_period_(std::max<uint64_t>(1, limit / kChecksPerLimit)) {
+  if (limit_ == 0) {
+    throw std::invalid_argument("Instruction limit should be positive");
+  }
+}
+
+InstructionCounter::~InstructionCounter() {
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+}
+
+void InstructionCounter::Attach(pid_t pid) {
+  fd_ = OpenPerfEvent(pid, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, check_period_);
+  // EACCES and EPERM come from perf_event_paranoid or a seccomp policy of a container, which may let software
+  // events through
+  if (fd_ < 0 && (errno == ENOENT || errno == EOPNOTSUPP || errno == ENODEV || errno == EACCES || errno == EPERM)) {
+    WARN("Hardware instruction counter is unavailable, falling back to task-clock: %s", strerror(errno))
+    hardware_ = false;
+    fd_ = OpenPerfEvent(pid, PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK, check_period_);
+  }
+  if (fd_ < 0 && (errno == EACCES || errno == EPERM)) {
+    throw std::runtime_error(std::string("instructionLimit can't be enforced, perf_event_open is not permitted (see ")
+                                 + "/proc/sys/kernel/perf_event_paranoid): " + strerror(errno));
+  }
+  if (fd_ < 0) {
+    throw SystemError("perf_event_open");
+  }
+  f_owner_ex owner{F_OWNER_TID, pid};
+  if (0 != fcntl(fd_, F_SETOWN_EX, &owner)
+      || 0 != fcntl(fd_, F_SETSIG, kOverflowSignal)
+      || 0 != fcntl(fd_, F_SETFL, O_ASYNC)) {
+    throw SystemError("fcntl perf event");
+  }
+}
+
+bool InstructionCounter::IsOverflowSignal(const siginfo_t &info) const {
+  return fd_ >= 0 && info.si_signo == kOverflowSignal && info.si_fd == fd_ && info.si_code > 0;
+}
+
+bool InstructionCounter::CheckLimit() {
+  limit_exceeded_ = limit_exceeded_ || Count() >= limit_;
+  return limit_exceeded_;
+}
+
+uint64_t InstructionCounter::Count() const {
+  uint64_t count = 0;
+  if (fd_ >= 0 && sizeof(count) != read(fd_, &count, sizeof(count))) {
+    WARN("Failed to read perf counter: %s", strerror(errno))
+  }
+  return count;
+}
+
+nlohmann::json InstructionCounter::CollectStatistics() const {
+  return {
+      {"event", hardware_ ? "instructions" : "taskClockNanos"},
+      {"count", Count()},
+      {"limit", limit_},
+  };
+}
+
+std::unique_ptr<InstructionCounter> CreateInstructionCounterIfConfigured(const nlohmann::json &config) {
+  if (!config.contains(kInstructionLimitKey)) {
+    return nullptr;
+  }
+  return std::make_unique<InstructionCounter>(config[kInstructionLimitKey].get<uint64_t>());
+}
@@ -0,0 +1,239 @@
+#include <kourt/runner/interactor.h>
+
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <climits>
+#include <csignal>
+#include <cerrno>
+#include <cstring>
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <kourt/runner/config.h>
+#include <kourt/runner/logging.h>
+#include <kourt/runner/runner_main.h>
+#include <kourt/runner/spawn.h>
+#include <kourt/runner/system.h>
+
+static const char *kInteractorExecutableKey = "executable";
+static const char *kInteractorArgvKey = "argv";
+static const char *kInteractorStderrFileKey = "stderrFile";
+static const char *kTraceeOutputLogFileKey = "traceeOutputLogFile";
+static const char *kInteractorOutputLogFileKey = "interactorOutputLogFile";
+static const char *kFinishTimeoutMillisKey = "finishTimeoutMillis";
+
+static const char *kDefaultInteractorStderrFile = "interactor-stderr.txt";
+static const long kDefaultFinishTimeoutMillis = 10'000;
+
+static void CloseIfOpen(int *fd) {
+  if (*fd >= 0) {
+    close(*fd);
+    *fd = -1;
+  }
+}
+
+/**
+ * Moves everything from <code>source_fd</code> to <code>target_fd</code> (both are pipes) until the end of file,
+ * duplicating it into <code>log_fd</code>. A failure to log doesn't break the interaction: the data is then relayed
+ * without logging.
+ */
+static void RelayWithLog(int source_fd, int target_fd, int log_fd) {
+  // The consumer may exit early: the relay should get EPIPE then rather than kill the runner.
+  sigset_t sigpipe;
+  sigemptyset(&sigpipe);
+  sigaddset(&sigpipe, SIGPIPE);
+  pthread_sigmask(SIG_BLOCK, &sigpipe, nullptr);
+
+  bool logging = true;
+  for (;;) {
+    ssize_t relayed = logging
+        ? tee(source_fd, target_fd, INT_MAX, 0)
+        : splice(source_fd, nullptr, target_fd, nullptr, INT_MAX, SPLICE_F_MOVE);
+    if (relayed < 0 && errno == EINTR) {
+      continue;
+    }
+    if (relayed < 0 && errno != EPIPE) {
+      WARN("Interactive relay failed: %s", strerror(errno))
+    }
+    if (relayed <= 0) {
+      break;
+    }
+    // tee doesn't consume the data, so it is moved out of the source pipe into the log
+    for (ssize_t left = relayed; logging && left > 0;) {
+      ssize_t logged = splice(source_fd, nullptr, log_fd, nullptr, left, SPLICE_F_MOVE);
+      if (logged < 0 && errno == EINTR) {
+        continue;
+      }
+      if (logged <= 0) {
+        WARN("Failed to log interactive traffic, it is relayed without logging from now on: %s", strerror(errno))
+        logging = false;
+        // the data already passed to the target has to be dropped from the source
+        char discarded[PIPE_BUF];
+        while (left > 0) {
+          ssize_t bytes_read = read(source_fd, discarded, std::min<size_t>(left, sizeof(discarded)));
+          if (bytes_read < 0 && errno == EINTR) {
+            continue;
+          }
+          if (bytes_read <= 0) {
+            break;
+          }
+          left -= bytes_read;
+        }
+        break;
+      }
+      left -= logged;
+    }
+  }
+  close(source_fd);
+  close(target_fd);
+  close(log_fd);
+}
+
+Interactor::Interactor(const nlohmann::json &interactor_config, const std::string &working_directory) :
+    executable_(interactor_config.at(kInteractorExecutableKey).get<std::string>()),
+    argv_(interactor_config.value(kInteractorArgvKey, std::vector<std::string>{executable_})),
+    stderr_file_(interactor_config.value(kInteractorStderrFileKey, kDefaultInteractorStderrFile)),
+    working_directory_(working_directory),
+    finish_timeout_(interactor_config.value(kFinishTimeoutMillisKey, kDefaultFinishTimeoutMillis)),
+    cgroup_(CreateCgroupIfConfigured(interactor_config)) {
+  for (auto &arg : argv_) {
+    argv_pointers_.push_back(arg.data());
+  }
+  argv_pointers_.push_back(nullptr);
+  try {
+    OpenChannel(interactor_config.value(kTraceeOutputLogFileKey, ""), &to_interactor_);
+    OpenChannel(interactor_config.value(kInteractorOutputLogFileKey, ""), &from_interactor_);
+  } catch (...) {
+    CloseChannel(&to_interactor_);
+    CloseChannel(&from_interactor_);
+    throw;
+  }
+}
+
+Interactor::~Interactor() {
+  if (pid_ > 0) {
+    kill(pid_, SIGKILL);
+    waitpid(pid_, nullptr, 0);
+    // Finish hasn't been called, so the tracee may still hold the pipes and a relay may never end.
+    for (Channel *channel : {&to_interactor_, &from_interactor_}) {
+      if (channel->relay.joinable()) {
+        channel->relay.detach();
+      }
+    }
+  }
+  CloseChannel(&to_interactor_);
+  CloseChannel(&from_interactor_);
+}
+
+void Interactor::OpenChannel(const std::string &log_file, Channel *channel) {
+  int fds[2];
+  if (0 != pipe2(fds, O_CLOEXEC)) {
+    throw SystemError("pipe2");
+  }
+  channel->producer_fd = fds[1];
+  if (log_file.empty()) {
+    channel->consumer_fd = fds[0];
+    return;
+  }
+  channel->relay_source_fd = fds[0];
+  if (0 != pipe2(fds, O_CLOEXEC)) {
+    throw SystemError("pipe2");
+  }
+  channel->relay_target_fd = fds[1];
+  channel->consumer_fd = fds[0];
+  channel->log_fd = open(log_file.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (channel->log_fd < 0) {
+    throw SystemError("open " + log_file);
+  }
+}
+
+void Interactor::CloseChannel(Channel *channel) {
+  CloseIfOpen(&channel->producer_fd);
+  CloseIfOpen(&channel->consumer_fd);
+  // the relay exits once both of its neighbours have closed their ends
+  if (channel->relay.joinable()) {
+    channel->relay.join();
+  }
+  CloseIfOpen(&channel->relay_source_fd);
+  CloseIfOpen(&channel->relay_target_fd);
+  CloseIfOpen(&channel->log_fd);
+}
+
+void Interactor::ExecInChild() {
+  ResetSignalMaskInChild();
+  if (!working_directory_.empty() && 0 != chdir(working_directory_.c_str())) {
+    perror("chdir");
+    _exit(1);
+  }
+  int stderr_fd = creat(stderr_file_.c_str(), 0644);
+  if (stderr_fd < 0) {
+    perror("creat");
+    _exit(1);
+  }
+  dup2(to_interactor_.consumer_fd, 0);
+  dup2(from_interactor_.producer_fd, 1);
+  dup2(stderr_fd, 2);
+  close(stderr_fd);
+  execv(executable_.c_str(), argv_pointers_.data());
+  perror("execv");
+  _exit(1);
+}
+
+void Interactor::Start() {
+  SpawnOptions spawn_options;
+  if (cgroup_) {
+    spawn_options.cgroup_fd = cgroup_->DirectoryFd();
+  }
+  pid_t pid = SpawnProcess(spawn_options);
+  if (0 == pid) {
+    ExecInChild();
+  }
+  pid_ = pid;
+  CloseIfOpen(&to_interactor_.consumer_fd);
+  CloseIfOpen(&from_interactor_.producer_fd);
+
+  for (Channel *channel : {&to_interactor_, &from_interactor_}) {
+    if (channel->log_fd >= 0) {
+      channel->relay = std::thread(RelayWithLog, channel->relay_source_fd, channel->relay_target_fd, channel->log_fd);
+      channel->relay_source_fd = channel->relay_target_fd = channel->log_fd = -1;
+    }
+  }
+}
+
+void Interactor::CloseTraceeEnds() {
+  CloseIfOpen(&to_interactor_.producer_fd);
+  CloseIfOpen(&from_interactor_.consumer_fd);
+}
+
+nlohmann::json Interactor::Finish() {
+  CloseTraceeEnds();
+  int status = 0;
+  bool timed_out = !WaitWithTimeout(pid_, finish_timeout_, &status);
+  if (timed_out) {
+    WARN("Interactor %d hasn't exited in %ld ms after the tracee, killing it", pid_, (long) finish_timeout_.count())
+    kill(pid_, SIGKILL);
+    waitpid(pid_, &status, 0);
+  }
+  pid_ = -1;
+  CloseChannel(&to_interactor_);
+  CloseChannel(&from_interactor_);
+  failed_ = timed_out || !WIFEXITED(status) || 0 != WEXITSTATUS(status);
+
+  nlohmann::json exit_status = ExitStatusToJson(status);
+  if (timed_out) {
+    exit_status["timedOut"] = true;
+  }
+  if (cgroup_) {
+    exit_status[kCgroupKey] = cgroup_->CollectStatistics();
+  }
+  return exit_status;
+}
+
+std::unique_ptr<Interactor> CreateInteractorIfConfigured(const nlohmann::json &config) {
+  if (!config.contains(kInteractorKey)) {
+    return nullptr;
+  }
+  return std::make_unique<Interactor>(config[kInteractorKey], config.value(kWorkingDirectoryKey, ""));
+}
@@ -2,12 +2,31 @@
 #include <stdexcept>
 #include <memory>
 
+#include <kourt/runner/buffering_detector_interceptor.h>
+#include <kourt/runner/emulation_interceptor.h>
 #include <kourt/runner/interceptors.h>
+#include <kourt/runner/memory_timeline_interceptor.h>
+#include <kourt/runner/path_policy_interceptor.h>
 #include <kourt/runner/read_size_shrink_interceptor.h>
+#include <kourt/runner/sampling_profiler_interceptor.h>
+#include <kourt/runner/signal_storm_interceptor.h>
 
-std::unique_ptr<StoppedTraceeInterceptor> CreateInterceptor(const std::string &interceptor_name, Tracee &tracee) {
+std::unique_ptr<StoppedTraceeInterceptor> CreateInterceptor(const nlohmann::json &interceptor_config) {
+  const std::string interceptor_name = interceptor_config.at("name");
   if ("ReadSizeShrinkInterceptor" == interceptor_name) {
     return std::unique_ptr<StoppedTraceeInterceptor>(new ReadSizeShrinkInterceptor());
+  } else if ("EmulationInterceptor" == interceptor_name) {
+    return std::unique_ptr<StoppedTraceeInterceptor>(new EmulationInterceptor(interceptor_config));
+  } else if ("SignalStormInterceptor" == interceptor_name) {
+    return std::unique_ptr<StoppedTraceeInterceptor>(new SignalStormInterceptor(interceptor_config));
+  } else if ("BufferingDetectorInterceptor" == interceptor_name) {
+    return std::unique_ptr<StoppedTraceeInterceptor>(new BufferingDetectorInterceptor(interceptor_config));
+  } else if ("MemoryTimelineInterceptor" == interceptor_name) {
+    return std::unique_ptr<StoppedTraceeInterceptor>(new MemoryTimelineInterceptor(interceptor_config));
+  } else if ("SamplingProfilerInterceptor" == interceptor_name) {
+    return std::unique_ptr<StoppedTraceeInterceptor>(new SamplingProfilerInterceptor(interceptor_config));
+  } else if ("PathPolicyInterceptor" == interceptor_name) {
+    return std::unique_ptr<StoppedTraceeInterceptor>(new PathPolicyInterceptor(interceptor_config));
   } else {
     throw std::invalid_argument("Unknown interceptor name: '" + interceptor_name + "'");
   }
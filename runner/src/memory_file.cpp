@@ -0,0 +1,150 @@
+#include <kourt/runner/memory_file.h>
+
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+
+#include <mutex>
+#include <stdexcept>
+#include <tuple>
+#include <unordered_map>
+
+#include <kourt/runner/logging.h>
+#include <kourt/runner/system.h>
+
+// Executables of this many distinct paths are kept loaded; the unused ones are dropped when the limit is reached.
+static const size_t kMaxCachedExecutables = 256;
+
+/// Copies <code>size</code> bytes from the beginning of <code>source_fd</code> to the current offset of
+/// <code>target_fd</code> without passing them through user space.
+static void CopyFileContent(int source_fd, int target_fd, size_t size) {
+  off_t offset = 0;
+  while (static_cast<size_t>(offset) < size) {
+    ssize_t copied = sendfile(target_fd, source_fd, &offset, size - offset);
+    if (copied < 0 && errno == EINTR) {
+      continue;
+    }
+    if (copied < 0) {
+      throw SystemError("sendfile");
+    }
+    if (copied == 0) {
+      throw std::runtime_error("File has been truncated while being copied");
+    }
+  }
+}
+
+MemoryFile::MemoryFile(const char *name) :
+    fd_(memfd_create(name, MFD_CLOEXEC | MFD_ALLOW_SEALING)) {
+  if (fd_ < 0) {
+    throw SystemError("memfd_create");
+  }
+}
+
+MemoryFile::~MemoryFile() {
+  close(fd_);
+}
+
+void MemoryFile::Seal() {
+  if (0 != fcntl(fd_, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL)) {
+    throw SystemError("fcntl(F_ADD_SEALS)");
+  }
+}
+
+std::string MemoryFile::ReadAll() const {
+  struct stat file_stat{};
+  if (0 != fstat(fd_, &file_stat)) {
+    throw SystemError("fstat");
+  }
+  std::string content(file_stat.st_size, '\0');
+  for (size_t offset = 0; offset < content.size();) {
+    ssize_t bytes_read = pread(fd_, content.data() + offset, content.size() - offset, offset);
+    if (bytes_read < 0 && errno == EINTR) {
+      continue;
+    }
+    if (bytes_read <= 0) {
+      throw SystemError("pread");
+    }
+    offset += bytes_read;
+  }
+  return content;
+}
+
+void MemoryFile::PersistTo(const std::string &path) const {
+  struct stat file_stat{};
+  if (0 != fstat(fd_, &file_stat)) {
+    throw SystemError("fstat");
+  }
+  int file_fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (file_fd < 0) {
+    throw SystemError("open " + path);
+  }
+  try {
+    CopyFileContent(fd_, file_fd, file_stat.st_size);
+  } catch (...) {
+    close(file_fd);
+    throw;
+  }
+  close(file_fd);
+}
+
+struct CachedExecutable {
+  dev_t device;
+  ino_t inode;
+  off_t size;
+  timespec modification_time;
+  std::shared_ptr<const MemoryFile> image;
+
+  [[nodiscard]] bool Matches(const struct stat &file_stat) const {
+    return std::tie(device, inode, size, modification_time.tv_sec, modification_time.tv_nsec)
+        == std::tie(file_stat.st_dev, file_stat.st_ino, file_stat.st_size,
+                    file_stat.st_mtim.tv_sec, file_stat.st_mtim.tv_nsec);
+  }
+};
+
+std::shared_ptr<const MemoryFile> LoadExecutableIntoMemory(const std::string &path) {
+  static std::mutex cache_mutex;
+  static std::unordered_map<std::string, CachedExecutable> cache;
+
+  struct stat file_stat{};
+  if (0 != stat(path.c_str(), &file_stat)) {
+    throw SystemError("stat " + path);
+  }
+  {
+    std::scoped_lock lock(cache_mutex);
+    auto cached = cache.find(path);
+    if (cached != cache.end() && cached->second.Matches(file_stat)) {
+      return cached->second.image;
+    }
+  }
+
+  int file_fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (file_fd < 0) {
+    throw SystemError("open " + path);
+  }
+  auto image = std::make_shared<MemoryFile>("kourt-executable");
+  try {
+    // the file may have been replaced since stat, so the cache entry describes the opened one
+    if (0 != fstat(file_fd, &file_stat)) {
+      throw SystemError("fstat " + path);
+    }
+    CopyFileContent(file_fd, image->Fd(), file_stat.st_size);
+    image->Seal();
+  } catch (...) {
+    close(file_fd);
+    throw;
+  }
+  close(file_fd);
+  DEBUG("Loaded %s into memory (%ld bytes)", path.c_str(), (long) file_stat.st_size)
+
+  std::scoped_lock lock(cache_mutex);
+  if (cache.size() >= kMaxCachedExecutables) {
+    for (auto entry = cache.begin(); entry != cache.end();) {
+      entry = (entry->second.image.use_count() == 1) ? cache.erase(entry) : std::next(entry);
+    }
+  }
+  cache[path] = CachedExecutable{file_stat.st_dev, file_stat.st_ino, file_stat.st_size, file_stat.st_mtim, image};
+  return image;
+}
@@ -0,0 +1,243 @@
+#include <kourt/runner/memory_timeline_interceptor.h>
+#include <kourt/runner/tracing.h>
+
+#include <sys/mman.h>
+#include <unistd.h>
+#include <cerrno>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+#include <kourt/runner/logging.h>
+
+static const char *kTimelineFileKey = "timelineFile";
+static const char *kRssSampleIntervalMillisKey = "rssSampleIntervalMillis";
+static const char *kMaxPointsKey = "maxPoints";
+static const char *kLimitBytesKey = "limitBytes";
+
+static const char *kDefaultTimelineFile = "memory-timeline.json";
+
+// Addresses this close to the top are negated errno values rather than mappings.
+static const unsigned long kMaxErrno = 4095;
+
+static bool IsError(long returned_value) {
+  return static_cast<unsigned long>(returned_value) > -kMaxErrno - 1;
+}
+
+/// @return whether the mapping is the tracee's own memory: an anonymous one, or a private writable one, whose pages
+///         become private copies once written to (e.g. of <code>/dev/zero</code>)
+static bool IsOwnMemory(const MmapCall &mmap) {
+  return (mmap.flags & MAP_ANONYMOUS) || ((mmap.flags & MAP_TYPE) == MAP_PRIVATE && (mmap.prot & PROT_WRITE));
+}
+
+/// @return resident set size of the process in bytes, or -1 if it can't be read
+static int64_t ReadRss(pid_t pid, unsigned long page_size) {
+  std::ifstream statm("/proc/" + std::to_string(pid) + "/statm");
+  uint64_t size_pages;
+  uint64_t resident_pages;
+  if (!(statm >> size_pages >> resident_pages)) {
+    return -1;
+  }
+  return static_cast<int64_t>(resident_pages * page_size);
+}
+
+MemoryTimelineInterceptor::MemoryTimelineInterceptor(const nlohmann::json &config) :
+    timeline_file_(config.value(kTimelineFileKey, kDefaultTimelineFile)),
+    rss_sample_interval_(config.value(kRssSampleIntervalMillisKey, 10L)),
+    max_points_(config.value(kMaxPointsKey, size_t{10'000})),
+    page_size_(sysconf(_SC_PAGESIZE)) {
+  if (config.contains(kLimitBytesKey)) {
+    limit_bytes_ = config[kLimitBytesKey].get<uint64_t>();
+  }
+  if (max_points_ < 2) {
+    throw std::invalid_argument("MemoryTimelineInterceptor: 'maxPoints' should be at least 2");
+  }
+}
+
+std::optional<std::vector<unsigned long>> MemoryTimelineInterceptor::InterceptedSyscalls() const {
+  return std::vector<unsigned long>{BrkCall::kNumber, MmapCall::kNumber, MremapCall::kNumber, MunmapCall::kNumber};
+}
+
+bool MemoryTimelineInterceptor::Intercept(BeforeSyscallStoppedTracee &tracee) {
+  ++syscalls_;
+  if (tracee.As<MunmapCall>() || tracee.As<MremapCall>()) {
+    // the memory about to be released may have been touched since the last sample, so the peak is sampled here
+    peak_rss_bytes_ = std::max(peak_rss_bytes_, ReadRss(tracee.Pid(), page_size_));
+  }
+  if (!limit_bytes_) {
+    return false;
+  }
+  uint64_t growth = RequestedGrowth(tracee);
+  if (growth > 0 && TotalBytes() + growth > *limit_bytes_) {
+    ++denied_allocations_;
+    DEBUG("Denying %s: %lu bytes over the limit", tracee.Describe().c_str(), TotalBytes() + growth - *limit_bytes_)
+    // a failed brk returns the current break rather than an error
+    tracee.SkipSyscall(tracee.As<BrkCall>() ? static_cast<long>(current_break_) : -ENOMEM);
+  }
+  return false;
+}
+
+uint64_t MemoryTimelineInterceptor::RequestedGrowth(BeforeSyscallStoppedTracee &tracee) {
+  auto round_up = [this](uint64_t size) { return (size + page_size_ - 1) / page_size_ * page_size_; };
+  if (auto brk = tracee.As<BrkCall>()) {
+    return current_break_ != 0 && brk->addr > current_break_ ? brk->addr - current_break_ : 0;
+  }
+  if (auto mmap = tracee.As<MmapCall>()) {
+    return IsOwnMemory(*mmap) ? round_up(mmap->length) : 0;
+  }
+  if (auto mremap = tracee.As<MremapCall>()) {
+    return mremap->new_size > mremap->old_size ? round_up(mremap->new_size) - round_up(mremap->old_size) : 0;
+  }
+  return 0;
+}
+
+bool MemoryTimelineInterceptor::Intercept(AfterSyscallStoppedTracee &tracee) {
+  const long returned_value = tracee.ReturnedValue();
+  auto round_up = [this](uint64_t size) { return (size + page_size_ - 1) / page_size_ * page_size_; };
+  if (tracee.As<BrkCall>()) {
+    if (initial_break_ == 0) {
+      initial_break_ = returned_value;
+    }
+    current_break_ = returned_value;
+    heap_bytes_ = current_break_ > initial_break_ ? current_break_ - initial_break_ : 0;
+  } else if (IsError(returned_value)) {
+    return false;
+  } else if (auto mmap = tracee.As<MmapCall>()) {
+    const unsigned long start = returned_value;
+    if (IsOwnMemory(*mmap)) {
+      AddMapping(start, start + round_up(mmap->length));
+    } else {
+      // a shared or read-only file mapped with MAP_FIXED replaces whatever has been there
+      RemoveMapping(start, start + round_up(mmap->length));
+    }
+  } else if (auto munmap = tracee.As<MunmapCall>()) {
+    RemoveMapping(munmap->addr, munmap->addr + round_up(munmap->length));
+  } else if (auto mremap = tracee.As<MremapCall>()) {
+    if (RemoveMapping(mremap->old_address, mremap->old_address + round_up(mremap->old_size)) > 0) {
+      const unsigned long start = returned_value;
+      AddMapping(start, start + round_up(mremap->new_size));
+    }
+  } else {
+    return false;
+  }
+  Record(tracee.Pid(), false);
+  return false;
+}
+
+bool MemoryTimelineInterceptor::Intercept(BeforeTerminationStoppedTracee &tracee) {
+  Record(tracee.Pid(), true);
+  return false;
+}
+
+void MemoryTimelineInterceptor::AddMapping(unsigned long start, unsigned long end) {
+  if (start >= end) {
+    return;
+  }
+  RemoveMapping(start, end);
+  anonymous_bytes_ += end - start;
+  auto next = mappings_.lower_bound(start);
+  if (next != mappings_.end() && next->first == end) {
+    end = next->second;
+    next = mappings_.erase(next);
+  }
+  if (next != mappings_.begin() && std::prev(next)->second == start) {
+    std::prev(next)->second = end;
+  } else {
+    mappings_.emplace_hint(next, start, end);
+  }
+}
+
+uint64_t MemoryTimelineInterceptor::RemoveMapping(unsigned long start, unsigned long end) {
+  if (start >= end) {
+    return 0;
+  }
+  auto mapping = mappings_.upper_bound(start);
+  if (mapping != mappings_.begin() && std::prev(mapping)->second > start) {
+    --mapping;
+  }
+  uint64_t removed = 0;
+  while (mapping != mappings_.end() && mapping->first < end) {
+    const unsigned long mapping_start = mapping->first;
+    const unsigned long mapping_end = mapping->second;
+    removed += std::min(mapping_end, end) - std::max(mapping_start, start);
+    mapping = mappings_.erase(mapping);
+    if (mapping_start < start) {
+      mappings_.emplace(mapping_start, start);
+    }
+    if (mapping_end > end) {
+      mapping = mappings_.emplace(end, mapping_end).first;
+    }
+  }
+  anonymous_bytes_ -= removed;
+  return removed;
+}
+
+void MemoryTimelineInterceptor::Record(pid_t pid, bool force_rss_sample) {
+  const auto now = std::chrono::steady_clock::now();
+  if (!started_) {
+    started_ = now;
+  }
+  int64_t rss_bytes = -1;
+  if (force_rss_sample || !last_rss_sample_ || now - *last_rss_sample_ >= rss_sample_interval_) {
+    rss_bytes = ReadRss(pid, page_size_);
+    last_rss_sample_ = now;
+    peak_rss_bytes_ = std::max(peak_rss_bytes_, rss_bytes);
+  }
+  Point point{
+      syscalls_,
+      std::chrono::duration_cast<std::chrono::microseconds>(now - *started_).count(),
+      heap_bytes_,
+      anonymous_bytes_,
+      rss_bytes,
+  };
+  if (TotalBytes() > peak_.heap_bytes + peak_.anonymous_bytes) {
+    peak_ = point;
+  }
+  if (points_.size() == max_points_) {
+    // every other point is dropped, so the whole run stays covered with a coarser resolution
+    size_t kept = 0;
+    for (size_t i = 0; i < points_.size(); i += 2) {
+      points_[kept++] = points_[i];
+    }
+    points_.resize(kept);
+  }
+  points_.push_back(point);
+}
+
+void MemoryTimelineInterceptor::OnFinish(const std::string &working_directory) {
+  timeline_file_ = (std::filesystem::path(working_directory) / timeline_file_).string();
+  nlohmann::json series = nlohmann::json::array();
+  for (const Point &point : points_) {
+    series.push_back({point.syscall_index, point.micros, point.heap_bytes, point.anonymous_bytes,
+                      point.rss_bytes >= 0 ? nlohmann::json(point.rss_bytes) : nlohmann::json()});
+  }
+  std::ofstream timeline(timeline_file_, std::ios::trunc);
+  timeline << nlohmann::json{
+      {"columns", {"syscallIndex", "micros", "heapBytes", "anonymousBytes", "rssBytes"}},
+      {"points", series},
+  };
+  if (!timeline) {
+    WARN("Failed to write memory timeline to %s", timeline_file_.c_str())
+  }
+}
+
+nlohmann::json MemoryTimelineInterceptor::CollectStatistics() const {
+  return {
+      {"peak", {
+          {"bytes", peak_.heap_bytes + peak_.anonymous_bytes},
+          {"heapBytes", peak_.heap_bytes},
+          {"anonymousBytes", peak_.anonymous_bytes},
+          {"syscallIndex", peak_.syscall_index},
+          {"micros", peak_.micros},
+      }},
+      {"peakRssBytes", peak_rss_bytes_ >= 0 ? nlohmann::json(peak_rss_bytes_) : nlohmann::json()},
+      {"finalBytes", TotalBytes()},
+      {"syscalls", syscalls_},
+      {"deniedAllocations", denied_allocations_},
+      {"points", points_.size()},
+      {kTimelineFileKey, timeline_file_},
+  };
+}
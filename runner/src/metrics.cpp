@@ -0,0 +1,177 @@
+#include <kourt/runner/metrics.h>
+
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
+
+#include <array>
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+// Bucket upper bounds grow by 4x from 1us to ~17s, which covers both a single ptrace stop and a whole launch.
+static const size_t kHistogramBuckets = 13;
+static const std::array<std::chrono::nanoseconds, kHistogramBuckets> kBucketBounds = [] {
+  std::array<std::chrono::nanoseconds, kHistogramBuckets> bounds{};
+  std::chrono::nanoseconds bound = std::chrono::microseconds(1);
+  for (auto &b : bounds) {
+    b = bound;
+    bound *= 4;
+  }
+  return bounds;
+}();
+
+struct CounterDescription {
+  const char *name;
+  const char *labels;
+  const char *help;
+};
+
+// Indexed by Counter. Counters sharing a name are rendered as one family.
+static const CounterDescription kCounterDescriptions[] = {
+    {"kourt_runner_stops_total", "type=\"before_syscall\"", "Tracee stops handled by the controller."},
+    {"kourt_runner_stops_total", "type=\"after_syscall\"", nullptr},
+    {"kourt_runner_stops_total", "type=\"before_signal_delivery\"", nullptr},
+    {"kourt_runner_stops_total", "type=\"on_group_stop\"", nullptr},
+    {"kourt_runner_stops_total", "type=\"before_termination\"", nullptr},
+    {"kourt_runner_launches_total", nullptr, "Tracees launched."},
+    {"kourt_runner_launch_failures_total", nullptr, "Launches failed because of a runner error."},
+    {"kourt_runner_verdicts_total", "verdict=\"exited_zero\"", "Tracees finished, by the way they terminated."},
+    {"kourt_runner_verdicts_total", "verdict=\"exited_non_zero\"", nullptr},
+    {"kourt_runner_verdicts_total", "verdict=\"signaled\"", nullptr},
+};
+static_assert(std::size(kCounterDescriptions) == static_cast<size_t>(Counter::kCount));
+
+struct HistogramDescription {
+  const char *name;
+  const char *help;
+};
+
+// Indexed by Histogram.
+static const HistogramDescription kHistogramDescriptions[] = {
+    {"kourt_runner_tracee_run_seconds", "Time the tracee ran from being resumed to its next stop or exit."},
+    {"kourt_runner_interceptor_seconds", "Time spent in interceptors per tracee stop, decoding the stop excluded."},
+    {"kourt_runner_launch_duration_seconds", "Wall time of a launch from spawning the tracee to its exit status."},
+};
+static_assert(std::size(kHistogramDescriptions) == static_cast<size_t>(Histogram::kCount));
+
+/// Metrics recorded by a single thread. Only the owner thread writes, any thread may read.
+struct MetricsShard {
+  std::array<std::atomic<uint64_t>, static_cast<size_t>(Counter::kCount)> counters{};
+
+  struct HistogramData {
+    std::array<std::atomic<uint64_t>, kHistogramBuckets + 1> buckets{};
+    std::atomic<uint64_t> sum_nanos{0};
+  };
+  std::array<HistogramData, static_cast<size_t>(Histogram::kCount)> histograms{};
+};
+
+// With a single writer, load + store is enough and avoids a locked read-modify-write instruction.
+static void Add(std::atomic<uint64_t> &value, uint64_t delta) {
+  value.store(value.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+}
+
+static std::mutex shards_mutex;
+// Shards outlive their threads, so that the totals don't go backwards when a thread exits.
+static std::vector<std::shared_ptr<MetricsShard>> shards;
+
+static MetricsShard &ThreadShard() {
+  thread_local std::shared_ptr<MetricsShard> shard = [] {
+    auto new_shard = std::make_shared<MetricsShard>();
+    std::scoped_lock lock(shards_mutex);
+    shards.push_back(new_shard);
+    return new_shard;
+  }();
+  return *shard;
+}
+
+void IncrementCounter(Counter counter) {
+  Add(ThreadShard().counters[static_cast<size_t>(counter)], 1);
+}
+
+void ObserveHistogram(Histogram histogram, std::chrono::nanoseconds value) {
+  auto &data = ThreadShard().histograms[static_cast<size_t>(histogram)];
+  size_t bucket = 0;
+  while (bucket < kHistogramBuckets && value > kBucketBounds[bucket]) {
+    ++bucket;
+  }
+  Add(data.buckets[bucket], 1);
+  Add(data.sum_nanos, value.count());
+}
+
+std::string RenderMetrics() {
+  std::array<uint64_t, static_cast<size_t>(Counter::kCount)> counters{};
+  std::array<std::array<uint64_t, kHistogramBuckets + 1>, static_cast<size_t>(Histogram::kCount)> buckets{};
+  std::array<uint64_t, static_cast<size_t>(Histogram::kCount)> sums{};
+  {
+    std::scoped_lock lock(shards_mutex);
+    for (auto &shard : shards) {
+      for (size_t i = 0; i < counters.size(); ++i) {
+        counters[i] += shard->counters[i].load(std::memory_order_relaxed);
+      }
+      for (size_t i = 0; i < buckets.size(); ++i) {
+        for (size_t j = 0; j <= kHistogramBuckets; ++j) {
+          buckets[i][j] += shard->histograms[i].buckets[j].load(std::memory_order_relaxed);
+        }
+        sums[i] += shard->histograms[i].sum_nanos.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  std::ostringstream out;
+  for (size_t i = 0; i < counters.size(); ++i) {
+    const CounterDescription &description = kCounterDescriptions[i];
+    if (description.help) {
+      out << "# HELP " << description.name << " " << description.help << "\n";
+      out << "# TYPE " << description.name << " counter\n";
+    }
+    out << description.name;
+    if (description.labels) {
+      out << "{" << description.labels << "}";
+    }
+    out << " " << counters[i] << "\n";
+  }
+  for (size_t i = 0; i < buckets.size(); ++i) {
+    const HistogramDescription &description = kHistogramDescriptions[i];
+    out << "# HELP " << description.name << " " << description.help << "\n";
+    out << "# TYPE " << description.name << " histogram\n";
+    uint64_t cumulative_count = 0;
+    for (size_t j = 0; j <= kHistogramBuckets; ++j) {
+      cumulative_count += buckets[i][j];
+      out << description.name << "_bucket{le=\"";
+      if (j < kHistogramBuckets) {
+        out << std::chrono::duration<double>(kBucketBounds[j]).count();
+      } else {
+        out << "+Inf";
+      }
+      out << "\"} " << cumulative_count << "\n";
+    }
+    out << description.name << "_sum " << std::chrono::duration<double>(std::chrono::nanoseconds(sums[i])).count()
+        << "\n";
+    out << description.name << "_count " << cumulative_count << "\n";
+  }
+  return out.str();
+}
+
+void WriteMetricsFile(const std::string &path) {
+  // Written aside and renamed, so that a scraper never reads a partially written file.
+  const std::string temporary_path = path + ".tmp." + std::to_string(getpid()) + "."
+      + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+  {
+    std::ofstream out(temporary_path, std::ofstream::out | std::ofstream::trunc);
+    out << RenderMetrics();
+    if (!out) {
+      throw std::runtime_error("Failed to write metrics to " + temporary_path);
+    }
+  }
+  if (0 != rename(temporary_path.c_str(), path.c_str())) {
+    int error_code = errno;
+    unlink(temporary_path.c_str());
+    throw std::runtime_error("Failed to rename " + temporary_path + ": " + strerror(error_code));
+  }
+}
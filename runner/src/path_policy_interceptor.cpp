@@ -0,0 +1,467 @@
+#include <kourt/runner/path_policy_interceptor.h>
+#include <kourt/runner/tracing.h>
+
+#include <fcntl.h>
+#include <linux/magic.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
+#include <unistd.h>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+
+#include <algorithm>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+#include <utility>
+
+#include <kourt/runner/logging.h>
+
+static const char *kRulesKey = "rules";
+static const char *kRulePathKey = "path";
+static const char *kRuleAccessKey = "access";
+static const char *kDefaultAccessKey = "defaultAccess";
+static const char *kSyscallsKey = "syscalls";
+static const char *kMaxReportedDenialsKey = "maxReportedDenials";
+
+static const char *kDefaultSyscalls[] = {
+    "open", "openat", "creat", "truncate", "unlink", "unlinkat", "rename", "renameat", "renameat2", "link", "linkat",
+    "symlink", "symlinkat", "mkdir", "mkdirat", "rmdir", "execve", "execveat",
+};
+// Most paths fit into the first read, longer ones are read on in growing chunks.
+static const size_t kInitialPathReadSize = 256;
+// Symbolic links followed in a single lookup before the kernel gives up with ELOOP.
+static const int kMaxSymlinksFollowed = 40;
+// Inode number of the root directory of a procfs mount.
+static const ino_t kProcRootInode = 1;
+
+/// Descriptor of the runner, closed once it goes out of scope.
+class ScopedFd {
+ public:
+  explicit ScopedFd(int fd = -1) : fd_(fd) {
+    // nop
+  }
+  ScopedFd(ScopedFd &&other) noexcept : fd_(std::exchange(other.fd_, -1)) {
+    // nop
+  }
+  ScopedFd &operator=(ScopedFd &&other) noexcept {
+    std::swap(fd_, other.fd_);
+    return *this;
+  }
+  ~ScopedFd() {
+    if (fd_ >= 0) {
+      close(fd_);
+    }
+  }
+
+  [[nodiscard]] int Get() const {
+    return fd_;
+  }
+
+ private:
+  int fd_;
+};
+
+static std::deque<std::string> SplitPath(std::string_view path) {
+  std::deque<std::string> components;
+  for (size_t start = 0; start < path.size();) {
+    size_t end = std::min(path.find('/', start), path.size());
+    if (end > start) {
+      components.emplace_back(path.substr(start, end - start));
+    }
+    start = end + 1;
+  }
+  return components;
+}
+
+static std::optional<std::string> ReadLink(int dirfd, const char *name) {
+  char target[PATH_MAX];
+  ssize_t length = readlinkat(dirfd, name, target, sizeof(target));
+  if (length < 0 || static_cast<size_t>(length) == sizeof(target)) {
+    return std::nullopt;
+  }
+  return std::string(target, length);
+}
+
+static bool IsSameFile(int fd, int other_fd) {
+  struct stat file_stat{};
+  struct stat other_stat{};
+  return 0 == fstat(fd, &file_stat) && 0 == fstat(other_fd, &other_stat)
+      && file_stat.st_dev == other_stat.st_dev && file_stat.st_ino == other_stat.st_ino;
+}
+
+static bool IsOnProcfs(int fd) {
+  struct statfs filesystem{};
+  return 0 == fstatfs(fd, &filesystem) && filesystem.f_type == PROC_SUPER_MAGIC;
+}
+
+static bool IsProcfsRoot(int fd) {
+  struct stat file_stat{};
+  return IsOnProcfs(fd) && 0 == fstat(fd, &file_stat) && file_stat.st_ino == kProcRootInode;
+}
+
+/// @param field <code>NStgid</code> or <code>NSpid</code>
+/// @return the id of the process in its own pid namespace, which its <code>/proc/self</code> names
+static std::string NamespacePid(pid_t pid, const std::string &field) {
+  std::ifstream status("/proc/" + std::to_string(pid) + "/status");
+  for (std::string line; std::getline(status, line);) {
+    if (line.rfind(field + ":", 0) == 0) {
+      return line.substr(line.find_last_of(" \t") + 1);
+    }
+  }
+  return std::to_string(pid);
+}
+
+static PathRuleTrie::Access ParseAccess(const std::string &access) {
+  if (access == "allow") {
+    return PathRuleTrie::Access::kAllow;
+  }
+  if (access == "deny") {
+    return PathRuleTrie::Access::kDeny;
+  }
+  throw std::invalid_argument("PathPolicyInterceptor: access should be 'allow' or 'deny', not '" + access + "'");
+}
+
+PathRuleTrie::PathRuleTrie(const std::vector<std::pair<std::string, Access>> &rules) {
+  // built with sorted maps first, then laid out flat so that a lookup touches two arrays only
+  std::vector<std::map<char, uint32_t>> children(1);
+  std::vector<Access> access(1, Access::kNone);
+  for (const auto &[path, rule_access] : rules) {
+    uint32_t node = 0;
+    for (char character : path) {
+      auto [child, inserted] = children[node].try_emplace(character, static_cast<uint32_t>(children.size()));
+      if (inserted) {
+        children.emplace_back();
+        access.push_back(Access::kNone);
+      }
+      node = child->second;
+    }
+    access[node] = rule_access;
+  }
+  nodes_.reserve(children.size());
+  for (size_t node = 0; node < children.size(); ++node) {
+    const auto first_edge = static_cast<uint32_t>(edges_.size());
+    for (const auto &[character, child] : children[node]) {
+      edges_.push_back({character, child});
+    }
+    nodes_.push_back({first_edge, static_cast<uint32_t>(edges_.size()), access[node]});
+  }
+}
+
+PathRuleTrie::Access PathRuleTrie::Match(std::string_view path) const {
+  Access access = Access::kNone;
+  uint32_t node = 0;
+  for (size_t i = 0;; ++i) {
+    // a rule covers the path if it ends at a component boundary: "/etc" covers "/etc/passwd" but not "/etcetera"
+    const bool at_boundary = i == path.size() || path[i] == '/' || (i > 0 && path[i - 1] == '/');
+    if (nodes_[node].access != Access::kNone && at_boundary) {
+      access = nodes_[node].access;
+    }
+    if (i == path.size()) {
+      return access;
+    }
+    auto first = edges_.begin() + nodes_[node].first_edge;
+    auto last = edges_.begin() + nodes_[node].last_edge;
+    auto edge = std::lower_bound(first, last, path[i], [](const Edge &edge, char character) {
+      return edge.character < character;
+    });
+    if (edge == last || edge->character != path[i]) {
+      return access;
+    }
+    node = edge->child;
+  }
+}
+
+std::string PathRuleTrie::NormalizePath(std::string_view base, std::string_view path) {
+  std::vector<std::string_view> components;
+  auto append = [&components](std::string_view path) {
+    for (size_t start = 0; start < path.size();) {
+      size_t end = std::min(path.find('/', start), path.size());
+      std::string_view component = path.substr(start, end - start);
+      if (component == "..") {
+        if (!components.empty()) {
+          components.pop_back();
+        }
+      } else if (!component.empty() && component != ".") {
+        components.push_back(component);
+      }
+      start = end + 1;
+    }
+  };
+  if (path.empty() || path[0] != '/') {
+    append(base);
+  }
+  append(path);
+  std::string normalized;
+  for (std::string_view component : components) {
+    normalized += '/';
+    normalized += component;
+  }
+  return normalized.empty() ? "/" : normalized;
+}
+
+PathPolicyInterceptor::PathPolicyInterceptor(const nlohmann::json &config) :
+    trie_([&config] {
+      std::vector<std::pair<std::string, PathRuleTrie::Access>> rules;
+      for (const auto &rule : config.value(kRulesKey, nlohmann::json::array())) {
+        const std::string path = rule.at(kRulePathKey);
+        if (path.empty() || path[0] != '/') {
+          throw std::invalid_argument("PathPolicyInterceptor: rule path should be absolute, not '" + path + "'");
+        }
+        rules.emplace_back(PathRuleTrie::NormalizePath("/", path), ParseAccess(rule.at(kRuleAccessKey)));
+      }
+      return PathRuleTrie(rules);
+    }()),
+    allow_by_default_(ParseAccess(config.value(kDefaultAccessKey, "allow")) == PathRuleTrie::Access::kAllow),
+    max_reported_denials_(config.value(kMaxReportedDenialsKey, size_t{10})) {
+  const std::vector<std::string> syscalls = config.value(
+      kSyscallsKey, std::vector<std::string>(std::begin(kDefaultSyscalls), std::end(kDefaultSyscalls)));
+  for (const std::string &name : syscalls) {
+    const SyscallDescriptor *descriptor = FindSyscallDescriptorByName(name);
+    if (!descriptor) {
+      throw std::invalid_argument("Unknown syscall: '" + name + "'");
+    }
+    if (std::find(descriptor->arg_kinds, descriptor->arg_kinds + descriptor->arity, kArgCString)
+        == descriptor->arg_kinds + descriptor->arity) {
+      throw std::invalid_argument("PathPolicyInterceptor: " + name + " takes no path");
+    }
+    syscalls_.set(descriptor->number);
+  }
+  if (syscalls_.test(__NR_openat)) {
+    // openat2 isn't in the catalogue: it is refused, so that opening files takes the checked way
+    syscalls_.set(__NR_openat2);
+  }
+}
+
+std::optional<std::vector<unsigned long>> PathPolicyInterceptor::InterceptedSyscalls() const {
+  std::vector<unsigned long> syscalls;
+  for (unsigned long syscall_no = 0; syscall_no < kMaxSyscallNumber; ++syscall_no) {
+    if (syscalls_.test(syscall_no)) {
+      syscalls.push_back(syscall_no);
+    }
+  }
+  return syscalls;
+}
+
+bool PathPolicyInterceptor::InterceptsSyscallExits() const {
+  return false;
+}
+
+nlohmann::json PathPolicyInterceptor::CollectStatistics() const {
+  return {
+      {"checkedSyscalls", checked_},
+      {"deniedSyscalls", denied_},
+      {"denials", reported_denials_},
+  };
+}
+
+bool PathPolicyInterceptor::Intercept(BeforeSyscallStoppedTracee &tracee) {
+  const unsigned long syscall_no = tracee.SyscallNumber();
+  // the x32 variants of the checked syscalls would bypass the policy
+  if (syscall_no != kCancelledSyscall && (syscall_no & kX32SyscallBit)) {
+    tracee.SkipSyscall(-ENOSYS);
+    return false;
+  }
+  if (syscall_no >= kMaxSyscallNumber || !syscalls_.test(syscall_no)) {
+    return false;
+  }
+  if (syscall_no == __NR_openat2) {
+    tracee.SkipSyscall(-ENOSYS);
+    return false;
+  }
+  const SyscallDescriptor *descriptor = tracee.Descriptor();
+  if (!descriptor) {
+    return false;
+  }
+  ++checked_;
+  // A relative symlink target is resolved against the directory of the link, so the link is resolved first.
+  std::optional<std::string> link_directory;
+  std::optional<int> target_index;
+  for (int i = 0; i < descriptor->arity; ++i) {
+    if (descriptor->arg_kinds[i] != kArgCString) {
+      continue;
+    }
+    if (0 == strcmp(descriptor->arg_names[i], "target")) {
+      target_index = i;
+      continue;
+    }
+    // Whatever the kernel would reject on its own (an unreadable path, a bad descriptor) is left to it.
+    std::optional<std::string> path = ReadPath(tracee, tracee.Arg(i));
+    if (!path || path->empty()) {
+      continue;
+    }
+    const bool has_dirfd = i > 0 && descriptor->arg_kinds[i - 1] == kArgFd;
+    std::optional<std::vector<std::string>> resolved =
+        ResolvePath(tracee.Pid(), has_dirfd ? static_cast<int>(tracee.Arg(i - 1)) : AT_FDCWD, *path);
+    if (!resolved) {
+      continue;
+    }
+    for (const std::string &resolved_path : *resolved) {
+      if (!Allows(resolved_path)) {
+        Deny(tracee, std::string(descriptor->name) + " " + resolved_path);
+        return false;
+      }
+    }
+    if (0 == strcmp(descriptor->arg_names[i], "linkpath")) {
+      link_directory = PathRuleTrie::NormalizePath(resolved->front(), "..");
+    }
+  }
+  if (target_index) {
+    std::optional<std::string> target = ReadPath(tracee, tracee.Arg(*target_index));
+    if (target && !target->empty() && ((*target)[0] == '/' || link_directory)) {
+      const std::string path = PathRuleTrie::NormalizePath(link_directory.value_or("/"), *target);
+      std::optional<std::vector<std::string>> resolved = ResolvePath(tracee.Pid(), AT_FDCWD, path);
+      for (const std::string &resolved_path : resolved.value_or(std::vector<std::string>{path})) {
+        if (!Allows(resolved_path)) {
+          Deny(tracee, std::string(descriptor->name) + " " + resolved_path);
+          break;
+        }
+      }
+    }
+  }
+  return false;
+}
+
+std::optional<std::string> PathPolicyInterceptor::ReadPath(BeforeSyscallStoppedTracee &tracee,
+                                                           unsigned long address) {
+  std::string path;
+  for (size_t chunk_size = kInitialPathReadSize; path.size() < PATH_MAX; chunk_size *= 2) {
+    const size_t offset = path.size();
+    chunk_size = std::min<size_t>(chunk_size, PATH_MAX - offset);
+    path.resize(offset + chunk_size);
+    const size_t copied = tracee.ReadMemory(address + offset, path.data() + offset, chunk_size);
+    const size_t terminator = path.find('\0', offset);
+    if (terminator < offset + copied) {
+      path.resize(terminator);
+      return path;
+    }
+    if (copied < chunk_size) {
+      return std::nullopt;
+    }
+  }
+  return std::nullopt;
+}
+
+std::optional<std::vector<std::string>> PathPolicyInterceptor::ResolvePath(pid_t pid,
+                                                                           int dirfd,
+                                                                           const std::string &path) {
+  const std::string process_directory = "/proc/" + std::to_string(pid);
+  const std::string root_link = process_directory + "/root";
+  // descriptors of pipes and sockets aren't directories, the kernel fails such a lookup itself
+  const std::string start_link = path[0] == '/' ? root_link
+      : dirfd == AT_FDCWD ? process_directory + "/cwd"
+      : process_directory + "/fd/" + std::to_string(dirfd);
+  ScopedFd root(open(root_link.c_str(), O_PATH | O_DIRECTORY | O_CLOEXEC));
+  ScopedFd directory(open(start_link.c_str(), O_PATH | O_DIRECTORY | O_CLOEXEC));
+  std::optional<std::string> root_path = ReadLink(AT_FDCWD, root_link.c_str());
+  if (root.Get() < 0 || directory.Get() < 0 || !root_path) {
+    return std::nullopt;
+  }
+  // the path of a descriptor as the tracee sees it, below its root
+  auto tracee_path = [&root_path](int fd) -> std::optional<std::string> {
+    std::optional<std::string> fd_path = ReadLink(AT_FDCWD, ("/proc/self/fd/" + std::to_string(fd)).c_str());
+    if (!fd_path || *root_path == "/") {
+      return fd_path;
+    }
+    const bool below_root = fd_path->rfind(*root_path, 0) == 0
+        && (fd_path->size() == root_path->size() || (*fd_path)[root_path->size()] == '/');
+    if (!below_root) {
+      return std::nullopt;
+    }
+    return fd_path->size() == root_path->size() ? "/" : fd_path->substr(root_path->size());
+  };
+
+  std::deque<std::string> components = SplitPath(path);
+  std::vector<std::string> links;
+  std::string missing;
+  int symlinks_followed = 0;
+  while (!components.empty()) {
+    std::string name = std::move(components.front());
+    components.pop_front();
+    if (name == ".") {
+      continue;
+    }
+    if (name == "..") {
+      // the tracee can't step out of its root
+      if (!IsSameFile(directory.Get(), root.Get())) {
+        directory = ScopedFd(openat(directory.Get(), "..", O_PATH | O_DIRECTORY | O_CLOEXEC));
+        if (directory.Get() < 0) {
+          return std::nullopt;
+        }
+      }
+      continue;
+    }
+    if ((name == "self" || name == "thread-self") && IsProcfsRoot(directory.Get())) {
+      // read by the runner these would name the runner rather than the tracee
+      if (name == "thread-self") {
+        components.push_front(NamespacePid(pid, "NSpid"));
+        components.push_front("task");
+      }
+      name = NamespacePid(pid, "NStgid");
+    }
+    ScopedFd entry(openat(directory.Get(), name.c_str(), O_PATH | O_NOFOLLOW | O_CLOEXEC));
+    struct stat entry_stat{};
+    if (entry.Get() < 0 || 0 != fstat(entry.Get(), &entry_stat)) {
+      // what doesn't exist yet, e.g. a file being created, is taken as spelled
+      missing = name;
+      for (const std::string &component : components) {
+        missing += "/" + component;
+      }
+      break;
+    }
+    if (!S_ISLNK(entry_stat.st_mode)) {
+      directory = std::move(entry);
+      continue;
+    }
+    if (++symlinks_followed > kMaxSymlinksFollowed) {
+      return std::nullopt;
+    }
+    if (components.empty()) {
+      // a syscall may act on the link at the end of the path rather than on its target, both are checked
+      std::optional<std::string> directory_path = tracee_path(directory.Get());
+      if (!directory_path) {
+        return std::nullopt;
+      }
+      links.push_back(PathRuleTrie::NormalizePath(*directory_path, name));
+    }
+    std::optional<std::string> target = ReadLink(directory.Get(), name.c_str());
+    if (!target || target->empty()) {
+      return std::nullopt;
+    }
+    if (IsOnProcfs(directory.Get()) && ((*target)[0] == '/' || target->find(':') != std::string::npos)) {
+      // a magic link, e.g. /proc/pid/root or a descriptor: its target is no path to walk, the kernel follows it
+      directory = ScopedFd(openat(directory.Get(), name.c_str(), O_PATH | O_CLOEXEC));
+      if (directory.Get() < 0) {
+        return std::nullopt;
+      }
+      continue;
+    }
+    if ((*target)[0] == '/') {
+      directory = ScopedFd(dup(root.Get()));
+    }
+    std::deque<std::string> target_components = SplitPath(*target);
+    components.insert(components.begin(), target_components.begin(), target_components.end());
+  }
+  std::optional<std::string> resolved = tracee_path(directory.Get());
+  if (!resolved) {
+    return std::nullopt;
+  }
+  links.push_back(PathRuleTrie::NormalizePath(*resolved, missing));
+  return links;
+}
+
+bool PathPolicyInterceptor::Allows(std::string_view path) const {
+  const PathRuleTrie::Access access = trie_.Match(path);
+  return access == PathRuleTrie::Access::kNone ? allow_by_default_ : access == PathRuleTrie::Access::kAllow;
+}
+
+void PathPolicyInterceptor::Deny(BeforeSyscallStoppedTracee &tracee, const std::string &path) {
+  ++denied_;
+  DEBUG("Denying %s: %s", tracee.Describe().c_str(), path.c_str())
+  if (reported_denials_.size() < max_reported_denials_) {
+    reported_denials_.push_back(path);
+  }
+  tracee.SkipSyscall(-EACCES);
+}
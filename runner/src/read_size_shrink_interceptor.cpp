@@ -1,5 +1,3 @@
-#include <asm/unistd.h>
-
 #include <kourt/runner/read_size_shrink_interceptor.h>
 #include <kourt/runner/tracing.h>
 
@@ -10,15 +8,15 @@ ReadSizeShrinkInterceptor::ReadSizeShrinkInterceptor() {
 }
 
 bool ReadSizeShrinkInterceptor::Intercept(BeforeSyscallStoppedTracee &tracee) {
-  TRACE("Before syscall %l", tracee.SyscallNumber())
-  if (__NR_read == tracee.SyscallNumber()) {
-    auto size = tracee.Arg3();
+  if (auto read = tracee.As<ReadCall>()) {
+    auto size = read->count;
     if (size > 1) {
       should_restore_size_ = true;
       size_to_restore_ = size;
       auto size_to_read = 1UL;
       DEBUG("change third syscall argument from %zu to %zu", size, size_to_read);
       tracee.SetArg3(size_to_read);
+      ++shrunk_reads_;
     }
   }
   return false;
@@ -33,6 +31,14 @@ bool ReadSizeShrinkInterceptor::Intercept(AfterSyscallStoppedTracee &tracee) {
   return false;
 }
 
+std::optional<std::vector<unsigned long>> ReadSizeShrinkInterceptor::InterceptedSyscalls() const {
+  return std::vector<unsigned long>{ReadCall::kNumber};
+}
+
+nlohmann::json ReadSizeShrinkInterceptor::CollectStatistics() const {
+  return {{"shrunkReads", shrunk_reads_}};
+}
+
 void ReadSizeShrinkInterceptor::ResetSizeRestoreNecessity() {
   should_restore_size_ = false;
   size_to_restore_ = 0;
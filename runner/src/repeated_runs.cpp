@@ -0,0 +1,194 @@
+#include <kourt/runner/repeated_runs.h>
+
+#include <unistd.h>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <utility>
+
+#include <kourt/runner/config.h>
+#include <kourt/runner/logging.h>
+#include <kourt/runner/memory_file.h>
+#include <kourt/runner/runner_main.h>
+#include <kourt/runner/system.h>
+
+static const char *kWarmupRunsKey = "warmupRuns";
+static const char *kMeasuredRunsKey = "measuredRuns";
+static const char *kMinMeasuredRunsKey = "minMeasuredRuns";
+static const char *kRelativeConfidenceKey = "relativeConfidence";
+
+static const int kDefaultWarmupRuns = 1;
+static const int kDefaultMeasuredRuns = 10;
+static const int kDefaultMinMeasuredRuns = 3;
+static const double kDefaultRelativeConfidence = 0.02;
+// Two-sided 95% quantiles of Student's t-distribution by the degrees of freedom, from 1 to 30, then for some more.
+// Between the tabulated degrees of freedom the quantile of the nearest one below is taken, which errs on the wide
+// side; past the table it is within 1% of the normal distribution's 1.96.
+static const double kStudentTQuantiles95[] = {
+    12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+    2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+    2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042,
+};
+static const std::pair<size_t, double> kSparseStudentTQuantiles95[] = {{40, 2.021}, {60, 2.000}, {120, 1.980}};
+
+/// Copies the rest of a non-seekable input (e.g. a pipe) into a memory file, so that it can be read by every run.
+static std::unique_ptr<MemoryFile> BufferInput(int fd) {
+  auto buffer = std::make_unique<MemoryFile>("kourt-repeated-stdin");
+  char chunk[1 << 16];
+  for (;;) {
+    ssize_t bytes_read = read(fd, chunk, sizeof(chunk));
+    if (bytes_read < 0 && errno == EINTR) {
+      continue;
+    }
+    if (bytes_read < 0) {
+      throw SystemError("read stdin");
+    }
+    if (bytes_read == 0) {
+      break;
+    }
+    for (ssize_t offset = 0; offset < bytes_read;) {
+      ssize_t written = write(buffer->Fd(), chunk + offset, bytes_read - offset);
+      if (written < 0 && errno != EINTR) {
+        throw SystemError("write stdin buffer");
+      }
+      offset += std::max<ssize_t>(written, 0);
+    }
+  }
+  return buffer;
+}
+
+static bool IsElfFile(const char *path) {
+  char magic[4] = {};
+  std::ifstream(path, std::ios::binary).read(magic, sizeof(magic));
+  return 0 == memcmp(magic, "\x7f" "ELF", sizeof(magic));
+}
+
+nlohmann::json DescribeSamples(std::vector<double> samples) {
+  if (samples.empty()) {
+    return nlohmann::json::object();
+  }
+  std::sort(samples.begin(), samples.end());
+  // nearest-rank percentiles
+  auto percentile = [&](double p) {
+    size_t rank = static_cast<size_t>(std::ceil(p * static_cast<double>(samples.size())));
+    return samples[std::clamp<size_t>(rank, 1, samples.size()) - 1];
+  };
+  const double mean = std::accumulate(samples.begin(), samples.end(), 0.0) / static_cast<double>(samples.size());
+  double squares = 0;
+  for (double sample : samples) {
+    squares += (sample - mean) * (sample - mean);
+  }
+  const double stddev = samples.size() > 1 ? std::sqrt(squares / static_cast<double>(samples.size() - 1)) : 0.0;
+  return {
+      {"min", samples.front()},
+      {"median", percentile(0.5)},
+      {"p90", percentile(0.9)},
+      {"max", samples.back()},
+      {"mean", mean},
+      {"stddev", stddev},
+      {"relativeSpread", mean > 0 ? (samples.back() - samples.front()) / mean : 0.0},
+  };
+}
+
+double StudentTQuantile95(size_t degrees_of_freedom) {
+  if (degrees_of_freedom == 0) {
+    // a single sample tells nothing about the spread
+    return std::numeric_limits<double>::infinity();
+  }
+  if (degrees_of_freedom <= std::size(kStudentTQuantiles95)) {
+    return kStudentTQuantiles95[degrees_of_freedom - 1];
+  }
+  double quantile = kStudentTQuantiles95[std::size(kStudentTQuantiles95) - 1];
+  for (const auto &[tabulated_degrees_of_freedom, tabulated_quantile] : kSparseStudentTQuantiles95) {
+    if (tabulated_degrees_of_freedom <= degrees_of_freedom) {
+      quantile = tabulated_quantile;
+    }
+  }
+  return quantile;
+}
+
+/// @return whether the 95% confidence interval of the mean is within <code>relative_confidence</code> of it
+static bool IsPreciseEnough(const std::vector<double> &samples, double relative_confidence) {
+  nlohmann::json description = DescribeSamples(samples);
+  const double mean = description["mean"];
+  const double stddev = description["stddev"];
+  const double quantile = StudentTQuantile95(samples.size() - 1);
+  const double half_width = quantile * stddev / std::sqrt(static_cast<double>(samples.size()));
+  return mean > 0 && std::isfinite(quantile) && half_width <= relative_confidence * mean;
+}
+
+nlohmann::json LaunchRepeatedly(const nlohmann::json &config,
+                                const char *path_to_executable,
+                                char *const *executable_argv,
+                                int stdin_fd) {
+  const nlohmann::json &repeat_config = config[kRepeatKey];
+  const int warmup_runs = repeat_config.value(kWarmupRunsKey, kDefaultWarmupRuns);
+  const int measured_runs = repeat_config.value(kMeasuredRunsKey, kDefaultMeasuredRuns);
+  const int min_measured_runs = std::min(measured_runs, repeat_config.value(kMinMeasuredRunsKey,
+                                                                            kDefaultMinMeasuredRuns));
+  const double relative_confidence = repeat_config.value(kRelativeConfidenceKey, kDefaultRelativeConfidence);
+  if (warmup_runs < 0 || measured_runs < 1) {
+    throw std::invalid_argument("Repeated runs need a non-negative number of warm-up runs and a measured run");
+  }
+
+  nlohmann::json run_config = config;
+  run_config.erase(kRepeatKey);
+  // the executable is read once rather than by every exec, unless it is a script which can't be executed from memory
+  if (!run_config.contains(kExecutableInMemoryKey)) {
+    run_config[kExecutableInMemoryKey] = IsElfFile(path_to_executable);
+  }
+  std::unique_ptr<MemoryFile> stdin_buffer;
+  // a generator produces the input anew for each run
+  if (stdin_fd < 0 && !run_config.contains(kStdinFileKey) && !run_config.contains(kGeneratorKey)) {
+    stdin_fd = 0;
+  }
+  if (stdin_fd >= 0 && lseek(stdin_fd, 0, SEEK_CUR) < 0) {
+    stdin_buffer = BufferInput(stdin_fd);
+    stdin_fd = stdin_buffer->Fd();
+  }
+  const off_t stdin_offset = stdin_fd >= 0 && !stdin_buffer ? lseek(stdin_fd, 0, SEEK_CUR) : 0;
+
+  nlohmann::json exit_status;
+  std::vector<double> wall_micros;
+  std::vector<double> cpu_micros;
+  int runs = 0;
+  for (; runs < warmup_runs + measured_runs; ++runs) {
+    if (stdin_fd >= 0 && lseek(stdin_fd, stdin_offset, SEEK_SET) < 0) {
+      throw SystemError("lseek stdin");
+    }
+    exit_status = LaunchRunner(run_config, path_to_executable, executable_argv, stdin_fd);
+    if (exit_status.value("verdict", "ok") != "ok") {
+      DEBUG("Run %d has failed, the solution is not measured further", runs)
+      ++runs;
+      break;
+    }
+    if (runs < warmup_runs) {
+      continue;
+    }
+    const nlohmann::json &usage = exit_status["resourceUsage"];
+    wall_micros.push_back(usage["wallMicros"].get<double>());
+    cpu_micros.push_back(usage["userMicros"].get<double>() + usage["systemMicros"].get<double>());
+    if (static_cast<int>(wall_micros.size()) >= min_measured_runs
+        && IsPreciseEnough(wall_micros, relative_confidence)) {
+      ++runs;
+      break;
+    }
+  }
+
+  exit_status[kRepeatKey] = {
+      {kWarmupRunsKey, std::min(runs, warmup_runs)},
+      {kMeasuredRunsKey, wall_micros.size()},
+      {"stoppedEarly", runs < warmup_runs + measured_runs},
+      {"wallMicros", DescribeSamples(wall_micros)},
+      {"cpuMicros", DescribeSamples(cpu_micros)},
+  };
+  return exit_status;
+}
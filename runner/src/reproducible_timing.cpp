@@ -0,0 +1,114 @@
+#include <kourt/runner/reproducible_timing.h>
+
+#include <sched.h>
+#include <sys/personality.h>
+#include <sys/resource.h>
+#include <cerrno>
+#include <cstring>
+
+#include <stdexcept>
+
+#include <kourt/runner/config.h>
+
+static const char *kCpuKey = "cpu";
+static const char *kEnvironmentKey = "environment";
+static const char *kRealtimePriorityKey = "realtimePriority";
+static const char *kNiceKey = "nice";
+
+static const std::map<std::string, std::string> kDefaultEnvironment = {
+    {"PATH", "/usr/local/bin:/usr/bin:/bin"},
+    {"LANG", "C"},
+    {"LC_ALL", "C"},
+};
+
+static int ChooseCpu(const nlohmann::json &config) {
+  const nlohmann::json &timing_config = config[kReproducibleTimingKey];
+  if (timing_config.contains(kCpuKey)) {
+    return timing_config[kCpuKey];
+  }
+  // the daemon gives each worker a core of its own
+  auto cpu_affinity = config.value(kCpuAffinityKey, std::vector<int>());
+  if (!cpu_affinity.empty()) {
+    return cpu_affinity.front();
+  }
+  // the first cores are the busiest with interrupts and system services usually
+  cpu_set_t allowed;
+  if (0 != sched_getaffinity(0, sizeof(allowed), &allowed)) {
+    int error_code = errno;
+    throw std::runtime_error(std::string("sched_getaffinity: ") + strerror(error_code));
+  }
+  for (int cpu = CPU_SETSIZE - 1; cpu > 0; --cpu) {
+    if (CPU_ISSET(cpu, &allowed)) {
+      return cpu;
+    }
+  }
+  return 0;
+}
+
+ReproducibleTiming::ReproducibleTiming(const nlohmann::json &config) :
+    cpu_(ChooseCpu(config)) {
+  const nlohmann::json &timing_config = config[kReproducibleTimingKey];
+  if (cpu_ < 0 || cpu_ >= CPU_SETSIZE) {
+    throw std::invalid_argument("CPU out of range: " + std::to_string(cpu_));
+  }
+  if (timing_config.contains(kRealtimePriorityKey)) {
+    realtime_priority_ = timing_config[kRealtimePriorityKey].get<int>();
+  }
+  if (timing_config.contains(kNiceKey)) {
+    nice_ = timing_config[kNiceKey].get<int>();
+  }
+  for (const auto &[name, value] : timing_config.value(kEnvironmentKey, kDefaultEnvironment)) {
+    environment_.push_back(name + "=" + value);
+  }
+  for (auto &variable : environment_) {
+    environment_pointers_.push_back(variable.data());
+  }
+  environment_pointers_.push_back(nullptr);
+}
+
+bool ReproducibleTiming::ApplyInChild() const {
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  CPU_SET(cpu_, &cpu_set);
+  if (0 != sched_setaffinity(0, sizeof(cpu_set), &cpu_set)) {
+    return false;
+  }
+  int persona = personality(0xffffffff);
+  if (persona < 0 || personality(persona | ADDR_NO_RANDOMIZE) < 0) {
+    return false;
+  }
+  if (realtime_priority_) {
+    sched_param param{};
+    param.sched_priority = *realtime_priority_;
+    // processes spawned by the tracee don't hog the core
+    if (0 != sched_setscheduler(0, SCHED_FIFO | SCHED_RESET_ON_FORK, &param)) {
+      return false;
+    }
+  }
+  if (nice_ && 0 != setpriority(PRIO_PROCESS, 0, *nice_)) {
+    return false;
+  }
+  return true;
+}
+
+nlohmann::json ReproducibleTiming::CollectStatistics() const {
+  nlohmann::json statistics = {
+      {kCpuKey, cpu_},
+      {"aslr", false},
+      {"scheduler", realtime_priority_ ? "fifo" : "other"},
+  };
+  if (realtime_priority_) {
+    statistics[kRealtimePriorityKey] = *realtime_priority_;
+  }
+  if (nice_) {
+    statistics[kNiceKey] = *nice_;
+  }
+  return statistics;
+}
+
+std::unique_ptr<ReproducibleTiming> CreateReproducibleTimingIfConfigured(const nlohmann::json &config) {
+  if (!config.contains(kReproducibleTimingKey)) {
+    return nullptr;
+  }
+  return std::make_unique<ReproducibleTiming>(config);
+}
@@ -0,0 +1,124 @@
+#include <kourt/runner/results.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+
+#include <stdexcept>
+#include <vector>
+
+#include <kourt/runner/system.h>
+
+static const char kRecordMagic[2] = {'K', 'R'};
+static const size_t kRecordHeaderSize = 8;
+
+ResultFormat ParseResultFormat(const std::string &name) {
+  if (name == "json") {
+    return ResultFormat::kJson;
+  } else if (name == "ndjson") {
+    return ResultFormat::kNdjson;
+  } else if (name == "binary") {
+    return ResultFormat::kBinary;
+  }
+  throw std::invalid_argument("Unknown result format: '" + name + "'");
+}
+
+static std::vector<uint8_t> EncodeRecord(const nlohmann::json &result) {
+  std::vector<uint8_t> payload = nlohmann::json::to_cbor(result);
+  std::vector<uint8_t> record(kRecordHeaderSize);
+  record[0] = kRecordMagic[0];
+  record[1] = kRecordMagic[1];
+  record[2] = kResultSchemaVersion;
+  record[3] = 0;
+  for (int i = 0; i < 4; ++i) {
+    record[4 + i] = (uint8_t) (payload.size() >> (8 * i));
+  }
+  record.insert(record.end(), payload.begin(), payload.end());
+  return record;
+}
+
+void WriteResult(const nlohmann::json &result, ResultFormat format, const std::string &path) {
+  std::string text;
+  std::vector<uint8_t> record;
+  const void *data;
+  size_t size;
+  int flags = O_WRONLY | O_CREAT | O_CLOEXEC;
+  if (format == ResultFormat::kBinary) {
+    record = EncodeRecord(result);
+    data = record.data();
+    size = record.size();
+    flags |= O_APPEND;
+  } else {
+    // inlined outputs of the tracee may be arbitrary bytes rather than UTF-8
+    text = result.dump(-1, ' ', false, nlohmann::json::error_handler_t::replace);
+    if (format == ResultFormat::kNdjson) {
+      text += '\n';
+      flags |= O_APPEND;
+    } else {
+      flags |= O_TRUNC;
+    }
+    data = text.data();
+    size = text.size();
+  }
+
+  int fd = open(path.c_str(), flags, 0644);
+  if (fd < 0) {
+    throw SystemError("open " + path);
+  }
+  // A single write: appends of concurrent writers don't interleave.
+  ssize_t written = write(fd, data, size);
+  int error_code = errno;
+  close(fd);
+  if (written != static_cast<ssize_t>(size)) {
+    errno = (written < 0) ? error_code : EIO;
+    throw SystemError("write " + path);
+  }
+}
+
+ResultReader::ResultReader(const std::string &path) :
+    file_(fopen(path.c_str(), "rbe")) {
+  if (!file_) {
+    throw SystemError("fopen " + path);
+  }
+}
+
+ResultReader::~ResultReader() {
+  fclose(file_);
+}
+
+std::optional<nlohmann::json> ResultReader::Next() {
+  int first = fgetc(file_);
+  while (first == '\n') {
+    first = fgetc(file_);
+  }
+  if (first == EOF) {
+    return std::nullopt;
+  }
+  if (first != kRecordMagic[0]) {
+    // a JSON text up to the end of the line
+    std::string line(1, static_cast<char>(first));
+    for (int c = fgetc(file_); c != EOF && c != '\n'; c = fgetc(file_)) {
+      line += static_cast<char>(c);
+    }
+    return nlohmann::json::parse(line);
+  }
+
+  uint8_t header[kRecordHeaderSize];
+  header[0] = first;
+  if (kRecordHeaderSize - 1 != fread(header + 1, 1, kRecordHeaderSize - 1, file_)
+      || header[1] != kRecordMagic[1]) {
+    throw std::runtime_error("Malformed result record header");
+  }
+  if (header[2] > kResultSchemaVersion) {
+    throw std::runtime_error("Unsupported result schema version " + std::to_string(header[2]));
+  }
+  uint32_t size = 0;
+  for (int i = 0; i < 4; ++i) {
+    size |= (uint32_t) header[4 + i] << (8 * i);
+  }
+  std::vector<uint8_t> payload(size);
+  if (size != fread(payload.data(), 1, size, file_)) {
+    throw std::runtime_error("Truncated result record");
+  }
+  return nlohmann::json::from_cbor(payload);
+}
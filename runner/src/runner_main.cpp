@@ -1,19 +1,44 @@
 #include <kourt/runner/runner_main.h>
 
+#include <algorithm>
+#include <chrono>
 #include <iostream>
 #include <fstream>
+#include <optional>
+#include <vector>
+#include <sched.h>
 #include <sys/types.h>
 #include <sys/ptrace.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <climits>
+#include <csignal>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <nlohmann/json.hpp>
 
 #include <kourt/runner/logging.h>
+#include <kourt/runner/cgroup.h>
 #include <kourt/runner/config.h>
+#include <kourt/runner/daemon.h>
+#include <kourt/runner/digest.h>
+#include <kourt/runner/fork_server.h>
+#include <kourt/runner/generator.h>
+#include <kourt/runner/instruction_counter.h>
+#include <kourt/runner/interactor.h>
 #include <kourt/runner/interceptors.h>
+#include <kourt/runner/memory_file.h>
+#include <kourt/runner/metrics.h>
+#include <kourt/runner/repeated_runs.h>
+#include <kourt/runner/reproducible_timing.h>
+#include <kourt/runner/results.h>
+#include <kourt/runner/sandbox.h>
+#include <kourt/runner/spawn.h>
+#include <kourt/runner/syscall_filter.h>
+#include <kourt/runner/system.h>
 #include <kourt/runner/tracee_controller.h>
 
 const char *kDefaultStdoutFile = "stdout.txt";
@@ -23,24 +48,43 @@ const char *kDefaultExitStatusFile = "exit-status.json";
 const char *kStdoutFileKey = "stdoutFile";
 const char *kStderrFileKey = "stderrFile";
 const char *kExitStatusFileKey = "exitStatusFile";
+const char *kCgroupKey = "cgroup";
+const char *kSandboxKey = "sandbox";
+const char *kStdinFileKey = "stdinFile";
+const char *kWorkingDirectoryKey = "workingDirectory";
+const char *kCpuAffinityKey = "cpuAffinity";
+const char *kMetricsFileKey = "metricsFile";
+const char *kExecutableInMemoryKey = "executableInMemory";
+const char *kOutputsInMemoryKey = "outputsInMemory";
+const char *kInteractorKey = "interactor";
+const char *kResultFormatKey = "resultFormat";
+const char *kResultIdKey = "resultId";
+const char *kOutputDigestsKey = "outputDigests";
+const char *kSyscallFilterKey = "syscallFilter";
+const char *kTraceAllSyscallsKey = "traceAllSyscalls";
+const char *kForkServerKey = "forkServer";
+const char *kInstructionLimitKey = "instructionLimit";
+const char *kReproducibleTimingKey = "reproducibleTiming";
+const char *kRepeatKey = "repeat";
+const char *kGeneratorKey = "generator";
 
-static void PipeStdoutAndStderrToFiles(const nlohmann::json &config) {
+static const char *kDumpResultsFlag = "--dump-results";
+
+static const char *kSnapshotSyscallKey = "snapshotSyscall";
+static const char *kTestsKey = "tests";
+
+static void PipeStdoutAndStderrToFiles(const std::string &stdout_file_name, const std::string &stderr_file_name) {
   // TODO: handle syscall errors
-  std::string stdou_file_name = config.value(kStdoutFileKey, kDefaultStdoutFile);
-  int stdout_file = creat(stdou_file_name.c_str(), 0644);
+  int stdout_file = creat(stdout_file_name.c_str(), 0644);
   dup2(stdout_file, 1);
   close(stdout_file);
 
-  std::string stderr_file_name = config.value(kStderrFileKey, kDefaultStderrFile);
   int stderr_file = creat(stderr_file_name.c_str(), 0644);
   dup2(stderr_file, 2);
   close(stderr_file);
 }
 
-static void PrintExitStatus(int exit_status, const nlohmann::json &config) {
-  std::string out_file_name = config.value(kExitStatusFileKey, kDefaultExitStatusFile);
-  std::ofstream out(out_file_name, std::ofstream::out | std::ofstream::trunc);
-
+nlohmann::json ExitStatusToJson(int exit_status) {
   nlohmann::json json;
   if (WIFEXITED(exit_status)) {
     json["exitCode"] = WEXITSTATUS(exit_status);
@@ -49,38 +93,551 @@ static void PrintExitStatus(int exit_status, const nlohmann::json &config) {
   } else {
     std::cerr << "Unexpected child exit status: " << exit_status << std::endl;
   }
-  out << json;
+  return json;
+}
+
+static void CountVerdict(int exit_status) {
+  if (WIFEXITED(exit_status)) {
+    IncrementCounter(WEXITSTATUS(exit_status) ? Counter::kVerdictsExitedNonZero : Counter::kVerdictsExitedZero);
+  } else if (WIFSIGNALED(exit_status)) {
+    IncrementCounter(Counter::kVerdictsSignaled);
+  }
+}
+
+static nlohmann::json LimitsHit(const nlohmann::json &cgroup_statistics) {
+  nlohmann::json limits_hit = nlohmann::json::array();
+  if (cgroup_statistics.value("oomKills", 0) > 0) {
+    limits_hit.push_back("memory");
+  }
+  if (cgroup_statistics.value("pidsMaxEvents", 0) > 0) {
+    limits_hit.push_back("pids");
+  }
+  return limits_hit;
+}
+
+static std::string Verdict(int exit_status, const nlohmann::json &limits_hit) {
+  if (std::find(limits_hit.begin(), limits_hit.end(), "memory") != limits_hit.end()) {
+    return "memoryLimitExceeded";
+  }
+  if (std::find(limits_hit.begin(), limits_hit.end(), "instructions") != limits_hit.end()) {
+    return "instructionLimitExceeded";
+  }
+  if (WIFSIGNALED(exit_status)) {
+    return "killedBySignal";
+  }
+  return WEXITSTATUS(exit_status) ? "nonZeroExitCode" : "ok";
+}
+
+static long long ToMicros(const timeval &time) {
+  return time.tv_sec * 1'000'000LL + time.tv_usec;
+}
+
+static nlohmann::json ResourceUsageToJson(const rusage &usage, std::chrono::nanoseconds wall_time) {
+  return {
+      {"userMicros", ToMicros(usage.ru_utime)},
+      {"systemMicros", ToMicros(usage.ru_stime)},
+      {"maxRssKiB", usage.ru_maxrss},
+      {"wallMicros", std::chrono::duration_cast<std::chrono::microseconds>(wall_time).count()},
+  };
+}
+
+/// @return path of a file the tracee refers to relative to its working directory, absolute unless both are relative
+static std::string ResolveInWorkingDirectory(const std::string &file_name, const std::string &working_directory) {
+  return (working_directory.empty() || file_name.rfind('/', 0) == 0)
+      ? file_name
+      : working_directory + "/" + file_name;
+}
+
+/// @return digest of an output kept in <code>memory_file</code> or written to <code>file_name</code>, or null if
+///         the output file is missing
+static nlohmann::json DigestOutput(const MemoryFile *memory_file,
+                                   const std::string &file_name,
+                                   const std::string &working_directory) {
+  if (memory_file) {
+    return DigestFile(memory_file->Fd());
+  }
+  const std::string path = ResolveInWorkingDirectory(file_name, working_directory);
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return nullptr;
+  }
+  std::string digest = DigestFile(fd);
+  close(fd);
+  return digest;
 }
 
-static void InitInterceptors(Tracee &tracee,
-                             const nlohmann::json &config,
+void PrintExitStatus(const nlohmann::json &exit_status, const nlohmann::json &config) {
+  WriteResult(exit_status,
+              ParseResultFormat(config.value(kResultFormatKey, "json")),
+              config.value(kExitStatusFileKey, kDefaultExitStatusFile));
+}
+
+/// Persists an in-memory output to the file configured by <code>file_key</code>, or inlines it into the exit status.
+static void CollectOutput(const MemoryFile &output,
+                          const nlohmann::json &config,
+                          const char *file_key,
+                          const char *exit_status_key,
+                          nlohmann::json *exit_status) {
+  if (config.contains(file_key)) {
+    output.PersistTo(config[file_key]);
+  } else {
+    (*exit_status)[exit_status_key] = output.ReadAll();
+  }
+}
+
+static void InitInterceptors(const nlohmann::json &config,
                              std::vector<std::unique_ptr<StoppedTraceeInterceptor>> *result) {
   auto interceptors = config.value("interceptors", nlohmann::json::array());
   for (auto &interceptor : interceptors) {
-    result->push_back(std::move(CreateInterceptor(interceptor["name"], tracee)));
+    result->push_back(std::move(CreateInterceptor(interceptor)));
+  }
+}
+
+/// Makes the child stop on the syscalls selected by the filter only, if there is one.
+static void InstallSyscallFilterInChild(const SyscallFilter *syscall_filter) {
+  if (syscall_filter && !syscall_filter->InstallInChild()) {
+    perror("seccomp");
+    _exit(1);
   }
 }
 
-void LaunchRunner(const nlohmann::json &config, const char *path_to_executable, char *const *executable_argv) {
-  pid_t child_pid = fork();
+/// @return absolute path of an existing file the tracee refers to
+static std::string RealPath(const std::string &file_name, const std::string &working_directory) {
+  const std::string path = ResolveInWorkingDirectory(file_name, working_directory);
+  char real_path[PATH_MAX];
+  if (!realpath(path.c_str(), real_path)) {
+    int error_code = errno;
+    throw std::runtime_error("Failed to open " + path + ": " + strerror(error_code));
+  }
+  return real_path;
+}
+
+/**
+ * Runs each test of the <code>forkServer</code> config in a process forked off the solution held at the snapshot
+ * syscall, or launches the solution for each test anew if it terminates before the snapshot.
+ *
+ * @param cgroup the cgroup of the solution, shared by the tests: a test hits its limits if their events are counted
+ *               while the test runs
+ * @param startup_output what the solution has written to its stdout, it is prepended to the output of each test
+ * @return exit status with the results of the tests
+ */
+static nlohmann::json ServeTests(const nlohmann::json &config,
+                                 Tracee &tracee,
+                                 Cgroup *cgroup,
+                                 std::vector<std::unique_ptr<StoppedTraceeInterceptor>> &&interceptors,
+                                 bool syscalls_filtered,
+                                 unsigned long snapshot_syscall,
+                                 const MemoryFile &startup_output,
+                                 const char *path_to_executable,
+                                 char *const *executable_argv) {
+  const auto startup_started = std::chrono::steady_clock::now();
+  const nlohmann::json &tests = config[kForkServerKey].at(kTestsKey);
+  const std::string working_directory = config.value(kWorkingDirectoryKey, "");
+  TraceeController server_controller(tracee, std::move(interceptors), syscalls_filtered);
+  std::optional<int> server_status = server_controller.ExecuteTraceeUntil([&](BeforeSyscallStoppedTracee &stop) {
+    // a read is a snapshot point only if it reads stdin
+    return stop.SyscallNumber() == snapshot_syscall && (snapshot_syscall != __NR_read || stop.Arg1() == 0);
+  });
+  std::unique_ptr<ForkServer> fork_server;
+  if (!server_status) {
+    try {
+      fork_server = std::make_unique<ForkServer>(tracee);
+    } catch (std::runtime_error &exc) {
+      WARN("Failed to start fork server, launching the solution for each test: %s", exc.what())
+      tracee.Kill(SIGKILL);
+      while (WIFSTOPPED(tracee.Wait())) {
+        tracee.Ptrace(PTRACE_CONT, nullptr, nullptr);
+      }
+    }
+  }
+  nlohmann::json exit_status = {
+      {kForkServerKey, {
+          {"snapshot", fork_server != nullptr},
+          {"startupMicros", std::chrono::duration_cast<std::chrono::microseconds>(
+              std::chrono::steady_clock::now() - startup_started).count()},
+      }},
+      {kTestsKey, nlohmann::json::array()},
+  };
+
+  const std::string startup_stdout = startup_output.ReadAll();
+  for (const auto &test : tests) {
+    if (!fork_server) {
+      nlohmann::json test_config = config;
+      test_config.erase(kForkServerKey);
+      test_config[kStdinFileKey] = test.at(kStdinFileKey);
+      test_config[kStdoutFileKey] = test.at(kStdoutFileKey);
+      exit_status[kTestsKey].push_back(LaunchRunner(test_config, path_to_executable, executable_argv, -1));
+      continue;
+    }
+    const auto test_started = std::chrono::steady_clock::now();
+    const nlohmann::json cgroup_statistics_before = cgroup ? cgroup->CollectStatistics() : nlohmann::json();
+    const std::string stdout_file = ResolveInWorkingDirectory(test.at(kStdoutFileKey), working_directory);
+    std::ofstream(stdout_file, std::ios::binary | std::ios::trunc) << startup_stdout;
+    pid_t pid = fork_server->Fork(RealPath(test.at(kStdinFileKey), working_directory),
+                                  RealPath(stdout_file, ""));
+    Tracee process(pid);
+    std::vector<std::unique_ptr<StoppedTraceeInterceptor>> test_interceptors;
+    InitInterceptors(config, &test_interceptors);
+    std::unique_ptr<InstructionCounter> instruction_counter = CreateInstructionCounterIfConfigured(config);
+    TraceeController controller(process, std::move(test_interceptors), syscalls_filtered, instruction_counter.get());
+    int status = controller.ResumeTracee();
+    fork_server->Reap(pid);
+
+    CountVerdict(status);
+    nlohmann::json test_status = ExitStatusToJson(status);
+    test_status["resourceUsage"] =
+        ResourceUsageToJson(process.ResourceUsage(), std::chrono::steady_clock::now() - test_started);
+    controller.FinishInterceptors(working_directory);
+    test_status["interceptors"] = controller.CollectInterceptorStatistics();
+    test_status["limitsHit"] = nlohmann::json::array();
+    if (cgroup) {
+      const nlohmann::json cgroup_statistics = cgroup->CollectStatistics();
+      nlohmann::json test_events = nlohmann::json::object();
+      for (const char *events : {"oomKills", "pidsMaxEvents"}) {
+        test_events[events] = cgroup_statistics.value(events, 0) - cgroup_statistics_before.value(events, 0);
+      }
+      test_status["limitsHit"] = LimitsHit(test_events);
+    }
+    if (instruction_counter) {
+      test_status["instructions"] = instruction_counter->CollectStatistics();
+      if (instruction_counter->LimitExceeded()) {
+        test_status["limitsHit"].push_back("instructions");
+      }
+    }
+    test_status["verdict"] = Verdict(status, test_status["limitsHit"]);
+    exit_status[kTestsKey].push_back(test_status);
+  }
+  return exit_status;
+}
+
+nlohmann::json LaunchRunner(const nlohmann::json &config,
+                            const char *path_to_executable,
+                            char *const *executable_argv,
+                            int stdin_fd) {
+  if (config.contains(kRepeatKey)) {
+    return LaunchRepeatedly(config, path_to_executable, executable_argv, stdin_fd);
+  }
+  const auto launch_started = std::chrono::steady_clock::now();
+  IncrementCounter(Counter::kLaunches);
+  // Everything the child needs is prepared before spawning it: the child should not allocate memory.
+  const std::string stdout_file_name = config.value(kStdoutFileKey, kDefaultStdoutFile);
+  const std::string stderr_file_name = config.value(kStderrFileKey, kDefaultStderrFile);
+  const std::string working_directory = config.value(kWorkingDirectoryKey, "");
+  std::unique_ptr<Cgroup> cgroup = CreateCgroupIfConfigured(config);
+  std::unique_ptr<Sandbox> sandbox = CreateSandboxIfConfigured(config);
+  std::unique_ptr<Interactor> interactor = CreateInteractorIfConfigured(config);
+  std::unique_ptr<Generator> generator = CreateGeneratorIfConfigured(config);
+  if (generator && (interactor || config.contains(kStdinFileKey) || stdin_fd >= 0)) {
+    throw std::invalid_argument("Generator can't be combined with an interactor or another stdin");
+  }
+  if (interactor && (config.contains(kStdinFileKey) || stdin_fd >= 0)) {
+    throw std::invalid_argument("Interactor can't be combined with another stdin");
+  }
+  std::unique_ptr<ReproducibleTiming> reproducible_timing = CreateReproducibleTimingIfConfigured(config);
+  char *const *environment = reproducible_timing ? reproducible_timing->Environment() : environ;
+  std::unique_ptr<InstructionCounter> instruction_counter;
+  if (!config.contains(kForkServerKey)) {
+    // a fork server counts the instructions of each test separately
+    instruction_counter = CreateInstructionCounterIfConfigured(config);
+  }
+  std::vector<std::unique_ptr<StoppedTraceeInterceptor>> interceptors;
+  InitInterceptors(config, &interceptors);
+  // e.g. for the debug log of every syscall the solution makes
+  const bool trace_all_syscalls = config.value(kTraceAllSyscallsKey, false);
+  std::optional<std::vector<unsigned long>> filtered_syscalls;
+  if (!trace_all_syscalls) {
+    filtered_syscalls = TraceeController::FilteredSyscalls(interceptors);
+    // The filter is inherited by the processes the tracee forks, which aren't traced, so the kernel would fail the
+    // selected syscalls for them: it is installed on request only, for solutions known to run a single process.
+    if (filtered_syscalls && !filtered_syscalls->empty() && !config.value(kSyscallFilterKey, false)) {
+      filtered_syscalls.reset();
+    }
+  }
+  std::unique_ptr<SyscallFilter> syscall_filter;
+  if (filtered_syscalls && !filtered_syscalls->empty()) {
+    syscall_filter = std::make_unique<SyscallFilter>(*filtered_syscalls);
+  }
+  const bool serves_tests = config.contains(kForkServerKey);
+  unsigned long snapshot_syscall = 0;
+  if (serves_tests) {
+    if (sandbox || interactor || generator) {
+      throw std::invalid_argument("Fork server can't be combined with a sandbox, an interactor or a generator");
+    }
+    // the tests write their outputs to the files of their own
+    if (config.value(kOutputsInMemoryKey, false) || config.value(kOutputDigestsKey, false)) {
+      throw std::invalid_argument("Fork server can't be combined with outputsInMemory or outputDigests");
+    }
+    const std::string snapshot_syscall_name = config[kForkServerKey].value(kSnapshotSyscallKey, "read");
+    const SyscallDescriptor *descriptor = FindSyscallDescriptorByName(snapshot_syscall_name);
+    if (!descriptor) {
+      throw std::invalid_argument("Unknown snapshot syscall: '" + snapshot_syscall_name + "'");
+    }
+    snapshot_syscall = descriptor->number;
+    // the solution has to stop on the snapshot syscall
+    if (filtered_syscalls
+        && std::find(filtered_syscalls->begin(), filtered_syscalls->end(), snapshot_syscall)
+            == filtered_syscalls->end()) {
+      filtered_syscalls->push_back(snapshot_syscall);
+      syscall_filter = filtered_syscalls->size() <= SyscallFilter::kMaxSyscalls
+          ? std::make_unique<SyscallFilter>(*filtered_syscalls)
+          : nullptr;
+      if (!syscall_filter) {
+        filtered_syscalls.reset();
+      }
+    }
+  }
+  // With nothing to intercept the solution runs at native speed, the runner only waits for it. A sandboxed one is
+  // not a child of the runner and has to be seized anyway, it is then resumed past every syscall. The instruction
+  // counter is attached at the exec stop and its overflow is handled at a signal-delivery-stop, as are the samples of
+  // an interceptor stopping on no syscalls.
+  const bool traced = sandbox || instruction_counter || !interceptors.empty() || serves_tests || trace_all_syscalls;
+  cpu_set_t cpu_affinity;
+  CPU_ZERO(&cpu_affinity);
+  for (int cpu : config.value(kCpuAffinityKey, std::vector<int>())) {
+    CPU_SET(cpu, &cpu_affinity);
+  }
+
+  std::shared_ptr<const MemoryFile> executable_image;
+  if (config.value(kExecutableInMemoryKey, false)) {
+    executable_image = LoadExecutableIntoMemory(path_to_executable);
+  }
+  std::unique_ptr<MemoryFile> stdout_memory_file;
+  std::unique_ptr<MemoryFile> stderr_memory_file;
+  if (config.value(kOutputsInMemoryKey, false)) {
+    stdout_memory_file = std::make_unique<MemoryFile>("kourt-stdout");
+    stderr_memory_file = std::make_unique<MemoryFile>("kourt-stderr");
+  }
+
+  int stdout_fd = -1;
+  if (interactor) {
+    interactor->Start();
+    stdin_fd = interactor->TraceeStdinFd();
+    stdout_fd = interactor->TraceeStdoutFd();
+  }
+  if (generator) {
+    generator->Start();
+    stdin_fd = generator->TraceeStdinFd();
+  }
+  // what a fork server writes before the snapshot belongs to the output of every test
+  std::unique_ptr<MemoryFile> startup_output;
+  if (serves_tests) {
+    startup_output = std::make_unique<MemoryFile>("kourt-startup-stdout");
+    stdout_fd = startup_output->Fd();
+  }
+
+  int stdin_file = -1;
+  if (stdin_fd < 0 && config.contains(kStdinFileKey)) {
+    const std::string stdin_file_name = config[kStdinFileKey];
+    stdin_file = open(stdin_file_name.c_str(), O_RDONLY | O_CLOEXEC);
+    if (stdin_file < 0) {
+      int error_code = errno;
+      throw std::runtime_error("Failed to open " + stdin_file_name + ": " + strerror(error_code));
+    }
+    stdin_fd = stdin_file;
+  }
+  if (stdin_fd < 0 && serves_tests) {
+    stdin_file = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    stdin_fd = stdin_file;
+  }
+
+  SpawnOptions spawn_options;
+  if (cgroup) {
+    spawn_options.cgroup_fd = cgroup->DirectoryFd();
+  }
+  if (sandbox) {
+    spawn_options.namespace_flags = Sandbox::kNamespaceFlags;
+  }
+  const auto spawn_started = std::chrono::steady_clock::now();
+  pid_t child_pid = SpawnProcess(spawn_options);
   if (0 == child_pid) {
     // child
-    PipeStdoutAndStderrToFiles(config);
-    ptrace(PTRACE_TRACEME, 0, NULL, NULL);
-    execv(path_to_executable, executable_argv);
-    perror("execv");
-    exit(1);
-  } else if (child_pid > 0) {
-    // parent
-    Tracee tracee(child_pid);
-    std::vector<std::unique_ptr<StoppedTraceeInterceptor>> interceptors;
-    InitInterceptors(tracee, config, &interceptors);
-    TraceeController controller(tracee, std::move(interceptors));
-    int child_status = controller.ExecuteTracee();
-    PrintExitStatus(child_status, config);
+    ResetSignalMaskInChild();
+    if (CPU_COUNT(&cpu_affinity) > 0 && 0 != sched_setaffinity(0, sizeof(cpu_affinity), &cpu_affinity)) {
+      perror("sched_setaffinity");
+      _exit(1);
+    }
+    if (reproducible_timing && !reproducible_timing->ApplyInChild()) {
+      perror("reproducibleTiming");
+      _exit(1);
+    }
+    if (!working_directory.empty() && 0 != chdir(working_directory.c_str())) {
+      perror("chdir");
+      _exit(1);
+    }
+    if (stdin_fd >= 0) {
+      dup2(stdin_fd, 0);
+    }
+    if (stdout_memory_file) {
+      dup2(stdout_memory_file->Fd(), 1);
+      dup2(stderr_memory_file->Fd(), 2);
+    } else {
+      PipeStdoutAndStderrToFiles(stdout_file_name, stderr_file_name);
+    }
+    if (stdout_fd >= 0) {
+      dup2(stdout_fd, 1);
+    }
+    if (sandbox) {
+      // the executable path is meaningless after the sandbox root is pivoted, so the binary is opened beforehand.
+      int executable_fd = executable_image
+          ? executable_image->Fd()
+          : open(path_to_executable, O_RDONLY | O_CLOEXEC);
+      if (executable_fd < 0) {
+        perror("open executable");
+        _exit(1);
+      }
+      sandbox->EnterInChild();
+      sandbox->ReleaseTracee();
+      InstallSyscallFilterInChild(syscall_filter.get());
+      fexecve(executable_fd, executable_argv, environment);
+      perror("fexecve");
+      _exit(1);
+    }
+    if (traced) {
+      ptrace(PTRACE_TRACEME, 0, NULL, NULL);
+      if (syscall_filter) {
+        // the runner sets PTRACE_O_TRACESECCOMP at this stop, so that the filter may select execve as well
+        raise(SIGSTOP);
+      }
+      InstallSyscallFilterInChild(syscall_filter.get());
+    }
+    if (executable_image) {
+      fexecve(executable_image->Fd(), executable_argv, environment);
+      perror("fexecve");
+      _exit(1);
+    }
+    execve(path_to_executable, executable_argv, environment);
+    perror("execve");
+    _exit(1);
   } else {
-    int error_code = errno;
-    throw std::runtime_error(std::string("Failed to fork due to error") + strerror(error_code));
+    // parent
+    if (stdin_file >= 0) {
+      close(stdin_file);
+    }
+    if (interactor) {
+      interactor->CloseTraceeEnds();
+    }
+    if (generator) {
+      generator->CloseTraceeEnd();
+    }
+    const long seize_options = PTRACE_O_TRACEEXEC | PTRACE_O_EXITKILL
+        | (syscall_filter ? PTRACE_O_TRACESECCOMP : 0);
+    pid_t tracee_pid = sandbox
+        ? sandbox->AttachToTracee(child_pid, seize_options, spawn_started)
+        : child_pid;
+    Tracee tracee(tracee_pid, sandbox ? seize_options : 0);
+    if (syscall_filter && !sandbox) {
+      if (!WIFSTOPPED(tracee.Wait())) {
+        throw std::runtime_error("Tracee has terminated before installing the syscall filter");
+      }
+      tracee.SetOptions(PTRACE_O_TRACESECCOMP | PTRACE_O_EXITKILL);
+      // the SIGSTOP is suppressed
+      tracee.Ptrace(PTRACE_CONT, nullptr, nullptr);
+    }
+    if (serves_tests) {
+      nlohmann::json exit_status = ServeTests(config,
+                                              tracee,
+                                              cgroup.get(),
+                                              std::move(interceptors),
+                                              filtered_syscalls.has_value(),
+                                              snapshot_syscall,
+                                              *startup_output,
+                                              path_to_executable,
+                                              executable_argv);
+      exit_status["schemaVersion"] = kResultSchemaVersion;
+      if (config.contains(kResultIdKey)) {
+        exit_status["id"] = config[kResultIdKey];
+      }
+      exit_status["limitsHit"] = nlohmann::json::array();
+      if (cgroup) {
+        exit_status[kCgroupKey] = cgroup->CollectStatistics();
+        exit_status["limitsHit"] = LimitsHit(exit_status[kCgroupKey]);
+      }
+      if (reproducible_timing) {
+        exit_status[kReproducibleTimingKey] = reproducible_timing->CollectStatistics();
+      }
+      exit_status["verdict"] = "ok";
+      for (const auto &test_status : exit_status[kTestsKey]) {
+        if (test_status["verdict"] != "ok") {
+          exit_status["verdict"] = test_status["verdict"];
+          break;
+        }
+      }
+      const auto &limits_hit = exit_status["limitsHit"];
+      if (std::find(limits_hit.begin(), limits_hit.end(), "memory") != limits_hit.end()) {
+        exit_status["verdict"] = "memoryLimitExceeded";
+      }
+      ObserveHistogram(Histogram::kLaunchDuration, std::chrono::steady_clock::now() - launch_started);
+      return exit_status;
+    }
+    int child_status;
+    nlohmann::json interceptor_statistics = nlohmann::json::array();
+    if (traced) {
+      TraceeController controller(tracee,
+                                  std::move(interceptors),
+                                  filtered_syscalls.has_value(),
+                                  instruction_counter.get());
+      child_status = controller.ExecuteTracee();
+      controller.FinishInterceptors(config.value(kWorkingDirectoryKey, ""));
+      interceptor_statistics = controller.CollectInterceptorStatistics();
+    } else {
+      child_status = tracee.Wait();
+    }
+
+    CountVerdict(child_status);
+    nlohmann::json exit_status = ExitStatusToJson(child_status);
+    exit_status["schemaVersion"] = kResultSchemaVersion;
+    if (config.contains(kResultIdKey)) {
+      exit_status["id"] = config[kResultIdKey];
+    }
+    exit_status["resourceUsage"] =
+        ResourceUsageToJson(tracee.ResourceUsage(), std::chrono::steady_clock::now() - launch_started);
+    exit_status["interceptors"] = interceptor_statistics;
+    exit_status["limitsHit"] = nlohmann::json::array();
+    if (cgroup) {
+      exit_status[kCgroupKey] = cgroup->CollectStatistics();
+      exit_status["limitsHit"] = LimitsHit(exit_status[kCgroupKey]);
+    }
+    if (instruction_counter) {
+      exit_status["instructions"] = instruction_counter->CollectStatistics();
+      if (instruction_counter->LimitExceeded()) {
+        exit_status["limitsHit"].push_back("instructions");
+      }
+    }
+    exit_status["verdict"] = Verdict(child_status, exit_status["limitsHit"]);
+    if (reproducible_timing) {
+      exit_status[kReproducibleTimingKey] = reproducible_timing->CollectStatistics();
+    }
+    if (sandbox) {
+      sandbox->ReapInit();
+      exit_status[kSandboxKey] = sandbox->CollectStatistics();
+    }
+    if (interactor) {
+      // after the sandbox init is reaped: it is the last process which may hold the tracee's ends of the pipes
+      exit_status[kInteractorKey] = interactor->Finish();
+      // the tracee's own failure comes first: the interactor usually fails as a consequence of it
+      if (interactor->Failed() && exit_status["verdict"] == "ok") {
+        exit_status["verdict"] = "interactorFailed";
+      }
+    }
+    if (generator) {
+      // after the sandbox init is reaped as well, the tracee's stdin is closed by then
+      exit_status[kGeneratorKey] = generator->Finish();
+      if (generator->Failed()) {
+        exit_status["verdict"] = "generatorFailed";
+      }
+    }
+    if (config.value(kOutputDigestsKey, false)) {
+      exit_status["outputDigests"] = {
+          {"stdout", DigestOutput(stdout_memory_file.get(), stdout_file_name, working_directory)},
+          {"stderr", DigestOutput(stderr_memory_file.get(), stderr_file_name, working_directory)},
+      };
+    }
+    if (stdout_memory_file) {
+      CollectOutput(*stdout_memory_file, config, kStdoutFileKey, "stdout", &exit_status);
+      CollectOutput(*stderr_memory_file, config, kStderrFileKey, "stderr", &exit_status);
+    }
+    ObserveHistogram(Histogram::kLaunchDuration, std::chrono::steady_clock::now() - launch_started);
+    return exit_status;
   }
 }
 
@@ -99,7 +656,10 @@ void ParseConfigAndLaunchRunner(const char *path_to_config,
     }
   }
 
-  LaunchRunner(config, path_to_executable, executable_argv);
+  PrintExitStatus(LaunchRunner(config, path_to_executable, executable_argv), config);
+  if (config.contains(kMetricsFileKey)) {
+    WriteMetricsFile(config[kMetricsFileKey]);
+  }
 }
 
 int RunnerMain(int argc, char *const *argv) {
@@ -107,8 +667,27 @@ int RunnerMain(int argc, char *const *argv) {
   // argv[2] --- executable to run
   // argv[3]..argv[argc-1] --- cmd arguments to the executable
   // argv[argc] --- NULL according to paragraph 5.1.2.2.1 of the C language Standard
+  //
+  // or, in daemon mode:
+  // argv[1] --- "--daemon"
+  // argv[2] --- path to the Unix domain socket to listen on
+  // argv[3] --- optional path to the daemon config file
+  //
+  // or, to print results of any format (see results.h) as newline-delimited JSON:
+  // argv[1] --- "--dump-results"
+  // argv[2] --- path to the result file
 
   try {
+    if (argc >= 3 && 0 == strcmp(argv[1], kDaemonFlag)) {
+      return DaemonMain(argv[2], argc > 3 ? argv[3] : nullptr);
+    }
+    if (argc >= 3 && 0 == strcmp(argv[1], kDumpResultsFlag)) {
+      ResultReader reader(argv[2]);
+      while (auto result = reader.Next()) {
+        std::cout << result->dump(-1, ' ', false, nlohmann::json::error_handler_t::replace) << '\n';
+      }
+      return 0;
+    }
     if (argc < 3) {
       throw std::invalid_argument("At least three arguments should be passed to runner.");
     }
@@ -116,6 +695,7 @@ int RunnerMain(int argc, char *const *argv) {
     ParseConfigAndLaunchRunner(argv[1], argv[2], argv + 2);
     return 0;
   } catch (std::exception &e) {
+    IncrementCounter(Counter::kLaunchFailures);
     ERROR("Uncaught exception: %s", e.what());
   } catch (...) {
     ERROR("Something non-assignable to std::exception& was thrown during runner execution.");
@@ -0,0 +1,392 @@
+#include <kourt/runner/sampling_profiler_interceptor.h>
+#include <kourt/runner/tracing.h>
+
+#include <elf.h>
+#include <fcntl.h>
+#include <linux/perf_event.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <cxxabi.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include <kourt/runner/logging.h>
+#include <kourt/runner/system.h>
+
+static const char *kFrequencyHzKey = "frequencyHz";
+static const char *kMaxFramesKey = "maxFrames";
+static const char *kFoldedStacksFileKey = "foldedStacksFile";
+static const char *kTopFunctionsKey = "topFunctions";
+
+static const char *kDefaultFoldedStacksFile = "profile.folded";
+// Stack frames within this distance from the stack pointer are read at once, deeper ones a frame at a time.
+static const size_t kStackSnapshotBytes = 16 << 10;
+static const char *kDeletedSuffix = " (deleted)";
+
+static std::string Demangle(const char *name) {
+  int status = 0;
+  char *demangled = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+  if (status != 0 || !demangled) {
+    return name;
+  }
+  std::string result(demangled);
+  free(demangled);
+  return result;
+}
+
+/**
+ * Reads the function symbols of an ELF image: the full symbol table if the file isn't stripped, the dynamic one
+ * otherwise.
+ *
+ * @return whether the image is a well-formed ELF file of this class
+ */
+template<typename Ehdr, typename Phdr, typename Shdr, typename Sym>
+static bool ReadElfSymbols(const char *image, size_t size, unsigned long page_size,
+                           std::vector<std::pair<unsigned long, unsigned long>> *ranges,
+                           std::vector<std::string> *names, unsigned long *first_segment_address) {
+  auto in_bounds = [size](uint64_t offset, uint64_t length) { return offset <= size && length <= size - offset; };
+  const auto *header = reinterpret_cast<const Ehdr *>(image);
+  if (!in_bounds(header->e_phoff, uint64_t{header->e_phnum} * sizeof(Phdr))
+      || !in_bounds(header->e_shoff, uint64_t{header->e_shnum} * sizeof(Shdr))) {
+    return false;
+  }
+  const auto *segments = reinterpret_cast<const Phdr *>(image + header->e_phoff);
+  *first_segment_address = ULONG_MAX;
+  for (int i = 0; i < header->e_phnum; ++i) {
+    if (segments[i].p_type == PT_LOAD) {
+      *first_segment_address = std::min<unsigned long>(*first_segment_address, segments[i].p_vaddr);
+    }
+  }
+  if (*first_segment_address == ULONG_MAX) {
+    return false;
+  }
+  *first_segment_address &= ~(page_size - 1);
+
+  const auto *sections = reinterpret_cast<const Shdr *>(image + header->e_shoff);
+  const Shdr *symbol_table = nullptr;
+  for (int i = 0; i < header->e_shnum; ++i) {
+    if (sections[i].sh_type == SHT_SYMTAB || (sections[i].sh_type == SHT_DYNSYM && !symbol_table)) {
+      symbol_table = &sections[i];
+    }
+  }
+  if (!symbol_table || symbol_table->sh_link >= header->e_shnum
+      || !in_bounds(symbol_table->sh_offset, symbol_table->sh_size)) {
+    return true;
+  }
+  const Shdr &string_table = sections[symbol_table->sh_link];
+  if (!in_bounds(string_table.sh_offset, string_table.sh_size)) {
+    return true;
+  }
+  const auto *symbols = reinterpret_cast<const Sym *>(image + symbol_table->sh_offset);
+  const size_t symbol_count = symbol_table->sh_size / sizeof(Sym);
+  for (size_t i = 0; i < symbol_count; ++i) {
+    const Sym &symbol = symbols[i];
+    // ELF32_ST_TYPE and ELF64_ST_TYPE are the same
+    if (ELF64_ST_TYPE(symbol.st_info) != STT_FUNC || symbol.st_shndx == SHN_UNDEF || symbol.st_value == 0
+        || symbol.st_name >= string_table.sh_size) {
+      continue;
+    }
+    const char *name = image + string_table.sh_offset + symbol.st_name;
+    if (!memchr(name, '\0', string_table.sh_size - symbol.st_name)) {
+      continue;
+    }
+    ranges->emplace_back(symbol.st_value, symbol.st_value + std::max<unsigned long>(symbol.st_size, 1));
+    names->push_back(Demangle(name));
+  }
+  return true;
+}
+
+size_t SamplingProfilerInterceptor::StackHash::operator()(const std::vector<unsigned long> &stack) const {
+  size_t hash = stack.size();
+  for (unsigned long address : stack) {
+    hash ^= std::hash<unsigned long>()(address) + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+  }
+  return hash;
+}
+
+SamplingProfilerInterceptor::SamplingProfilerInterceptor(const nlohmann::json &config) :
+    frequency_hz_(config.value(kFrequencyHzKey, 100L)),
+    max_frames_(config.value(kMaxFramesKey, size_t{64})),
+    folded_stacks_file_(config.value(kFoldedStacksFileKey, kDefaultFoldedStacksFile)),
+    top_functions_(config.value(kTopFunctionsKey, size_t{10})),
+    stack_snapshot_(kStackSnapshotBytes) {
+  if (frequency_hz_ <= 0 || frequency_hz_ > kMaxFrequencyHz) {
+    throw std::invalid_argument("SamplingProfilerInterceptor: 'frequencyHz' should be in [1, "
+                                    + std::to_string(kMaxFrequencyHz) + "]");
+  }
+  if (max_frames_ == 0) {
+    throw std::invalid_argument("SamplingProfilerInterceptor: 'maxFrames' should be positive");
+  }
+}
+
+SamplingProfilerInterceptor::~SamplingProfilerInterceptor() {
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+}
+
+std::optional<std::vector<unsigned long>> SamplingProfilerInterceptor::InterceptedSyscalls() const {
+  return std::vector<unsigned long>{};
+}
+
+void SamplingProfilerInterceptor::OnExec(Tracee &tracee) {
+  perf_event_attr attributes{};
+  attributes.size = sizeof(attributes);
+  attributes.type = PERF_TYPE_SOFTWARE;
+  attributes.config = PERF_COUNT_SW_TASK_CLOCK;
+  attributes.sample_period = 1'000'000'000 / frequency_hz_;
+  attributes.wakeup_events = 1;
+  // a sample taken in the kernel is dropped rather than attributed to the syscall's caller
+  attributes.exclude_kernel = 1;
+  attributes.exclude_hv = 1;
+  fd_ = static_cast<int>(syscall(SYS_perf_event_open, &attributes, tracee.Pid(), -1, -1, PERF_FLAG_FD_CLOEXEC));
+  if (fd_ < 0) {
+    throw SystemError("perf_event_open");
+  }
+  f_owner_ex owner{F_OWNER_TID, tracee.Pid()};
+  if (0 != fcntl(fd_, F_SETOWN_EX, &owner)
+      || 0 != fcntl(fd_, F_SETSIG, kSampleSignal)
+      || 0 != fcntl(fd_, F_SETFL, O_ASYNC)) {
+    throw SystemError("fcntl perf event");
+  }
+  char executable_path[PATH_MAX];
+  ssize_t length = readlink(("/proc/" + std::to_string(tracee.Pid()) + "/exe").c_str(),
+                            executable_path, sizeof(executable_path));
+  if (length > 0) {
+    executable_path_.assign(executable_path, length);
+  }
+  RefreshMappings(tracee.Pid());
+}
+
+bool SamplingProfilerInterceptor::Intercept(BeforeSignalDeliveryStoppedTracee &tracee) {
+  if (fd_ < 0 || tracee.SignalNumber() != kSampleSignal) {
+    return false;
+  }
+  const siginfo_t info = tracee.SignalInfo();
+  if (info.si_fd != fd_ || info.si_code <= 0) {
+    // the tracee's own SIGPROF
+    return false;
+  }
+  const auto started = std::chrono::steady_clock::now();
+  Sample(tracee);
+  if (samples_ == 1) {
+    // the libraries are mapped by the time the tracee has run long enough to be sampled
+    RefreshMappings(tracee.Pid());
+  }
+  sampling_time_ += std::chrono::steady_clock::now() - started;
+  tracee.SuppressSignal();
+  return false;
+}
+
+bool SamplingProfilerInterceptor::Intercept(BeforeTerminationStoppedTracee &tracee) {
+  if (fd_ >= 0) {
+    RefreshMappings(tracee.Pid());
+  }
+  return false;
+}
+
+void SamplingProfilerInterceptor::Sample(StoppedTracee &tracee) {
+  const SyscallRegisters registers = tracee.LoadRegisters();
+  std::vector<unsigned long> stack{registers.InstructionPointer()};
+  const size_t word_size = registers.Abi() == SyscallAbi::kX86_64 ? 8 : 4;
+  const unsigned long stack_pointer = registers.StackPointer();
+  const size_t copied = tracee.ReadMemory(stack_pointer, stack_snapshot_.data(), stack_snapshot_.size());
+  auto read_word = [&](unsigned long address, unsigned long *word) {
+    *word = 0;
+    if (address >= stack_pointer && address - stack_pointer + word_size <= copied) {
+      memcpy(word, stack_snapshot_.data() + (address - stack_pointer), word_size);
+      return true;
+    }
+    return tracee.ReadMemory(address, word, word_size) == word_size;
+  };
+  // Each frame keeps the caller's frame pointer and the return address right above it. A frame which doesn't keep
+  // the pointer ends the walk, since the chain then leads elsewhere than up the stack.
+  unsigned long frame_pointer = registers.FramePointer();
+  while (stack.size() < max_frames_ && frame_pointer >= stack_pointer && frame_pointer % word_size == 0) {
+    unsigned long caller_frame_pointer;
+    unsigned long return_address;
+    if (!read_word(frame_pointer, &caller_frame_pointer)
+        || !read_word(frame_pointer + word_size, &return_address)
+        || return_address == 0) {
+      break;
+    }
+    stack.push_back(return_address);
+    if (caller_frame_pointer <= frame_pointer) {
+      break;
+    }
+    frame_pointer = caller_frame_pointer;
+  }
+  ++stacks_[stack];
+  ++samples_;
+}
+
+void SamplingProfilerInterceptor::RefreshMappings(pid_t pid) {
+  std::ifstream maps("/proc/" + std::to_string(pid) + "/maps");
+  if (!maps) {
+    return;
+  }
+  mappings_.clear();
+  // the mapping at the offset 0 comes first for each file, it tells where the file is loaded
+  std::unordered_map<std::string, unsigned long> load_addresses;
+  for (std::string line; std::getline(maps, line);) {
+    unsigned long start;
+    unsigned long end;
+    char permissions[5];
+    unsigned long offset;
+    int path_position = -1;
+    if (sscanf(line.c_str(), "%lx-%lx %4s %lx %*s %*s %n", &start, &end, permissions, &offset, &path_position) < 4
+        || path_position < 0 || line[path_position] != '/') {
+      continue;
+    }
+    const std::string path = line.substr(path_position);
+    if (offset == 0) {
+      load_addresses.emplace(path, start);
+    }
+    auto load_address = load_addresses.find(path);
+    if (permissions[2] != 'x' || load_address == load_addresses.end()) {
+      continue;
+    }
+    const std::string file_to_read = path == executable_path_ ? "/proc/" + std::to_string(pid) + "/exe" : path;
+    const Module *module = LoadModule(path, file_to_read);
+    mappings_.emplace(start, Mapping{end, load_address->second - module->first_segment_address, module});
+  }
+}
+
+const SamplingProfilerInterceptor::Module *SamplingProfilerInterceptor::LoadModule(const std::string &path,
+                                                                                   const std::string &file_to_read) {
+  auto [loaded, inserted] = modules_.try_emplace(path);
+  Module &module = loaded->second;
+  if (!inserted) {
+    return &module;
+  }
+  std::string name = path.substr(path.rfind('/') + 1);
+  if (name.size() > strlen(kDeletedSuffix)
+      && 0 == name.compare(name.size() - strlen(kDeletedSuffix), std::string::npos, kDeletedSuffix)) {
+    name.resize(name.size() - strlen(kDeletedSuffix));
+  }
+  module.name = name;
+
+  int fd = open(file_to_read.c_str(), O_RDONLY | O_CLOEXEC);
+  struct stat file_stat{};
+  if (fd < 0 || 0 != fstat(fd, &file_stat) || static_cast<size_t>(file_stat.st_size) < sizeof(Elf64_Ehdr)) {
+    DEBUG("Can't read symbols of %s", path.c_str())
+    if (fd >= 0) {
+      close(fd);
+    }
+    return &module;
+  }
+  const size_t size = file_stat.st_size;
+  void *image = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (image == MAP_FAILED) {
+    WARN("Failed to map %s: %s", path.c_str(), strerror(errno))
+    return &module;
+  }
+  const char *bytes = static_cast<const char *>(image);
+  std::vector<std::pair<unsigned long, unsigned long>> ranges;
+  std::vector<std::string> names;
+  const unsigned long page_size = sysconf(_SC_PAGESIZE);
+  bool valid = false;
+  if (0 == memcmp(bytes, ELFMAG, SELFMAG)) {
+    valid = bytes[EI_CLASS] == ELFCLASS64
+        ? ReadElfSymbols<Elf64_Ehdr, Elf64_Phdr, Elf64_Shdr, Elf64_Sym>(
+            bytes, size, page_size, &ranges, &names, &module.first_segment_address)
+        : ReadElfSymbols<Elf32_Ehdr, Elf32_Phdr, Elf32_Shdr, Elf32_Sym>(
+            bytes, size, page_size, &ranges, &names, &module.first_segment_address);
+  }
+  munmap(image, size);
+  if (!valid) {
+    DEBUG("%s is not an ELF file", path.c_str())
+    module.first_segment_address = 0;
+    return &module;
+  }
+  for (size_t i = 0; i < ranges.size(); ++i) {
+    module.symbols.push_back({ranges[i].first, ranges[i].second, std::move(names[i])});
+  }
+  // aliases share the address, the longest one is kept
+  std::sort(module.symbols.begin(), module.symbols.end(), [](const Symbol &left, const Symbol &right) {
+    return left.start != right.start ? left.start < right.start : left.end > right.end;
+  });
+  module.symbols.erase(std::unique(module.symbols.begin(), module.symbols.end(),
+                                   [](const Symbol &left, const Symbol &right) { return left.start == right.start; }),
+                       module.symbols.end());
+  DEBUG("Read %zu function symbols of %s", module.symbols.size(), path.c_str())
+  return &module;
+}
+
+std::string SamplingProfilerInterceptor::Symbolize(unsigned long address, bool return_address) const {
+  auto mapping = mappings_.upper_bound(address);
+  if (mapping == mappings_.begin() || address >= (--mapping)->second.end) {
+    return "[unknown]";
+  }
+  const Module &module = *mapping->second.module;
+  // a return address may already belong to the next function if the call is the last instruction of its caller
+  const unsigned long linked_address = address - mapping->second.load_bias - (return_address ? 1 : 0);
+  auto symbol = std::upper_bound(module.symbols.begin(), module.symbols.end(), linked_address,
+                                 [](unsigned long address, const Symbol &symbol) { return address < symbol.start; });
+  if (symbol == module.symbols.begin() || linked_address >= (--symbol)->end) {
+    return "[" + module.name + "]";
+  }
+  return symbol->name;
+}
+
+std::map<std::string, uint64_t> SamplingProfilerInterceptor::FoldStacks() const {
+  // distinct addresses may fold into the same functions
+  std::map<std::string, uint64_t> folded_stacks;
+  for (const auto &[stack, count] : stacks_) {
+    std::string folded;
+    for (size_t i = stack.size(); i-- > 0;) {
+      folded += Symbolize(stack[i], i > 0);
+      if (i > 0) {
+        folded += ';';
+      }
+    }
+    folded_stacks[folded] += count;
+  }
+  return folded_stacks;
+}
+
+void SamplingProfilerInterceptor::OnFinish(const std::string &working_directory) {
+  folded_stacks_file_ = (std::filesystem::path(working_directory) / folded_stacks_file_).string();
+  std::ofstream folded_stacks_file(folded_stacks_file_, std::ios::trunc);
+  for (const auto &[stack, count] : FoldStacks()) {
+    folded_stacks_file << stack << ' ' << count << '\n';
+  }
+  if (!folded_stacks_file) {
+    WARN("Failed to write folded stacks to %s", folded_stacks_file_.c_str())
+  }
+}
+
+nlohmann::json SamplingProfilerInterceptor::CollectStatistics() const {
+  std::unordered_map<std::string, uint64_t> self_samples;
+  for (const auto &[stack, count] : stacks_) {
+    self_samples[Symbolize(stack[0], false)] += count;
+  }
+
+  std::vector<std::pair<std::string, uint64_t>> top(self_samples.begin(), self_samples.end());
+  std::sort(top.begin(), top.end(), [](const auto &left, const auto &right) {
+    return left.second != right.second ? left.second > right.second : left.first < right.first;
+  });
+  top.resize(std::min(top.size(), top_functions_));
+  nlohmann::json top_functions = nlohmann::json::array();
+  for (const auto &[function, samples] : top) {
+    top_functions.push_back({{"function", function}, {"samples", samples}});
+  }
+  return {
+      {"samples", samples_},
+      {"stacks", FoldStacks().size()},
+      {"frequencyHz", frequency_hz_},
+      {"samplingMicros", std::chrono::duration_cast<std::chrono::microseconds>(sampling_time_).count()},
+      {"topFunctions", top_functions},
+      {kFoldedStacksFileKey, folded_stacks_file_},
+  };
+}
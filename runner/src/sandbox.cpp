@@ -0,0 +1,314 @@
+#include <kourt/runner/sandbox.h>
+
+#include <sys/mount.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <csignal>
+#include <cerrno>
+#include <cstring>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <stdexcept>
+
+#include <kourt/runner/config.h>
+#include <kourt/runner/logging.h>
+#include <kourt/runner/tracing.h>
+
+namespace fs = std::filesystem;
+
+static const char *kSandboxRootfsKey = "rootfs";
+static const char *kSandboxCacheDirKey = "cacheDir";
+static const char *kSandboxBindMountsKey = "bindMounts";
+
+static const char *kDefaultSandboxCacheDir = "/tmp/kourt-sandbox";
+static const char *kDefaultBindMounts[] = {"/bin", "/lib", "/lib32", "/lib64", "/usr"};
+static const char *kDevices[] = {"/dev/null", "/dev/zero", "/dev/random", "/dev/urandom"};
+
+static const char kTraceeReady = 'R';
+static const char kTraceeFailed = 'E';
+static const char kTraceeSeized = 'S';
+
+/// Flags which can't be cleared by a bind remount inside a user namespace if the original mount has them.
+static unsigned long LockedMountFlags(const std::string &path) {
+  struct statvfs stat{};
+  if (0 != statvfs(path.c_str(), &stat)) {
+    return 0;
+  }
+  unsigned long flags = 0;
+  if (stat.f_flag & ST_NODEV) flags |= MS_NODEV;
+  if (stat.f_flag & ST_NOEXEC) flags |= MS_NOEXEC;
+  if (stat.f_flag & ST_NOATIME) flags |= MS_NOATIME;
+  if (stat.f_flag & ST_NODIRATIME) flags |= MS_NODIRATIME;
+  if (stat.f_flag & ST_RELATIME) flags |= MS_RELATIME;
+  return flags;
+}
+
+/// Failures are ignored here: without id mappings the subsequent mounts fail and get reported.
+static void WriteWholeFile(const char *path, const std::string &content) {
+  int fd = open(path, O_WRONLY | O_CLOEXEC);
+  if (fd >= 0) {
+    write(fd, content.data(), content.size());
+    close(fd);
+  }
+}
+
+Sandbox::Sandbox(const nlohmann::json &sandbox_config, const std::string &working_directory) {
+  const std::string cache_dir = sandbox_config.value(kSandboxCacheDirKey, kDefaultSandboxCacheDir);
+  std::vector<std::string> bind_paths(std::begin(kDefaultBindMounts), std::end(kDefaultBindMounts));
+  if (sandbox_config.contains(kSandboxBindMountsKey)) {
+    bind_paths = sandbox_config[kSandboxBindMountsKey].get<std::vector<std::string>>();
+  }
+
+  // The rootfs skeleton depends on the set of bind mounts, so each set gets its own cached copy.
+  std::string bind_paths_key;
+  for (auto &path : bind_paths) {
+    bind_paths_key += path + ":";
+  }
+  rootfs_ = sandbox_config.value(
+      kSandboxRootfsKey,
+      cache_dir + "/rootfs-" + std::to_string(std::hash<std::string>()(bind_paths_key)));
+  scratch_ = cache_dir + "/scratch";
+  fs::create_directories(scratch_);
+  if (!fs::exists(rootfs_)) {
+    PrepareRootfs(bind_paths);
+  }
+
+  upper_ = scratch_ + "/upper";
+  work_ = scratch_ + "/work";
+  new_root_ = scratch_ + "/root";
+  new_root_tmp_ = new_root_ + "/tmp";
+  new_root_proc_ = new_root_ + "/proc";
+  new_root_work_ = new_root_ + "/work";
+  overlay_options_ = "lowerdir=" + rootfs_ + ",upperdir=" + upper_ + ",workdir=" + work_;
+  current_directory_ = working_directory.empty() ? fs::current_path().string() : working_directory;
+  uid_map_ = "0 " + std::to_string(getuid()) + " 1\n";
+  gid_map_ = "0 " + std::to_string(getgid()) + " 1\n";
+
+  for (auto &path : bind_paths) {
+    if (fs::is_directory(fs::symlink_status(path))) {
+      unsigned long flags = MS_BIND | MS_REC | MS_RDONLY | MS_NOSUID | LockedMountFlags(path);
+      bind_mounts_.push_back(BindMount{path, new_root_ + path, flags});
+    }
+  }
+  for (auto &device : kDevices) {
+    if (fs::exists(device)) {
+      bind_mounts_.push_back(BindMount{device, new_root_ + device, MS_BIND});
+    }
+  }
+
+  int sockets[2];
+  if (0 != socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sockets)) {
+    int error_code = errno;
+    throw std::runtime_error(std::string("socketpair: ") + strerror(error_code));
+  }
+  parent_socket_ = sockets[0];
+  child_socket_ = sockets[1];
+  int enable = 1;
+  setsockopt(parent_socket_, SOL_SOCKET, SO_PASSCRED, &enable, sizeof(enable));
+}
+
+Sandbox::~Sandbox() {
+  if (init_pid_ > 0) {
+    kill(init_pid_, SIGKILL);
+    ReapInit();
+  }
+  close(parent_socket_);
+  close(child_socket_);
+}
+
+void Sandbox::PrepareRootfs(const std::vector<std::string> &bind_paths) {
+  // The skeleton is built aside and renamed into place, so concurrent runners never see a half-built one.
+  const fs::path rootfs(rootfs_);
+  const fs::path skeleton = rootfs.string() + ".tmp." + std::to_string(getpid());
+  fs::remove_all(skeleton);
+  for (auto &directory : {"proc", "tmp", "work", "dev"}) {
+    fs::create_directories(skeleton / directory);
+  }
+  fs::permissions(skeleton / "tmp", fs::perms::all | fs::perms::sticky_bit);
+  for (auto &path : bind_paths) {
+    const fs::path target = skeleton / fs::path(path).relative_path();
+    auto status = fs::symlink_status(path);
+    if (fs::is_symlink(status)) {
+      fs::create_directories(target.parent_path());
+      fs::create_symlink(fs::read_symlink(path), target);
+    } else if (fs::is_directory(status)) {
+      fs::create_directories(target);
+    }
+  }
+  for (auto &device : kDevices) {
+    std::ofstream(skeleton / fs::path(device).relative_path());
+  }
+
+  std::error_code error;
+  fs::rename(skeleton, rootfs, error);
+  if (error) {
+    fs::remove_all(skeleton);
+    if (!fs::exists(rootfs)) {
+      throw std::runtime_error("Failed to prepare sandbox rootfs " + rootfs_ + ": " + error.message());
+    }
+  }
+  INFO("Prepared sandbox rootfs %s", rootfs_.c_str());
+}
+
+void Sandbox::FailInChild(const char *what) {
+  const char *reason = strerror(errno);
+  char message[512];
+  int length = snprintf(message, sizeof(message), "%c%s: %s", kTraceeFailed, what, reason);
+  if (length > 0) {
+    write(child_socket_, message, std::min<size_t>(length, sizeof(message) - 1));
+  }
+  _exit(1);
+}
+
+void Sandbox::SetUpFilesystem() {
+  WriteWholeFile("/proc/self/setgroups", "deny");
+  WriteWholeFile("/proc/self/uid_map", uid_map_);
+  WriteWholeFile("/proc/self/gid_map", gid_map_);
+
+  if (0 != mount(nullptr, "/", nullptr, MS_REC | MS_PRIVATE, nullptr)) {
+    FailInChild("make mounts private");
+  }
+  if (0 != mount("tmpfs", scratch_.c_str(), "tmpfs", MS_NOSUID | MS_NODEV, "mode=0755")) {
+    FailInChild("mount scratch tmpfs");
+  }
+  if (0 != mkdir(upper_.c_str(), 0755) || 0 != mkdir(work_.c_str(), 0755) || 0 != mkdir(new_root_.c_str(), 0755)) {
+    FailInChild("create overlay directories");
+  }
+  if (0 != mount("overlay", new_root_.c_str(), "overlay", MS_NOSUID, overlay_options_.c_str())) {
+    // Kernels older than 5.11 don't allow overlayfs in user namespaces:
+    // use a read-only rootfs with a writable /tmp instead.
+    if (0 != mount(rootfs_.c_str(), new_root_.c_str(), nullptr, MS_BIND | MS_REC, nullptr)
+        || 0 != mount(nullptr, new_root_.c_str(), nullptr, MS_REMOUNT | MS_BIND | MS_RDONLY | MS_NOSUID, nullptr)
+        || 0 != mount("tmpfs", new_root_tmp_.c_str(), "tmpfs", MS_NOSUID | MS_NODEV, "mode=1777")) {
+      FailInChild("mount rootfs");
+    }
+  }
+  for (auto &bind_mount : bind_mounts_) {
+    if (0 != mount(bind_mount.source.c_str(), bind_mount.target.c_str(), nullptr, MS_BIND | MS_REC, nullptr)) {
+      FailInChild(bind_mount.source.c_str());
+    }
+    if ((bind_mount.flags & MS_RDONLY)
+        && 0 != mount(nullptr, bind_mount.target.c_str(), nullptr, MS_REMOUNT | bind_mount.flags, nullptr)) {
+      FailInChild(bind_mount.target.c_str());
+    }
+  }
+  if (0 != mount(current_directory_.c_str(), new_root_work_.c_str(), nullptr, MS_BIND | MS_REC, nullptr)) {
+    FailInChild("bind working directory");
+  }
+  if (0 != mount("proc", new_root_proc_.c_str(), "proc", MS_NOSUID | MS_NODEV | MS_NOEXEC, nullptr)) {
+    FailInChild("mount proc");
+  }
+  if (0 != chdir(new_root_.c_str())
+      || 0 != syscall(SYS_pivot_root, ".", ".")
+      || 0 != umount2(".", MNT_DETACH)
+      || 0 != chdir("/work")) {
+    FailInChild("pivot_root");
+  }
+}
+
+void Sandbox::EnterInChild() {
+  close(parent_socket_);
+  SetUpFilesystem();
+
+  pid_t tracee_pid = fork();
+  if (tracee_pid < 0) {
+    FailInChild("fork tracee");
+  } else if (tracee_pid > 0) {
+    // namespace init: reap everything until the tracee is gone, then tear the namespace down by exiting.
+    close(child_socket_);
+    // The init must not keep the tracee's stdio open: e.g. an interactor waits for the end of the tracee's output.
+    syscall(SYS_close_range, 0U, ~0U, 0U);
+    for (;;) {
+      pid_t pid = wait(nullptr);
+      if (pid == tracee_pid || (pid < 0 && errno == ECHILD)) {
+        _exit(0);
+      }
+    }
+  }
+
+  // The kernel attaches our pid, translated to the runner's pid namespace, to the message.
+  if (1 != write(child_socket_, &kTraceeReady, 1)) {
+    FailInChild("notify runner");
+  }
+}
+
+void Sandbox::ReleaseTracee() {
+  char reply = 0;
+  if (1 != read(child_socket_, &reply, 1) || reply != kTraceeSeized) {
+    FailInChild("wait for runner");
+  }
+  close(child_socket_);
+}
+
+pid_t Sandbox::AttachToTracee(pid_t init_pid, long ptrace_options,
+                              std::chrono::steady_clock::time_point spawn_started) {
+  init_pid_ = init_pid;
+  close(child_socket_);
+  child_socket_ = -1;
+
+  char message[512];
+  iovec iov{message, sizeof(message) - 1};
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(ucred))];
+  msghdr header{};
+  header.msg_iov = &iov;
+  header.msg_iovlen = 1;
+  header.msg_control = control;
+  header.msg_controllen = sizeof(control);
+  ssize_t received;
+  do {
+    received = recvmsg(parent_socket_, &header, 0);
+  } while (received < 0 && errno == EINTR);
+
+  if (received <= 0) {
+    throw std::runtime_error("Sandbox init exited before the tracee was started");
+  } else if (message[0] != kTraceeReady) {
+    message[received] = '\0';
+    throw std::runtime_error(std::string("Failed to set up sandbox: ") + (message + 1));
+  }
+  cmsghdr *control_message = CMSG_FIRSTHDR(&header);
+  if (!control_message || control_message->cmsg_type != SCM_CREDENTIALS) {
+    throw std::runtime_error("Sandboxed tracee did not pass its credentials");
+  }
+  ucred credentials{};
+  memcpy(&credentials, CMSG_DATA(control_message), sizeof(credentials));
+
+  Tracee tracee(credentials.pid);
+  tracee.Ptrace(PTRACE_SEIZE, nullptr, (void *) ptrace_options);
+  if (1 != write(parent_socket_, &kTraceeSeized, 1)) {
+    int error_code = errno;
+    throw std::runtime_error(std::string("Failed to release sandboxed tracee: ") + strerror(error_code));
+  }
+  setup_time_ = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - spawn_started);
+  DEBUG("Sandboxed tracee %d is ready in %ld us", credentials.pid, (long) setup_time_.count());
+  return credentials.pid;
+}
+
+void Sandbox::ReapInit() {
+  if (init_pid_ <= 0) {
+    return;
+  }
+  while (waitpid(init_pid_, nullptr, 0) < 0 && errno == EINTR) {
+    // retry
+  }
+  init_pid_ = -1;
+}
+
+nlohmann::json Sandbox::CollectStatistics() const {
+  return {{"setupMicros", setup_time_.count()}};
+}
+
+std::unique_ptr<Sandbox> CreateSandboxIfConfigured(const nlohmann::json &config) {
+  if (!config.contains(kSandboxKey)) {
+    return nullptr;
+  }
+  return std::make_unique<Sandbox>(config[kSandboxKey], config.value(kWorkingDirectoryKey, ""));
+}
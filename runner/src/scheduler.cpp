@@ -0,0 +1,103 @@
+#include <kourt/runner/scheduler.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+static const char *kJobSubmissionKey = "submission";
+static const char *kJobWeightKey = "weight";
+static const char *kJobInteractiveKey = "interactive";
+static const char *kJobEstimatedCostKey = "estimatedCost";
+
+void JobScheduler::Push(DaemonJob &&job) {
+  const nlohmann::json &request = job.request;
+  const double cost = request.value(kJobEstimatedCostKey, 1.0);
+  const double weight = request.value(kJobWeightKey, 1.0);
+  if (cost <= 0 || weight <= 0) {
+    throw std::invalid_argument("estimatedCost and weight of a job should be positive");
+  }
+  job.enqueued_at = std::chrono::steady_clock::now();
+
+  if (request.value(kJobInteractiveKey, false)) {
+    interactive_jobs_.push(InteractiveEntry{cost, next_sequence_number_++, std::move(job)});
+    return;
+  }
+  auto [submission, is_new] = submissions_.try_emplace(request.value(kJobSubmissionKey, ""));
+  if (is_new || submission->second.jobs.empty()) {
+    // an idle submission doesn't accumulate credit, but keeps the debt of its recent jobs
+    submission->second.virtual_time = std::max(submission->second.virtual_time, virtual_time_);
+  }
+  submission->second.weight = weight;
+  submission->second.jobs.push_back(BatchEntry{cost, next_sequence_number_++, std::move(job)});
+  ++batch_jobs_;
+}
+
+std::optional<DaemonJob> JobScheduler::Pop() {
+  if (!interactive_jobs_.empty()) {
+    DaemonJob job = std::move(interactive_jobs_.top().job);
+    interactive_jobs_.pop();
+    return Dispatch(std::move(job), &interactive_statistics_);
+  }
+  if (batch_jobs_ == 0) {
+    return std::nullopt;
+  }
+
+  // Submissions are few compared to jobs, so a linear scan is cheaper than maintaining a heap of them.
+  auto next = submissions_.end();
+  for (auto it = submissions_.begin(); it != submissions_.end();) {
+    Submission &submission = it->second;
+    if (submission.jobs.empty()) {
+      // an idle submission is remembered only while its virtual time is ahead of the current one
+      it = (submission.virtual_time <= virtual_time_) ? submissions_.erase(it) : std::next(it);
+      continue;
+    }
+    if (next == submissions_.end()
+        || std::make_pair(submission.virtual_time, submission.jobs.front().sequence_number)
+            < std::make_pair(next->second.virtual_time, next->second.jobs.front().sequence_number)) {
+      next = it;
+    }
+    ++it;
+  }
+  Submission &submission = next->second;
+  BatchEntry entry = std::move(submission.jobs.front());
+  submission.jobs.pop_front();
+  --batch_jobs_;
+  virtual_time_ = submission.virtual_time;
+  submission.virtual_time += entry.cost / submission.weight;
+  return Dispatch(std::move(entry.job), &batch_statistics_);
+}
+
+DaemonJob JobScheduler::Dispatch(DaemonJob &&job, WaitStatistics *statistics) {
+  job.wait = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - job.enqueued_at);
+  statistics->Record(job.wait);
+  return std::move(job);
+}
+
+void JobScheduler::WaitStatistics::Record(std::chrono::microseconds wait) {
+  ++dispatched;
+  total_wait += wait;
+  max_wait = std::max(max_wait, wait);
+}
+
+nlohmann::json JobScheduler::WaitStatistics::ToJson() const {
+  return {
+      {"dispatched", dispatched},
+      {"meanWaitMicros", dispatched ? total_wait.count() / dispatched : 0},
+      {"maxWaitMicros", max_wait.count()},
+  };
+}
+
+nlohmann::json JobScheduler::CollectStatistics() const {
+  nlohmann::json queued_per_submission = nlohmann::json::object();
+  for (auto &[name, submission] : submissions_) {
+    if (!submission.jobs.empty()) {
+      queued_per_submission[name] = submission.jobs.size();
+    }
+  }
+  return {
+      {"queueDepth", Depth()},
+      {"interactiveQueueDepth", interactive_jobs_.size()},
+      {"queuedPerSubmission", queued_per_submission},
+      {"interactive", interactive_statistics_.ToJson()},
+      {"batch", batch_statistics_.ToJson()},
+  };
+}
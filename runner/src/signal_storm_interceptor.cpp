@@ -0,0 +1,89 @@
+#include <kourt/runner/signal_storm_interceptor.h>
+#include <kourt/runner/tracing.h>
+
+#include <csignal>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+static const char *kSignalKey = "signal";
+static const char *kSyscallsKey = "syscalls";
+static const char *kBoundaryKey = "boundary";
+static const char *kEveryKey = "every";
+static const char *kSkipKey = "skip";
+static const char *kLimitKey = "limit";
+
+SignalStormInterceptor::SignalStormInterceptor(const nlohmann::json &config) :
+    signal_number_(config.at(kSignalKey).get<int>()),
+    on_entry_(config.value(kBoundaryKey, "entry") == "entry"),
+    every_(config.value(kEveryKey, uint64_t{1})),
+    skip_(config.value(kSkipKey, uint64_t{0})),
+    limit_(config.value(kLimitKey, std::numeric_limits<uint64_t>::max())) {
+  if (signal_number_ <= 0 || signal_number_ >= NSIG) {
+    throw std::invalid_argument("Invalid signal number " + std::to_string(signal_number_));
+  }
+  if (every_ == 0) {
+    throw std::invalid_argument("SignalStormInterceptor: 'every' should be positive");
+  }
+  if (!config.contains(kSyscallsKey)) {
+    syscalls_.set();
+  }
+  for (const std::string &name : config.value(kSyscallsKey, std::vector<std::string>())) {
+    const SyscallDescriptor *descriptor = FindSyscallDescriptorByName(name);
+    if (!descriptor) {
+      throw std::invalid_argument("Unknown syscall: '" + name + "'");
+    }
+    syscalls_.set(descriptor->number);
+  }
+}
+
+std::optional<std::vector<unsigned long>> SignalStormInterceptor::InterceptedSyscalls() const {
+  if (syscalls_.all()) {
+    return std::nullopt;
+  }
+  std::vector<unsigned long> syscalls;
+  for (unsigned long syscall_no = 0; syscall_no < kMaxSyscallNumber; ++syscall_no) {
+    if (syscalls_.test(syscall_no)) {
+      syscalls.push_back(syscall_no);
+    }
+  }
+  return syscalls;
+}
+
+bool SignalStormInterceptor::InterceptsSyscallExits() const {
+  return !on_entry_;
+}
+
+nlohmann::json SignalStormInterceptor::CollectStatistics() const {
+  return {{"injectedSignals", injected_}};
+}
+
+bool SignalStormInterceptor::Intercept(BeforeSyscallStoppedTracee &tracee) {
+  if (on_entry_) {
+    MaybeInject(tracee);
+  }
+  return false;
+}
+
+bool SignalStormInterceptor::Intercept(AfterSyscallStoppedTracee &tracee) {
+  if (!on_entry_) {
+    MaybeInject(tracee);
+  }
+  return false;
+}
+
+void SignalStormInterceptor::MaybeInject(SyscallStoppedTracee &tracee) {
+  if (injected_ >= limit_) {
+    return;
+  }
+  const unsigned long syscall_no = tracee.SyscallNumber();
+  if (syscall_no >= kMaxSyscallNumber || !syscalls_.test(syscall_no)) {
+    return;
+  }
+  if (matched_++ < skip_ || (matched_ - skip_) % every_ != 0) {
+    return;
+  }
+  TRACE("Injecting signal %d at %s", signal_number_, tracee.Describe().c_str())
+  tracee.InjectSignal(signal_number_);
+  ++injected_;
+}
@@ -0,0 +1,105 @@
+#include <kourt/runner/spawn.h>
+
+#include <poll.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <csignal>
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#include <linux/sched.h>
+
+#include <kourt/runner/logging.h>
+
+#if defined(SYS_clone3) && defined(CLONE_INTO_CGROUP)
+#define KOURT_HAVE_CLONE3 1
+#endif
+
+#ifdef KOURT_HAVE_CLONE3
+static pid_t Clone3(const SpawnOptions &options) {
+  clone_args args{};
+  args.exit_signal = SIGCHLD;
+  args.flags = options.namespace_flags;
+  if (options.cgroup_fd >= 0) {
+    args.flags |= CLONE_INTO_CGROUP;
+    args.cgroup = options.cgroup_fd;
+  }
+  return (pid_t) syscall(SYS_clone3, &args, sizeof(args));
+}
+#endif
+
+static void JoinCgroup(int cgroup_fd) {
+  // Runs in the child, so nothing but async-signal-safe calls are allowed here.
+  int procs_fd = openat(cgroup_fd, "cgroup.procs", O_WRONLY | O_CLOEXEC);
+  if (procs_fd < 0 || write(procs_fd, "0", 1) != 1) {
+    perror("failed to join cgroup");
+    _exit(1);
+  }
+  close(procs_fd);
+}
+
+pid_t SpawnProcess(const SpawnOptions &options) {
+  if (0 == options.namespace_flags) {
+    // The runner has threads of its own: only fork runs the atfork handlers and resets the locks of malloc and stdio
+    // in the child, which calls them before exec. The child joins the cgroup itself.
+    pid_t child_pid = fork();
+    if (child_pid < 0) {
+      int error_code = errno;
+      throw std::runtime_error(std::string("Failed to fork: ") + strerror(error_code));
+    }
+    if (0 == child_pid && options.cgroup_fd >= 0) {
+      JoinCgroup(options.cgroup_fd);
+    }
+    return child_pid;
+  }
+#ifdef KOURT_HAVE_CLONE3
+  pid_t pid = Clone3(options);
+  if (pid >= 0) {
+    return pid;
+  }
+  int error_code = errno;
+  if (error_code != ENOSYS && error_code != E2BIG && error_code != EINVAL) {
+    throw std::runtime_error(std::string("clone3 failed: ") + strerror(error_code));
+  }
+  DEBUG("clone3 is not supported by the kernel (%s), falling back to clone", strerror(error_code));
+#endif
+
+  pid_t child_pid = (pid_t) syscall(SYS_clone, SIGCHLD | options.namespace_flags, nullptr, nullptr, nullptr, nullptr);
+  if (child_pid < 0) {
+    int error_code = errno;
+    throw std::runtime_error(std::string("Failed to fork due to error: ") + strerror(error_code));
+  }
+  if (0 == child_pid && options.cgroup_fd >= 0) {
+    JoinCgroup(options.cgroup_fd);
+  }
+  return child_pid;
+}
+
+bool WaitWithTimeout(pid_t pid, std::chrono::milliseconds timeout, int *status) {
+  int pid_fd = static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+  if (pid_fd >= 0) {
+    pollfd poll_fd{pid_fd, POLLIN, 0};
+    int ready;
+    do {
+      ready = poll(&poll_fd, 1, static_cast<int>(timeout.count()));
+    } while (ready < 0 && errno == EINTR);
+    close(pid_fd);
+    return ready > 0 && pid == waitpid(pid, status, 0);
+  }
+  // kernels older than 5.3 have no pidfd
+  const auto deadline = std::chrono::steady_clock::now() + timeout;
+  std::chrono::microseconds delay(100);
+  while (0 == waitpid(pid, status, WNOHANG)) {
+    if (std::chrono::steady_clock::now() >= deadline) {
+      return false;
+    }
+    usleep(delay.count());
+    delay = std::min(delay * 2, std::chrono::microseconds(10'000));
+  }
+  return true;
+}
@@ -0,0 +1,78 @@
+#include <kourt/runner/syscall_filter.h>
+
+#include <linux/audit.h>
+#include <linux/seccomp.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstddef>
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#include <kourt/runner/syscalls.h>
+
+static sock_filter Statement(unsigned short code, unsigned int k) {
+  return BPF_STMT(code, k);
+}
+
+static sock_filter Jump(unsigned short code, unsigned int k, size_t from, size_t if_true, size_t if_false) {
+  return BPF_JUMP(code,
+                  k,
+                  static_cast<unsigned char>(if_true - from - 1),
+                  static_cast<unsigned char>(if_false - from - 1));
+}
+
+SyscallFilter::SyscallFilter(const std::vector<unsigned long> &syscalls) {
+  if (syscalls.size() > kMaxSyscalls) {
+    throw std::invalid_argument("Too many syscalls for a seccomp filter: " + std::to_string(syscalls.size()));
+  }
+  // every ia32 row of a selected syscall, a syscall may have a legacy number as well (stat, fcntl, futex, ...)
+  std::vector<unsigned int> i386_syscalls;
+  auto select_i386 = [&](unsigned int i386_syscall_no, unsigned long syscall_no) {
+    if (std::find(syscalls.begin(), syscalls.end(), syscall_no) != syscalls.end()) {
+      i386_syscalls.push_back(i386_syscall_no);
+    }
+  };
+#define KOURT_SELECT_I386_SYSCALL(i386_number, name) select_i386(i386_number, __NR_##name);
+  KOURT_I386_SYSCALL_TABLE(KOURT_SELECT_I386_SYSCALL)
+#undef KOURT_SELECT_I386_SYSCALL
+  for (unsigned long syscall_no : syscalls) {
+    if (syscall_no & kUnmappedI386SyscallBit) {
+      i386_syscalls.push_back(static_cast<unsigned int>(NativeSyscallToI386(syscall_no)));
+    }
+  }
+  // The program checks the arch, then compares the number with each selected syscall of the arch:
+  //   0: loading the arch, 1: the x86-64 check, 2: loading the number, 3: the x32 check, then the x86-64 syscalls
+  //   and a jump to "allow"; the same for ia32 without the x32 check; then "allow", "trace" and "deny".
+  // x32 syscalls are denied rather than allowed: a tracer stopping on a syscall would miss its x32 variant.
+  const size_t i386_start = 5 + syscalls.size();
+  const size_t allow = i386_start + 2 + i386_syscalls.size();
+  const size_t trace = allow + 1;
+  const size_t deny = trace + 1;
+  program_.push_back(Statement(BPF_LD | BPF_W | BPF_ABS, offsetof(seccomp_data, arch)));
+  program_.push_back(Jump(BPF_JMP | BPF_JEQ | BPF_K, AUDIT_ARCH_X86_64, program_.size(), 2, i386_start));
+  program_.push_back(Statement(BPF_LD | BPF_W | BPF_ABS, offsetof(seccomp_data, nr)));
+  program_.push_back(Jump(BPF_JMP | BPF_JSET | BPF_K, kX32SyscallBit, program_.size(), deny, 4));
+  for (unsigned long syscall_no : syscalls) {
+    program_.push_back(Jump(BPF_JMP | BPF_JEQ | BPF_K, syscall_no, program_.size(), trace, program_.size() + 1));
+  }
+  program_.push_back(Statement(BPF_JMP | BPF_JA, allow - program_.size() - 1));
+  program_.push_back(Jump(BPF_JMP | BPF_JEQ | BPF_K, AUDIT_ARCH_I386, program_.size(), i386_start + 1, allow));
+  program_.push_back(Statement(BPF_LD | BPF_W | BPF_ABS, offsetof(seccomp_data, nr)));
+  for (unsigned int syscall_no : i386_syscalls) {
+    program_.push_back(Jump(BPF_JMP | BPF_JEQ | BPF_K, syscall_no, program_.size(), trace, program_.size() + 1));
+  }
+  program_.push_back(Statement(BPF_RET | BPF_K, SECCOMP_RET_ALLOW));
+  program_.push_back(Statement(BPF_RET | BPF_K, SECCOMP_RET_TRACE));
+  program_.push_back(Statement(BPF_RET | BPF_K, SECCOMP_RET_ERRNO | ENOSYS));
+}
+
+bool SyscallFilter::InstallInChild() const {
+  sock_fprog program{static_cast<unsigned short>(program_.size()), const_cast<sock_filter *>(program_.data())};
+  // without CAP_SYS_ADMIN a filter may be installed only by a process which can't gain privileges
+  return 0 == prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0)
+      && 0 == syscall(SYS_seccomp, SECCOMP_SET_MODE_FILTER, 0, &program);
+}
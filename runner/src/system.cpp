@@ -0,0 +1,16 @@
+#include <kourt/runner/system.h>
+
+#include <csignal>
+#include <cerrno>
+#include <cstring>
+
+std::runtime_error SystemError(const std::string &what) {
+  int error_code = errno;
+  return std::runtime_error(what + ": " + strerror(error_code));
+}
+
+void ResetSignalMaskInChild() {
+  sigset_t empty_signal_set;
+  sigemptyset(&empty_signal_set);
+  sigprocmask(SIG_SETMASK, &empty_signal_set, nullptr);
+}
@@ -1,15 +1,20 @@
+#include <algorithm>
+#include <chrono>
+
 #include <kourt/runner/tracee_controller.h>
 #include <kourt/runner/tracing.h>
 #include <kourt/runner/logging.h>
+#include <kourt/runner/metrics.h>
+#include <kourt/runner/syscall_filter.h>
 
 class LoggingInterceptor : public virtual StoppedTraceeInterceptor {
   bool Intercept(BeforeSyscallStoppedTracee &stopped_tracee) override {
-    LOG(level_, "Stopped before syscall %d", stopped_tracee.SyscallNumber())
+    LOG(level_, "Stopped before syscall %s", stopped_tracee.Describe().c_str())
     return false;
   }
 
   bool Intercept(AfterSyscallStoppedTracee &stopped_tracee) override {
-    LOG(level_, "Stopped after syscall %d", stopped_tracee.SyscallNumber())
+    LOG(level_, "Stopped after syscall %s = %ld", stopped_tracee.Describe().c_str(), stopped_tracee.ReturnedValue())
     return false;
   }
 
@@ -34,42 +39,152 @@ class LoggingInterceptor : public virtual StoppedTraceeInterceptor {
 
 TraceeController::TraceeController(
     Tracee &tracee,
-    std::vector<std::unique_ptr<StoppedTraceeInterceptor>> &&interceptors
+    std::vector<std::unique_ptr<StoppedTraceeInterceptor>> &&interceptors,
+    bool syscalls_filtered,
+    InstructionCounter *instruction_counter
 ) :
     interceptors_(std::move(interceptors)),
     tracee_(tracee),
-    entered_syscall_(false) {
+    entered_syscall_(false),
+    syscalls_filtered_(syscalls_filtered),
+    instruction_counter_(instruction_counter) {
+  for (auto &interceptor : interceptors_) {
+    intercepts_syscall_exits_ = intercepts_syscall_exits_ || interceptor->InterceptsSyscallExits();
+  }
   interceptors_.insert(interceptors_.cbegin(), std::move(std::make_unique<LoggingInterceptor>()));
   DEBUG("Successfully initialized TraceeController with %zu interceptors", interceptors_.size());
 }
 
+std::optional<std::vector<unsigned long>> TraceeController::FilteredSyscalls(
+    const std::vector<std::unique_ptr<StoppedTraceeInterceptor>> &interceptors) {
+  // The logging interceptor is not consulted: it logs whatever stops there are, so that logging doesn't change
+  // the way the tracee runs.
+  std::vector<unsigned long> syscalls;
+  for (auto &interceptor : interceptors) {
+    auto intercepted_syscalls = interceptor->InterceptedSyscalls();
+    if (!intercepted_syscalls) {
+      return std::nullopt;
+    }
+    syscalls.insert(syscalls.end(), intercepted_syscalls->begin(), intercepted_syscalls->end());
+  }
+  std::sort(syscalls.begin(), syscalls.end());
+  syscalls.erase(std::unique(syscalls.begin(), syscalls.end()), syscalls.end());
+  if (syscalls.size() > SyscallFilter::kMaxSyscalls) {
+    return std::nullopt;
+  }
+  return syscalls;
+}
+
+static bool IsPtraceEventStop(const int wait_status, const __ptrace_eventcodes event_code) {
+  return wait_status >> 8 == (SIGTRAP | (event_code << 8));
+}
+
 int TraceeController::ExecuteTracee() {
-  int wait_status = tracee_.Wait(); // catch initial SIGTRAP sent to tracee on exec call.
-  auto options = PTRACE_O_TRACEEXIT | PTRACE_O_TRACESYSGOOD;
-  tracee_.Ptrace(PTRACE_SETOPTIONS, nullptr, (void *) options);
-  tracee_.Ptrace(PTRACE_SYSCALL, nullptr, nullptr);
+  return *ExecuteTraceeUntil(nullptr);
+}
 
+std::optional<int> TraceeController::ExecuteTraceeUntil(
+    const std::function<bool(BeforeSyscallStoppedTracee &)> &hold) {
+  // The exec of the executable stops at the syscall filter if it selects execve; that exec is the runner's rather than
+  // the tracee's, so the interceptors don't observe it.
+  int wait_status = tracee_.Wait();
+  while (IsPtraceEventStop(wait_status, PTRACE_EVENT_SECCOMP)) {
+    tracee_.Ptrace(PTRACE_CONT, nullptr, nullptr);
+    wait_status = tracee_.Wait();
+  }
+  // the initial SIGTRAP sent to the tracee on exec call is caught here
+  SetOptions();
+  for (auto &interceptor : interceptors_) {
+    interceptor->OnExec(tracee_);
+  }
+  tracee_.Ptrace(syscalls_filtered_ ? PTRACE_CONT : PTRACE_SYSCALL, nullptr, nullptr);
+  return Trace(hold);
+}
+
+int TraceeController::ResumeTracee() {
+  SetOptions();
+  tracee_.Ptrace(syscalls_filtered_ ? PTRACE_CONT : PTRACE_SYSCALL, nullptr, nullptr);
+  return *Trace(nullptr);
+}
+
+void TraceeController::SetOptions() {
+  // The options the tracee has been seized with are kept: a tracee outliving a crashed runner would run unlimited.
+  long options = tracee_.Options() | PTRACE_O_EXITKILL | PTRACE_O_TRACEEXIT | PTRACE_O_TRACESYSGOOD;
+  if (syscalls_filtered_) {
+    options |= PTRACE_O_TRACESECCOMP;
+  }
+  tracee_.SetOptions(options);
+  // the tracee is stopped, so counting starts before it runs any code of its own
+  if (instruction_counter_) {
+    instruction_counter_->Attach(tracee_.Pid());
+  }
+}
+
+std::optional<int> TraceeController::Trace(const std::function<bool(BeforeSyscallStoppedTracee &)> &hold) {
+  int wait_status;
+  // the caller has just resumed the tracee
+  auto resumed_at = std::chrono::steady_clock::now();
   for (bool keep_tracing = true; keep_tracing;) {
     wait_status = tracee_.Wait();
+    ObserveHistogram(Histogram::kTraceeRunTime, std::chrono::steady_clock::now() - resumed_at);
     keep_tracing = WIFSTOPPED(wait_status);
     if (keep_tracing) {
       auto stopped_tracee = DetermineStopMoment(wait_status);
+      // An injected signal is delivered at the exit of its syscall at the latest. Past that it has been blocked or
+      // consumed otherwise, and its details mustn't be applied to a later signal of the same number.
+      if (!dynamic_cast<AfterSyscallStoppedTracee *>(stopped_tracee.get())) {
+        pending_signal_info_.reset();
+      }
+      if (hold) {
+        auto *entry_stop = dynamic_cast<BeforeSyscallStoppedTracee *>(stopped_tracee.get());
+        if (entry_stop && hold(*entry_stop)) {
+          return std::nullopt;
+        }
+      }
+      const auto interceptors_started = std::chrono::steady_clock::now();
       bool tracee_is_stopped = true;
       for (auto interceptor = interceptors_.begin();
            tracee_is_stopped && interceptor < interceptors_.end();
            ++interceptor) {
         tracee_is_stopped = !stopped_tracee->Intercept(**interceptor);
       }
+      ObserveHistogram(Histogram::kInterceptorTime, std::chrono::steady_clock::now() - interceptors_started);
+      if (auto *entry_stop = dynamic_cast<BeforeSyscallStoppedTracee *>(stopped_tracee.get())) {
+        entry_registers_stored_ = entry_stop->RegistersStored();
+      }
       if (tracee_is_stopped) {
+        if (const siginfo_t *injected_signal_info = stopped_tracee->InjectedSignalInfo()) {
+          pending_signal_info_ = *injected_signal_info;
+        }
+        bool stop_at_syscall_exit = !syscalls_filtered_;
+        if (auto *entry_stop = dynamic_cast<BeforeSyscallStoppedTracee *>(stopped_tracee.get())) {
+          skipped_syscall_return_value_ = entry_stop->SkippedSyscallReturnValue();
+          // a skipped syscall gets its return value at the exit
+          stop_at_syscall_exit = stop_at_syscall_exit || intercepts_syscall_exits_ || skipped_syscall_return_value_;
+        }
+        stopped_tracee->SetResumeRequest(stop_at_syscall_exit ? PTRACE_SYSCALL : PTRACE_CONT);
         stopped_tracee->ContinueExecution();
       }
+      resumed_at = std::chrono::steady_clock::now();
     }
   }
   return wait_status;
 }
 
-static bool IsPtraceEventStop(const int wait_status, const __ptrace_eventcodes event_code) {
-  return wait_status >> 8 == (SIGTRAP | (event_code << 8));
+void TraceeController::FinishInterceptors(const std::string &working_directory) {
+  for (auto &interceptor : interceptors_) {
+    interceptor->OnFinish(working_directory);
+  }
+}
+
+nlohmann::json TraceeController::CollectInterceptorStatistics() const {
+  nlohmann::json statistics = nlohmann::json::array();
+  // the first one is the logging interceptor added by the controller itself
+  for (auto interceptor = interceptors_.begin() + 1; interceptor < interceptors_.end(); ++interceptor) {
+    nlohmann::json interceptor_statistics = (*interceptor)->CollectStatistics();
+    statistics.push_back(interceptor_statistics.is_null() ? nlohmann::json::object() : interceptor_statistics);
+  }
+  return statistics;
 }
 
 static bool IsNotGroupStopSignal(const int signal_no) {
@@ -101,6 +216,8 @@ std::unique_ptr<StoppedTracee> TraceeController::DetermineStopMoment(int wait_st
   } else /* signal_number == SIGTRAP */ {
     if (IsPtraceEventStop(wait_status, PTRACE_EVENT_EXIT)) {
       return ExitStop();
+    } else if (IsPtraceEventStop(wait_status, PTRACE_EVENT_SECCOMP)) {
+      return SeccompStop();
     } else {
       // either SIGTRAP signal-delivery-stop or syscall-stop.
       siginfo_t signal_info;
@@ -122,21 +239,100 @@ std::unique_ptr<StoppedTracee> TraceeController::DetermineStopMoment(int wait_st
 }
 
 std::unique_ptr<StoppedTracee> TraceeController::SyscallStop() {
-  auto stopped_tracee = entered_syscall_
-      ? (StoppedTracee *) new AfterSyscallStoppedTracee(tracee_)
-      : (StoppedTracee *) new BeforeSyscallStoppedTracee(tracee_);
+#ifdef PTRACE_GET_SYSCALL_INFO
+  // The kernel knows whether it is syscall-enter-stop or syscall-exit-stop, and reports the syscall in the same call,
+  // so there is no need to fetch the registers unless an interceptor modifies them.
+  if (syscall_info_supported_) {
+    __ptrace_syscall_info info{};
+    try {
+      tracee_.Ptrace(PTRACE_GET_SYSCALL_INFO, (void *) sizeof(info), &info);
+    } catch (PtraceCallFailed &exc) {
+      if (exc.Errno() != EIO && exc.Errno() != EINVAL) {
+        throw;
+      }
+      WARN("PTRACE_GET_SYSCALL_INFO is not supported, falling back to counting syscall stops")
+      syscall_info_supported_ = false;
+    }
+    if (info.op == PTRACE_SYSCALL_INFO_ENTRY || info.op == PTRACE_SYSCALL_INFO_SECCOMP) {
+      entered_syscall_ = true;
+      entry_info_ = info;
+      entry_registers_stored_ = false;
+      SyscallRegisters snapshot;
+      snapshot.LoadSyscallInfo(info);
+      IncrementCounter(Counter::kStopsBeforeSyscall);
+      return std::make_unique<BeforeSyscallStoppedTracee>(tracee_, snapshot);
+    }
+    if (info.op == PTRACE_SYSCALL_INFO_EXIT) {
+      entered_syscall_ = false;
+      // the exit info has no syscall number and arguments, they are taken from the entry if there was one
+      SyscallRegisters snapshot;
+      if (entry_info_.op == PTRACE_SYSCALL_INFO_ENTRY || entry_info_.op == PTRACE_SYSCALL_INFO_SECCOMP) {
+        snapshot.LoadSyscallInfo(entry_info_);
+      }
+      snapshot.LoadSyscallInfo(info);
+      if (entry_registers_stored_) {
+        // The entry info predates the changes of the interceptors (a shrunk argument, a cancelled syscall), so the
+        // syscall as executed is read from the registers. The ABI reported by the kernel is kept.
+        snapshot.Load(tracee_);
+      }
+      IncrementCounter(Counter::kStopsAfterSyscall);
+      return ExitFromSyscall(std::make_unique<AfterSyscallStoppedTracee>(tracee_, snapshot));
+    }
+  }
+#endif
+  IncrementCounter(entered_syscall_ ? Counter::kStopsAfterSyscall : Counter::kStopsBeforeSyscall);
   entered_syscall_ = !entered_syscall_;
-  return std::unique_ptr<StoppedTracee>(stopped_tracee);
+  if (entered_syscall_) {
+    return std::make_unique<BeforeSyscallStoppedTracee>(tracee_);
+  }
+  return ExitFromSyscall(std::make_unique<AfterSyscallStoppedTracee>(tracee_));
+}
+
+std::unique_ptr<StoppedTracee> TraceeController::SeccompStop() {
+  // A seccomp stop is at the entry of a syscall even if the exit of the previous one hasn't been stopped at.
+  entered_syscall_ = false;
+  auto stop = SyscallStop();
+  static_cast<SyscallStoppedTracee &>(*stop).SetSeccompStop();
+  return stop;
+}
+
+std::unique_ptr<StoppedTracee> TraceeController::ExitFromSyscall(std::unique_ptr<AfterSyscallStoppedTracee> stop) {
+  if (skipped_syscall_return_value_) {
+    stop->SetReturnedValue(*skipped_syscall_return_value_);
+    skipped_syscall_return_value_.reset();
+  }
+  return stop;
 }
 
 std::unique_ptr<StoppedTracee> TraceeController::SignalDeliveryStop(int signal_number) {
+  IncrementCounter(Counter::kStopsBeforeSignalDelivery);
+  if (pending_signal_info_ && pending_signal_info_->si_signo == signal_number) {
+    // The kernel sends injected signals with generic details, so they are replaced before anyone observes them.
+    tracee_.Ptrace(PTRACE_SETSIGINFO, nullptr, &*pending_signal_info_);
+    pending_signal_info_.reset();
+  }
+  if (instruction_counter_ && signal_number == InstructionCounter::kOverflowSignal) {
+    siginfo_t signal_info;
+    tracee_.Ptrace(PTRACE_GETSIGINFO, nullptr, &signal_info);
+    if (instruction_counter_->IsOverflowSignal(signal_info)) {
+      if (instruction_counter_->CheckLimit()) {
+        // the tracee may handle or ignore the overflow signal, so SIGKILL is delivered instead
+        DEBUG("Tracee has exhausted its instruction limit, killing it")
+        signal_number = SIGKILL;
+      } else {
+        signal_number = 0;
+      }
+    }
+  }
   return std::unique_ptr<StoppedTracee>(new BeforeSignalDeliveryStoppedTracee(tracee_, signal_number));
 }
 
 std::unique_ptr<StoppedTracee> TraceeController::GroupStop() {
+  IncrementCounter(Counter::kStopsOnGroupStop);
   return std::unique_ptr<StoppedTracee>(new OnGroupStopStoppedTracee(tracee_));
 }
 
 std::unique_ptr<StoppedTracee> TraceeController::ExitStop() {
+  IncrementCounter(Counter::kStopsBeforeTermination);
   return std::unique_ptr<StoppedTracee>(new BeforeTerminationStoppedTracee(tracee_));
 }
@@ -1,5 +1,39 @@
 #include <kourt/runner/tracing.h>
 
+#include <sys/uio.h>
+
+static size_t TransferMemory(pid_t pid, unsigned long address, void *buffer, size_t size, bool write) {
+  size_t transferred = 0;
+  while (transferred < size) {
+    iovec local{static_cast<char *>(buffer) + transferred, size - transferred};
+    iovec remote{reinterpret_cast<void *>(address + transferred), size - transferred};
+    ssize_t result = write
+        ? process_vm_writev(pid, &local, 1, &remote, 1, 0)
+        : process_vm_readv(pid, &local, 1, &remote, 1, 0);
+    if (result < 0 && errno == EFAULT) {
+      break;
+    }
+    if (result < 0) {
+      int error = errno;
+      const char *call = write ? "process_vm_writev: " : "process_vm_readv: ";
+      throw PtraceCallFailed(error, std::string(call) + strerror(error));
+    }
+    if (result == 0) {
+      break;
+    }
+    transferred += result;
+  }
+  return transferred;
+}
+
+size_t Tracee::ReadMemory(unsigned long address, void *buffer, size_t size) {
+  return TransferMemory(tracee_pid_, address, buffer, size, false);
+}
+
+size_t Tracee::WriteMemory(unsigned long address, const void *buffer, size_t size) {
+  return TransferMemory(tracee_pid_, address, const_cast<void *>(buffer), size, true);
+}
+
 bool AfterSyscallStoppedTracee::Intercept(StoppedTraceeInterceptor &visitor) {
   return visitor.Intercept(*this);
 }
@@ -15,3 +49,41 @@ bool OnGroupStopStoppedTracee::Intercept(StoppedTraceeInterceptor &visitor) {
 bool BeforeTerminationStoppedTracee::Intercept(StoppedTraceeInterceptor &visitor) {
   return visitor.Intercept(*this);
 }
+
+std::string SyscallStoppedTracee::Describe() {
+  const unsigned long syscall_no = SyscallNumber();
+  const SyscallDescriptor *descriptor = FindSyscallDescriptor(syscall_no);
+  if (syscall_no == kCancelledSyscall) {
+    return "cancelled_syscall()";
+  }
+  if (!descriptor) {
+    return (syscall_no & kUnmappedI386SyscallBit)
+        ? "ia32_syscall_" + std::to_string(syscall_no & ~kUnmappedI386SyscallBit) + "(...)"
+        : "syscall_" + std::to_string(syscall_no) + "(...)";
+  }
+
+  std::string description = std::string(descriptor->name) + "(";
+  for (int i = 0; i < descriptor->arity; ++i) {
+    char value[32];
+    const unsigned long arg = Arg(i);
+    switch (descriptor->arg_kinds[i]) {
+      case kArgFd:
+      case kArgInt: snprintf(value, sizeof(value), "%d", (int) arg);
+        break;
+      case kArgSize:
+      case kArgOffset: snprintf(value, sizeof(value), "%ld", (long) arg);
+        break;
+      case kArgMode: snprintf(value, sizeof(value), "0%lo", arg);
+        break;
+      default: snprintf(value, sizeof(value), "0x%lx", arg);
+        break;
+    }
+    description += std::string(i ? ", " : "") + descriptor->arg_names[i] + "=" + value;
+  }
+  return description + ")";
+}
+
+static_assert(FindSyscallDescriptor(__NR_read)->arity == 3, "read takes fd, buf and count");
+static_assert(FindSyscallDescriptor(__NR_mmap)->arg_kinds[4] == kArgFd, "fifth argument of mmap is fd");
+static_assert(FindSyscallDescriptor(__NR_getpid)->arity == 0, "getpid has no arguments");
+static_assert(FindSyscallDescriptorByName("clock_nanosleep")->number == __NR_clock_nanosleep, "lookup by name");
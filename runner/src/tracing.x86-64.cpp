@@ -1,107 +1,255 @@
+#include <sys/uio.h>
 #include <sys/user.h>
+#include <elf.h>
+#include <linux/audit.h>
 
+#include <kourt/runner/registers.h>
 #include <kourt/runner/tracee_controller.h>
 
-unsigned long SyscallStoppedTracee::SyscallNumber() {
-  user_regs_struct registers{};
-  tracee_.Ptrace(PTRACE_GETREGS, nullptr, &registers);
-  return registers.orig_rax;
+// Code segment selector of 32-bit user code on x86-64 Linux.
+static const unsigned long kI386UserCodeSegment = 0x23;
+
+void SyscallRegisters::Load(Tracee &tracee) {
+  iovec iov{&registers_, sizeof(registers_)};
+  tracee.Ptrace(PTRACE_GETREGSET, (void *) NT_PRSTATUS, &iov);
+  size_ = iov.iov_len;
+  if (!has_info_) {
+    // The ABI reported by the kernel is preferred: it tells int 0x80 issued by 64-bit code apart as well.
+    abi_ = (size_ == sizeof(I386UserRegisters) || registers_.x86_64.cs == kI386UserCodeSegment)
+        ? SyscallAbi::kI386
+        : SyscallAbi::kX86_64;
+  }
 }
 
-void SyscallStoppedTracee::SetSyscallNumber(unsigned long syscall_no) {
-  user_regs_struct registers{};
-  tracee_.Ptrace(PTRACE_GETREGS, nullptr, &registers);
-  registers.rax = syscall_no;
-  tracee_.Ptrace(PTRACE_SETREGS, nullptr, &registers);
+#ifdef PTRACE_GET_SYSCALL_INFO
+void SyscallRegisters::LoadSyscallInfo(const __ptrace_syscall_info &info) {
+  abi_ = (info.arch == AUDIT_ARCH_I386) ? SyscallAbi::kI386 : SyscallAbi::kX86_64;
+  info_.instruction_pointer = info.instruction_pointer;
+  info_.stack_pointer = info.stack_pointer;
+  const uint64_t *args = nullptr;
+  switch (info.op) {
+    case PTRACE_SYSCALL_INFO_ENTRY:
+      info_.number = info.entry.nr;
+      args = info.entry.args;
+      break;
+    case PTRACE_SYSCALL_INFO_SECCOMP:
+      info_.number = info.seccomp.nr;
+      args = info.seccomp.args;
+      break;
+    case PTRACE_SYSCALL_INFO_EXIT:
+      info_.return_value = info.exit.rval;
+      break;
+    default:
+      throw std::invalid_argument("Unexpected PTRACE_GET_SYSCALL_INFO op: " + std::to_string(info.op));
+  }
+  for (int i = 0; args && i < 6; ++i) {
+    info_.args[i] = (abi_ == SyscallAbi::kI386) ? (uint32_t) args[i] : args[i];
+  }
+  has_info_ = true;
+}
+#endif
+
+void SyscallRegisters::Store(Tracee &tracee) {
+  iovec iov{&registers_, size_};
+  tracee.Ptrace(PTRACE_SETREGSET, (void *) NT_PRSTATUS, &iov);
 }
 
-unsigned long SyscallStoppedTracee::Arg1() {
-  user_regs_struct registers{};
-  tracee_.Ptrace(PTRACE_GETREGS, nullptr, &registers);
-  return registers.rdi;
+/// @return register holding the argument according to the x86-64 syscall calling convention.
+template<typename Registers>
+static auto &X86_64ArgRegister(Registers &registers, int index) {
+  switch (index) {
+    case 0: return registers.rdi;
+    case 1: return registers.rsi;
+    case 2: return registers.rdx;
+    case 3: return registers.r10;
+    case 4: return registers.r8;
+    case 5: return registers.r9;
+    default: throw std::out_of_range("Syscall argument index out of range: " + std::to_string(index));
+  }
 }
 
-void SyscallStoppedTracee::SetArg1(unsigned long arg) {
-  user_regs_struct registers{};
-  tracee_.Ptrace(PTRACE_GETREGS, nullptr, &registers);
-  registers.rdi = arg;
-  tracee_.Ptrace(PTRACE_SETREGS, nullptr, &registers);
+/// @return register holding the argument according to the i386 syscall calling convention.
+template<typename Registers>
+static auto &I386ArgRegister(Registers &registers, int index) {
+  switch (index) {
+    case 0: return registers.ebx;
+    case 1: return registers.ecx;
+    case 2: return registers.edx;
+    case 3: return registers.esi;
+    case 4: return registers.edi;
+    case 5: return registers.ebp;
+    default: throw std::out_of_range("Syscall argument index out of range: " + std::to_string(index));
+  }
 }
 
-unsigned long SyscallStoppedTracee::Arg2() {
-  user_regs_struct registers{};
-  tracee_.Ptrace(PTRACE_GETREGS, nullptr, &registers);
-  return registers.rdi;
+// A 64-bit task executing 32-bit code still reports the 64-bit register layout,
+// but uses the lower halves of the registers in the i386 order.
+template<typename Registers>
+static auto &X86_64RegisterForI386Arg(Registers &registers, int index) {
+  switch (index) {
+    case 0: return registers.rbx;
+    case 1: return registers.rcx;
+    case 2: return registers.rdx;
+    case 3: return registers.rsi;
+    case 4: return registers.rdi;
+    case 5: return registers.rbp;
+    default: throw std::out_of_range("Syscall argument index out of range: " + std::to_string(index));
+  }
 }
 
-void SyscallStoppedTracee::SetArg2(unsigned long arg) {
-  user_regs_struct registers{};
-  tracee_.Ptrace(PTRACE_GETREGS, nullptr, &registers);
-  registers.rdi = arg;
-  tracee_.Ptrace(PTRACE_SETREGS, nullptr, &registers);
+unsigned long SyscallRegisters::SyscallNumber() const {
+  if (!HasRegisterSet()) {
+    return (abi_ == SyscallAbi::kI386) ? I386SyscallToNative(info_.number) : info_.number;
+  }
+  switch (abi_) {
+    case SyscallAbi::kX86_64: return registers_.x86_64.orig_rax;
+    case SyscallAbi::kI386: {
+      unsigned long i386_number = (size_ == sizeof(I386UserRegisters))
+          ? registers_.i386.orig_eax
+          : (uint32_t) registers_.x86_64.orig_rax;
+      return I386SyscallToNative(i386_number);
+    }
+  }
+  throw std::logic_error("Unknown syscall ABI");
 }
 
-unsigned long SyscallStoppedTracee::Arg3() {
-  user_regs_struct registers{};
-  tracee_.Ptrace(PTRACE_GETREGS, nullptr, &registers);
-  return registers.rdx;
+void SyscallRegisters::SetSyscallNumber(unsigned long syscall_no) {
+  if (abi_ == SyscallAbi::kX86_64) {
+    registers_.x86_64.orig_rax = syscall_no;
+    return;
+  }
+  long i386_number = ((long) syscall_no == -1) ? -1 : NativeSyscallToI386(syscall_no);
+  if (i386_number < 0 && (long) syscall_no != -1) {
+    throw std::invalid_argument("Syscall " + std::to_string(syscall_no) + " has no ia32 counterpart");
+  }
+  if (size_ == sizeof(I386UserRegisters)) {
+    registers_.i386.orig_eax = (uint32_t) i386_number;
+  } else {
+    registers_.x86_64.orig_rax = (unsigned long) i386_number;
+  }
 }
 
-void SyscallStoppedTracee::SetArg3(unsigned long arg) {
-  user_regs_struct registers{};
-  tracee_.Ptrace(PTRACE_GETREGS, nullptr, &registers);
-  registers.rdx = arg;
-  tracee_.Ptrace(PTRACE_SETREGS, nullptr, &registers);
+unsigned long SyscallRegisters::Arg(int index) const {
+  if (!HasRegisterSet()) {
+    if (index < 0 || index >= 6) {
+      throw std::out_of_range("Syscall argument index out of range: " + std::to_string(index));
+    }
+    return info_.args[index];
+  }
+  if (abi_ == SyscallAbi::kX86_64) {
+    return X86_64ArgRegister(registers_.x86_64, index);
+  }
+  return (size_ == sizeof(I386UserRegisters))
+      ? I386ArgRegister(registers_.i386, index)
+      : (uint32_t) X86_64RegisterForI386Arg(registers_.x86_64, index);
 }
 
-unsigned long SyscallStoppedTracee::Arg4() {
-  user_regs_struct registers{};
-  tracee_.Ptrace(PTRACE_GETREGS, nullptr, &registers);
-  return registers.r10;
+void SyscallRegisters::SetArg(int index, unsigned long arg) {
+  if (abi_ == SyscallAbi::kX86_64) {
+    X86_64ArgRegister(registers_.x86_64, index) = arg;
+  } else if (size_ == sizeof(I386UserRegisters)) {
+    I386ArgRegister(registers_.i386, index) = (uint32_t) arg;
+  } else {
+    X86_64RegisterForI386Arg(registers_.x86_64, index) = (uint32_t) arg;
+  }
 }
 
-void SyscallStoppedTracee::SetArg4(unsigned long arg) {
-  user_regs_struct registers{};
-  tracee_.Ptrace(PTRACE_GETREGS, nullptr, &registers);
-  registers.r10 = arg;
-  tracee_.Ptrace(PTRACE_SETREGS, nullptr, &registers);
+long SyscallRegisters::ReturnValue() const {
+  if (!HasRegisterSet()) {
+    return info_.return_value;
+  }
+  if (size_ == sizeof(I386UserRegisters)) {
+    return (int32_t) registers_.i386.eax;
+  }
+  return (abi_ == SyscallAbi::kI386) ? (int32_t) registers_.x86_64.rax : (long) registers_.x86_64.rax;
 }
 
-unsigned long SyscallStoppedTracee::Arg5() {
-  user_regs_struct registers{};
-  tracee_.Ptrace(PTRACE_GETREGS, nullptr, &registers);
-  return registers.r8;
+void SyscallRegisters::SetReturnValue(long return_value) {
+  if (size_ == sizeof(I386UserRegisters)) {
+    registers_.i386.eax = (uint32_t) return_value;
+  } else {
+    registers_.x86_64.rax = return_value;
+  }
 }
 
-void SyscallStoppedTracee::SetArg5(unsigned long arg) {
-  user_regs_struct registers{};
-  tracee_.Ptrace(PTRACE_GETREGS, nullptr, &registers);
-  registers.r8 = arg;
-  tracee_.Ptrace(PTRACE_SETREGS, nullptr, &registers);
+unsigned long SyscallRegisters::InstructionPointer() const {
+  if (!HasRegisterSet()) {
+    return info_.instruction_pointer;
+  }
+  return (size_ == sizeof(I386UserRegisters)) ? registers_.i386.eip : registers_.x86_64.rip;
 }
 
-void SyscallStoppedTracee::SetArg6(unsigned long arg) {
-  user_regs_struct registers{};
-  tracee_.Ptrace(PTRACE_GETREGS, nullptr, &registers);
-  registers.r9 = arg;
-  tracee_.Ptrace(PTRACE_SETREGS, nullptr, &registers);
+void SyscallRegisters::SetInstructionPointer(unsigned long address) {
+  if (size_ == sizeof(I386UserRegisters)) {
+    registers_.i386.eip = (uint32_t) address;
+  } else {
+    registers_.x86_64.rip = address;
+  }
 }
 
-unsigned long SyscallStoppedTracee::Arg6() {
-  user_regs_struct registers{};
-  tracee_.Ptrace(PTRACE_GETREGS, nullptr, &registers);
-  return registers.r9;
+unsigned long SyscallRegisters::StackPointer() const {
+  if (!HasRegisterSet()) {
+    return info_.stack_pointer;
+  }
+  return (size_ == sizeof(I386UserRegisters)) ? registers_.i386.esp : registers_.x86_64.rsp;
+}
+
+unsigned long SyscallRegisters::FramePointer() const {
+  if (!HasRegisterSet()) {
+    throw std::logic_error("Frame pointer is not available without the register set");
+  }
+  return (size_ == sizeof(I386UserRegisters)) ? registers_.i386.ebp : registers_.x86_64.rbp;
+}
+
+SyscallRegisters &SyscallStoppedTracee::Registers() {
+  if (!registers_loaded_) {
+    registers_.Load(tracee_);
+    registers_loaded_ = true;
+  }
+  return registers_;
+}
+
+SyscallRegisters &SyscallStoppedTracee::RegisterSet() {
+  if (!registers_.HasRegisterSet()) {
+    registers_.Load(tracee_);
+    registers_loaded_ = true;
+  }
+  return registers_;
+}
+
+void SyscallStoppedTracee::StoreRegisters() {
+  registers_.Store(tracee_);
+  registers_stored_ = true;
+}
+
+unsigned long SyscallStoppedTracee::SyscallNumber() {
+  return Registers().SyscallNumber();
+}
+
+void SyscallStoppedTracee::SetSyscallNumber(unsigned long syscall_no) {
+  RegisterSet().SetSyscallNumber(syscall_no);
+  StoreRegisters();
+}
+
+unsigned long SyscallStoppedTracee::Arg(int index) {
+  return Registers().Arg(index);
+}
+
+void SyscallStoppedTracee::SetArg(int index, unsigned long arg) {
+  RegisterSet().SetArg(index, arg);
+  StoreRegisters();
+}
+
+void BeforeSyscallStoppedTracee::SkipSyscall(long return_value) {
+  SetSyscallNumber(-1);
+  skipped_syscall_return_value_ = return_value;
 }
 
 long AfterSyscallStoppedTracee::ReturnedValue() {
-  user_regs_struct registers{};
-  tracee_.Ptrace(PTRACE_GETREGS, nullptr, &registers);
-  return registers.rax;
+  return Registers().ReturnValue();
 }
 
 void AfterSyscallStoppedTracee::SetReturnedValue(long returned_value) {
-  user_regs_struct registers{};
-  tracee_.Ptrace(PTRACE_GETREGS, nullptr, &registers);
-  registers.rax = returned_value;
-  tracee_.Ptrace(PTRACE_SETREGS, nullptr, &registers);
-}
\ No newline at end of file
+  RegisterSet().SetReturnValue(returned_value);
+  StoreRegisters();
+}
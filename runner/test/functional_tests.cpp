@@ -5,13 +5,23 @@
 #include <fstream>
 #include <memory>
 #include <vector>
+#include <unordered_map>
 #include <unordered_set>
 #include <string>
+#include <thread>
 
+#include <cmath>
+#include <csignal>
 #include <cstdlib>
+#include <sched.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
 #include <fcntl.h>
 #include <dirent.h>
 
@@ -19,6 +29,10 @@
 #include <gtest/gtest.h>
 
 #include <kourt/runner/config.h>
+#include <kourt/runner/digest.h>
+#include <kourt/runner/metrics.h>
+#include <kourt/runner/repeated_runs.h>
+#include <kourt/runner/results.h>
 #include <kourt/runner/runner_main.h>
 
 namespace fs = std::filesystem;
@@ -79,6 +93,71 @@ void DiscoverOpenFileDescriptors(std::unordered_set<int> *out_file_descriptors)
   close(dirfd);
 }
 
+/// \return mount point of the cgroup v2 hierarchy, or an empty path if there is no writable one.
+fs::path FindWritableCgroup2MountPoint() {
+  std::ifstream mounts("/proc/mounts");
+  for (std::string device, mount_point, fs_type, rest; mounts >> device >> mount_point >> fs_type;) {
+    std::getline(mounts, rest);
+    if (fs_type == "cgroup2" && 0 == access(mount_point.c_str(), W_OK)) {
+      return mount_point;
+    }
+  }
+  return fs::path();
+}
+
+/// @return whether the controller is available to the cgroups created under <code>cgroup_root</code>
+bool IsCgroupControllerAvailable(const fs::path &cgroup_root, const std::string &controller) {
+  std::ifstream controllers(cgroup_root / "cgroup.controllers");
+  for (std::string available; controllers >> available;) {
+    if (available == controller) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool AreUnprivilegedNamespacesAvailable() {
+  pid_t pid = fork();
+  if (0 == pid) {
+    _exit(0 == unshare(CLONE_NEWUSER | CLONE_NEWNS) ? 0 : 1);
+  }
+  int status;
+  waitpid(pid, &status, 0);
+  return WIFEXITED(status) && 0 == WEXITSTATUS(status);
+}
+
+/// @return whether this process may count its own user-space execution with perf events, as the runner does
+bool IsPerfEventAvailable() {
+  perf_event_attr attributes{};
+  attributes.size = sizeof(attributes);
+  attributes.type = PERF_TYPE_SOFTWARE;
+  attributes.config = PERF_COUNT_SW_TASK_CLOCK;
+  attributes.exclude_kernel = 1;
+  attributes.exclude_hv = 1;
+  int fd = static_cast<int>(syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0));
+  if (fd < 0) {
+    return false;
+  }
+  close(fd);
+  return true;
+}
+
+/// @return socket connected to the daemon listening on <code>socket_path</code>, or -1 if it has not started in time
+int ConnectToDaemon(const fs::path &socket_path) {
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+  for (int attempt = 0; attempt < 500; ++attempt) {
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (0 == connect(fd, (sockaddr *) &address, sizeof(address))) {
+      return fd;
+    }
+    close(fd);
+    usleep(10'000);
+  }
+  return -1;
+}
+
 class FunctionalTest : public ::testing::Test {
  protected:
 
@@ -104,15 +183,30 @@ class FunctionalTest : public ::testing::Test {
     free(original_working_directory_);
   }
 
-  void WithProgram(const std::string &program_text) {
+  void WithProgram(const std::string &program_text, const std::string &compiler_flags = "") {
+    Compile(program_source_file_, program_binary_file_, program_text, compiler_flags);
+  }
+
+  /// \return path to the binary of an auxiliary program, e.g. an interactor
+  fs::path WithAuxiliaryProgram(const std::string &name, const std::string &program_text) {
+    fs::path binary_file = working_directory_ / name;
+    Compile(working_directory_ / (name + ".c"), binary_file, program_text, "");
+    return binary_file;
+  }
+
+  void Compile(const fs::path &source_file,
+               const fs::path &binary_file,
+               const std::string &program_text,
+               const std::string &compiler_flags) {
     char *compiler_path = std::getenv("CC");
     if (!compiler_path) {
       throw std::runtime_error("CC environment variable is not set");
     }
 
-    WithFile(program_source_file_, program_text);
+    WithFile(source_file, program_text);
     auto compile_command =
-        compiler_path + std::string(" ") + program_source_file_.string() + " -o " + program_binary_file_.string();
+        compiler_path + std::string(" ") + compiler_flags + " " + source_file.string()
+            + " -o " + binary_file.string();
     if (int status = system(compile_command.c_str()); status == -1 || !WIFEXITED(status) || 0 != WEXITSTATUS(status)) {
       throw std::runtime_error("Compilation failed");
     }
@@ -145,6 +239,9 @@ class FunctionalTest : public ::testing::Test {
     }
   }
 
+  [[nodiscard]] const fs::path &program_binary_file() const {
+    return program_binary_file_;
+  }
   [[nodiscard]] const fs::path &program_stdout_file() const {
     return program_stdout_file_;
   }
@@ -350,4 +447,1390 @@ TEST_F(FunctionalTest, ReadSizeShrinkInterceptorShouldMakeReadSyscallToReadLessB
   auto output = ReadTextFile(program_stdout_file());
   EXPECT_LT(output.length(), input.length());
   EXPECT_EQ(output, input.substr(0, output.length()));
-}
\ No newline at end of file
+}
+
+TEST_F(FunctionalTest, ShouldReportCgroupStatisticsAndRemoveCgroupAfterExecution) {
+  fs::path cgroup_root = FindWritableCgroup2MountPoint();
+  if (cgroup_root.empty()) {
+    GTEST_SKIP() << "cgroup v2 hierarchy is not mounted or not writable";
+  }
+
+  // given:
+  WithProgram(/* language=C */ R"bibakuka(
+    int main() {
+      volatile unsigned long counter = 0;
+      for (unsigned long i = 0; i < 10000000UL; ++i) {
+        counter += i;
+      }
+    }
+  )bibakuka");
+  nlohmann::json config;
+  config[kCgroupKey] = {{"parent", cgroup_root.string()}};
+  WithConfig(config);
+
+  // when:
+  int runner_exit_status = ExecuteRunner();
+
+  // then:
+  ASSERT_EQ(runner_exit_status, 0);
+
+  // and: resource usage of the cgroup is reported
+  nlohmann::json exit_status_content = ReadJsonFile(program_exit_status_file());
+  ASSERT_EQ(exit_status_content["exitCode"], 0);
+  ASSERT_TRUE(exit_status_content.contains(kCgroupKey));
+  EXPECT_GT(exit_status_content[kCgroupKey]["cpuUsageMicros"].get<unsigned long>(), 0);
+
+  // and: the cgroup is torn down
+  for (auto &entry : fs::directory_iterator(cgroup_root)) {
+    EXPECT_EQ(entry.path().filename().string().rfind("kourt-runner-" + std::to_string(getpid()) + "-", 0),
+              std::string::npos);
+  }
+}
+
+TEST_F(FunctionalTest, SandboxedProgramShouldNotSeeHostProcessesNetworkAndFilesystem) {
+  if (!AreUnprivilegedNamespacesAvailable()) {
+    GTEST_SKIP() << "user namespaces are not available";
+  }
+
+  // given:
+  WithProgram(/* language=C */ R"bibakuka(
+    #include <arpa/inet.h>
+    #include <netinet/in.h>
+    #include <sys/socket.h>
+    #include <stdio.h>
+    #include <unistd.h>
+
+    int main() {
+      struct sockaddr_in address = {0};
+      address.sin_family = AF_INET;
+      address.sin_port = htons(80);
+      address.sin_addr.s_addr = inet_addr("1.1.1.1");
+      int sock = socket(AF_INET, SOCK_STREAM, 0);
+
+      printf("pid: %d\n", getpid());
+      printf("network: %d\n", connect(sock, (struct sockaddr *) &address, sizeof(address)) == 0);
+      printf("usr writable: %d\n", access("/usr", W_OK) == 0);
+      printf("input visible: %d\n", access("test_input_file.txt", R_OK) == 0);
+      fflush(stdout);
+      raise(10);
+    }
+  )bibakuka");
+  WithFile("test_input_file.txt", "biba");
+  nlohmann::json config;
+  config[kSandboxKey] = nlohmann::json::object();
+  WithConfig(config);
+
+  // when:
+  int runner_exit_status = ExecuteRunner();
+
+  // then:
+  ASSERT_EQ(runner_exit_status, 0);
+  ASSERT_EQ(ReadTextFile(program_stdout_file()), "pid: 2\nnetwork: 0\nusr writable: 0\ninput visible: 1\n");
+
+  // and: the program is terminated by a signal even though it is run in its own pid namespace
+  nlohmann::json exit_status_content = ReadJsonFile(program_exit_status_file());
+  ASSERT_EQ(exit_status_content["signal"], 10);
+  ASSERT_TRUE(exit_status_content[kSandboxKey].contains("setupMicros"));
+}
+
+TEST_F(FunctionalTest, BenchmarkSandboxSetupTime) {
+  if (!AreUnprivilegedNamespacesAvailable()) {
+    GTEST_SKIP() << "user namespaces are not available";
+  }
+
+  // given:
+  WithProgram(/* language=C */ R"bibakuka(
+    int main() {
+      return 0;
+    }
+  )bibakuka");
+  nlohmann::json config;
+  config[kSandboxKey] = nlohmann::json::object();
+  WithConfig(config);
+  ASSERT_EQ(ExecuteRunner(), 0); // warm up the cached rootfs
+
+  // when:
+  const int launches = 20;
+  long total_setup_micros = 0;
+  for (int i = 0; i < launches; ++i) {
+    ASSERT_EQ(ExecuteRunner(), 0);
+    total_setup_micros += ReadJsonFile(program_exit_status_file())[kSandboxKey]["setupMicros"].get<long>();
+  }
+
+  // then: the setup time is reported; it is recorded for comparison across hosts rather than checked against
+  // a threshold, which would depend on the load of the machine
+  long mean_setup_micros = total_setup_micros / launches;
+  RecordProperty("meanSandboxSetupMicros", std::to_string(mean_setup_micros));
+  EXPECT_GT(mean_setup_micros, 0);
+}
+
+TEST_F(FunctionalTest, ReadSizeShrinkInterceptorShouldInterceptSyscallsOf32BitProgram) {
+  // given: a freestanding ia32 program, so that no 32-bit libc is required on the host
+  try {
+    WithProgram(/* language=C */ R"bibakuka(
+      static long Syscall3(long number, long arg1, long arg2, long arg3) {
+        long result;
+        __asm__ volatile ("int $0x80" : "=a"(result) : "a"(number), "b"(arg1), "c"(arg2), "d"(arg3) : "memory");
+        return result;
+      }
+
+      void _start(void) {
+        enum { kRead = 3, kWrite = 4, kExit = 1, kOpen = 5 };
+        char data[10];
+        int fd = Syscall3(kOpen, (long) "test_input_file.txt", 0, 0);
+        long bytes_read = Syscall3(kRead, fd, (long) data, 10);
+        for (long bytes_written = 0; bytes_written < bytes_read;) {
+          bytes_written += Syscall3(kWrite, 1, (long) data + bytes_written, bytes_read - bytes_written);
+        }
+        Syscall3(kExit, bytes_read, 0, 0);
+      }
+    )bibakuka", "-m32 -nostdlib -static -ffreestanding -fno-pie -no-pie -fno-stack-protector");
+  } catch (std::runtime_error &) {
+    GTEST_SKIP() << "the compiler can't produce ia32 executables";
+  }
+  WithConfig(nlohmann::json::parse(R"biba(
+    {"interceptors": [{"name": "ReadSizeShrinkInterceptor"}]}
+  )biba"));
+  std::string input = "123";
+  WithFile("test_input_file.txt", input);
+
+  // when:
+  int runner_exit_status = ExecuteRunner();
+
+  // then:
+  ASSERT_EQ(runner_exit_status, 0);
+
+  // and: read syscall made with the ia32 ABI was shrunk
+  nlohmann::json exit_status_content = ReadJsonFile(program_exit_status_file());
+  ASSERT_EQ(exit_status_content["exitCode"], 1);
+  ASSERT_EQ(ReadTextFile(program_stdout_file()), "1");
+}
+
+TEST_F(FunctionalTest, ReadSizeShrinkInterceptorShouldInterceptIa32SyscallsMadeBy64BitProgram) {
+  // given: a 64-bit program making ia32 syscalls, which can only be told apart by the ABI reported by the kernel
+  WithProgram(/* language=C */ R"bibakuka(
+    #include <unistd.h>
+
+    static char data[10];
+
+    static long Ia32Syscall3(long number, long arg1, long arg2, long arg3) {
+      long result;
+      __asm__ volatile ("int $0x80" : "=a"(result) : "a"(number), "b"(arg1), "c"(arg2), "d"(arg3) : "memory");
+      return result;
+    }
+
+    int main() {
+      enum { kRead = 3, kOpen = 5 };
+      int fd = Ia32Syscall3(kOpen, (long) "test_input_file.txt", 0, 0);
+      long bytes_read = Ia32Syscall3(kRead, fd, (long) data, sizeof(data));
+      write(STDOUT_FILENO, data, bytes_read);
+      return bytes_read;
+    }
+  )bibakuka", "-fno-pie -no-pie");
+  WithConfig(nlohmann::json::parse(R"biba(
+    {"interceptors": [{"name": "ReadSizeShrinkInterceptor"}]}
+  )biba"));
+  WithFile("test_input_file.txt", "123");
+
+  // when:
+  int runner_exit_status = ExecuteRunner();
+
+  // then:
+  ASSERT_EQ(runner_exit_status, 0);
+
+  // and:
+  nlohmann::json exit_status_content = ReadJsonFile(program_exit_status_file());
+  ASSERT_EQ(exit_status_content["exitCode"], 1);
+  ASSERT_EQ(ReadTextFile(program_stdout_file()), "1");
+}
+
+TEST_F(FunctionalTest, DaemonShouldExecuteJobsSubmittedThroughSocket) {
+  // given:
+  WithProgram(/* language=C */ R"bibakuka(
+    #include <stdio.h>
+
+    int main(int argc, char *argv[]) {
+      int code;
+      scanf("%d", &code);
+      printf("%s %d\n", argv[1], code);
+      return code;
+    }
+  )bibakuka");
+  const fs::path socket_path = fs::current_path() / "runner.sock";
+  int daemon_exit_code = -1;
+  std::thread daemon([&] {
+    const char *argv[] = {"runner", "--daemon", socket_path.c_str(), nullptr};
+    daemon_exit_code = RunnerMain(3, const_cast<char *const *>(argv));
+  });
+  int client = ConnectToDaemon(socket_path);
+  ASSERT_NE(client, -1);
+
+  // when:
+  std::string requests;
+  for (int id = 1; id <= 3; ++id) {
+    nlohmann::json request = {
+        {"id", id},
+        {"executable", program_binary_file()},
+        {"argv", {"job" + std::to_string(id)}},
+        {"stdin", std::to_string(id) + "\n"},
+        {"config", {
+            {kStdoutFileKey, "stdout-" + std::to_string(id) + ".txt"},
+            {kWorkingDirectoryKey, fs::current_path()}
+        }}
+    };
+    requests += request.dump() + "\n";
+  }
+  ASSERT_EQ(write(client, requests.data(), requests.size()), (ssize_t) requests.size());
+  FILE *responses_stream = fdopen(client, "r");
+  std::vector<nlohmann::json> responses;
+  char *line = nullptr;
+  size_t line_capacity = 0;
+  while (responses.size() < 3 && getline(&line, &line_capacity, responses_stream) > 0) {
+    responses.push_back(nlohmann::json::parse(line));
+  }
+  free(line);
+  std::string shutdown_request = R"({"shutdown": true})" "\n";
+  write(client, shutdown_request.data(), shutdown_request.size());
+  daemon.join();
+  fclose(responses_stream);
+
+  // then:
+  ASSERT_EQ(daemon_exit_code, 0);
+  ASSERT_EQ(responses.size(), 3);
+  for (auto &response : responses) {
+    int id = response["id"];
+    ASSERT_EQ(response["exitStatus"]["exitCode"], id);
+    const std::string expected_stdout = "job" + std::to_string(id) + " " + std::to_string(id) + "\n";
+    ASSERT_EQ(ReadTextFile("stdout-" + std::to_string(id) + ".txt"), expected_stdout);
+  }
+
+  // and: the socket is removed on shutdown
+  ASSERT_FALSE(fs::exists(socket_path));
+}
+
+TEST_F(FunctionalTest, DaemonShouldAnswerRejectedJobWithItsId) {
+  // given:
+  const fs::path socket_path = fs::current_path() / "runner.sock";
+  int daemon_exit_code = -1;
+  std::thread daemon([&] {
+    const char *argv[] = {"runner", "--daemon", socket_path.c_str(), nullptr};
+    daemon_exit_code = RunnerMain(3, const_cast<char *const *>(argv));
+  });
+  int client = ConnectToDaemon(socket_path);
+  ASSERT_NE(client, -1);
+
+  // when: the scheduler rejects the job
+  std::string request = R"({"id": 42, "weight": 0, "executable": "/bin/true", "config": {}})" "\n";
+  ASSERT_EQ(write(client, request.data(), request.size()), (ssize_t) request.size());
+  FILE *responses_stream = fdopen(client, "r");
+  char *line = nullptr;
+  size_t line_capacity = 0;
+  ASSERT_GT(getline(&line, &line_capacity, responses_stream), 0);
+  nlohmann::json response = nlohmann::json::parse(line);
+  free(line);
+  std::string shutdown_request = R"({"shutdown": true})" "\n";
+  write(client, shutdown_request.data(), shutdown_request.size());
+  daemon.join();
+  fclose(responses_stream);
+
+  // then:
+  ASSERT_EQ(daemon_exit_code, 0);
+  ASSERT_EQ(response["id"], 42);
+  ASSERT_TRUE(response.contains("error"));
+}
+
+TEST_F(FunctionalTest, DaemonShouldRejectConfigWithoutWorkers) {
+  for (const char *workers : {"0", "-1"}) {
+    // given
+    WithFile("daemon.json", std::string(R"({"workers": )") + workers + "}");
+    const fs::path socket_path = fs::current_path() / "runner.sock";
+    const fs::path daemon_config = fs::current_path() / "daemon.json";
+
+    // when
+    int daemon_exit_code = -1;
+    std::thread daemon([&] {
+      const char *argv[] = {"runner", "--daemon", socket_path.c_str(), daemon_config.c_str(), nullptr};
+      daemon_exit_code = RunnerMain(4, const_cast<char *const *>(argv));
+    });
+    daemon.join();
+
+    // then: the daemon fails on start rather than never running a job
+    EXPECT_NE(daemon_exit_code, 0) << "workers=" << workers;
+    EXPECT_FALSE(fs::exists(socket_path)) << "workers=" << workers;
+  }
+}
+
+TEST_F(FunctionalTest, DaemonShouldShareWorkersFairlyBetweenSubmissionsAndPrioritizeInteractiveJobs) {
+  // given: a program which may wait until the test lets it finish
+  WithProgram(/* language=C */ R"bibakuka(
+    #include <fcntl.h>
+    #include <string.h>
+    #include <unistd.h>
+
+    int main(int argc, char *argv[]) {
+      if (argc > 1 && 0 == strcmp(argv[1], "wait")) {
+        char byte;
+        close(creat("started", 0644));
+        read(open("gate.fifo", O_RDONLY), &byte, 1);
+      }
+      return 0;
+    }
+  )bibakuka");
+  ASSERT_EQ(mkfifo("gate.fifo", 0600), 0);
+  WithFile("daemon.json", R"({"workers": 1})");
+  const fs::path socket_path = fs::current_path() / "runner.sock";
+  const fs::path daemon_config = fs::current_path() / "daemon.json";
+  std::thread daemon([&] {
+    const char *argv[] = {"runner", "--daemon", socket_path.c_str(), daemon_config.c_str(), nullptr};
+    RunnerMain(4, const_cast<char *const *>(argv));
+  });
+  int client = ConnectToDaemon(socket_path);
+  ASSERT_NE(client, -1);
+  auto make_job = [this](const std::string &id, const std::string &submission, bool interactive) {
+    return nlohmann::json{
+        {"id", id},
+        {"executable", program_binary_file()},
+        {"argv", {id == "heavy-1" ? "wait" : "run"}},
+        {"submission", submission},
+        {"interactive", interactive},
+        {"config", {{kWorkingDirectoryKey, fs::current_path()}}}
+    }.dump() + "\n";
+  };
+
+  // when: a heavy submission occupies the only worker, and other jobs are queued meanwhile
+  std::string requests = make_job("heavy-1", "heavy", false);
+  ASSERT_EQ(write(client, requests.data(), requests.size()), (ssize_t) requests.size());
+  for (int attempt = 0; attempt < 500 && !fs::exists("started"); ++attempt) {
+    usleep(10'000);
+  }
+  requests.clear();
+  for (int i = 2; i <= 5; ++i) {
+    requests += make_job("heavy-" + std::to_string(i), "heavy", false);
+  }
+  requests += make_job("light-1", "light", false) + make_job("light-2", "light", false);
+  requests += make_job("sample", "light", true);
+  ASSERT_EQ(write(client, requests.data(), requests.size()), (ssize_t) requests.size());
+  usleep(100'000);
+  int gate = open("gate.fifo", O_WRONLY);
+  ASSERT_EQ(write(gate, "x", 1), 1);
+  close(gate);
+
+  FILE *responses_stream = fdopen(client, "r");
+  std::vector<std::string> completion_order;
+  char *line = nullptr;
+  size_t line_capacity = 0;
+  while (completion_order.size() < 8 && getline(&line, &line_capacity, responses_stream) > 0) {
+    nlohmann::json response = nlohmann::json::parse(line);
+    ASSERT_TRUE(response.contains("exitStatus")) << response;
+    ASSERT_TRUE(response["scheduling"].contains("waitMicros"));
+    completion_order.push_back(response["id"]);
+  }
+  std::string requests_tail = R"({"id": "stats", "statistics": true})" "\n" R"({"shutdown": true})" "\n";
+  write(client, requests_tail.data(), requests_tail.size());
+  ASSERT_GT(getline(&line, &line_capacity, responses_stream), 0);
+  nlohmann::json statistics = nlohmann::json::parse(line)["statistics"];
+  free(line);
+  daemon.join();
+  fclose(responses_stream);
+
+  // then: the interactive job goes first, and the submissions take turns
+  std::vector<std::string> expected_order =
+      {"heavy-1", "sample", "light-1", "heavy-2", "light-2", "heavy-3", "heavy-4", "heavy-5"};
+  ASSERT_EQ(completion_order, expected_order);
+
+  // and:
+  ASSERT_EQ(statistics["queueDepth"], 0);
+  ASSERT_EQ(statistics["batch"]["dispatched"], 7);
+  ASSERT_EQ(statistics["interactive"]["dispatched"], 1);
+}
+
+TEST_F(FunctionalTest, ShouldExposeMetricsInPrometheusTextFormat) {
+  // given:
+  WithProgram(/* language=C */ R"bibakuka(
+    int main() {
+      return 3;
+    }
+  )bibakuka");
+  const fs::path metrics_file = fs::current_path() / "metrics.prom";
+  // with no interceptors the tracee would run untraced, and there would be no stops to count
+  WithConfig({{kMetricsFileKey, metrics_file}, {kTraceAllSyscallsKey, true}});
+
+  // when:
+  int runner_exit_status = ExecuteRunner();
+
+  // then:
+  ASSERT_EQ(runner_exit_status, 0);
+
+  // and: metrics are accumulated over the whole process, so only their presence and lower bounds are checked
+  std::unordered_map<std::string, double> samples;
+  for (auto &line : ReadLines(metrics_file)) {
+    if (!line.empty() && line[0] != '#') {
+      auto separator = line.rfind(' ');
+      samples[line.substr(0, separator)] = std::stod(line.substr(separator + 1));
+    }
+  }
+  EXPECT_GE(samples["kourt_runner_launches_total"], 1);
+  EXPECT_GE(samples["kourt_runner_verdicts_total{verdict=\"exited_non_zero\"}"], 1);
+  EXPECT_GE(samples["kourt_runner_stops_total{type=\"before_syscall\"}"], 1);
+  EXPECT_GE(samples["kourt_runner_stops_total{type=\"before_termination\"}"], 1);
+  EXPECT_GE(samples["kourt_runner_tracee_run_seconds_count"],
+            samples["kourt_runner_stops_total{type=\"before_syscall\"}"]);
+  EXPECT_EQ(samples["kourt_runner_interceptor_seconds_bucket{le=\"+Inf\"}"],
+            samples["kourt_runner_interceptor_seconds_count"]);
+}
+
+TEST_F(FunctionalTest, ShouldExecuteFromMemoryAndInlineOutputsIntoExitStatus) {
+  // given:
+  WithConfig({{kExecutableInMemoryKey, true}, {kOutputsInMemoryKey, true}});
+  WithProgram(/* language=C */ R"bibakuka(
+    #include <stdio.h>
+
+    int main() {
+      printf("first");
+      fprintf(stderr, "error");
+      return 0;
+    }
+  )bibakuka");
+  ASSERT_EQ(ExecuteRunner(), 0);
+
+  // when: the executable is replaced after it has been loaded into memory
+  WithProgram(/* language=C */ R"bibakuka(
+    #include <stdio.h>
+
+    int main() {
+      printf("second");
+      return 0;
+    }
+  )bibakuka");
+  int runner_exit_status = ExecuteRunner();
+
+  // then:
+  ASSERT_EQ(runner_exit_status, 0);
+
+  // and: the new executable is run, and its outputs are not written to files
+  nlohmann::json exit_status_content = ReadJsonFile(program_exit_status_file());
+  ASSERT_EQ(exit_status_content["exitCode"], 0);
+  ASSERT_EQ(exit_status_content["stdout"], "second");
+  ASSERT_EQ(exit_status_content["stderr"], "");
+  ASSERT_FALSE(fs::exists(program_stdout_file()));
+}
+
+TEST_F(FunctionalTest, ShouldConnectProgramWithInteractorAndLogTheirTraffic) {
+  // given
+  WithProgram(/* language=C */ R"bibakuka(
+    #include <stdio.h>
+    int main() {
+      int low = 1, high = 1000000;
+      char reply[2];
+      while (low <= high) {
+        int guess = low + (high - low) / 2;
+        printf("%d\n", guess);
+        fflush(stdout);
+        if (scanf("%1s", reply) != 1 || reply[0] == '=') {
+          return 0;
+        }
+        if (reply[0] == '<') {
+          high = guess - 1;
+        } else {
+          low = guess + 1;
+        }
+      }
+      return 1;
+    }
+  )bibakuka");
+  fs::path interactor = WithAuxiliaryProgram("interactor", /* language=C */ R"bibakuka(
+    #include <stdio.h>
+    int main() {
+      const int secret = 271828;
+      for (int guesses = 1; guesses <= 20; ++guesses) {
+        int guess;
+        if (scanf("%d", &guess) != 1) {
+          fprintf(stderr, "no guess\n");
+          return 2;
+        }
+        printf("%s\n", guess < secret ? ">" : guess > secret ? "<" : "=");
+        fflush(stdout);
+        if (guess == secret) {
+          fprintf(stderr, "guessed in %d\n", guesses);
+          return 0;
+        }
+      }
+      return 1;
+    }
+  )bibakuka");
+  WithConfig({{kInteractorKey, {{"executable", interactor.string()},
+                                {"traceeOutputLogFile", "tracee-output.log"},
+                                {"interactorOutputLogFile", "interactor-output.log"}}}});
+
+  // when
+  int runner_exit_status = ExecuteRunner();
+
+  // then
+  ASSERT_EQ(0, runner_exit_status);
+  auto exit_status = nlohmann::json::parse(ReadTextFile(program_exit_status_file()));
+  EXPECT_EQ(0, exit_status["exitCode"]);
+  EXPECT_EQ(0, exit_status[kInteractorKey]["exitCode"]);
+  EXPECT_EQ("guessed in 19\n", ReadTextFile("interactor-stderr.txt"));
+  auto guesses = ReadLines("tracee-output.log");
+  auto replies = ReadLines("interactor-output.log");
+  ASSERT_EQ(19u, guesses.size());
+  ASSERT_EQ(19u, replies.size());
+  EXPECT_EQ("500000", guesses.front());
+  EXPECT_EQ("271828", guesses.back());
+  EXPECT_EQ("<", replies.front());
+  EXPECT_EQ("=", replies.back());
+}
+
+TEST_F(FunctionalTest, ShouldReportInteractorFailureInVerdict) {
+  // given: the program gives up after a single guess, which the interactor doesn't accept
+  WithProgram(/* language=C */ R"bibakuka(
+    #include <stdio.h>
+    int main() {
+      char reply[2];
+      printf("1\n");
+      fflush(stdout);
+      return scanf("%1s", reply) == 1 ? 0 : 1;
+    }
+  )bibakuka");
+  fs::path interactor = WithAuxiliaryProgram("interactor", /* language=C */ R"bibakuka(
+    #include <stdio.h>
+    int main() {
+      int guess;
+      while (scanf("%d", &guess) == 1) {
+        printf(">\n");
+        fflush(stdout);
+      }
+      return 2;
+    }
+  )bibakuka");
+  WithConfig({{kInteractorKey, {{"executable", interactor.string()}}}});
+
+  // when
+  int runner_exit_status = ExecuteRunner();
+
+  // then
+  ASSERT_EQ(0, runner_exit_status);
+  auto exit_status = nlohmann::json::parse(ReadTextFile(program_exit_status_file()));
+  EXPECT_EQ(0, exit_status["exitCode"]);
+  EXPECT_EQ(2, exit_status[kInteractorKey]["exitCode"]);
+  EXPECT_EQ("interactorFailed", exit_status["verdict"]);
+}
+
+TEST_F(FunctionalTest, ShouldRejectInteractorCombinedWithStdinFile) {
+  // given
+  WithProgram(/* language=C */ R"bibakuka(
+    int main() {
+      return 0;
+    }
+  )bibakuka");
+  WithFile("input.txt", "1\n");
+  WithConfig({{kInteractorKey, {{"executable", "/bin/cat"}}}, {kStdinFileKey, "input.txt"}});
+
+  // when
+  int runner_exit_status = ExecuteRunner();
+
+  // then
+  ASSERT_EQ(1, runner_exit_status);
+}
+
+TEST_F(FunctionalTest, SignalStormInterceptorShouldInterruptSyscallsWithInjectedSignals) {
+  // given
+  WithProgram(/* language=C */ R"bibakuka(
+    #include <errno.h>
+    #include <signal.h>
+    #include <stdio.h>
+    #include <string.h>
+    #include <time.h>
+
+    static volatile sig_atomic_t handled = 0;
+
+    static void handle(int signal_number) {
+      ++handled;
+    }
+
+    int main() {
+      struct sigaction action;
+      memset(&action, 0, sizeof(action));
+      action.sa_handler = handle;  // no SA_RESTART, so interrupted sleeps fail with EINTR
+      sigaction(SIGUSR1, &action, NULL);
+      int interrupted = 0;
+      for (int i = 0; i < 10000; ++i) {
+        struct timespec duration = {3600, 0};
+        if (nanosleep(&duration, NULL) != 0 && errno == EINTR) {
+          ++interrupted;
+        }
+      }
+      printf("%d %d\n", interrupted, (int) handled);
+      return 0;
+    }
+  )bibakuka");
+  WithConfig({{"interceptors", {{{"name", "SignalStormInterceptor"},
+                                 {"signal", SIGUSR1},
+                                 {"syscalls", {"nanosleep", "clock_nanosleep"}}}}}});
+
+  // when
+  int runner_exit_status = ExecuteRunner();
+
+  // then
+  ASSERT_EQ(0, runner_exit_status);
+  auto exit_status = nlohmann::json::parse(ReadTextFile(program_exit_status_file()));
+  EXPECT_EQ(0, exit_status["exitCode"]);
+  EXPECT_EQ("10000 10000\n", ReadTextFile(program_stdout_file()));
+}
+
+TEST_F(FunctionalTest, EmulationInterceptorShouldServeStdinClockAndRandomFromRunner) {
+  // given
+  WithProgram(/* language=C */ R"bibakuka(
+    #include <stdio.h>
+    #include <sys/random.h>
+    #include <time.h>
+    int main() {
+      long long sum = 0, value;
+      while (scanf("%lld", &value) == 1) {
+        sum += value;
+      }
+      struct timespec first, second;
+      clock_gettime(CLOCK_MONOTONIC, &first);
+      clock_gettime(CLOCK_REALTIME, &second);
+      unsigned long long random_value;
+      getrandom(&random_value, sizeof(random_value), 0);
+      printf("%lld %ld.%09ld %ld.%09ld %llx\n", sum,
+             (long) first.tv_sec, first.tv_nsec, (long) second.tv_sec, second.tv_nsec, random_value);
+      return 0;
+    }
+  )bibakuka");
+  std::string input;
+  for (int i = 1; i <= 100000; ++i) {
+    input += std::to_string(i) + "\n";
+  }
+  WithFile("input.txt", input);
+  WithConfig({{"interceptors", {{{"name", "EmulationInterceptor"},
+                                 {"stdinFile", "input.txt"},
+                                 {"clock", {{"startNanos", 5'999'999'500}, {"stepNanos", 1'000}}},
+                                 {"randomSeed", 42}}}}});
+
+  // when
+  int first_exit_status = ExecuteRunner();
+  std::string first_output = ReadTextFile(program_stdout_file());
+  int second_exit_status = ExecuteRunner();
+  std::string second_output = ReadTextFile(program_stdout_file());
+
+  // then
+  ASSERT_EQ(0, first_exit_status);
+  ASSERT_EQ(0, second_exit_status);
+  EXPECT_EQ(0, nlohmann::json::parse(ReadTextFile(program_exit_status_file()))["exitCode"]);
+  EXPECT_EQ(0u, first_output.find("5000050000 5.999999500 6.000000500 ")) << first_output;
+  EXPECT_EQ(first_output, second_output);
+}
+
+TEST_F(FunctionalTest, ShouldAppendVersionedResultsToSingleBinaryFile) {
+  // given
+  WithProgram(/* language=C */ R"bibakuka(
+    #include <stdio.h>
+    #include <stdlib.h>
+    int main(int argc, char *argv[]) {
+      printf("hello\n");
+      return atoi(argv[1]);
+    }
+  )bibakuka");
+  const fs::path results_file = fs::current_path() / "results.bin";
+
+  // when
+  for (const char *exit_code : {"0", "3"}) {
+    WithConfig({{kExitStatusFileKey, results_file},
+                {kResultFormatKey, "binary"},
+                {kResultIdKey, std::string("test-") + exit_code},
+                {kOutputDigestsKey, true}});
+    std::string argv0 = "runner";
+    const char *argv[] = {argv0.c_str(), "config.json", program_binary_file().c_str(), exit_code, nullptr};
+    ASSERT_EQ(0, RunnerMain(4, const_cast<char *const *>(argv)));
+  }
+
+  // then
+  ResultReader reader(results_file);
+  auto first = reader.Next();
+  auto second = reader.Next();
+  ASSERT_TRUE(first && second);
+  EXPECT_FALSE(reader.Next());
+  EXPECT_EQ(kResultSchemaVersion, (*first)["schemaVersion"]);
+  EXPECT_EQ("test-0", (*first)["id"]);
+  EXPECT_EQ("ok", (*first)["verdict"]);
+  EXPECT_EQ("test-3", (*second)["id"]);
+  EXPECT_EQ("nonZeroExitCode", (*second)["verdict"]);
+  EXPECT_EQ(3, (*second)["exitCode"]);
+  EXPECT_EQ("sha256:5891b5b522d5df086d0ff0b110fbd9d21bb4fc7163af34d08286a2e846f6be03",
+            (*second)["outputDigests"]["stdout"]);
+  EXPECT_EQ("sha256:e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855",
+            (*second)["outputDigests"]["stderr"]);
+  EXPECT_GT((*second)["resourceUsage"]["maxRssKiB"], 0);
+  EXPECT_TRUE((*second)["interceptors"].empty());
+}
+
+/// @return number of the syscall-enter-stops handled by the runner process so far.
+static double StopsBeforeSyscall() {
+  const std::string sample = "kourt_runner_stops_total{type=\"before_syscall\"} ";
+  const std::string metrics = RenderMetrics();
+  return std::stod(metrics.substr(metrics.find(sample) + sample.size()));
+}
+
+TEST_F(FunctionalTest, BufferingDetectorInterceptorShouldReportUnbufferedOutputStoppingOnIoOnly) {
+  // given
+  WithProgram(/* language=C */ R"bibakuka(
+    #include <stdio.h>
+    #include <unistd.h>
+    int main() {
+      for (int i = 0; i < 2000; ++i) {
+        putchar('x');
+        fflush(stdout);
+      }
+      for (int i = 0; i < 20000; ++i) {
+        getppid();
+      }
+      return 0;
+    }
+  )bibakuka");
+  WithConfig({{kSyscallFilterKey, true}, {"interceptors", {{{"name", "BufferingDetectorInterceptor"}}}}});
+  const double stops_before = StopsBeforeSyscall();
+
+  // when
+  int runner_exit_status = ExecuteRunner();
+
+  // then
+  ASSERT_EQ(0, runner_exit_status);
+  auto exit_status = nlohmann::json::parse(ReadTextFile(program_exit_status_file()));
+  EXPECT_EQ(0, exit_status["exitCode"]);
+  auto statistics = exit_status["interceptors"][0];
+  EXPECT_EQ(2000, statistics["fds"]["1"]["writes"]["calls"]);
+  EXPECT_EQ(2000, statistics["fds"]["1"]["writes"]["histogram"][1]);
+  ASSERT_EQ(1, statistics["findings"].size()) << statistics.dump();
+  EXPECT_EQ("1", statistics["findings"][0]["fd"]);
+  EXPECT_EQ("writes", statistics["findings"][0]["direction"]);
+
+  // and: the getppid calls haven't stopped the tracee
+  EXPECT_LT(StopsBeforeSyscall() - stops_before, 3000);
+}
+
+TEST_F(FunctionalTest, InterceptorsNamingTheirSyscallsShouldNotBreakForkingPrograms) {
+  // given: the children of the tracee aren't traced
+  WithProgram(/* language=C */ R"bibakuka(
+    #include <stdio.h>
+    #include <stdlib.h>
+    #include <sys/wait.h>
+    #include <unistd.h>
+    int main() {
+      if (fork() == 0) {
+        write(1, "child\n", 6);
+        return 0;
+      }
+      wait(NULL);
+      fflush(stdout);
+      printf("system %d\n", system("echo shell"));
+      return 0;
+    }
+  )bibakuka");
+  WithConfig({{"interceptors", {{{"name", "BufferingDetectorInterceptor"}}}}});
+
+  // when
+  int runner_exit_status = ExecuteRunner();
+
+  // then
+  ASSERT_EQ(0, runner_exit_status);
+  EXPECT_EQ("child\nshell\nsystem 0\n", ReadTextFile(program_stdout_file()));
+  auto exit_status = nlohmann::json::parse(ReadTextFile(program_exit_status_file()));
+  EXPECT_EQ("ok", exit_status["verdict"]);
+}
+
+TEST_F(FunctionalTest, ShouldRunProgramUntracedWithoutInterceptors) {
+  // given
+  WithProgram(/* language=C */ R"bibakuka(
+    #include <stdio.h>
+    #include <sys/ptrace.h>
+    int main() {
+      // fails if the process is traced already
+      printf("%s\n", ptrace(PTRACE_TRACEME, 0, NULL, NULL) == 0 ? "untraced" : "traced");
+      return 5;
+    }
+  )bibakuka");
+  WithConfig({{"interceptors", nlohmann::json::array()}});
+  const double stops_before = StopsBeforeSyscall();
+
+  // when
+  int runner_exit_status = ExecuteRunner();
+
+  // then
+  ASSERT_EQ(0, runner_exit_status);
+  EXPECT_EQ("untraced\n", ReadTextFile(program_stdout_file()));
+  auto exit_status = nlohmann::json::parse(ReadTextFile(program_exit_status_file()));
+  EXPECT_EQ(5, exit_status["exitCode"]);
+  EXPECT_EQ("nonZeroExitCode", exit_status["verdict"]);
+  EXPECT_GT(exit_status["resourceUsage"]["maxRssKiB"], 0);
+  EXPECT_EQ(stops_before, StopsBeforeSyscall());
+}
+
+TEST_F(FunctionalTest, ForkServerShouldRunEachTestOffSingleStartedSolution) {
+  // given
+  WithProgram(/* language=C */ R"bibakuka(
+    #include <stdio.h>
+    int main() {
+      fprintf(stderr, "started\n");
+      printf("sum: ");
+      long long value, sum = 0;
+      while (scanf("%lld", &value) == 1) {
+        sum += value;
+      }
+      printf("%lld\n", sum);
+      return sum == 6;
+    }
+  )bibakuka");
+  WithFile("1.in", "1 2");
+  WithFile("2.in", "1 2 3");
+  WithFile("3.in", "40 2");
+  nlohmann::json tests = nlohmann::json::array();
+  for (const char *test : {"1", "2", "3"}) {
+    tests.push_back({{kStdinFileKey, std::string(test) + ".in"}, {kStdoutFileKey, std::string(test) + ".out"}});
+  }
+  WithConfig({{kForkServerKey, {{"tests", tests}}}});
+
+  // when
+  int runner_exit_status = ExecuteRunner();
+
+  // then
+  ASSERT_EQ(0, runner_exit_status);
+  auto exit_status = nlohmann::json::parse(ReadTextFile(program_exit_status_file()));
+  EXPECT_TRUE(exit_status[kForkServerKey]["snapshot"].get<bool>());
+  ASSERT_EQ(3, exit_status["tests"].size());
+  EXPECT_EQ("ok", exit_status["tests"][0]["verdict"]);
+  EXPECT_EQ(1, exit_status["tests"][1]["exitCode"]);
+  EXPECT_EQ("ok", exit_status["tests"][2]["verdict"]);
+  EXPECT_EQ("nonZeroExitCode", exit_status["verdict"]);
+  EXPECT_EQ("sum: 3\n", ReadTextFile("1.out"));
+  EXPECT_EQ("sum: 6\n", ReadTextFile("2.out"));
+  EXPECT_EQ("sum: 42\n", ReadTextFile("3.out"));
+
+  // and: the solution has been started once
+  EXPECT_EQ("started\n", ReadTextFile(program_stderr_file()));
+}
+
+TEST_F(FunctionalTest, ForkServerShouldReportCgroupLimitsHitByEachTest) {
+  fs::path cgroup_root = FindWritableCgroup2MountPoint();
+  if (cgroup_root.empty() || !IsCgroupControllerAvailable(cgroup_root, "memory")) {
+    GTEST_SKIP() << "cgroup v2 hierarchy with the memory controller is not mounted or not writable";
+  }
+
+  // given: the second test runs out of the memory of the cgroup shared by the tests
+  WithProgram(/* language=C */ R"bibakuka(
+    #include <stdio.h>
+    #include <stdlib.h>
+    #include <string.h>
+    int main() {
+      long mebibytes;
+      if (scanf("%ld", &mebibytes) != 1) {
+        return 1;
+      }
+      char *memory = malloc(mebibytes << 20);
+      memset(memory, 1, mebibytes << 20);
+      printf("%d\n", memory[mebibytes]);
+      return 0;
+    }
+  )bibakuka");
+  nlohmann::json tests = nlohmann::json::array();
+  for (const char *test : {"1", "512", "2"}) {
+    WithFile(std::string(test) + ".in", test);
+    tests.push_back({{kStdinFileKey, std::string(test) + ".in"}, {kStdoutFileKey, std::string(test) + ".out"}});
+  }
+  WithConfig({{kForkServerKey, {{"tests", tests}}},
+              {kCgroupKey, {{"parent", cgroup_root.string()}, {"memoryMax", 64 << 20}}}});
+
+  // when
+  int runner_exit_status = ExecuteRunner();
+
+  // then
+  ASSERT_EQ(0, runner_exit_status);
+  auto exit_status = nlohmann::json::parse(ReadTextFile(program_exit_status_file()));
+  ASSERT_EQ(3, exit_status["tests"].size());
+  EXPECT_EQ(nlohmann::json::array(), exit_status["tests"][0]["limitsHit"]);
+  EXPECT_EQ(nlohmann::json::array({"memory"}), exit_status["tests"][1]["limitsHit"]);
+  EXPECT_EQ("memoryLimitExceeded", exit_status["tests"][1]["verdict"]);
+  EXPECT_EQ(nlohmann::json::array(), exit_status["tests"][2]["limitsHit"]);
+  EXPECT_EQ("ok", exit_status["tests"][2]["verdict"]);
+}
+
+TEST_F(FunctionalTest, ForkServerShouldRejectOutputsItDoesNotCollect) {
+  // given
+  WithProgram(/* language=C */ R"bibakuka(
+    int main() {
+      return 0;
+    }
+  )bibakuka");
+  WithFile("1.in", "");
+  nlohmann::json tests = {{{kStdinFileKey, "1.in"}, {kStdoutFileKey, "1.out"}}};
+
+  for (const char *key : {kOutputsInMemoryKey, kOutputDigestsKey}) {
+    WithConfig({{kForkServerKey, {{"tests", tests}}}, {key, true}});
+
+    // when
+    int runner_exit_status = ExecuteRunner();
+
+    // then
+    EXPECT_EQ(1, runner_exit_status) << key;
+  }
+}
+
+TEST_F(FunctionalTest, ShouldKillProgramExceedingInstructionLimit) {
+  if (!IsPerfEventAvailable()) {
+    GTEST_SKIP() << "perf events are not available";
+  }
+
+  // given
+  WithProgram(/* language=C */ R"bibakuka(
+    #include <signal.h>
+    int main() {
+      // the overflow signal can't save the program
+      signal(SIGXCPU, SIG_IGN);
+      for (volatile unsigned long i = 0;; ++i) {
+      }
+    }
+  )bibakuka");
+  WithConfig({{kInstructionLimitKey, 10'000'000}});
+
+  // when
+  int runner_exit_status = ExecuteRunner();
+
+  // then
+  ASSERT_EQ(0, runner_exit_status);
+  auto exit_status = nlohmann::json::parse(ReadTextFile(program_exit_status_file()));
+  EXPECT_EQ("instructionLimitExceeded", exit_status["verdict"]);
+  EXPECT_EQ(nlohmann::json::array({"instructions"}), exit_status["limitsHit"]);
+  EXPECT_EQ(SIGKILL, exit_status["signal"]);
+  EXPECT_EQ(10'000'000, exit_status["instructions"]["limit"]);
+  EXPECT_GE(exit_status["instructions"]["count"].get<unsigned long>(), 10'000'000UL);
+}
+
+TEST_F(FunctionalTest, InstructionLimitShouldCountAllThreads) {
+  if (!IsPerfEventAvailable()) {
+    GTEST_SKIP() << "perf events are not available";
+  }
+
+  // given: the main thread only waits for the others doing the work
+  WithProgram(/* language=C */ R"bibakuka(
+    #include <pthread.h>
+    static void *work(void *argument) {
+      for (volatile unsigned long i = 0; i < 1000000000UL; ++i) {
+      }
+      return NULL;
+    }
+    int main() {
+      pthread_t threads[2];
+      for (int i = 0; i < 2; ++i) {
+        pthread_create(&threads[i], NULL, work, NULL);
+      }
+      for (int i = 0; i < 2; ++i) {
+        pthread_join(threads[i], NULL);
+      }
+      return 0;
+    }
+  )bibakuka", "-pthread");
+  WithConfig({{kInstructionLimitKey, 10'000'000}});
+
+  // when
+  int runner_exit_status = ExecuteRunner();
+
+  // then
+  ASSERT_EQ(0, runner_exit_status);
+  auto exit_status = nlohmann::json::parse(ReadTextFile(program_exit_status_file()));
+  EXPECT_EQ("instructionLimitExceeded", exit_status["verdict"]);
+  EXPECT_EQ(SIGKILL, exit_status["signal"]);
+  EXPECT_GE(exit_status["instructions"]["count"].get<unsigned long>(), 10'000'000UL);
+  // a sixteenth of the limit per thread, and what they retire until the kill
+  EXPECT_LT(exit_status["instructions"]["count"].get<unsigned long>(), 20'000'000UL);
+}
+
+TEST_F(FunctionalTest, ShouldRunProgramPinnedWithoutAslrInFixedEnvironment) {
+  // given
+  WithProgram(/* language=C */ R"bibakuka(
+    #define _GNU_SOURCE
+    #include <sched.h>
+    #include <stdio.h>
+    #include <sys/personality.h>
+    extern char **environ;
+    int main() {
+      printf("cpu %d\n", sched_getcpu());
+      printf("aslr %s\n", personality(0xffffffff) & ADDR_NO_RANDOMIZE ? "off" : "on");
+      for (char **variable = environ; *variable; ++variable) {
+        printf("%s\n", *variable);
+      }
+    }
+  )bibakuka");
+  WithConfig({{kReproducibleTimingKey, {{"cpu", 0}, {"environment", {{"LANG", "C"}, {"TZ", "UTC"}}}}}});
+
+  // when
+  int runner_exit_status = ExecuteRunner();
+
+  // then
+  ASSERT_EQ(0, runner_exit_status);
+  EXPECT_EQ("cpu 0\naslr off\nLANG=C\nTZ=UTC\n", ReadTextFile(program_stdout_file()));
+  auto exit_status = nlohmann::json::parse(ReadTextFile(program_exit_status_file()));
+  EXPECT_EQ(0, exit_status[kReproducibleTimingKey]["cpu"]);
+  EXPECT_EQ("other", exit_status[kReproducibleTimingKey]["scheduler"]);
+}
+
+TEST_F(FunctionalTest, ShouldRepeatRunsAndReportTimePercentiles) {
+  // given
+  WithProgram(/* language=C */ R"bibakuka(
+    #include <stdio.h>
+    int main() {
+      long long a, b;
+      scanf("%lld %lld", &a, &b);
+      printf("%lld\n", a + b);
+      FILE *runs = fopen("runs.log", "a");
+      fputs("run\n", runs);
+      fclose(runs);
+    }
+  )bibakuka");
+  WithFile("input.txt", "2 3\n");
+  WithConfig({{kStdinFileKey, "input.txt"},
+              {kRepeatKey, {{"warmupRuns", 1}, {"measuredRuns", 5}, {"relativeConfidence", 0}}}});
+
+  // when
+  int runner_exit_status = ExecuteRunner();
+
+  // then
+  ASSERT_EQ(0, runner_exit_status);
+  EXPECT_EQ("5\n", ReadTextFile(program_stdout_file()));
+  EXPECT_EQ("run\nrun\nrun\nrun\nrun\nrun\n", ReadTextFile("runs.log"));
+  auto exit_status = nlohmann::json::parse(ReadTextFile(program_exit_status_file()));
+  EXPECT_EQ("ok", exit_status["verdict"]);
+  const auto &repeat = exit_status[kRepeatKey];
+  EXPECT_EQ(1, repeat["warmupRuns"]);
+  EXPECT_EQ(5, repeat["measuredRuns"]);
+  EXPECT_EQ(false, repeat["stoppedEarly"]);
+  for (const char *measure : {"wallMicros", "cpuMicros"}) {
+    EXPECT_LE(repeat[measure]["min"], repeat[measure]["median"]);
+    EXPECT_LE(repeat[measure]["median"], repeat[measure]["p90"]);
+    EXPECT_LE(repeat[measure]["p90"], repeat[measure]["max"]);
+  }
+  EXPECT_GT(repeat["wallMicros"]["min"], 0);
+}
+
+TEST(RepeatedRunsTest, ConfidenceIntervalShouldUseStudentTQuantiles) {
+  // a few runs have a wide interval, which narrows to the normal one as runs are added
+  EXPECT_DOUBLE_EQ(12.706, StudentTQuantile95(1));
+  EXPECT_DOUBLE_EQ(4.303, StudentTQuantile95(2));
+  EXPECT_DOUBLE_EQ(2.262, StudentTQuantile95(9));
+  EXPECT_DOUBLE_EQ(2.042, StudentTQuantile95(35));
+  EXPECT_DOUBLE_EQ(2.000, StudentTQuantile95(100));
+  EXPECT_DOUBLE_EQ(1.980, StudentTQuantile95(100000));
+  EXPECT_TRUE(std::isinf(StudentTQuantile95(0)));
+  for (size_t degrees_of_freedom = 1; degrees_of_freedom < 200; ++degrees_of_freedom) {
+    EXPECT_GE(StudentTQuantile95(degrees_of_freedom), StudentTQuantile95(degrees_of_freedom + 1));
+  }
+}
+
+TEST_F(FunctionalTest, ShouldStreamGeneratedInputIntoProgramAndHashIt) {
+  // given: a generator of a test bigger than the pipe buffers
+  WithProgram(/* language=C */ R"bibakuka(
+    #include <stdio.h>
+    int main() {
+      long long count = 0, sum = 0, value;
+      while (scanf("%lld", &value) == 1) {
+        ++count;
+        sum += value;
+      }
+      printf("%lld %lld\n", count, sum);
+    }
+  )bibakuka");
+  fs::path generator = WithAuxiliaryProgram("generator", /* language=C */ R"bibakuka(
+    #include <stdio.h>
+    #include <stdlib.h>
+    int main(int argc, char **argv) {
+      long long n = atoll(argv[1]), seed = atoll(argv[2]);
+      for (long long i = 1; i <= n; ++i) {
+        printf("%lld\n", i * seed);
+      }
+    }
+  )bibakuka");
+  std::string expected_input;
+  for (long long i = 1; i <= 200'000; ++i) {
+    expected_input += std::to_string(i * 7) + "\n";
+  }
+  Sha256 expected_sha256;
+  expected_sha256.Update(expected_input.data(), expected_input.size());
+  WithConfig({{kGeneratorKey, {{"executable", generator.string()},
+                               {"argv", {"generator", "200000"}},
+                               {"seed", 7},
+                               {"expectedSha256", "sha256:" + expected_sha256.HexDigest()}}}});
+
+  // when
+  int runner_exit_status = ExecuteRunner();
+
+  // then
+  ASSERT_EQ(0, runner_exit_status);
+  EXPECT_EQ("200000 140000700000\n", ReadTextFile(program_stdout_file()));
+  auto exit_status = nlohmann::json::parse(ReadTextFile(program_exit_status_file()));
+  EXPECT_EQ("ok", exit_status["verdict"]);
+  EXPECT_EQ(0, exit_status[kGeneratorKey]["exitCode"]);
+  EXPECT_EQ(expected_input.size(), exit_status[kGeneratorKey]["bytes"]);
+  EXPECT_EQ(expected_input.size(), exit_status[kGeneratorKey]["relayedBytes"]);
+  EXPECT_EQ(true, exit_status[kGeneratorKey]["sha256Matches"]);
+}
+
+TEST_F(FunctionalTest, MemoryTimelineInterceptorShouldTrackPeakAndDenyAllocationsOverLimit) {
+  // given
+  WithProgram(/* language=C */ R"bibakuka(
+    #include <fcntl.h>
+    #include <stdio.h>
+    #include <stdlib.h>
+    #include <string.h>
+    #include <sys/mman.h>
+    int main() {
+      char *block = malloc(32 << 20);
+      memset(block, 1, 32 << 20);
+      free(block);
+      char *huge = malloc(256 << 20);
+      printf("%s\n", huge ? "allocated" : "denied");
+      // the pages of a private writable mapping of a file are the tracee's own as well
+      void *zeros = mmap(NULL, 256 << 20, PROT_READ | PROT_WRITE, MAP_PRIVATE, open("/dev/zero", O_RDWR), 0);
+      printf("%s\n", zeros != MAP_FAILED ? "allocated" : "denied");
+      return 0;
+    }
+  )bibakuka");
+  fs::create_directory("job");
+  WithConfig({{kWorkingDirectoryKey, "job"},
+              {kStdoutFileKey, fs::absolute(kDefaultStdoutFile)},
+              {"interceptors", {{{"name", "MemoryTimelineInterceptor"},
+                                 {"timelineFile", "timeline.json"},
+                                 {"rssSampleIntervalMillis", 0},
+                                 {"limitBytes", 128 << 20}}}}});
+
+  // when
+  int runner_exit_status = ExecuteRunner();
+
+  // then
+  ASSERT_EQ(0, runner_exit_status);
+  EXPECT_EQ("denied\ndenied\n", ReadTextFile(program_stdout_file()));
+  auto exit_status = nlohmann::json::parse(ReadTextFile(program_exit_status_file()));
+  const auto &statistics = exit_status["interceptors"][0];
+  EXPECT_GE(statistics["peak"]["bytes"].get<uint64_t>(), 32u << 20);
+  EXPECT_LT(statistics["peak"]["bytes"].get<uint64_t>(), 128u << 20);
+  EXPECT_GT(statistics["peak"]["syscallIndex"].get<uint64_t>(), 0u);
+  EXPECT_GE(statistics["peakRssBytes"].get<int64_t>(), 32 << 20);
+  EXPECT_GE(statistics["deniedAllocations"].get<uint64_t>(), 2u);
+  EXPECT_LT(statistics["finalBytes"].get<uint64_t>(), 32u << 20);
+
+  // and: the series covers the allocation and the release, it is written to the working directory of the tracee
+  EXPECT_EQ("job/timeline.json", statistics["timelineFile"]);
+  auto timeline = nlohmann::json::parse(ReadTextFile("job/timeline.json"));
+  EXPECT_EQ(statistics["points"], timeline["points"].size());
+  EXPECT_EQ("anonymousBytes", timeline["columns"][3]);
+}
+
+TEST_F(FunctionalTest, SamplingProfilerInterceptorShouldFoldStacksOfHotFunctions) {
+  if (!IsPerfEventAvailable()) {
+    GTEST_SKIP() << "perf events are not available";
+  }
+  // given
+  WithProgram(/* language=C */ R"bibakuka(
+    #include <signal.h>
+    #include <stdio.h>
+    #include <string.h>
+    static volatile int foreign_sigprof;
+    static volatile unsigned long result;
+    static void on_sigprof(int signal_number) {
+      foreign_sigprof = 1;
+    }
+    __attribute__((noinline)) unsigned long hot_loop(unsigned long n) {
+      unsigned long sum = 0;
+      for (unsigned long i = 0; i < n; ++i) {
+        sum += i * i ^ (sum >> 3);
+      }
+      return sum;
+    }
+    __attribute__((noinline)) unsigned long solve(void) {
+      // not a tail call, so the frame of solve stays on the stack
+      return hot_loop(50000000UL) + 1;
+    }
+    int main() {
+      signal(SIGPROF, on_sigprof);
+      result = solve();
+      printf("%s\n", foreign_sigprof ? "observed" : "unobserved");
+      return 0;
+    }
+  )bibakuka", "-O0 -fno-omit-frame-pointer");
+  fs::create_directory("job");
+  WithConfig({{kWorkingDirectoryKey, "job"},
+              {kStdoutFileKey, fs::absolute(kDefaultStdoutFile)},
+              {"interceptors", {{{"name", "SamplingProfilerInterceptor"},
+                                 {"frequencyHz", 1000},
+                                 {"foldedStacksFile", "stacks.folded"}}}}});
+
+  // when
+  int runner_exit_status = ExecuteRunner();
+
+  // then: the profiler's signals don't reach the program
+  ASSERT_EQ(0, runner_exit_status);
+  EXPECT_EQ("unobserved\n", ReadTextFile(program_stdout_file()));
+  auto exit_status = nlohmann::json::parse(ReadTextFile(program_exit_status_file()));
+  const auto &statistics = exit_status["interceptors"][0];
+  EXPECT_GT(statistics["samples"].get<uint64_t>(), 10u);
+  EXPECT_EQ("hot_loop", statistics["topFunctions"][0]["function"]);
+
+  // and: the hot function is reached through its callers, the profile is written to the working directory of the
+  // tracee
+  EXPECT_EQ("job/stacks.folded", statistics["foldedStacksFile"]);
+  const std::string folded_stacks = ReadTextFile("job/stacks.folded");
+  EXPECT_NE(std::string::npos, folded_stacks.find("main;solve;hot_loop ")) << folded_stacks;
+}
+
+TEST_F(FunctionalTest, PathPolicyInterceptorShouldDenyPathsByLongestRule) {
+  // given
+  WithProgram(/* language=C */ R"bibakuka(
+    #include <errno.h>
+    #include <fcntl.h>
+    #include <stdio.h>
+    #include <unistd.h>
+    static void try_open(const char *path, int flags) {
+      int fd = open(path, flags, 0644);
+      printf("%s %s\n", path, fd >= 0 ? "ok" : errno == EACCES ? "denied" : "failed");
+      if (fd >= 0) {
+        close(fd);
+      }
+    }
+    int main() {
+      try_open("/etc/passwd", O_RDONLY);
+      try_open("/tmp/../etc//passwd", O_RDONLY);
+      try_open("/etc/ld.so.cache", O_RDONLY);
+      try_open("/etcetera", O_RDONLY);
+      try_open("output.txt", O_WRONLY | O_CREAT);
+      printf("symlink %s\n", symlink("../../../../../../../etc/passwd", "link") == 0 ? "ok"
+                               : errno == EACCES ? "denied" : "failed");
+      return 0;
+    }
+  )bibakuka");
+  WithConfig({{"interceptors", {{{"name", "PathPolicyInterceptor"},
+                                 {"rules", {{{"path", "/etc"}, {"access", "deny"}},
+                                            {{"path", "/etc/ld.so.cache"}, {"access", "allow"}}}}}}}});
+
+  // when
+  int runner_exit_status = ExecuteRunner();
+
+  // then
+  ASSERT_EQ(0, runner_exit_status);
+  EXPECT_EQ("/etc/passwd denied\n"
+            "/tmp/../etc//passwd denied\n"
+            "/etc/ld.so.cache ok\n"
+            "/etcetera failed\n"
+            "output.txt ok\n"
+            "symlink denied\n",
+            ReadTextFile(program_stdout_file()));
+  auto exit_status = nlohmann::json::parse(ReadTextFile(program_exit_status_file()));
+  const auto &statistics = exit_status["interceptors"][0];
+  EXPECT_EQ(3, statistics["deniedSyscalls"]);
+  EXPECT_EQ("openat /etc/passwd", statistics["denials"][0]);
+}
+
+TEST_F(FunctionalTest, PathPolicyInterceptorShouldCheckExecutedFilesWithSyscallFilter) {
+  // given
+  WithProgram(/* language=C */ R"bibakuka(
+    #include <errno.h>
+    #include <stdio.h>
+    #include <unistd.h>
+    int main() {
+      execl("/usr/bin/env", "env", (char *) NULL);
+      printf("%s\n", errno == EACCES ? "denied" : "failed");
+      return 0;
+    }
+  )bibakuka");
+  WithConfig({{kSyscallFilterKey, true},
+              {"interceptors", {{{"name", "PathPolicyInterceptor"},
+                                 {"rules", {{{"path", "/usr/bin"}, {"access", "deny"}}}}}}}});
+
+  // when: the tracee stops on the selected syscalls only, execve among them, from the exec of the program on
+  int runner_exit_status = ExecuteRunner();
+
+  // then: the exec of the program itself is let through
+  ASSERT_EQ(0, runner_exit_status);
+  EXPECT_EQ("denied\n", ReadTextFile(program_stdout_file()));
+  auto exit_status = nlohmann::json::parse(ReadTextFile(program_exit_status_file()));
+  EXPECT_EQ("ok", exit_status["verdict"]);
+  EXPECT_EQ("execve /usr/bin/env", exit_status["interceptors"][0]["denials"][0]);
+}
+
+TEST_F(FunctionalTest, PathPolicyInterceptorShouldResolvePathsAsKernelDoes) {
+  // given: the paths lead to a denied file through magic links of procfs, a symbolic link on the host and
+  // a descriptor
+  WithProgram(/* language=C */ R"bibakuka(
+    #include <errno.h>
+    #include <fcntl.h>
+    #include <stdio.h>
+    #include <unistd.h>
+    static void try_open(const char *name, int dirfd, const char *path, int flags) {
+      int fd = openat(dirfd, path, flags, 0644);
+      printf("%s %s\n", name, fd >= 0 ? "ok" : errno == EACCES ? "denied" : "failed");
+      if (fd >= 0) {
+        close(fd);
+      }
+    }
+    int main() {
+      try_open("root", AT_FDCWD, "/proc/self/root/etc/passwd", O_RDONLY);
+      try_open("thread-root", AT_FDCWD, "/proc/thread-self/root/etc/passwd", O_RDONLY);
+      try_open("cwd", AT_FDCWD, "/proc/self/cwd/../../../../../../../etc/passwd", O_RDONLY);
+      try_open("host-link", AT_FDCWD, "etc-link/passwd", O_RDONLY);
+      try_open("descriptor", open("/", O_RDONLY | O_DIRECTORY), "etc/passwd", O_RDONLY);
+      try_open("allowed", AT_FDCWD, "/proc/self/cwd/output.txt", O_WRONLY | O_CREAT);
+      return 0;
+    }
+  )bibakuka");
+  fs::create_directory_symlink("/etc", "etc-link");
+  WithConfig({{"interceptors", {{{"name", "PathPolicyInterceptor"},
+                                 {"rules", {{{"path", "/etc"}, {"access", "deny"}},
+                                            {{"path", "/etc/ld.so.cache"}, {"access", "allow"}}}}}}}});
+
+  // when
+  int runner_exit_status = ExecuteRunner();
+
+  // then
+  ASSERT_EQ(0, runner_exit_status);
+  EXPECT_EQ("root denied\n"
+            "thread-root denied\n"
+            "cwd denied\n"
+            "host-link denied\n"
+            "descriptor denied\n"
+            "allowed ok\n",
+            ReadTextFile(program_stdout_file()));
+  auto exit_status = nlohmann::json::parse(ReadTextFile(program_exit_status_file()));
+  const auto &statistics = exit_status["interceptors"][0];
+  EXPECT_EQ(5, statistics["deniedSyscalls"]);
+  for (const auto &denial : statistics["denials"]) {
+    EXPECT_EQ("openat /etc/passwd", denial);
+  }
+}
+
+TEST_F(FunctionalTest, PathPolicyInterceptorShouldDenyX32Syscalls) {
+  // given: the program opens a denied file by the x32 variant of openat, which the runner doesn't decode
+  WithProgram(/* language=C */ R"bibakuka(
+    #include <errno.h>
+    #include <fcntl.h>
+    #include <stdio.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+    int main() {
+      long fd = syscall(0x40000000 | SYS_openat, AT_FDCWD, "/etc/passwd", O_RDONLY);
+      printf("%s\n", fd >= 0 ? "ok" : errno == ENOSYS ? "denied" : "failed");
+      return 0;
+    }
+  )bibakuka");
+
+  for (bool syscall_filter : {false, true}) {
+    WithConfig({{kSyscallFilterKey, syscall_filter},
+                {"interceptors", {{{"name", "PathPolicyInterceptor"},
+                                   {"rules", {{{"path", "/etc/passwd"}, {"access", "deny"}}}}}}}});
+
+    // when
+    int runner_exit_status = ExecuteRunner();
+
+    // then: the syscall fails as if the kernel had no x32 support, by the interceptor or by the filter (a kernel
+    // built without it fails the syscall the same way)
+    ASSERT_EQ(0, runner_exit_status) << "syscall_filter=" << syscall_filter;
+    EXPECT_EQ("denied\n", ReadTextFile(program_stdout_file())) << "syscall_filter=" << syscall_filter;
+  }
+}
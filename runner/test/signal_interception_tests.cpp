@@ -0,0 +1,246 @@
+#include <cerrno>
+#include <csignal>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <sys/ptrace.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include <kourt/runner/interceptors.h>
+#include <kourt/runner/tracee_controller.h>
+#include <kourt/runner/tracing.h>
+
+/// Interceptors changing signals are run by a real controller against a forked child, which reports what it has
+/// observed with its exit code.
+class SignalInterceptionTest : public ::testing::Test {
+ protected:
+  /// Runs <code>body</code> in a traced child and returns its wait status.
+  static int Trace(const std::function<int()> &body, std::unique_ptr<StoppedTraceeInterceptor> interceptor) {
+    pid_t pid = fork();
+    if (0 == pid) {
+      ptrace(PTRACE_TRACEME, 0, nullptr, nullptr);
+      raise(SIGSTOP);
+      _exit(body());
+    }
+    Tracee tracee(pid);
+    std::vector<std::unique_ptr<StoppedTraceeInterceptor>> interceptors;
+    interceptors.push_back(std::move(interceptor));
+    TraceeController controller(tracee, std::move(interceptors));
+    return controller.ExecuteTracee();
+  }
+};
+
+/// Applies <code>on_signal</code> at every signal-delivery-stop, <code>on_syscall</code> at every syscall entry and
+/// <code>on_syscall_exit</code> at every syscall exit.
+class LambdaInterceptor : public virtual NoOpStoppedTraceeInterceptor {
+ public:
+  explicit LambdaInterceptor(std::function<void(BeforeSignalDeliveryStoppedTracee &)> on_signal,
+                             std::function<void(BeforeSyscallStoppedTracee &)> on_syscall = nullptr,
+                             std::function<void(AfterSyscallStoppedTracee &)> on_syscall_exit = nullptr) :
+      on_signal_(std::move(on_signal)),
+      on_syscall_(std::move(on_syscall)),
+      on_syscall_exit_(std::move(on_syscall_exit)) {
+    // nop
+  }
+
+ protected:
+  bool Intercept(BeforeSignalDeliveryStoppedTracee &tracee) override {
+    if (on_signal_) {
+      on_signal_(tracee);
+    }
+    return false;
+  }
+  bool Intercept(BeforeSyscallStoppedTracee &tracee) override {
+    if (on_syscall_) {
+      on_syscall_(tracee);
+    }
+    return false;
+  }
+  bool Intercept(AfterSyscallStoppedTracee &tracee) override {
+    if (on_syscall_exit_) {
+      on_syscall_exit_(tracee);
+    }
+    return false;
+  }
+
+ private:
+  std::function<void(BeforeSignalDeliveryStoppedTracee &)> on_signal_;
+  std::function<void(BeforeSyscallStoppedTracee &)> on_syscall_;
+  std::function<void(AfterSyscallStoppedTracee &)> on_syscall_exit_;
+};
+
+// what the child's handler has observed
+static volatile sig_atomic_t handled_signal;
+static volatile sig_atomic_t handled_code;
+static volatile sig_atomic_t handled_value;
+
+static void RecordSignal(int signal_number, siginfo_t *info, void *) {
+  handled_signal = signal_number;
+  handled_code = info->si_code;
+  handled_value = info->si_value.sival_int;
+}
+
+static void HandleWithInfo(int signal_number) {
+  struct sigaction action{};
+  action.sa_sigaction = RecordSignal;
+  action.sa_flags = SA_SIGINFO;
+  sigaction(signal_number, &action, nullptr);
+}
+
+static siginfo_t QueuedSignalInfo(int signal_number, int value) {
+  siginfo_t info{};
+  info.si_signo = signal_number;
+  info.si_code = SI_QUEUE;
+  info.si_pid = getpid();
+  info.si_uid = getuid();
+  info.si_value.sival_int = value;
+  return info;
+}
+
+TEST_F(SignalInterceptionTest, SuppressedSignalShouldNotReachTracee) {
+  // when: the default action of SIGUSR1 would terminate the tracee
+  int status = Trace([] {
+    raise(SIGUSR1);
+    return 7;
+  }, std::make_unique<LambdaInterceptor>([](BeforeSignalDeliveryStoppedTracee &tracee) {
+    if (tracee.SignalNumber() == SIGUSR1) {
+      tracee.SuppressSignal();
+    }
+  }));
+
+  // then
+  ASSERT_TRUE(WIFEXITED(status));
+  EXPECT_EQ(7, WEXITSTATUS(status));
+}
+
+TEST_F(SignalInterceptionTest, ReplacedSignalNumberShouldBeDelivered) {
+  // when
+  int status = Trace([] {
+    HandleWithInfo(SIGUSR2);
+    raise(SIGUSR1);
+    return handled_signal;
+  }, std::make_unique<LambdaInterceptor>([](BeforeSignalDeliveryStoppedTracee &tracee) {
+    if (tracee.SignalNumber() == SIGUSR1) {
+      tracee.SetSignalNumber(SIGUSR2);
+    }
+  }));
+
+  // then
+  ASSERT_TRUE(WIFEXITED(status));
+  EXPECT_EQ(SIGUSR2, WEXITSTATUS(status));
+}
+
+TEST_F(SignalInterceptionTest, ReplacedSignalInfoShouldBeSeenByHandler) {
+  // when
+  int status = Trace([] {
+    HandleWithInfo(SIGUSR1);
+    raise(SIGUSR1);
+    return handled_code == SI_QUEUE ? handled_value : 0;
+  }, std::make_unique<LambdaInterceptor>([](BeforeSignalDeliveryStoppedTracee &tracee) {
+    if (tracee.SignalNumber() == SIGUSR1) {
+      EXPECT_EQ(SI_TKILL, tracee.SignalInfo().si_code);
+      tracee.SetSignalInfo(QueuedSignalInfo(SIGUSR1, 42));
+    }
+  }));
+
+  // then
+  ASSERT_TRUE(WIFEXITED(status));
+  EXPECT_EQ(42, WEXITSTATUS(status));
+}
+
+TEST_F(SignalInterceptionTest, SignalInjectedWithInfoShouldBeSeenByHandlerWithIt) {
+  // when: the signal is injected at the entry of getppid
+  int status = Trace([] {
+    HandleWithInfo(SIGUSR1);
+    syscall(SYS_getppid);
+    return handled_code == SI_QUEUE ? handled_value : 0;
+  }, std::make_unique<LambdaInterceptor>(nullptr, [](BeforeSyscallStoppedTracee &tracee) {
+    if (tracee.SyscallNumber() == __NR_getppid) {
+      tracee.InjectSignal(QueuedSignalInfo(SIGUSR1, 42));
+    }
+  }));
+
+  // then
+  ASSERT_TRUE(WIFEXITED(status));
+  EXPECT_EQ(42, WEXITSTATUS(status));
+}
+
+TEST_F(SignalInterceptionTest, InfoOfUndeliveredInjectedSignalShouldNotApplyToLaterSignal) {
+  // when: the injected signal is blocked, taken with sigtimedwait without a signal-delivery-stop, and then
+  // the tracee sends itself the same signal
+  int status = Trace([] {
+    HandleWithInfo(SIGUSR1);
+    sigset_t usr1;
+    sigemptyset(&usr1);
+    sigaddset(&usr1, SIGUSR1);
+    sigprocmask(SIG_BLOCK, &usr1, nullptr);
+    syscall(SYS_getppid);
+    timespec timeout{1, 0};
+    if (sigtimedwait(&usr1, nullptr, &timeout) != SIGUSR1) {
+      return 1;
+    }
+    sigprocmask(SIG_UNBLOCK, &usr1, nullptr);
+    raise(SIGUSR1);
+    return handled_code == SI_TKILL ? 0 : 2;
+  }, std::make_unique<LambdaInterceptor>(nullptr, [](BeforeSyscallStoppedTracee &tracee) {
+    if (tracee.SyscallNumber() == __NR_getppid) {
+      tracee.InjectSignal(QueuedSignalInfo(SIGUSR1, 42));
+    }
+  }));
+
+  // then
+  ASSERT_TRUE(WIFEXITED(status));
+  EXPECT_EQ(0, WEXITSTATUS(status));
+}
+
+TEST_F(SignalInterceptionTest, SyscallExitShouldReportSyscallAsModifiedAtEntry) {
+  // given: the count of a read is shrunk and a getppid is cancelled at their entries
+  // a value as reported by the exit stop and as read back from the registers
+  using Observed = std::pair<unsigned long, unsigned long>;
+  bool entry_modified = false;
+  std::vector<Observed> exit_numbers;
+  std::vector<Observed> exit_counts;
+  auto shrink_or_cancel = [&entry_modified](BeforeSyscallStoppedTracee &tracee) {
+    if (tracee.As<ReadCall>()) {
+      tracee.SetArg3(4);
+      entry_modified = true;
+    } else if (tracee.SyscallNumber() == __NR_getppid) {
+      tracee.SkipSyscall(-EPERM);
+      entry_modified = true;
+    }
+  };
+  // the exit stop is built from the syscall info where the kernel supports it, the registers are the fallback
+  auto compare_with_registers = [&](AfterSyscallStoppedTracee &tracee) {
+    if (entry_modified) {
+      SyscallRegisters registers = tracee.LoadRegisters();
+      exit_numbers.emplace_back(tracee.SyscallNumber(), registers.SyscallNumber());
+      exit_counts.emplace_back(tracee.Arg3(), registers.Arg(2));
+      entry_modified = false;
+    }
+  };
+
+  // when
+  int status = Trace([] {
+    static char buffer[16];
+    int fds[2];
+    if (0 != pipe(fds) || 16 != write(fds[1], "0123456789abcdef", 16)) {
+      return 1;
+    }
+    long bytes_read = read(fds[0], buffer, sizeof(buffer));
+    return (syscall(SYS_getppid) == -1 && errno == EPERM) ? static_cast<int>(bytes_read) : 2;
+  }, std::make_unique<LambdaInterceptor>(nullptr, shrink_or_cancel, compare_with_registers));
+
+  // then: both report the count and the number the kernel has seen
+  ASSERT_TRUE(WIFEXITED(status));
+  EXPECT_EQ(4, WEXITSTATUS(status));
+  ASSERT_EQ(2u, exit_numbers.size());
+  EXPECT_EQ(Observed(__NR_read, __NR_read), exit_numbers[0]);
+  EXPECT_EQ(Observed(4, 4), exit_counts[0]);
+  EXPECT_EQ(Observed(kCancelledSyscall, kCancelledSyscall), exit_numbers[1]);
+}
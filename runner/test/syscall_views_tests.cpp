@@ -0,0 +1,252 @@
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/ptrace.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include <kourt/runner/registers.h>
+#include <kourt/runner/syscall_filter.h>
+#include <kourt/runner/syscalls.h>
+#include <kourt/runner/tracing.h>
+
+/// The syscalls of a forked child are decoded at their real syscall-enter-stops, as the controller sees them.
+class SyscallViewsTest : public ::testing::Test {
+ protected:
+  void TearDown() override {
+    if (pid_ > 0) {
+      kill(pid_, SIGKILL);
+      waitpid(pid_, nullptr, 0);
+    }
+  }
+
+  /// Forks a traced child which runs <code>body</code> once the test has attached to it.
+  void StartTracee(const std::function<void()> &body) {
+    pid_ = fork();
+    ASSERT_GE(pid_, 0);
+    if (0 == pid_) {
+      ptrace(PTRACE_TRACEME, 0, nullptr, nullptr);
+      raise(SIGSTOP);
+      body();
+      _exit(0);
+    }
+    int status;
+    ASSERT_EQ(pid_, waitpid(pid_, &status, 0));
+    ASSERT_TRUE(WIFSTOPPED(status));
+    ASSERT_EQ(0, ptrace(PTRACE_SETOPTIONS, pid_, nullptr, (void *) (PTRACE_O_TRACESYSGOOD | PTRACE_O_EXITKILL)));
+  }
+
+  /**
+   * Runs the tracee up to the entry of the syscall with the native number <code>Call::kNumber</code>.
+   *
+   * @param from_syscall_info whether the stop is built from <code>PTRACE_GET_SYSCALL_INFO</code>, as the controller
+   *                          does where the kernel supports it, rather than from the register set
+   */
+  template<typename Call>
+  std::optional<Call> DecodeNext(bool from_syscall_info) {
+    for (;;) {
+      if (0 != ptrace(PTRACE_SYSCALL, pid_, nullptr, nullptr)) {
+        return std::nullopt;
+      }
+      int status;
+      if (pid_ != waitpid(pid_, &status, 0) || !WIFSTOPPED(status)) {
+        pid_ = -1;
+        return std::nullopt;
+      }
+      if (WSTOPSIG(status) != (SIGTRAP | 0x80)) {
+        continue;
+      }
+      __ptrace_syscall_info info{};
+      ptrace(PTRACE_GET_SYSCALL_INFO, pid_, (void *) sizeof(info), &info);
+      if (info.op != PTRACE_SYSCALL_INFO_ENTRY) {
+        continue;
+      }
+      snapshot_ = SyscallRegisters();
+      snapshot_.LoadSyscallInfo(info);
+      std::optional<BeforeSyscallStoppedTracee> stop;
+      if (from_syscall_info) {
+        stop.emplace(tracee_, snapshot_);
+      } else {
+        stop.emplace(tracee_);
+      }
+      if (auto call = stop->template As<Call>()) {
+        abi_ = stop->Abi();
+        return call;
+      }
+    }
+  }
+
+  pid_t pid_{-1};
+  Tracee tracee_{0};
+  SyscallAbi abi_{SyscallAbi::kX86_64};
+  // the syscall info of the last stop
+  SyscallRegisters snapshot_;
+};
+
+static char buffer[64];
+
+// The sixth argument would go to ebp, which holds the frame here; the tests leave it alone.
+static long Ia32Syscall5(long number, long arg1, long arg2, long arg3, long arg4, long arg5) {
+  long result;
+  __asm__ volatile ("int $0x80"
+      : "=a"(result)
+      : "a"(number), "b"(arg1), "c"(arg2), "d"(arg3), "S"(arg4), "D"(arg5)
+      : "memory");
+  return result;
+}
+
+TEST_F(SyscallViewsTest, ShouldDecodeReadFromRegisterSetAndSyscallInfo) {
+  for (bool from_syscall_info : {false, true}) {
+    // given
+    StartTracee([] { read(7, buffer, 42); });
+    tracee_ = Tracee(pid_);
+
+    // when
+    auto read_call = DecodeNext<ReadCall>(from_syscall_info);
+
+    // then
+    ASSERT_TRUE(read_call) << "from_syscall_info=" << from_syscall_info;
+    EXPECT_EQ(SyscallAbi::kX86_64, abi_);
+    EXPECT_EQ(7, read_call->fd);
+    EXPECT_EQ(reinterpret_cast<unsigned long>(buffer), read_call->buf);
+    EXPECT_EQ(42u, read_call->count);
+    TearDown();
+  }
+}
+
+TEST_F(SyscallViewsTest, ShouldDecodeOpenatWithPathInTraceeMemory) {
+  // given
+  StartTracee([] { open("views/path.txt", O_RDONLY | O_CLOEXEC); });
+  tracee_ = Tracee(pid_);
+
+  // when
+  auto openat_call = DecodeNext<OpenatCall>(false);
+
+  // then
+  ASSERT_TRUE(openat_call);
+  EXPECT_EQ(AT_FDCWD, openat_call->dirfd);
+  EXPECT_EQ(O_RDONLY | O_CLOEXEC, openat_call->flags & (O_ACCMODE | O_CLOEXEC));
+  char path[64] = {};
+  tracee_.ReadMemory(openat_call->path, path, sizeof(path) - 1);
+  EXPECT_STREQ("views/path.txt", path);
+}
+
+TEST_F(SyscallViewsTest, ShouldDecodeAllSixArgumentsOfMmap) {
+  // given
+  StartTracee([] { mmap(nullptr, 12345, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 8192); });
+  tracee_ = Tracee(pid_);
+
+  // when
+  auto mmap_call = DecodeNext<MmapCall>(false);
+
+  // then
+  ASSERT_TRUE(mmap_call);
+  EXPECT_EQ(0u, mmap_call->addr);
+  EXPECT_EQ(12345u, mmap_call->length);
+  EXPECT_EQ(PROT_READ, mmap_call->prot);
+  EXPECT_EQ(MAP_PRIVATE | MAP_ANONYMOUS, mmap_call->flags);
+  EXPECT_EQ(-1, mmap_call->fd);
+  EXPECT_EQ(8192, mmap_call->offset);
+}
+
+TEST_F(SyscallViewsTest, ShouldDecodeIa32SyscallsAsNativeOnes) {
+  // given: ia32 syscalls made by a 64-bit process, told apart by the ABI the kernel reports
+  StartTracee([] {
+    enum { kRead = 3, kMmap2 = 192 };
+    Ia32Syscall5(kRead, 7, reinterpret_cast<long>(buffer), 42, 0, 0);
+    Ia32Syscall5(kMmap2, 0, 12345, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1);
+  });
+  tracee_ = Tracee(pid_);
+
+  // when
+  auto read_call = DecodeNext<ReadCall>(true);
+
+  // then
+  ASSERT_TRUE(read_call);
+  EXPECT_EQ(SyscallAbi::kI386, abi_);
+  EXPECT_EQ(7, read_call->fd);
+  // the ia32 ABI passes the low half of the address only
+  EXPECT_EQ(static_cast<uint32_t>(reinterpret_cast<unsigned long>(buffer)), read_call->buf);
+  EXPECT_EQ(42u, read_call->count);
+
+  // when
+  auto mmap_call = DecodeNext<MmapCall>(true);
+
+  // then: the arguments are taken from ebx, ecx, edx, esi and edi, the descriptor is sign-extended
+  ASSERT_TRUE(mmap_call);
+  EXPECT_EQ(SyscallAbi::kI386, abi_);
+  EXPECT_EQ(12345u, mmap_call->length);
+  EXPECT_EQ(PROT_READ, mmap_call->prot);
+  EXPECT_EQ(MAP_PRIVATE | MAP_ANONYMOUS, mmap_call->flags);
+  EXPECT_EQ(-1, mmap_call->fd);
+}
+
+TEST_F(SyscallViewsTest, ShouldDescribeCancelledSyscallInBothAbis) {
+  // given
+  StartTracee([] {
+    read(7, buffer, 42);
+    Ia32Syscall5(3, 7, reinterpret_cast<long>(buffer), 42, 0, 0);
+  });
+  tracee_ = Tracee(pid_);
+
+  for (SyscallAbi abi : {SyscallAbi::kX86_64, SyscallAbi::kI386}) {
+    ASSERT_TRUE(DecodeNext<ReadCall>(true));
+    ASSERT_EQ(abi, abi_);
+    BeforeSyscallStoppedTracee stop(tracee_, snapshot_);
+    EXPECT_EQ(0u, stop.Describe().find("read(fd=7, "));
+
+    // when
+    stop.SkipSyscall(-EINTR);
+
+    // then
+    EXPECT_EQ("cancelled_syscall()", stop.Describe());
+
+    // and: as read back from the tracee
+    SyscallRegisters reloaded = snapshot_;
+    reloaded.Load(tracee_);
+    EXPECT_EQ("cancelled_syscall()", BeforeSyscallStoppedTracee(tracee_, reloaded).Describe());
+  }
+}
+
+TEST_F(SyscallViewsTest, SyscallFilterShouldStopOnLegacyIa32Numbers) {
+  // given: a filter selecting syscalls which have two ia32 numbers each
+  SyscallFilter filter({__NR_truncate, __NR_fstat, __NR_fcntl});
+  enum { kTruncate = 92, kFstat = 108, kFcntl = 55, kTruncate64 = 193, kFstat64 = 197, kFcntl64 = 221 };
+  StartTracee([&filter] {
+    if (!filter.InstallInChild()) {
+      _exit(1);
+    }
+    for (long number : {kTruncate, kFstat, kFcntl, kTruncate64, kFstat64, kFcntl64}) {
+      Ia32Syscall5(number, 0, 0, 0, 0, 0);
+    }
+  });
+  ASSERT_EQ(0, ptrace(PTRACE_SETOPTIONS, pid_, nullptr, (void *) (PTRACE_O_TRACESECCOMP | PTRACE_O_EXITKILL)));
+
+  // when
+  std::vector<unsigned long> stopped_on;
+  int status;
+  while (0 == ptrace(PTRACE_CONT, pid_, nullptr, nullptr) && pid_ == waitpid(pid_, &status, 0)
+      && WIFSTOPPED(status)) {
+    if (status >> 8 == (SIGTRAP | (PTRACE_EVENT_SECCOMP << 8))) {
+      __ptrace_syscall_info info{};
+      ptrace(PTRACE_GET_SYSCALL_INFO, pid_, (void *) sizeof(info), &info);
+      stopped_on.push_back(info.seccomp.nr);
+    }
+  }
+
+  // then: the kernel stops on the legacy numbers as well
+  ASSERT_TRUE(WIFEXITED(status));
+  pid_ = -1;
+  EXPECT_EQ(0, WEXITSTATUS(status));
+  std::vector<unsigned long> expected{kTruncate, kFstat, kFcntl, kTruncate64, kFstat64, kFcntl64};
+  EXPECT_EQ(expected, stopped_on);
+}
@@ -0,0 +1,63 @@
+import json
+from pathlib import Path
+
+import pytest
+from munch import Munch
+
+from agent.calibration import (
+    CALIBRATION_FILE_ENV_VARIABLE, calibration_key, load_profiles, profile_from_exit_status, resolve_limits,
+    save_profiles
+)
+from agent.execution import EXIT_STATUS_FILE
+from agent.validation import validate_execution_results
+
+
+@pytest.fixture(autouse=True)
+def calibration_file(tmp_path, monkeypatch):
+    calibration_file = tmp_path / 'calibration.json'
+    monkeypatch.setenv(CALIBRATION_FILE_ENV_VARIABLE, str(calibration_file))
+    return calibration_file
+
+
+def test_profiles_should_be_kept_per_cpu_model():
+    save_profiles({'sum-numbers/test-suite.yml#0': {'cpuMicros': 100}}, cpu_model='slow')
+    save_profiles({'sum-numbers/test-suite.yml#0': {'cpuMicros': 40}}, cpu_model='fast')
+
+    assert load_profiles('slow') == {'sum-numbers/test-suite.yml#0': {'cpuMicros': 100}}
+    assert load_profiles('fast') == {'sum-numbers/test-suite.yml#0': {'cpuMicros': 40}}
+    assert load_profiles('unknown') == {}
+
+
+def test_calibration_key_should_not_depend_on_checkout_location():
+    assert calibration_key(Path('/a/problems/sum-numbers/test-suites/suite.yml'), 2) \
+           == calibration_key(Path('/b/problems/sum-numbers/test-suites/suite.yml'), 2) \
+           == 'sum-numbers/suite.yml#2'
+
+
+def test_limits_should_be_multiples_of_reference_profile():
+    profile = profile_from_exit_status({
+        'repeat': {'cpuMicros': {'median': 50_000}, 'wallMicros': {'median': 60_000}},
+        'instructions': {'event': 'instructions', 'count': 1_000_000, 'limit': 1 << 62},
+    })
+
+    runner_config, limits = resolve_limits(Munch(timeFactor=3, instructionFactor=1.5), profile)
+
+    assert runner_config == {'instructionLimit': 1_500_000}
+    assert limits == {'cpuMicros': 150_000}
+
+
+def test_limits_should_not_be_applied_without_profile():
+    assert resolve_limits(Munch(timeFactor=3), None) == ({}, {})
+
+
+def test_instruction_limit_verdict_should_fail_validation_without_other_limits(tmp_path):
+    (tmp_path / EXIT_STATUS_FILE).write_text(json.dumps({
+        'verdict': 'instructionLimitExceeded',
+        'instructions': {'event': 'instructions', 'count': 1_500_001, 'limit': 1_500_000},
+    }))
+    profile = {'instructions': 1_000_000}
+    runner_config, limits = resolve_limits(Munch(instructionFactor=1.5), profile)
+    assert limits == {}
+
+    with pytest.raises(AssertionError, match='Instruction limit 1500000 exceeded'):
+        validate_execution_results(tmp_path, Munch(), limits, runner_config)
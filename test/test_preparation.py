@@ -0,0 +1,94 @@
+from pathlib import Path
+
+import pytest
+from munch import Munch
+
+from agent import preparation as preparation_module
+from agent.preparation import prepare_for_execution, CACHE_DIR_ENV_VARIABLE
+
+
+@pytest.fixture(autouse=True)
+def cache_dir(tmp_path, monkeypatch):
+    cache_dir = tmp_path / 'cache'
+    monkeypatch.setenv(CACHE_DIR_ENV_VARIABLE, str(cache_dir))
+    return cache_dir
+
+
+@pytest.fixture
+def solution_file(tmp_path) -> Path:
+    solution_file = tmp_path / 'solution.txt'
+    solution_file.write_text('solution')
+    return solution_file
+
+
+def _counting_preparation(tmp_path: Path) -> Munch:
+    # the command records each of its invocations outside of the execution directory
+    invocations_file = tmp_path / 'invocations.txt'
+    return Munch(
+        solutionFileName='solution.txt',
+        command=f'echo run >> {invocations_file} && cp solution.txt prepared.txt'
+    )
+
+
+def _invocations(tmp_path: Path) -> int:
+    return len((tmp_path / 'invocations.txt').read_text().splitlines())
+
+
+def test_solution_should_be_prepared_once_for_many_executions(tmp_path, solution_file):
+    preparation = _counting_preparation(tmp_path)
+
+    for _ in range(3):
+        with prepare_for_execution(preparation, solution_file) as execution_dir:
+            assert (Path(execution_dir) / 'prepared.txt').read_text() == 'solution'
+
+    assert _invocations(tmp_path) == 1
+
+
+def test_changed_solution_should_be_prepared_again(tmp_path, solution_file):
+    preparation = _counting_preparation(tmp_path)
+    with prepare_for_execution(preparation, solution_file):
+        pass
+
+    solution_file.write_text('another solution')
+    with prepare_for_execution(preparation, solution_file) as execution_dir:
+        assert (Path(execution_dir) / 'prepared.txt').read_text() == 'another solution'
+
+    assert _invocations(tmp_path) == 2
+
+
+def test_failed_preparation_should_not_be_cached(tmp_path, solution_file):
+    preparation = Munch(solutionFileName='solution.txt', command=f'echo run >> {tmp_path / "invocations.txt"} && false')
+
+    for _ in range(2):
+        with prepare_for_execution(preparation, solution_file):
+            pass
+
+    assert _invocations(tmp_path) == 2
+
+
+def test_execution_should_not_modify_cached_preparation(tmp_path, solution_file):
+    preparation = _counting_preparation(tmp_path)
+    with prepare_for_execution(preparation, solution_file) as execution_dir:
+        (Path(execution_dir) / 'prepared.txt').write_text('modified')
+
+    with prepare_for_execution(preparation, solution_file) as execution_dir:
+        assert (Path(execution_dir) / 'prepared.txt').read_text() == 'solution'
+
+    assert _invocations(tmp_path) == 1
+
+
+def test_least_recently_used_preparation_should_be_evicted(tmp_path, solution_file, monkeypatch):
+    monkeypatch.setattr(preparation_module, 'MAX_CACHED_PREPARATIONS', 1)
+    preparation = _counting_preparation(tmp_path)
+    with prepare_for_execution(preparation, solution_file):
+        pass
+
+    other_solution_file = tmp_path / 'other_solution.txt'
+    other_solution_file.write_text('other solution')
+    with prepare_for_execution(preparation, other_solution_file):
+        pass
+
+    with prepare_for_execution(preparation, solution_file) as execution_dir:
+        assert (Path(execution_dir) / 'prepared.txt').read_text() == 'solution'
+
+    assert _invocations(tmp_path) == 3
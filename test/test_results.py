@@ -0,0 +1,60 @@
+import json
+import subprocess
+from pathlib import Path
+
+import pytest
+
+from agent.results import read_results, read_exit_status
+
+
+@pytest.fixture
+def project_root_dir():
+    return Path(__file__).absolute().parent.parent
+
+
+@pytest.fixture
+def runner_executable(project_root_dir) -> Path:
+    runner_dir = project_root_dir / 'runner'
+    subprocess.run('mkdir -p build', shell=True, cwd=runner_dir, check=True)
+    build_dir = runner_dir / 'build'
+    subprocess.run("cmake .. && make", shell=True, cwd=build_dir, check=True)
+    return build_dir / 'runner'
+
+
+def _run(runner_executable: Path, tmp_path: Path, config: dict, exit_code: int):
+    config_file = tmp_path / 'runner-config.json'
+    config_file.write_text(json.dumps(config))
+    subprocess.run([str(runner_executable), str(config_file), '/bin/sh', '-c', f'exit {exit_code}'],
+                   cwd=tmp_path, check=True)
+
+
+def test_results_should_be_read_from_ndjson_and_binary_records_of_runner(runner_executable, tmp_path):
+    results_file = tmp_path / 'results'
+    for result_id, result_format, exit_code in (('a', 'ndjson', 3), ('b', 'binary', 300 % 256), ('c', 'ndjson', 0)):
+        _run(runner_executable, tmp_path, {
+            'exitStatusFile': str(results_file),
+            'resultFormat': result_format,
+            'resultId': result_id,
+        }, exit_code)
+
+    results = list(read_results(results_file))
+
+    assert [(result['id'], result['exitCode'], result['verdict']) for result in results] == [
+        ('a', 3, 'nonZeroExitCode'),
+        ('b', 44, 'nonZeroExitCode'),
+        ('c', 0, 'ok'),
+    ]
+    # the binary record carries the same fields as the JSON ones
+    assert results[1].keys() == results[0].keys()
+    assert read_exit_status(results_file)['id'] == 'c'
+
+
+def test_exit_status_should_be_read_from_json_result(runner_executable, tmp_path):
+    exit_status_file = tmp_path / 'exit-status.json'
+    _run(runner_executable, tmp_path, {'exitStatusFile': str(exit_status_file)}, 5)
+
+    exit_status = read_exit_status(exit_status_file)
+
+    assert exit_status['exitCode'] == 5
+    assert exit_status['verdict'] == 'nonZeroExitCode'
+    assert 'resourceUsage' in exit_status